@@ -0,0 +1,475 @@
+#include "alloc_stats.h"
+#include "pe.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#define ALLOC_SIZE_CLASSES 18            // 16B, 32B, ..., 1MB, それより大きい
+#define ALLOC_SITE_DEPTH 6               // シムの中のフレームを含めて記録する深さ
+
+// --- シムのソース ---
+// C と C++ のどちらとしてもコンパイルできるように書く (C++ では operator new/delete もシムを通す)。
+// malloc を呼ぶ機能 (stdio、__thread の emutls など) はシムの中で使わない
+static const char g_shim_source[] =
+    "/* crun --alloc-stats: -Wl,--wrap=malloc,... でリンクするアロケーション計測用のシム */\n"
+    "#include <windows.h>\n"
+    "#include <malloc.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#ifdef __cplusplus\n"
+    "#include <new>\n"
+    "extern \"C\" {\n"
+    "#endif\n"
+    "void* __real_malloc(size_t size);\n"
+    "void* __real_calloc(size_t count, size_t size);\n"
+    "void* __real_realloc(void* p, size_t size);\n"
+    "void __real_free(void* p);\n"
+    "\n"
+    "#define CLASSES 18\n"
+    "#define SITE_SLOTS 4096\n"
+    "#define SITE_DEPTH 6\n"
+    "#define LIVE_SLOTS (1 << 20)\n"
+    "#define LIVE_PROBES 64\n"
+    "#define LIVE_FREED ((void*)1)\n"
+    "\n"
+    "/* スレッドごとのカウンタ。所有スレッドだけが書き、終了時にまとめて読む */\n"
+    "typedef struct CrunThreadCounters {\n"
+    "    struct CrunThreadCounters* next;\n"
+    "    LONGLONG classes[CLASSES];\n"
+    "    LONGLONG allocs, frees, reallocs, realloc_moves, realloc_copied, bytes;\n"
+    "} CrunThreadCounters;\n"
+    "\n"
+    "/* 呼び出し元ごとの集計 (バックトレースのハッシュで開番地法、CAS で枠を確保する) */\n"
+    "typedef struct CrunSite {\n"
+    "    volatile LONG hash;\n"
+    "    volatile LONG ready;\n"
+    "    LONG depth;\n"
+    "    void* frames[SITE_DEPTH];\n"
+    "    volatile LONGLONG count, bytes;\n"
+    "} CrunSite;\n"
+    "\n"
+    "static volatile LONG g_crun_tls = (LONG)TLS_OUT_OF_INDEXES;\n"
+    "static CrunThreadCounters* volatile g_crun_threads;\n"
+    "static volatile LONGLONG g_crun_live, g_crun_peak, g_crun_live_blocks, g_crun_untracked;\n"
+    "static volatile LONG g_crun_lost_sites;\n"
+    "static CrunSite g_crun_sites[SITE_SLOTS];\n"
+    "/* シムが確保した生きているブロック (開番地法、解放した枠は LIVE_FREED にして再利用する)。\n"
+    "   シムを通らずに確保されたもの (DLL の中の strdup など) の解放を数えないために使う */\n"
+    "static void* volatile g_crun_blocks[LIVE_SLOTS];\n"
+    "\n"
+    "static CrunThreadCounters* crun_counters(void) {\n"
+    "    if (g_crun_tls == (LONG)TLS_OUT_OF_INDEXES) {\n"
+    "        DWORD index = TlsAlloc();\n"
+    "        if (InterlockedCompareExchange(&g_crun_tls, (LONG)index, (LONG)TLS_OUT_OF_INDEXES) != (LONG)TLS_OUT_OF_INDEXES) TlsFree(index);\n"
+    "    }\n"
+    "    CrunThreadCounters* c = (CrunThreadCounters*)TlsGetValue((DWORD)g_crun_tls);\n"
+    "    if (!c) {\n"
+    "        c = (CrunThreadCounters*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(CrunThreadCounters));\n"
+    "        if (!c) return NULL;\n"
+    "        TlsSetValue((DWORD)g_crun_tls, c);\n"
+    "        do { c->next = g_crun_threads; }\n"
+    "        while (InterlockedCompareExchangePointer((PVOID volatile*)&g_crun_threads, c, c->next) != c->next);\n"
+    "    }\n"
+    "    return c;\n"
+    "}\n"
+    "\n"
+    "static ULONG crun_block_slot(void* p) {\n"
+    "    ULONG_PTR h = (ULONG_PTR)p >> 4;\n"
+    "    return (ULONG)((h ^ (h >> 15) ^ (h >> 30)) * 2654435761u) & (LIVE_SLOTS - 1);\n"
+    "}\n"
+    "\n"
+    "static BOOL crun_remember_block(void* p) {\n"
+    "    ULONG slot = crun_block_slot(p);\n"
+    "    for (int probe = 0; probe < LIVE_PROBES; ++probe) {\n"
+    "        void* volatile* s = &g_crun_blocks[(slot + probe) & (LIVE_SLOTS - 1)];\n"
+    "        void* current = *s;\n"
+    "        if ((current == NULL || current == LIVE_FREED) && InterlockedCompareExchangePointer((PVOID volatile*)s, p, current) == current) return TRUE;\n"
+    "    }\n"
+    "    InterlockedIncrement64(&g_crun_untracked);\n"
+    "    return FALSE;\n"
+    "}\n"
+    "\n"
+    "/* p がシムの確保したブロックなら表から外して TRUE を返す (枠は NULL に戻さないので、探索は NULL で止めてよい) */\n"
+    "static BOOL crun_forget_block(void* p) {\n"
+    "    ULONG slot = crun_block_slot(p);\n"
+    "    for (int probe = 0; probe < LIVE_PROBES; ++probe) {\n"
+    "        void* volatile* s = &g_crun_blocks[(slot + probe) & (LIVE_SLOTS - 1)];\n"
+    "        void* current = *s;\n"
+    "        if (current == NULL) return FALSE;\n"
+    "        if (current == p && InterlockedCompareExchangePointer((PVOID volatile*)s, LIVE_FREED, p) == p) return TRUE;\n"
+    "    }\n"
+    "    return FALSE;\n"
+    "}\n"
+    "\n"
+    "static void crun_add_live(LONGLONG delta, LONGLONG blocks) {\n"
+    "    InterlockedExchangeAdd64(&g_crun_live_blocks, blocks);\n"
+    "    LONGLONG live = InterlockedExchangeAdd64(&g_crun_live, delta) + delta;\n"
+    "    LONGLONG peak = g_crun_peak;\n"
+    "    while (live > peak) {\n"
+    "        LONGLONG previous = InterlockedCompareExchange64(&g_crun_peak, live, peak);\n"
+    "        if (previous == peak) break;\n"
+    "        peak = previous;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static void crun_record_alloc(size_t size) {\n"
+    "    CrunThreadCounters* c = crun_counters();\n"
+    "    if (!c) return;\n"
+    "    int k = 0;\n"
+    "    for (size_t limit = 16; k < CLASSES - 1 && size > limit; limit <<= 1) k++;\n"
+    "    c->classes[k]++;\n"
+    "    c->allocs++;\n"
+    "    c->bytes += (LONGLONG)size;\n"
+    "}\n"
+    "\n"
+    "static __attribute__((noinline)) void crun_record_site(size_t size) {\n"
+    "    void* frames[SITE_DEPTH];\n"
+    "    ULONG hash = 0;\n"
+    "    USHORT depth = CaptureStackBackTrace(1, SITE_DEPTH, frames, &hash);\n"
+    "    if (depth == 0) return;\n"
+    "    LONG key = hash ? (LONG)hash : 1;\n"
+    "    for (int probe = 0; probe < 64; ++probe) {\n"
+    "        CrunSite* s = &g_crun_sites[(hash + probe) & (SITE_SLOTS - 1)];\n"
+    "        LONG previous = InterlockedCompareExchange(&s->hash, key, 0);\n"
+    "        if (previous == 0) {\n"
+    "            memcpy(s->frames, frames, depth * sizeof(void*));\n"
+    "            s->depth = depth;\n"
+    "            InterlockedExchange(&s->ready, 1);\n"
+    "        } else if (previous != key) {\n"
+    "            continue;\n"
+    "        }\n"
+    "        InterlockedIncrement64(&s->count);\n"
+    "        InterlockedExchangeAdd64(&s->bytes, (LONGLONG)size);\n"
+    "        return;\n"
+    "    }\n"
+    "    InterlockedIncrement(&g_crun_lost_sites);\n"
+    "}\n"
+    "\n"
+    "/* 確保したブロックを表に加えて生きている量に足す (表が溢れたブロックは数えない) */\n"
+    "static void crun_track_block(void* p) {\n"
+    "    if (crun_remember_block(p)) crun_add_live((LONGLONG)_msize(p), 1);\n"
+    "}\n"
+    "\n"
+    "void* __wrap_malloc(size_t size) {\n"
+    "    void* p = __real_malloc(size);\n"
+    "    if (p) {\n"
+    "        crun_record_alloc(size);\n"
+    "        crun_track_block(p);\n"
+    "        crun_record_site(size);\n"
+    "    }\n"
+    "    return p;\n"
+    "}\n"
+    "\n"
+    "void* __wrap_calloc(size_t count, size_t size) {\n"
+    "    void* p = __real_calloc(count, size);\n"
+    "    if (p) {\n"
+    "        crun_record_alloc(count * size);\n"
+    "        crun_track_block(p);\n"
+    "        crun_record_site(count * size);\n"
+    "    }\n"
+    "    return p;\n"
+    "}\n"
+    "\n"
+    "/* シムが確保したブロックの解放だけを数える */\n"
+    "static void crun_record_free(size_t size) {\n"
+    "    CrunThreadCounters* c = crun_counters();\n"
+    "    if (c) c->frees++;\n"
+    "    crun_add_live(-(LONGLONG)size, -1);\n"
+    "}\n"
+    "\n"
+    "void __wrap_free(void* p) {\n"
+    "    if (p && crun_forget_block(p)) crun_record_free(_msize(p));\n"
+    "    __real_free(p);\n"
+    "}\n"
+    "\n"
+    "void* __wrap_realloc(void* p, size_t size) {\n"
+    "    if (!p) return __wrap_malloc(size);\n"
+    "    size_t old_size = _msize(p);\n"
+    "    /* 先に表から外す (移動した後の p が他のスレッドで確保し直されることがある) */\n"
+    "    BOOL owned = crun_forget_block(p);\n"
+    "    void* q = __real_realloc(p, size);\n"
+    "    CrunThreadCounters* c = crun_counters();\n"
+    "    if (!q) {\n"
+    "        if (size == 0) { /* realloc(p, 0) は解放として扱う */\n"
+    "            if (owned) crun_record_free(old_size);\n"
+    "        } else if (owned) {\n"
+    "            crun_remember_block(p);\n"
+    "        }\n"
+    "        return q;\n"
+    "    }\n"
+    "    if (c) {\n"
+    "        c->reallocs++;\n"
+    "        if (q != p) {\n"
+    "            c->realloc_moves++;\n"
+    "            c->realloc_copied += (LONGLONG)(old_size < size ? old_size : size);\n"
+    "        }\n"
+    "    }\n"
+    "    /* シムを通らずに確保されたブロックは、ここから新しいブロックとして数える */\n"
+    "    if (crun_remember_block(q)) crun_add_live((LONGLONG)_msize(q) - (owned ? (LONGLONG)old_size : 0), owned ? 0 : 1);\n"
+    "    else if (owned) crun_add_live(-(LONGLONG)old_size, -1);\n"
+    "    crun_record_site(size);\n"
+    "    return q;\n"
+    "}\n"
+    "\n"
+    "/* --- 結果の書き出し (malloc を使わない) --- */\n"
+    "static char* crun_put(char* out, const char* text) {\n"
+    "    while (*text) *out++ = *text++;\n"
+    "    return out;\n"
+    "}\n"
+    "\n"
+    "static char* crun_put_u64(char* out, ULONGLONG value, int base) {\n"
+    "    char digits[24];\n"
+    "    int n = 0;\n"
+    "    do { digits[n++] = \"0123456789abcdef\"[value % base]; value /= base; } while (value);\n"
+    "    *out++ = ' ';\n"
+    "    while (n) *out++ = digits[--n];\n"
+    "    return out;\n"
+    "}\n"
+    "\n"
+    "static void crun_write_line(HANDLE file, const char* start, char* end) {\n"
+    "    DWORD written;\n"
+    "    *end++ = '\\n';\n"
+    "    WriteFile(file, start, (DWORD)(end - start), &written, NULL);\n"
+    "}\n"
+    "\n"
+    "static void crun_write_stats(void) {\n"
+    "    wchar_t path[MAX_PATH];\n"
+    "    DWORD length = GetEnvironmentVariableW(L\"CRUN_ALLOC_STATS\", path, MAX_PATH);\n"
+    "    if (length == 0 || length >= MAX_PATH) return;\n"
+    "    HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);\n"
+    "    if (file == INVALID_HANDLE_VALUE) return;\n"
+    "\n"
+    "    CrunThreadCounters total;\n"
+    "    memset(&total, 0, sizeof(total));\n"
+    "    LONGLONG threads = 0;\n"
+    "    for (CrunThreadCounters* c = g_crun_threads; c; c = c->next) {\n"
+    "        for (int k = 0; k < CLASSES; ++k) total.classes[k] += c->classes[k];\n"
+    "        total.allocs += c->allocs;\n"
+    "        total.frees += c->frees;\n"
+    "        total.reallocs += c->reallocs;\n"
+    "        total.realloc_moves += c->realloc_moves;\n"
+    "        total.realloc_copied += c->realloc_copied;\n"
+    "        total.bytes += c->bytes;\n"
+    "        threads++;\n"
+    "    }\n"
+    "    char line[512];\n"
+    "    char* p = crun_put(line, \"base\");\n"
+    "    crun_write_line(file, line, crun_put_u64(p, (ULONGLONG)(ULONG_PTR)GetModuleHandleA(NULL), 16));\n"
+    "    p = crun_put(line, \"total\");\n"
+    "    p = crun_put_u64(p, total.allocs, 10);\n"
+    "    p = crun_put_u64(p, total.frees, 10);\n"
+    "    p = crun_put_u64(p, total.reallocs, 10);\n"
+    "    p = crun_put_u64(p, total.realloc_moves, 10);\n"
+    "    p = crun_put_u64(p, total.realloc_copied, 10);\n"
+    "    p = crun_put_u64(p, total.bytes, 10);\n"
+    "    p = crun_put_u64(p, g_crun_peak, 10);\n"
+    "    p = crun_put_u64(p, g_crun_live > 0 ? g_crun_live : 0, 10);\n"
+    "    p = crun_put_u64(p, threads, 10);\n"
+    "    p = crun_put_u64(p, g_crun_lost_sites, 10);\n"
+    "    p = crun_put_u64(p, g_crun_live_blocks > 0 ? g_crun_live_blocks : 0, 10);\n"
+    "    crun_write_line(file, line, crun_put_u64(p, g_crun_untracked, 10));\n"
+    "    p = crun_put(line, \"classes\");\n"
+    "    for (int k = 0; k < CLASSES; ++k) p = crun_put_u64(p, total.classes[k], 10);\n"
+    "    crun_write_line(file, line, p);\n"
+    "    for (int i = 0; i < SITE_SLOTS; ++i) {\n"
+    "        CrunSite* s = &g_crun_sites[i];\n"
+    "        if (!s->ready) continue;\n"
+    "        p = crun_put(line, \"site\");\n"
+    "        p = crun_put_u64(p, s->count, 10);\n"
+    "        p = crun_put_u64(p, s->bytes, 10);\n"
+    "        for (int d = 0; d < s->depth; ++d) p = crun_put_u64(p, (ULONGLONG)(ULONG_PTR)s->frames[d], 16);\n"
+    "        crun_write_line(file, line, p);\n"
+    "    }\n"
+    "    CloseHandle(file);\n"
+    "}\n"
+    "\n"
+    "static __attribute__((constructor)) void crun_alloc_shim_init(void) {\n"
+    "    atexit(crun_write_stats);\n"
+    "}\n"
+    "#ifdef __cplusplus\n"
+    "}\n"
+    "\n"
+    "/* C++ の new/delete もシムを通す (libstdc++ の DLL 内の既定の実装は --wrap の対象にならないため) */\n"
+    "void* operator new(size_t size) {\n"
+    "    void* p = __wrap_malloc(size ? size : 1);\n"
+    "#if defined(__cpp_exceptions)\n"
+    "    if (!p) throw std::bad_alloc();\n"
+    "#else\n"
+    "    if (!p) abort(); /* -fno-exceptions では投げられない */\n"
+    "#endif\n"
+    "    return p;\n"
+    "}\n"
+    "void* operator new[](size_t size) { return operator new(size); }\n"
+    "void* operator new(size_t size, const std::nothrow_t&) noexcept { return __wrap_malloc(size ? size : 1); }\n"
+    "void* operator new[](size_t size, const std::nothrow_t&) noexcept { return __wrap_malloc(size ? size : 1); }\n"
+    "void operator delete(void* p) noexcept { __wrap_free(p); }\n"
+    "void operator delete[](void* p) noexcept { __wrap_free(p); }\n"
+    "void operator delete(void* p, size_t) noexcept { __wrap_free(p); }\n"
+    "void operator delete[](void* p, size_t) noexcept { __wrap_free(p); }\n"
+    "#endif\n";
+
+// --- ビルド ---
+// シムを一時ディレクトリに書き出し、入力とリンクフラグに加える (C++ のプログラムでは C++ としてコンパイルする)
+BOOL alloc_stats_prepare(const ProgramOptions* opts, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, AllocStatsBuild* build) {
+    memset(build, 0, sizeof(AllocStatsBuild));
+    build->opts = *opts;
+    build->inputs = (wchar_t**)calloc(num_inputs + 1, sizeof(wchar_t*));
+    build->libraries = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    wchar_t shim_path[MAX_PATH];
+    swprintf_s(shim_path, MAX_PATH, L"%s\\crun_alloc_shim.%s", temp_dir, has_cpp ? L"cpp" : L"c");
+    if (!build->inputs || !build->libraries || !write_file_bytes(shim_path, g_shim_source, sizeof(g_shim_source) - 1)) {
+        fwprintf_err(L"Error: Failed to write the allocation shim.\n");
+        alloc_stats_free_build(build);
+        return FALSE;
+    }
+    for (int i = 0; i < num_inputs; ++i) build->inputs[i] = inputs[i];
+    build->inputs[num_inputs] = _wcsdup(shim_path);
+    build->num_inputs = num_inputs + 1;
+
+    swprintf_s(build->libraries, 32767, L"-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free %s",
+               opts->user_libraries ? opts->user_libraries : L"");
+    build->opts.user_libraries = build->libraries;
+    return build->inputs[num_inputs] != NULL;
+}
+
+void alloc_stats_free_build(AllocStatsBuild* build) {
+    if (build->inputs && build->num_inputs > 0) free(build->inputs[build->num_inputs - 1]);
+    free(build->inputs);
+    free(build->libraries);
+    memset(build, 0, sizeof(AllocStatsBuild));
+}
+
+// --- レポート ---
+struct AllocSite {
+    ULONGLONG count;
+    ULONGLONG bytes;
+    ULONGLONG frames[ALLOC_SITE_DEPTH];
+    int depth;
+};
+
+static int compare_sites_desc(const void* a, const void* b) {
+    const AllocSite* x = (const AllocSite*)a;
+    const AllocSite* y = (const AllocSite*)b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+// シムのフレーム (__wrap_* や operator new) を読み飛ばし、最初の呼び出し元から表示する
+static BOOL is_shim_symbol(const char* name) {
+    return strncmp(name, "__wrap_", 7) == 0 || strncmp(name, "crun_", 5) == 0 ||
+           strncmp(name, "_Znw", 4) == 0 || strncmp(name, "_Zna", 4) == 0;
+}
+
+static void print_site(const AllocSite* site, const PeSymbolTable* symbols, ULONGLONG module_base) {
+    wchar_t bytes[32];
+    format_bytes(site->bytes, bytes, _countof(bytes));
+    wprintf(L"%10llu %12s  ", site->count, bytes);
+    int printed = 0;
+    for (int d = 0; d < site->depth && printed < 3; ++d) {
+        ULONGLONG address = site->frames[d];
+        const PeSymbol* sym = NULL;
+        if (symbols->count > 0 && address > module_base) {
+            sym = pe_find_symbol(symbols, address - 1 - module_base + symbols->image_base); // 戻りアドレスは呼び出し命令内を指すよう1戻す
+        }
+        if (sym && is_shim_symbol(sym->name)) continue;
+        if (printed > 0) wprintf(L" <- ");
+        if (sym) wprintf(L"%hs", sym->name);
+        else wprintf(L"0x%llx", address);
+        printed++;
+    }
+    wprintf(L"\n");
+}
+
+// シムが書き出したファイルを読み、レポートを表示する
+void alloc_stats_print(const wchar_t* stats_path, const wchar_t* executable_path) {
+    FILE* in = _wfopen(stats_path, L"r");
+    if (!in) {
+        fwprintf_err(L"Warning: No allocation stats were written (the program may have exited without running atexit handlers).\n");
+        return;
+    }
+    ULONGLONG module_base = 0;
+    ULONGLONG allocs = 0, frees = 0, reallocs = 0, moves = 0, copied = 0, bytes = 0, peak = 0, live = 0, threads = 0, lost = 0;
+    ULONGLONG live_blocks = 0, untracked = 0;
+    ULONGLONG classes[ALLOC_SIZE_CLASSES] = {0};
+    AllocSite* sites = NULL;
+    int num_sites = 0, site_capacity = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        char* p = line;
+        if (strncmp(p, "base ", 5) == 0) {
+            module_base = strtoull(p + 5, NULL, 16);
+        } else if (strncmp(p, "total ", 6) == 0) {
+            ULONGLONG* fields[] = { &allocs, &frees, &reallocs, &moves, &copied, &bytes, &peak, &live, &threads, &lost, &live_blocks, &untracked };
+            p += 6;
+            for (size_t i = 0; i < _countof(fields); ++i) *fields[i] = strtoull(p, &p, 10);
+        } else if (strncmp(p, "classes ", 8) == 0) {
+            p += 8;
+            for (int k = 0; k < ALLOC_SIZE_CLASSES; ++k) classes[k] = strtoull(p, &p, 10);
+        } else if (strncmp(p, "site ", 5) == 0) {
+            if (num_sites == site_capacity) {
+                int capacity = site_capacity ? site_capacity * 2 : 256;
+                AllocSite* grown = (AllocSite*)realloc(sites, sizeof(AllocSite) * capacity);
+                if (!grown) break;
+                sites = grown;
+                site_capacity = capacity;
+            }
+            AllocSite* site = &sites[num_sites++];
+            memset(site, 0, sizeof(AllocSite));
+            p += 5;
+            site->count = strtoull(p, &p, 10);
+            site->bytes = strtoull(p, &p, 10);
+            while (site->depth < ALLOC_SITE_DEPTH) {
+                char* end = NULL;
+                ULONGLONG address = strtoull(p, &end, 16);
+                if (end == p) break;
+                site->frames[site->depth++] = address;
+                p = end;
+            }
+        }
+    }
+    fclose(in);
+
+    wchar_t text[3][32];
+    wprintf(L"\n--- Allocation stats ---\n");
+    format_bytes(bytes, text[0], 32);
+    format_bytes(peak, text[1], 32);
+    format_bytes(live, text[2], 32);
+    wprintf(L"Allocations: %llu (%s)   Frees: %llu   Threads: %llu\n", allocs, text[0], frees, threads);
+    wprintf(L"Peak live:   %s   Live at exit: %s (%llu blocks)\n", text[1], text[2], live_blocks);
+    if (untracked > 0) {
+        wprintf(L"Note:        %llu blocks were not tracked (too many live blocks); live and peak figures are approximate.\n", untracked);
+    }
+    format_bytes(copied, text[0], 32);
+    wprintf(L"Realloc:     %llu calls, %llu moved, %s copied\n", reallocs, moves, text[0]);
+
+    ULONGLONG max_class = 1;
+    for (int k = 0; k < ALLOC_SIZE_CLASSES; ++k) if (classes[k] > max_class) max_class = classes[k];
+    wprintf(L"\nSize class      Count\n");
+    for (int k = 0; k < ALLOC_SIZE_CLASSES; ++k) {
+        if (classes[k] == 0) continue;
+        wchar_t label[32];
+        if (k == ALLOC_SIZE_CLASSES - 1) {
+            format_bytes(16ULL << (k - 1), text[0], 32);
+            swprintf_s(label, _countof(label), L"> %s", text[0]);
+        } else {
+            format_bytes(16ULL << k, text[0], 32);
+            swprintf_s(label, _countof(label), L"<= %s", text[0]);
+        }
+        int bar = (int)(classes[k] * 40 / max_class);
+        wprintf(L"%-12s %10llu  ", label, classes[k]);
+        for (int i = 0; i < bar; ++i) wprintf(L"#");
+        wprintf(L"\n");
+    }
+
+    if (num_sites > 0) {
+        PeSymbolTable symbols;
+        if (!pe_load_symbols(executable_path, &symbols)) memset(&symbols, 0, sizeof(symbols));
+        qsort(sites, num_sites, sizeof(AllocSite), compare_sites_desc);
+        wprintf(L"\nTop allocation sites (by calls):\n%10s %12s  %s\n", L"Calls", L"Bytes", L"Call site");
+        for (int i = 0; i < num_sites && i < ALLOC_STATS_TOP_SITES; ++i) print_site(&sites[i], &symbols, module_base);
+        if (lost > 0) wprintf(L"(%llu allocations from additional call sites were not attributed)\n", lost);
+        pe_free_symbols(&symbols);
+    }
+    free(sites);
+}
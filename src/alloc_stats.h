@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- アロケーションの計測 (--alloc-stats) ---
+// 計測用のシム (C のソース) をプログラムと一緒にコンパイルし、-Wl,--wrap で malloc/calloc/realloc/free を
+// シムに差し替える。シムはスレッドごとのカウンタ (ロックなし) に記録し、終了時に環境変数 CRUN_ALLOC_STATS の
+// ファイルへ書き出す。crun はそれを読んで呼び出し元のシンボルを解決し、レポートを表示する
+#define ALLOC_STATS_ENV L"CRUN_ALLOC_STATS"
+#define ALLOC_STATS_TOP_SITES 10
+
+// シムを加えたビルドの設定
+struct AllocStatsBuild {
+    ProgramOptions opts;         // user_libraries に --wrap を加えたもの
+    wchar_t** inputs;            // 元の入力 + シムのソース
+    int num_inputs;
+    wchar_t* libraries;
+};
+
+// --- 関数宣言 ---
+BOOL alloc_stats_prepare(const ProgramOptions* opts, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, AllocStatsBuild* build);
+void alloc_stats_free_build(AllocStatsBuild* build);
+void alloc_stats_print(const wchar_t* stats_path, const wchar_t* executable_path);
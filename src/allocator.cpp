@@ -0,0 +1,322 @@
+#include "allocator.h"
+#include "cache.h"
+#include "symindex.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+// --- アダプタのソース ---
+// C と C++ のどちらとしてもコンパイルできるように書く (C++ では operator new/delete もアダプタを通す)。
+// 先頭部・アロケータごとの宣言・本体をつなげて1つのファイルにする
+static const char g_adapter_head[] =
+    "/* crun --malloc: -Wl,--wrap=malloc,... でリンクし、CRT の malloc などを別のアロケータに回すアダプタ */\n"
+    "#include <malloc.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <wchar.h>\n"
+    "#ifdef __cplusplus\n"
+    "#include <new>\n"
+    "extern \"C\" {\n"
+    "#else\n"
+    "#include <stdbool.h>\n"
+    "#endif\n"
+    "void __real_free(void* p);\n"
+    "size_t __real__msize(void* p);\n"
+    "\n";
+
+// CRUN_OWNS はブロックがアロケータのものかを返す。CRT の関数が内部で確保したブロックは CRT に返す
+static const char g_adapter_mimalloc[] =
+    "void* mi_malloc(size_t size);\n"
+    "void* mi_calloc(size_t count, size_t size);\n"
+    "void* mi_realloc(void* p, size_t size);\n"
+    "void mi_free(void* p);\n"
+    "size_t mi_usable_size(const void* p);\n"
+    "bool mi_is_in_heap_region(const void* p);\n"
+    "#define CRUN_MALLOC(size) mi_malloc(size)\n"
+    "#define CRUN_CALLOC(count, size) mi_calloc(count, size)\n"
+    "#define CRUN_REALLOC(p, size) mi_realloc(p, size)\n"
+    "#define CRUN_FREE(p) mi_free(p)\n"
+    "#define CRUN_USABLE_SIZE(p) mi_usable_size(p)\n"
+    "#define CRUN_OWNS(p) mi_is_in_heap_region(p)\n"
+    "\n";
+
+// jemalloc (Windows では je_ 付きの名前) は arenas.lookup でブロックのアリーナを引き、引けなければ CRT のものとみなす
+// (jemalloc 5.3 以降。jemalloc が管理していないポインタでは失敗を返す)
+static const char g_adapter_jemalloc[] =
+    "int je_mallctl(const char* name, void* oldp, size_t* oldlenp, void* newp, size_t newlen);\n"
+    "void* je_malloc(size_t size);\n"
+    "void* je_calloc(size_t count, size_t size);\n"
+    "void* je_realloc(void* p, size_t size);\n"
+    "void je_free(void* p);\n"
+    "size_t je_malloc_usable_size(void* p);\n"
+    "#define CRUN_MALLOC(size) je_malloc(size)\n"
+    "#define CRUN_CALLOC(count, size) je_calloc(count, size)\n"
+    "#define CRUN_REALLOC(p, size) je_realloc(p, size)\n"
+    "#define CRUN_FREE(p) je_free(p)\n"
+    "#define CRUN_USABLE_SIZE(p) je_malloc_usable_size(p)\n"
+    "static int crun_je_owns(void* p) {\n"
+    "    unsigned arena;\n"
+    "    size_t size = sizeof(arena);\n"
+    "    return je_mallctl(\"arenas.lookup\", &arena, &size, &p, sizeof(p)) == 0;\n"
+    "}\n"
+    "#define CRUN_OWNS(p) crun_je_owns(p)\n"
+    "\n";
+
+static const char g_adapter_body[] =
+    "void* __wrap_malloc(size_t size) { return CRUN_MALLOC(size); }\n"
+    "void* __wrap_calloc(size_t count, size_t size) { return CRUN_CALLOC(count, size); }\n"
+    "\n"
+    "void __wrap_free(void* p) {\n"
+    "    if (!p) return;\n"
+    "    if (CRUN_OWNS(p)) CRUN_FREE(p);\n"
+    "    else __real_free(p);\n"
+    "}\n"
+    "\n"
+    "void* __wrap_realloc(void* p, size_t size) {\n"
+    "    if (!p || CRUN_OWNS(p)) return CRUN_REALLOC(p, size);\n"
+    "    /* CRT が確保したブロックはアロケータのブロックに移す */\n"
+    "    if (size == 0) { __real_free(p); return NULL; }\n"
+    "    void* q = CRUN_MALLOC(size);\n"
+    "    if (q) {\n"
+    "        size_t old_size = __real__msize(p);\n"
+    "        memcpy(q, p, old_size < size ? old_size : size);\n"
+    "        __real_free(p);\n"
+    "    }\n"
+    "    return q;\n"
+    "}\n"
+    "\n"
+    "size_t __wrap__msize(void* p) { return CRUN_OWNS(p) ? CRUN_USABLE_SIZE(p) : __real__msize(p); }\n"
+    "\n"
+    "/* 文字列の複製もアロケータで確保する (返したブロックはプログラムが free するため) */\n"
+    "char* __wrap__strdup(const char* s) {\n"
+    "    size_t size = strlen(s) + 1;\n"
+    "    char* p = (char*)CRUN_MALLOC(size);\n"
+    "    if (p) memcpy(p, s, size);\n"
+    "    return p;\n"
+    "}\n"
+    "char* __wrap_strdup(const char* s) { return __wrap__strdup(s); }\n"
+    "wchar_t* __wrap__wcsdup(const wchar_t* s) {\n"
+    "    size_t size = (wcslen(s) + 1) * sizeof(wchar_t);\n"
+    "    wchar_t* p = (wchar_t*)CRUN_MALLOC(size);\n"
+    "    if (p) memcpy(p, s, size);\n"
+    "    return p;\n"
+    "}\n"
+    "wchar_t* __wrap_wcsdup(const wchar_t* s) { return __wrap__wcsdup(s); }\n"
+    "#ifdef __cplusplus\n"
+    "}\n"
+    "\n"
+    "/* C++ の new/delete もアダプタを通す (libstdc++ の DLL 内の既定の実装は --wrap の対象にならないため) */\n"
+    "void* operator new(size_t size) {\n"
+    "    void* p = __wrap_malloc(size ? size : 1);\n"
+    "#if defined(__cpp_exceptions)\n"
+    "    if (!p) throw std::bad_alloc();\n"
+    "#else\n"
+    "    if (!p) abort(); /* -fno-exceptions では投げられない */\n"
+    "#endif\n"
+    "    return p;\n"
+    "}\n"
+    "void* operator new[](size_t size) { return operator new(size); }\n"
+    "void* operator new(size_t size, const std::nothrow_t&) noexcept { return __wrap_malloc(size ? size : 1); }\n"
+    "void* operator new[](size_t size, const std::nothrow_t&) noexcept { return __wrap_malloc(size ? size : 1); }\n"
+    "void operator delete(void* p) noexcept { __wrap_free(p); }\n"
+    "void operator delete[](void* p) noexcept { __wrap_free(p); }\n"
+    "void operator delete(void* p, size_t) noexcept { __wrap_free(p); }\n"
+    "void operator delete[](void* p, size_t) noexcept { __wrap_free(p); }\n"
+    "#endif\n";
+
+#define ALLOCATOR_WRAP_FLAGS L"-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,--wrap=_msize,--wrap=_strdup,--wrap=strdup,--wrap=_wcsdup,--wrap=wcsdup"
+
+// --- アロケータの一覧 ---
+struct AllocatorInfo {
+    const wchar_t* name;
+    const wchar_t* libs[2];        // 探すライブラリ (lib<name>.a / lib<name>.dll.a、先に書いたものを優先)
+    const char* adapter;           // アダプタの宣言部 (NULL ならアダプタを使わない)
+    const wchar_t* static_deps;    // 静的リンクで追加が必要なシステムライブラリ
+    BOOL vendored;                 // allocators\<name> のソースからビルドできるか
+};
+
+static const AllocatorInfo g_allocators[] = {
+    { L"mimalloc", { L"mimalloc", NULL }, g_adapter_mimalloc, L"-lpsapi -lshell32 -luser32 -ladvapi32 -lbcrypt", TRUE },
+    { L"jemalloc", { L"jemalloc", NULL }, g_adapter_jemalloc, L"", FALSE },
+    // tcmalloc は読み込まれたモジュールの CRT の malloc/free を自分で書き換える (リンクさせるための未定義シンボルだけ加える)
+    { L"tcmalloc", { L"tcmalloc_minimal", L"tcmalloc" }, NULL, L"-lpsapi", FALSE },
+};
+
+static const AllocatorInfo* find_allocator(const wchar_t* name) {
+    for (size_t i = 0; i < _countof(g_allocators); ++i) {
+        if (wcscmp(g_allocators[i].name, name) == 0) return &g_allocators[i];
+    }
+    return NULL;
+}
+
+// "system" は CRT の malloc をそのまま使う (--malloc を指定しないのと同じ)
+BOOL allocator_is_known(const wchar_t* name) {
+    return wcscmp(name, L"system") == 0 || find_allocator(name) != NULL;
+}
+
+// --- ライブラリの検索 ---
+// ツールチェーンの lib ディレクトリから探す。静的リンクなら lib<name>.a、それ以外は lib<name>.dll.a を優先する
+static BOOL find_installed_library(const wchar_t* compiler_path, const AllocatorInfo* info, BOOL prefer_static, wchar_t* path, size_t path_size, BOOL* is_static) {
+    wchar_t dirs[8][MAX_PATH];
+    int num_dirs = symbol_index_lib_dirs(compiler_path, dirs, 8);
+    for (int pass = 0; pass < 2; ++pass) {
+        BOOL want_static = (pass == 0) ? prefer_static : !prefer_static;
+        for (size_t n = 0; n < _countof(info->libs) && info->libs[n]; ++n) {
+            for (int d = 0; d < num_dirs; ++d) {
+                swprintf_s(path, path_size, L"%s\\lib%s%s", dirs[d], info->libs[n], want_static ? L".a" : L".dll.a");
+                if (file_exists(path)) {
+                    *is_static = want_static;
+                    return TRUE;
+                }
+            }
+        }
+    }
+    return FALSE;
+}
+
+// ディレクトリ直下のファイルで最も新しい更新日時を newest に反映する
+static void update_newest_write_time(const wchar_t* dir, FILETIME* newest) {
+    wchar_t pattern[MAX_PATH];
+    swprintf_s(pattern, MAX_PATH, L"%s\\*", dir);
+    WIN32_FIND_DATAW find_data;
+    HANDLE h_find = FindFirstFileW(pattern, &find_data);
+    if (h_find == INVALID_HANDLE_VALUE) return;
+    do {
+        if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && CompareFileTime(&find_data.ftLastWriteTime, newest) > 0) {
+            *newest = find_data.ftLastWriteTime;
+        }
+    } while (FindNextFileW(h_find, &find_data));
+    FindClose(h_find);
+}
+
+// crun.exe の隣の allocators\<name> にあるソース (mimalloc の src\static.c) を1つのオブジェクトにビルドし、
+// キャッシュに置く。キーはコンパイラとソースの場所で、ソースが更新されたときだけビルドし直す
+static BOOL build_vendored_library(const wchar_t* compiler_path, const AllocatorInfo* info, BOOL verbose, wchar_t* object_path, size_t object_path_size) {
+    wchar_t exe_path[MAX_PATH], exe_dir[MAX_PATH], vendor_dir[MAX_PATH], static_source[MAX_PATH];
+    if (!GetModuleFileNameW(NULL, exe_path, MAX_PATH)) return FALSE;
+    get_parent_path(exe_path, exe_dir, MAX_PATH);
+    swprintf_s(vendor_dir, MAX_PATH, L"%s\\%s\\%s", exe_dir, ALLOCATOR_VENDOR_DIR, info->name);
+    swprintf_s(static_source, MAX_PATH, L"%s\\src\\static.c", vendor_dir);
+    if (!file_exists(static_source)) return FALSE;
+
+    ULONGLONG key = hash_bytes(compiler_path, wcslen(compiler_path) * sizeof(wchar_t), 0);
+    key = hash_bytes(vendor_dir, wcslen(vendor_dir) * sizeof(wchar_t), key);
+    FILETIME newest = {0};
+    const wchar_t* subdirs[] = { L"src", L"include", L"include\\mimalloc" };
+    for (size_t i = 0; i < _countof(subdirs); ++i) {
+        wchar_t dir[MAX_PATH];
+        swprintf_s(dir, MAX_PATH, L"%s\\%s", vendor_dir, subdirs[i]);
+        update_newest_write_time(dir, &newest);
+    }
+    wchar_t suffix[32];
+    swprintf_s(suffix, _countof(suffix), L".%s.o", info->name);
+    if (cache_lookup(key, suffix, &newest, object_path, object_path_size)) return TRUE;
+
+    wchar_t temp_path[MAX_PATH];
+    if (!cache_temp_path(key, suffix, temp_path, MAX_PATH)) return FALSE;
+    wchar_t command[4096];
+    swprintf_s(command, _countof(command), L"\"%s\" -c -x c -O2 -DNDEBUG -I\"%s\\include\" \"%s\" -o \"%s\"",
+               compiler_path, vendor_dir, static_source, temp_path);
+    if (verbose) wprintf(L"Allocator: building %s from %s\nCommand: %s\n", info->name, vendor_dir, command);
+
+    wchar_t* output = NULL;
+    BOOL built = run_process_and_capture_output(command, &output);
+    if (!built && output) wprintf(L"%s", output);
+    free(output);
+    if (!built || !MoveFileExW(temp_path, object_path, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(temp_path);
+        fwprintf_err(L"Error: Failed to build %s from %s.\n", info->name, vendor_dir);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// フラグの並びに -static そのものがあるか (-static-libgcc などは静的リンクにしない)
+static BOOL has_static_flag(const wchar_t* flags) {
+    if (!flags) return FALSE;
+    for (const wchar_t* p = flags; *p; ) {
+        while (*p == L' ') p++;
+        size_t len = wcscspn(p, L" ");
+        if (len == 7 && wcsncmp(p, L"-static", 7) == 0) return TRUE;
+        p += len;
+    }
+    return FALSE;
+}
+
+// --- ビルド ---
+// アロケータのライブラリを探し (無ければ同梱のソースからビルドし)、アダプタを入力に、ライブラリをリンクフラグに加える
+BOOL allocator_prepare(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, AllocatorBuild* build) {
+    memset(build, 0, sizeof(AllocatorBuild));
+    build->opts = *opts;
+    const AllocatorInfo* info = find_allocator(opts->malloc_name);
+    if (!info) return FALSE;
+
+    // -static が指定されていれば静的ライブラリを選ぶ
+    BOOL prefer_static = has_static_flag(opts->compiler_flags) || has_static_flag(opts->user_libraries);
+    wchar_t library[MAX_PATH];
+    BOOL is_static = FALSE;
+    if (find_installed_library(compiler_path, info, prefer_static, library, MAX_PATH, &is_static)) {
+        swprintf_s(build->description, _countof(build->description), L"%s (%s, %s)", info->name, is_static ? L"static" : L"dynamic", library);
+    } else if (info->vendored && build_vendored_library(compiler_path, info, opts->verbose, library, MAX_PATH)) {
+        is_static = TRUE;
+        swprintf_s(build->description, _countof(build->description), L"%s (bundled source, %s)", info->name, library);
+    } else {
+        fwprintf_err(L"Error: %s was not found in the toolchain's lib directories.\n"
+                     L"Install it for your compiler (e.g. pacman -S mingw-w64-x86_64-%s)%s.\n",
+                     info->name, info->name, info->vendored ? L" or place its source in <crun dir>\\allocators\\mimalloc" : L"");
+        return FALSE;
+    }
+
+    build->inputs = (wchar_t**)calloc(num_inputs + 1, sizeof(wchar_t*));
+    build->libraries = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    if (!build->inputs || !build->libraries) {
+        allocator_free_build(build);
+        return FALSE;
+    }
+    for (int i = 0; i < num_inputs; ++i) build->inputs[i] = inputs[i];
+    build->num_inputs = num_inputs;
+
+    const wchar_t* link_flags;
+    if (info->adapter) {
+        wchar_t adapter_path[MAX_PATH];
+        swprintf_s(adapter_path, MAX_PATH, L"%s\\crun_malloc_adapter.%s", temp_dir, has_cpp ? L"cpp" : L"c");
+        size_t head = sizeof(g_adapter_head) - 1, decls = strlen(info->adapter), body = sizeof(g_adapter_body) - 1;
+        char* source = (char*)malloc(head + decls + body);
+        BOOL written = source != NULL;
+        if (written) {
+            memcpy(source, g_adapter_head, head);
+            memcpy(source + head, info->adapter, decls);
+            memcpy(source + head + decls, g_adapter_body, body);
+            written = write_file_bytes(adapter_path, source, head + decls + body);
+        }
+        free(source);
+        build->adapter = written ? _wcsdup(adapter_path) : NULL;
+        if (!build->adapter) {
+            fwprintf_err(L"Error: Failed to write the allocator adapter.\n");
+            allocator_free_build(build);
+            return FALSE;
+        }
+        build->inputs[num_inputs] = build->adapter;
+        build->num_inputs = num_inputs + 1;
+        link_flags = ALLOCATOR_WRAP_FLAGS;
+    } else {
+        // x86 では C の名前に '_' が付く
+        link_flags = wcsstr(library, L"i686") ? L"-Wl,--undefined=__tcmalloc" : L"-Wl,--undefined=_tcmalloc";
+    }
+
+    // tcmalloc の静的ライブラリは C++ で書かれているため、C のプログラムでは libstdc++ も必要になる
+    const wchar_t* cpp_runtime = (is_static && !info->adapter && !has_cpp) ? L" -lstdc++" : L"";
+    swprintf_s(build->libraries, 32767, L"%s \"%s\" %s%s %s", link_flags, library, is_static ? info->static_deps : L"", cpp_runtime,
+               opts->user_libraries ? opts->user_libraries : L"");
+    build->opts.user_libraries = build->libraries;
+    return TRUE;
+}
+
+void allocator_free_build(AllocatorBuild* build) {
+    free(build->adapter);
+    free(build->inputs);
+    free(build->libraries);
+    memset(build, 0, sizeof(AllocatorBuild));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- アロケータの差し替え (--malloc) ---
+// mimalloc と jemalloc は小さなアダプタ (C のソース) をプログラムと一緒にコンパイルし、-Wl,--wrap で
+// malloc/calloc/realloc/free などをアダプタ経由でそのアロケータに回す。tcmalloc は自身が起動時に CRT の
+// malloc を書き換えるため、ライブラリをリンクするだけでよい。ライブラリはツールチェーンの lib ディレクトリから
+// 探し、無ければ crun.exe の隣の allocators\mimalloc に置いたソースを一度だけビルドしてキャッシュに置く
+#define ALLOCATOR_VENDOR_DIR L"allocators"
+
+// アロケータを加えたビルドの設定
+struct AllocatorBuild {
+    ProgramOptions opts;         // user_libraries にライブラリと --wrap を加えたもの
+    wchar_t** inputs;            // 元の入力 + アダプタのソース (tcmalloc では元の入力のまま)
+    int num_inputs;
+    wchar_t* libraries;
+    wchar_t* adapter;            // 書き出したアダプタのパス (アダプタを使わない場合は NULL)
+    wchar_t description[MAX_PATH + 64]; // --verbose で表示する説明 (例: "mimalloc (static, C:\...\libmimalloc.a)")
+};
+
+// --- 関数宣言 ---
+BOOL allocator_is_known(const wchar_t* name);
+BOOL allocator_prepare(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, AllocatorBuild* build);
+void allocator_free_build(AllocatorBuild* build);
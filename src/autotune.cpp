@@ -0,0 +1,236 @@
+#include "autotune.h"
+#include "compare.h"
+#include "cache.h"
+#include "stats.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+// --- フラグ空間 ---
+struct FlagDimension {
+    wchar_t choices[8][128];
+    int num_choices;
+};
+
+// "-O2|-O3;|-march=native" を次元ごとの候補に分ける
+static BOOL parse_space(const wchar_t* spec, FlagDimension* dims, int max_dims, int* num_dims) {
+    *num_dims = 0;
+    const wchar_t* p = spec;
+    while (*p) {
+        if (*num_dims == max_dims) return FALSE;
+        FlagDimension* dim = &dims[(*num_dims)++];
+        dim->num_choices = 0;
+        for (;;) {
+            size_t len = wcscspn(p, L"|;");
+            if (dim->num_choices == _countof(dim->choices) || len >= _countof(dim->choices[0])) return FALSE;
+            wchar_t* choice = dim->choices[dim->num_choices++];
+            wcsncpy_s(choice, _countof(dim->choices[0]), p, len);
+            // 前後の空白を取り除く
+            size_t start = wcsspn(choice, L" ");
+            memmove(choice, choice + start, (wcslen(choice + start) + 1) * sizeof(wchar_t));
+            for (size_t n = wcslen(choice); n > 0 && choice[n - 1] == L' '; --n) choice[n - 1] = L'\0';
+            p += len;
+            if (*p != L'|') break;
+            p++;
+        }
+        if (*p == L';') p++;
+    }
+    return *num_dims > 0;
+}
+
+// 全ての組み合わせを候補にする。候補 0 は各次元の最初の選択肢で、比較の基準になる
+static BOOL enumerate_candidates(const FlagDimension* dims, int num_dims, const wchar_t* compiler_name, CompareVariant* candidates, int* count) {
+    int total = 1;
+    for (int d = 0; d < num_dims; ++d) {
+        total *= dims[d].num_choices;
+        if (total > AUTOTUNE_MAX_CANDIDATES) return FALSE;
+    }
+    for (int i = 0; i < total; ++i) {
+        CompareVariant* c = &candidates[i];
+        memset(c, 0, sizeof(CompareVariant));
+        c->compiler_name = compiler_name;
+        int index = i;
+        for (int d = 0; d < num_dims; ++d) {
+            const wchar_t* choice = dims[d].choices[index % dims[d].num_choices];
+            index /= dims[d].num_choices;
+            if (!choice[0]) continue;
+            if (c->flags[0]) wcscat_s(c->flags, _countof(c->flags), L" ");
+            wcscat_s(c->flags, _countof(c->flags), choice);
+        }
+        wcscpy_s(c->label, _countof(c->label), c->flags[0] ? c->flags : L"(no flags)");
+    }
+    *count = total;
+    return TRUE;
+}
+
+// --- 保存 ---
+// キーはコンパイラ・--cflags・ソースの内容 (パスは含めない) から決める
+static BOOL saved_flags_path(const ProgramOptions* opts, wchar_t* path, size_t path_size) {
+    ULONGLONG key = hash_bytes(opts->compiler_name, wcslen(opts->compiler_name) * sizeof(wchar_t), 0);
+    if (opts->compiler_flags) key = hash_bytes(opts->compiler_flags, wcslen(opts->compiler_flags) * sizeof(wchar_t), key);
+    for (int i = 0; i < opts->num_source_files; ++i) {
+        unsigned char* data = NULL;
+        size_t size = 0;
+        if (!read_file_bytes(opts->source_files[i], &data, &size)) return FALSE;
+        key = hash_bytes(data, size, key);
+        free(data);
+    }
+    return cache_entry_path(key, L".tune", path, path_size);
+}
+
+static BOOL save_flags(const ProgramOptions* opts, const wchar_t* flags) {
+    wchar_t path[MAX_PATH];
+    char utf8[1024];
+    if (!saved_flags_path(opts, path, MAX_PATH)) return FALSE;
+    int length = WideCharToMultiByte(CP_UTF8, 0, flags, -1, utf8, sizeof(utf8), NULL, NULL);
+    return length > 0 && write_file_bytes(path, utf8, length - 1);
+}
+
+// キャッシュに保存したフラグが1つでもあるか (無ければ毎回のビルドでソースを読んでキーを作らずに済む)
+static BOOL any_saved_flags(void) {
+    wchar_t pattern[MAX_PATH];
+    if (!cache_get_dir(pattern, MAX_PATH) || wcscat_s(pattern, MAX_PATH, L"\\*.tune") != 0) return FALSE;
+    WIN32_FIND_DATAW find_data;
+    HANDLE find = FindFirstFileW(pattern, &find_data);
+    if (find == INVALID_HANDLE_VALUE) return FALSE;
+    FindClose(find);
+    return TRUE;
+}
+
+// 以前の --autotune で保存したフラグがあれば返す
+BOOL autotune_load_saved(const ProgramOptions* opts, wchar_t* flags, size_t flags_size) {
+    wchar_t path[MAX_PATH];
+    if (!any_saved_flags() || !saved_flags_path(opts, path, MAX_PATH)) return FALSE;
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return FALSE;
+    int length = (size > 0) ? MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, flags, (int)flags_size - 1) : 0;
+    free(data);
+    if (length <= 0) return FALSE;
+    flags[length] = L'\0';
+    return TRUE;
+}
+
+// --- 探索 ---
+// 最も速い候補の信頼区間より確実に遅い候補の計測を打ち切る (基準の候補は最後の検定のために残す)
+static void prune_candidates(CompareVariant* candidates, int count, SampleStats* stats) {
+    int best = -1;
+    for (int i = 0; i < count; ++i) {
+        CompareVariant* c = &candidates[i];
+        if (!c->built || c->run_failed || c->pruned || c->num_runs == 0) continue;
+        stats_compute(c->run_ms, c->num_runs, &stats[i]);
+        if (best < 0 || stats[i].median < stats[best].median) best = i;
+    }
+    if (best < 0) return;
+    for (int i = 1; i < count; ++i) {
+        CompareVariant* c = &candidates[i];
+        if (i == best || !c->built || c->run_failed || c->pruned || c->num_runs == 0) continue;
+        if (stats[i].ci_low > stats[best].ci_high) c->pruned = TRUE;
+    }
+}
+
+// --- 公開関数 ---
+DWORD run_autotune(const ProgramOptions* opts, const wchar_t* work_dir) {
+    FlagDimension dims[8];
+    int num_dims = 0;
+    const wchar_t* space = opts->autotune_space ? opts->autotune_space : AUTOTUNE_DEFAULT_SPACE;
+    if (!parse_space(space, dims, _countof(dims), &num_dims)) {
+        fwprintf_err(L"Error: Invalid --autotune-space '%s' (e.g. \"-O2|-O3;|-march=native\").\n", space);
+        return 1;
+    }
+    CompareVariant* candidates = (CompareVariant*)calloc(AUTOTUNE_MAX_CANDIDATES, sizeof(CompareVariant));
+    SampleStats* stats = (SampleStats*)calloc(AUTOTUNE_MAX_CANDIDATES, sizeof(SampleStats));
+    int count = 0;
+    if (!candidates || !stats) {
+        free(candidates);
+        free(stats);
+        return 1;
+    }
+    if (!enumerate_candidates(dims, num_dims, opts->compiler_name, candidates, &count)) {
+        fwprintf_err(L"Error: --autotune-space has more than %d combinations.\n", AUTOTUNE_MAX_CANDIDATES);
+        free(candidates);
+        free(stats);
+        return 1;
+    }
+
+    wprintf(L"Autotune: building %d candidates...\n", count);
+    fflush(stdout);
+    compare_build_variants(opts, candidates, count, work_dir, opts->jobs);
+    DWORD exit_code = 1;
+    if (!candidates[0].built) {
+        fwprintf_err(L"Error: The baseline candidate (%s) could not be built.\n", candidates[0].label);
+        goto done;
+    }
+    compare_check_outputs(opts, candidates, count);
+    if (candidates[0].run_failed) {
+        fwprintf_err(L"Error: The baseline candidate (%s) did not run successfully.\n", candidates[0].label);
+        goto done;
+    }
+
+    {
+        fwprintf(stderr, L"Autotune: up to %d interleaved runs each ", opts->repeat);
+        for (int round = 0; round < opts->repeat; ++round) {
+            compare_run_round(opts, candidates, count, round);
+            if (round + 1 >= AUTOTUNE_MIN_RUNS) prune_candidates(candidates, count, stats);
+            fwprintf(stderr, L".");
+        }
+        fwprintf(stderr, L"\n");
+        if (candidates[0].run_failed) {
+            fwprintf_err(L"Error: The baseline candidate (%s) did not run successfully.\n", candidates[0].label);
+            goto done;
+        }
+
+        // 最も速い候補を、基準に対する U 検定で有意な場合だけ採用する。計測した候補の中から最も速いものを
+        // 選んでから検定するので、有意水準は比べた候補の数で割る (Bonferroni の補正)
+        int winner = 0, num_compared = 0;
+        for (int i = 0; i < count; ++i) {
+            CompareVariant* c = &candidates[i];
+            if (!c->built || c->run_failed || c->num_runs == 0) continue;
+            stats_compute(c->run_ms, c->num_runs, &stats[i]);
+            if (i > 0) num_compared++;
+            if (!c->pruned && stats[i].median < stats[winner].median) winner = i;
+        }
+        double alpha = AUTOTUNE_SIGNIFICANCE / (num_compared > 0 ? num_compared : 1);
+        double p = (winner == 0) ? 1.0 : stats_mann_whitney_p(candidates[winner].run_ms, candidates[winner].num_runs,
+                                                             candidates[0].run_ms, candidates[0].num_runs);
+        BOOL accepted = winner != 0 && p < alpha;
+
+        wprintf(L"\n--- Autotune (%s) ---\n", opts->compiler_name);
+        wprintf(L"%-40s %12s %5s %12s  %-23s %8s\n", L"Flags", L"Compile(ms)", L"Runs", L"Median(ms)", L"95% CI (ms)", L"Speedup");
+        for (int i = 0; i < count; ++i) {
+            const CompareVariant* c = &candidates[i];
+            if (!c->built) { wprintf(L"%-40.40s %12s\n", c->label, L"failed"); continue; }
+            if (c->run_failed || c->num_runs == 0) { wprintf(L"%-40.40s %12.1f %5s\n", c->label, c->compile_ms, L"failed"); continue; }
+            wchar_t interval[64];
+            swprintf_s(interval, _countof(interval), L"[%.3f, %.3f]", stats[i].ci_low, stats[i].ci_high);
+            wprintf(L"%-40.40s %12.1f %5d %12.3f  %-23s %7.2fx%s\n", c->label, c->compile_ms, c->num_runs, stats[i].median, interval,
+                    stats[i].median > 0 ? stats[0].median / stats[i].median : 0.0,
+                    i == 0 ? L" (baseline)" : (i == winner ? L" (best)" : (c->pruned ? L" (pruned)" : L"")));
+        }
+
+        const wchar_t* chosen = candidates[accepted ? winner : 0].flags;
+        if (accepted) {
+            wprintf(L"\nAutotune: %s is %.2fx faster than %s (p = %.4f < %.4f).\n", candidates[winner].label,
+                    stats[0].median / stats[winner].median, candidates[0].label, p, alpha);
+        } else if (winner != 0) {
+            wprintf(L"\nAutotune: %s is not significantly faster than %s (p = %.4f, needs < %.4f for %d candidates); keeping %s.\n",
+                    candidates[winner].label, candidates[0].label, p, alpha, num_compared, candidates[0].label);
+        } else {
+            wprintf(L"\nAutotune: no candidate is faster than %s; keeping it.\n", candidates[0].label);
+        }
+        if (save_flags(opts, chosen)) {
+            wprintf(L"Autotune: saved \"%s\"; later runs of this source use it.\n", chosen);
+            exit_code = 0;
+        } else {
+            fwprintf_err(L"Error: Could not save the autotune result to the cache.\n");
+        }
+    }
+
+done:
+    for (int i = 0; i < count; ++i) free(candidates[i].run_ms);
+    free(candidates);
+    free(stats);
+    return exit_code;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- 最適化フラグの自動調整 (--autotune) ---
+// フラグ空間の全ての組み合わせをビルドし、交互に繰り返し実行しながら明らかに遅い候補を途中で打ち切る。
+// 既定の組み合わせ (各次元の最初の候補) より統計的に有意に速い組み合わせだけを採用し、
+// ソースの内容をキーにキャッシュへ保存する。以降の実行では保存したフラグが既定の -O2 -s の後に付く
+
+// 次元を ';'、次元内の候補を '|' で区切る。空の候補はそのフラグを付けないことを表す
+#define AUTOTUNE_DEFAULT_SPACE L"-O2|-O3;|-march=native;|-flto;|-funroll-loops"
+#define AUTOTUNE_MAX_CANDIDATES 32
+#define AUTOTUNE_MIN_RUNS 3            // 打ち切りの判定を始めるまでの計測回数
+#define AUTOTUNE_SIGNIFICANCE 0.05     // 採用に必要な有意水準 (Mann-Whitney の U 検定。比べた候補の数で割って使う)
+
+// --- 関数宣言 ---
+DWORD run_autotune(const ProgramOptions* opts, const wchar_t* work_dir);
+BOOL autotune_load_saved(const ProgramOptions* opts, wchar_t* flags, size_t flags_size);
@@ -0,0 +1,51 @@
+#include "cache.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+// キャッシュディレクトリのパスを返す。無ければ作成する
+BOOL cache_get_dir(wchar_t* dir, size_t dir_size) {
+    wchar_t base[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return FALSE;
+
+    swprintf_s(dir, dir_size, L"%s\\crun", base);
+    if (!CreateDirectoryW(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return FALSE;
+    wcscat_s(dir, dir_size, L"\\cache");
+    if (!CreateDirectoryW(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return FALSE;
+    return TRUE;
+}
+
+BOOL cache_entry_path(ULONGLONG key, const wchar_t* suffix, wchar_t* path, size_t path_size) {
+    wchar_t dir[MAX_PATH];
+    if (!cache_get_dir(dir, MAX_PATH)) return FALSE;
+    return swprintf_s(path, path_size, L"%s\\%016llx%s", dir, key, suffix) > 0;
+}
+
+// エントリを書き込むための一時ファイルのパス (プロセスごとに異なる)。書き終えたら MoveFileEx で置き換える
+BOOL cache_temp_path(ULONGLONG key, const wchar_t* suffix, wchar_t* path, size_t path_size) {
+    wchar_t dir[MAX_PATH];
+    if (!cache_get_dir(dir, MAX_PATH)) return FALSE;
+    return swprintf_s(path, path_size, L"%s\\%016llx.%lu.tmp%s", dir, key, GetCurrentProcessId(), suffix) > 0;
+}
+
+// エントリが存在し、入力ファイルのどれよりも新しければそのパスを返す
+BOOL cache_lookup(ULONGLONG key, const wchar_t* suffix, const FILETIME* newest_input, wchar_t* path, size_t path_size) {
+    if (!cache_entry_path(key, suffix, path, path_size)) return FALSE;
+    FILETIME entry_time;
+    if (!get_file_write_time(path, &entry_time)) return FALSE;
+    return !newest_input || CompareFileTime(&entry_time, newest_input) >= 0;
+}
+
+// ファイルの内容をキーに混ぜる (読めない場合はパスだけを混ぜる)
+ULONGLONG cache_hash_file(const wchar_t* path, ULONGLONG seed) {
+    ULONGLONG hash = hash_bytes(path, wcslen(path) * sizeof(wchar_t), seed);
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (read_file_bytes(path, &data, &size)) {
+        hash = hash_bytes(data, size, hash);
+        free(data);
+    }
+    return hash;
+}
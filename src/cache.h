@@ -0,0 +1,14 @@
+#pragma once
+
+#include <windows.h>
+
+// --- ビルド成果物のキャッシュ (%LOCALAPPDATA%\crun\cache) ---
+// エントリはキー (ビルド内容のハッシュ) と拡張子で決まるファイル。
+// 書き込みは一時ファイルに行ってから置き換えるため、読み手が書きかけのファイルを見ることはない
+
+// --- 関数宣言 ---
+BOOL cache_get_dir(wchar_t* dir, size_t dir_size);
+BOOL cache_entry_path(ULONGLONG key, const wchar_t* suffix, wchar_t* path, size_t path_size);
+BOOL cache_temp_path(ULONGLONG key, const wchar_t* suffix, wchar_t* path, size_t path_size);
+BOOL cache_lookup(ULONGLONG key, const wchar_t* suffix, const FILETIME* newest_input, wchar_t* path, size_t path_size);
+ULONGLONG cache_hash_file(const wchar_t* path, ULONGLONG seed);
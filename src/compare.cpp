@@ -0,0 +1,346 @@
+#include "compare.h"
+#include "compiler.h"
+#include "process.h"
+#include "jobserver.h"
+#include "stats.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+static double elapsed_ms(const LARGE_INTEGER* start, const LARGE_INTEGER* end, const LARGE_INTEGER* frequency) {
+    return (double)(end->QuadPart - start->QuadPart) * 1000.0 / frequency->QuadPart;
+}
+
+// "gcc,clang,gcc:-O3 -march=native,-Os" を解析する。コンパイラを省略した項目 (-Os) は --compiler のコンパイラで、
+// フラグだけを変えたバリアントになる
+static BOOL parse_variants(const wchar_t* spec, const wchar_t* default_compiler, CompareVariant* variants, int* count) {
+    *count = 0;
+    const wchar_t* p = spec;
+    while (*p) {
+        size_t len = wcscspn(p, L",");
+        wchar_t item[1024];
+        while (len > 0 && *p == L' ') { p++; len--; }
+        wcsncpy_s(item, _countof(item), p, len < _countof(item) ? len : _countof(item) - 1);
+        for (size_t n = wcslen(item); n > 0 && item[n - 1] == L' '; --n) item[n - 1] = L'\0';
+        p += len;
+        if (*p == L',') p++;
+        if (item[0] == L'\0') continue;
+
+        if (*count == COMPARE_MAX_VARIANTS) {
+            fwprintf_err(L"Error: --compare accepts at most %d variants.\n", COMPARE_MAX_VARIANTS);
+            return FALSE;
+        }
+        CompareVariant* v = &variants[*count];
+        memset(v, 0, sizeof(CompareVariant));
+        const wchar_t* flags = NULL;
+        if (item[0] == L'-') {
+            v->compiler_name = default_compiler;
+            flags = item;
+        } else {
+            wchar_t* colon = wcschr(item, L':');
+            if (colon) {
+                *colon = L'\0';
+                flags = colon + 1;
+            }
+            if (wcscmp(item, L"gcc") == 0) v->compiler_name = L"gcc";
+            else if (wcscmp(item, L"clang") == 0) v->compiler_name = L"clang";
+            else {
+                fwprintf_err(L"Error: Unknown compiler '%s' in --compare (use gcc, clang, <compiler>:<flags> or <flags>).\n", item);
+                return FALSE;
+            }
+        }
+        if (flags) wcscpy_s(v->flags, _countof(v->flags), flags);
+        swprintf_s(v->label, _countof(v->label), v->flags[0] ? L"%s %s" : L"%s", v->compiler_name, v->flags);
+        (*count)++;
+    }
+    if (*count < 1) {
+        fwprintf_err(L"Error: --compare needs at least one variant (e.g. gcc,clang).\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void print_log(const CompareVariant* v) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (read_file_bytes(v->log_path, &data, &size)) {
+        if (size > 0) {
+            int wide_size = MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, NULL, 0);
+            wchar_t* text = (wchar_t*)malloc(sizeof(wchar_t) * (wide_size + 1));
+            if (text) {
+                MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, text, wide_size);
+                text[wide_size] = L'\0';
+                wprintf(L"[%s]\n%s", v->label, text);
+                free(text);
+            }
+        }
+        free(data);
+    }
+    DeleteFileW(v->log_path);
+}
+
+// --- ビルド ---
+// バリアントを最大 max_parallel 個ずつ同時にコンパイルし、それぞれの所要時間を記録する。ビルドできた数を返す
+int compare_build_variants(const ProgramOptions* opts, CompareVariant* variants, int count, const wchar_t* work_dir, int max_parallel) {
+    BOOL has_cpp = FALSE;
+    for (int i = 0; i < opts->num_source_files; ++i) {
+        const wchar_t* ext = get_extension(opts->source_files[i]);
+        if (ext && wcscmp(ext, L".cpp") == 0) has_cpp = TRUE;
+    }
+    wchar_t main_source_full_path[MAX_PATH], source_stem[MAX_PATH];
+    if (!GetFullPathNameW(opts->source_files[0], MAX_PATH, main_source_full_path, NULL)) return 0;
+    get_stem(main_source_full_path, source_stem, MAX_PATH);
+
+    wchar_t* command = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    wchar_t* cflags = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    if (!command || !cflags) { free(command); free(cflags); return 0; }
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    ChildProcess* running[PROCESS_WAIT_MAX];
+    int running_variant[PROCESS_WAIT_MAX];
+    int num_running = 0;
+    int num_built = 0;
+    if (max_parallel > PROCESS_WAIT_MAX) max_parallel = PROCESS_WAIT_MAX;
+    if (max_parallel < 1) max_parallel = 1;
+    for (int i = 0; i <= count; ++i) {
+        // 同時実行数の上限に達したか、ジョブサーバーのトークンが無いか、全て起動し終えたら終了を待つ
+        while (num_running > 0 && (num_running == max_parallel || i == count || !jobserver_acquire(num_running))) {
+            int slot = process_wait_any(running, num_running, INFINITE);
+            if (slot < 0) {
+                for (int r = 0; r < num_running; ++r) {
+                    process_terminate(running[r]);
+                    process_close(running[r]);
+                }
+                num_running = 0;
+                break;
+            }
+            CompareVariant* v = &variants[running_variant[slot]];
+            LARGE_INTEGER end;
+            QueryPerformanceCounter(&end);
+            v->compile_ms = elapsed_ms(&v->compile_start, &end, &frequency);
+            DWORD exit_code = 1;
+            process_exit_code(&v->compile, &exit_code);
+            process_close(&v->compile);
+
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (exit_code == 0 && GetFileAttributesExW(v->executable, GetFileExInfoStandard, &attributes)) {
+                v->built = TRUE;
+                v->size = ((ULONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+                num_built++;
+            }
+            running[slot] = running[num_running - 1];
+            running_variant[slot] = running_variant[num_running - 1];
+            num_running--;
+            jobserver_sync(num_running);
+        }
+        if (i == count) break;
+
+        CompareVariant* v = &variants[i];
+        swprintf_s(v->dir, MAX_PATH, L"%s\\v%d", work_dir, i);
+        swprintf_s(v->executable, MAX_PATH, L"%s\\%s.exe", v->dir, source_stem);
+        swprintf_s(v->log_path, MAX_PATH, L"%s\\compile.log", v->dir);
+        if (!CreateDirectoryW(v->dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) continue;
+
+        wchar_t compiler_path[MAX_PATH];
+        if (!find_compiler(v->compiler_name, has_cpp, compiler_path, MAX_PATH)) continue;
+        // --cflags は全てのバリアントに共通で、バリアントのフラグを後に付けて上書きできるようにする
+        ProgramOptions variant_opts = *opts;
+        variant_opts.compiler_name = v->compiler_name;
+        swprintf_s(cflags, 32767, L"%s %s", opts->compiler_flags ? opts->compiler_flags : L"", v->flags);
+        variant_opts.compiler_flags = cflags;
+        if (!build_compile_command(&variant_opts, opts->source_files, opts->num_source_files, v->executable, compiler_path, has_cpp, FALSE, command, 32767)) continue;
+        if (opts->verbose) wprintf(L"[%s] Command: %s\n", v->label, command);
+
+        ProcessSpawnOptions spawn = {};
+        spawn.output = PROCESS_OUTPUT_FILE;
+        spawn.output_file = v->log_path;
+        spawn.hide_window = TRUE;
+        QueryPerformanceCounter(&v->compile_start);
+        if (!process_spawn(command, &spawn, &v->compile)) {
+            fwprintf_err(L"Error: Failed to start the compiler for %s\n", v->label);
+            continue;
+        }
+        running[num_running] = &v->compile;
+        running_variant[num_running] = i;
+        num_running++;
+    }
+
+    jobserver_sync(0);
+    for (int i = 0; i < count; ++i) {
+        print_log(&variants[i]);
+        if (!variants[i].built) fwprintf_err(L"Error: Compilation failed for %s\n", variants[i].label);
+    }
+    free(command);
+    free(cflags);
+    return num_built;
+}
+
+// --- 実行 ---
+// 1回実行して所要時間を返す。output_file を指定した場合は出力をそこに書く (それ以外は捨てる)
+static BOOL run_variant_once(const ProgramOptions* opts, CompareVariant* v, const wchar_t* output_file, double* ms) {
+    wchar_t run_command[32767];
+    swprintf_s(run_command, 32767, L"\"%s\"", v->executable);
+    for (int i = 0; i < opts->num_program_args; ++i) {
+        wcscat_s(run_command, 32767, L" \"");
+        wcscat_s(run_command, 32767, opts->program_args[i]);
+        wcscat_s(run_command, 32767, L"\"");
+    }
+    ProcessSpawnOptions spawn = {};
+    spawn.output = output_file ? PROCESS_OUTPUT_FILE : PROCESS_OUTPUT_NULL;
+    spawn.output_file = output_file;
+    spawn.null_stdin = TRUE;
+    spawn.limits = opts->limits;
+    spawn.placement = opts->placement;
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    ChildProcess proc;
+    if (!process_spawn(run_command, &spawn, &proc)) {
+        fwprintf_err(L"Error: Failed to start %s\n", v->executable);
+        return FALSE;
+    }
+    DWORD exit_code = 1;
+    process_wait(&proc, INFINITE, &exit_code);
+    QueryPerformanceCounter(&end);
+    ProcessVerdict verdict = proc.verdict;
+    process_close(&proc);
+    *ms = elapsed_ms(&start, &end, &frequency);
+
+    if (verdict != PROCESS_VERDICT_EXITED || exit_code != 0) {
+        fwprintf_err(L"Error: %s failed (%s, exit code %lu); it is excluded from the comparison.\n", v->label, process_verdict_name(verdict), exit_code);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL files_equal(const wchar_t* a, const wchar_t* b) {
+    unsigned char *data_a = NULL, *data_b = NULL;
+    size_t size_a = 0, size_b = 0;
+    BOOL equal = read_file_bytes(a, &data_a, &size_a) && read_file_bytes(b, &data_b, &size_b) &&
+                 size_a == size_b && memcmp(data_a, data_b, size_a) == 0;
+    free(data_a);
+    free(data_b);
+    return equal;
+}
+
+// 各バリアントを1回ずつ試走し (計測しない)、出力が最初のバリアントと違えば警告する。計測値の領域もここで確保する
+void compare_check_outputs(const ProgramOptions* opts, CompareVariant* variants, int count) {
+    int reference = -1;
+    for (int i = 0; i < count; ++i) {
+        CompareVariant* v = &variants[i];
+        if (!v->built) continue;
+        v->run_ms = (double*)malloc(sizeof(double) * opts->repeat);
+        wchar_t output_path[MAX_PATH];
+        swprintf_s(output_path, MAX_PATH, L"%s\\output.txt", v->dir);
+        double ms;
+        if (!v->run_ms || !run_variant_once(opts, v, output_path, &ms)) {
+            v->run_failed = TRUE;
+            continue;
+        }
+        if (reference < 0) {
+            reference = i;
+        } else {
+            wchar_t reference_path[MAX_PATH];
+            swprintf_s(reference_path, MAX_PATH, L"%s\\output.txt", variants[reference].dir);
+            if (!files_equal(reference_path, output_path)) {
+                fwprintf_err(L"Warning: Output of %s differs from %s.\n", v->label, variants[reference].label);
+            }
+        }
+    }
+}
+
+// 計測を続けている全てのバリアントを1回ずつ実行する。round ごとに開始位置をずらして交互に実行することで、
+// 温度やクロック周波数の変化がどれか1つのバリアントに偏らないようにする
+void compare_run_round(const ProgramOptions* opts, CompareVariant* variants, int count, int round) {
+    for (int k = 0; k < count; ++k) {
+        CompareVariant* v = &variants[(round + k) % count];
+        if (!v->built || v->run_failed || v->pruned || v->num_runs >= opts->repeat) continue;
+        double ms;
+        if (run_variant_once(opts, v, NULL, &ms)) v->run_ms[v->num_runs++] = ms;
+        else v->run_failed = TRUE;
+    }
+}
+
+// --- 結果の表示 ---
+static void print_results(const ProgramOptions* opts, CompareVariant* variants, int count) {
+    SampleStats stats[COMPARE_MAX_VARIANTS];
+    int baseline = -1;
+    for (int i = 0; i < count; ++i) {
+        BOOL measured = variants[i].built && !variants[i].run_failed && variants[i].num_runs > 0;
+        if (measured) stats_compute(variants[i].run_ms, variants[i].num_runs, &stats[i]);
+        else memset(&stats[i], 0, sizeof(SampleStats));
+        if (measured && baseline < 0) baseline = i;
+    }
+
+    int label_width = 8;
+    for (int i = 0; i < count; ++i) {
+        int len = (int)wcslen(variants[i].label);
+        if (len > label_width) label_width = len;
+    }
+    if (label_width > 40) label_width = 40;
+
+    wprintf(L"\n--- Compare (%d interleaved runs each) ---\n", opts->repeat);
+    wprintf(L"%-*s %12s %10s %12s  %-23s %s\n", label_width, L"Variant", L"Compile(ms)", L"Size(KB)", L"Median(ms)", L"95% CI (ms)", L"Speedup");
+    BOOL any_significant = FALSE;
+    for (int i = 0; i < count; ++i) {
+        const CompareVariant* v = &variants[i];
+        if (!v->built) {
+            wprintf(L"%-*.*s %12s\n", label_width, label_width, v->label, L"failed");
+            continue;
+        }
+        wprintf(L"%-*.*s %12.1f %10.1f ", label_width, label_width, v->label, v->compile_ms, v->size / 1024.0);
+        if (stats[i].count == 0) {
+            wprintf(L"%12s\n", L"run failed");
+            continue;
+        }
+        wchar_t interval[64];
+        swprintf_s(interval, _countof(interval), L"[%.3f, %.3f]", stats[i].ci_low, stats[i].ci_high);
+        wprintf(L"%12.3f  %-23s ", stats[i].median, interval);
+        if (i == baseline) {
+            wprintf(L"1.00x (baseline)\n");
+        } else {
+            BOOL significant = !stats_intervals_overlap(&stats[i], &stats[baseline]);
+            any_significant |= significant;
+            wprintf(L"%.2fx%s\n", stats[i].median > 0 ? stats[baseline].median / stats[i].median : 0.0, significant ? L" *" : L"");
+        }
+    }
+    wprintf(L"Speedup = baseline median / variant median (higher is faster).");
+    if (any_significant) wprintf(L" * = confidence intervals do not overlap.");
+    wprintf(L"\n");
+}
+
+// --- 公開関数 ---
+// 全てのバリアントがビルドでき、正常に実行できれば 0 を返す
+DWORD run_compare(const ProgramOptions* opts, const wchar_t* work_dir) {
+    CompareVariant* variants = (CompareVariant*)calloc(COMPARE_MAX_VARIANTS, sizeof(CompareVariant));
+    int count = 0;
+    if (!variants) return 1;
+    if (!parse_variants(opts->compare_spec, opts->compiler_name, variants, &count)) {
+        free(variants);
+        return 1;
+    }
+    if (opts->verbose) wprintf(L"--- Compiling %d variants ---\n", count);
+    int num_built = compare_build_variants(opts, variants, count, work_dir, count);
+    if (num_built > 0) {
+        fwprintf(stderr, L"Running %d variants x %d ", num_built, opts->repeat);
+        compare_check_outputs(opts, variants, count);
+        for (int round = 0; round < opts->repeat; ++round) {
+            compare_run_round(opts, variants, count, round);
+            fwprintf(stderr, L".");
+        }
+        fwprintf(stderr, L"\n");
+        print_results(opts, variants, count);
+    }
+
+    DWORD exit_code = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!variants[i].built || variants[i].run_failed) exit_code = 1;
+        free(variants[i].run_ms);
+    }
+    free(variants);
+    return exit_code;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+#include "process.h"
+
+// --- コンパイラ・フラグの比較 (--compare) ---
+// 全てのバリアントを並列にビルドし、同じ引数で交互に繰り返し実行して、
+// コンパイル時間・バイナリサイズ・実行時間の中央値 (95%信頼区間) と相対速度を表にする
+// ビルドと交互計測の部分は --autotune と共有する
+#define COMPARE_MAX_VARIANTS 16
+
+// --- データ構造 ---
+struct CompareVariant {
+    wchar_t label[256];          // 表示名 ("gcc", "clang -O3" など)
+    const wchar_t* compiler_name;
+    wchar_t flags[1024];         // バリアント固有のフラグ (--cflags の後に付ける)
+    wchar_t dir[MAX_PATH];       // 出力先 (work_dir\v<番号>)
+    wchar_t executable[MAX_PATH];
+    wchar_t log_path[MAX_PATH];
+    ChildProcess compile;
+    LARGE_INTEGER compile_start;
+    double compile_ms;
+    ULONGLONG size;
+    BOOL built;
+    BOOL run_failed;             // 0 以外の終了コード・異常終了・制限超過
+    BOOL pruned;                 // 計測を打ち切った (--autotune で明らかに遅い候補)
+    double* run_ms;              // 計測値 (最大 opts->repeat 個)
+    int num_runs;
+};
+
+// --- 関数宣言 ---
+DWORD run_compare(const ProgramOptions* opts, const wchar_t* work_dir);
+int compare_build_variants(const ProgramOptions* opts, CompareVariant* variants, int count, const wchar_t* work_dir, int max_parallel);
+void compare_check_outputs(const ProgramOptions* opts, CompareVariant* variants, int count);
+void compare_run_round(const ProgramOptions* opts, CompareVariant* variants, int count, int round);
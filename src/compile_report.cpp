@@ -0,0 +1,378 @@
+#include "compile_report.h"
+#include "json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#define REPORT_TOP 15               // 各ランキングに表示する件数
+#define REPORT_MAX_INCLUDE_DEPTH 256
+
+// --- 集計 ---
+// key に対応する集計値を返す (無ければ作る)。メモリ不足の場合は NULL
+static ReportEntry* get_entry(StringSet* set, ReportEntry** stats, int* capacity, const wchar_t* key, size_t len, int* p_id) {
+    int id = string_set_intern(set, key, len, NULL);
+    if (id < 0) return NULL;
+    if (p_id) *p_id = id;
+    if (id >= *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 256;
+        while (new_capacity <= id) new_capacity *= 2;
+        ReportEntry* grown = (ReportEntry*)realloc(*stats, new_capacity * sizeof(ReportEntry));
+        if (!grown) return NULL;
+        memset(grown + *capacity, 0, (new_capacity - *capacity) * sizeof(ReportEntry));
+        *stats = grown;
+        *capacity = new_capacity;
+    }
+    return &(*stats)[id];
+}
+
+// ヘッダーのパスを正規化して集計値を返す (区切り文字の違いや ".." を吸収し、スキャン結果と比較できるようにする)
+static ReportEntry* get_header_entry(CompileReport* report, const wchar_t* path, size_t len, int* p_id) {
+    wchar_t raw[MAX_PATH], full_path[MAX_PATH];
+    if (len >= MAX_PATH) return NULL;
+    wmemcpy(raw, path, len);
+    raw[len] = L'\0';
+    for (wchar_t* c = raw; *c; ++c) if (*c == L'/') *c = L'\\';
+    if (!GetFullPathNameW(raw, MAX_PATH, full_path, NULL)) wcscpy_s(full_path, MAX_PATH, raw);
+    return get_entry(&report->headers, &report->header_stats, &report->header_capacity, full_path, wcslen(full_path), p_id);
+}
+
+static TuReport* add_tu(CompileReport* report, const wchar_t* name) {
+    if (report->num_tus == report->tu_capacity) {
+        int capacity = report->tu_capacity ? report->tu_capacity * 2 : 16;
+        TuReport* tus = (TuReport*)realloc(report->tus, capacity * sizeof(TuReport));
+        if (!tus) return NULL;
+        report->tus = tus;
+        report->tu_capacity = capacity;
+    }
+    TuReport* tu = &report->tus[report->num_tus];
+    memset(tu, 0, sizeof(TuReport));
+    tu->name = _wcsdup(name);
+    if (!tu->name) return NULL;
+    report->num_tus++;
+    return tu;
+}
+
+static ULONGLONG file_size_of(const wchar_t* path) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data)) return 0;
+    return ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+}
+
+// --- gcc (-ftime-report, -H) ---
+// " phase parsing   :   0.06 ( 55%)   0.03 ( 75%)   0.10 ( 62%)  1245k ( 10%)" の wall 列 (3番目の数値) を返す
+static double parse_time_report_wall(const wchar_t* line) {
+    const wchar_t* p = wcschr(line, L':');
+    if (!p) return 0;
+    double values[3] = {0};
+    int found = 0;
+    for (++p; *p && found < 3; ) {
+        if (*p == L'(') { // 括弧内の割合は読み飛ばす
+            const wchar_t* close = wcschr(p, L')');
+            if (!close) break;
+            p = close + 1;
+            continue;
+        }
+        wchar_t* end = NULL;
+        double value = wcstod(p, &end);
+        if (end != p) { values[found++] = value; p = end; continue; }
+        p++;
+    }
+    return found == 3 ? values[2] * 1000.0 : (found > 0 ? values[found - 1] * 1000.0 : 0);
+}
+
+static BOOL starts_with_trimmed(const wchar_t* line, const wchar_t* prefix) {
+    while (*line == L' ' || *line == L'\t') line++;
+    return wcsncmp(line, prefix, wcslen(prefix)) == 0;
+}
+
+// 1行分の -ftime-report を翻訳単位の合計に加える
+static void add_time_report_line(TuReport* tu, const wchar_t* line) {
+    double wall = parse_time_report_wall(line);
+    if (starts_with_trimmed(line, L"phase setup") || starts_with_trimmed(line, L"phase parsing") || starts_with_trimmed(line, L"phase lang. deferred")) {
+        tu->frontend_ms += wall;
+    } else if (starts_with_trimmed(line, L"phase opt and generate") || starts_with_trimmed(line, L"phase last asm") || starts_with_trimmed(line, L"phase finalize")) {
+        tu->backend_ms += wall;
+    } else if (starts_with_trimmed(line, L"template instantiation")) {
+        tu->templates_ms += wall;
+    } else if (starts_with_trimmed(line, L"TOTAL")) {
+        tu->total_ms = wall;
+    }
+}
+
+// gcc の出力から -H のインクルード木と -ftime-report の表を集計し、出力からは取り除く (診断メッセージだけを残す)。
+// gcc は入力ファイルを順にコンパイルするので、n 番目の表は n 番目の入力のものになる
+static void collect_gcc_output(CompileReport* report, wchar_t* const* inputs, int num_inputs, wchar_t* output) {
+    int stack[REPORT_MAX_INCLUDE_DEPTH]; // 現在のインクルード元 (深さごとのヘッダーID)
+    int depth = 0;
+    TuReport* tu = NULL;
+    BOOL in_guard_list = FALSE;
+
+    wchar_t* write = output;
+    wchar_t* line = output;
+    while (line && *line) {
+        wchar_t* line_end = wcschr(line, L'\n');
+        size_t raw_len = line_end ? (size_t)(line_end - line + 1) : wcslen(line);
+        size_t len = line_end ? (size_t)(line_end - line) : raw_len;
+        if (len > 0 && line[len - 1] == L'\r') len--;
+        wchar_t saved = line[len];
+        line[len] = L'\0';
+
+        BOOL drop = TRUE;
+        int dots = 0;
+        while (line[dots] == L'.') dots++;
+        if (tu) {
+            add_time_report_line(tu, line);
+            if (starts_with_trimmed(line, L"TOTAL")) tu = NULL;
+        } else if (dots > 0 && line[dots] == L' ') {
+            // -H: ". path" の点の数が深さを表す。入れ子の分は祖先すべてに加算する
+            in_guard_list = FALSE;
+            int id = -1;
+            ReportEntry* entry = get_header_entry(report, line + dots + 1, len - dots - 1, &id);
+            if (entry && id >= 0) {
+                ULONGLONG size = file_size_of(report->headers.items[id]);
+                entry->count++;
+                entry->bytes += size;
+                if (dots > REPORT_MAX_INCLUDE_DEPTH) dots = REPORT_MAX_INCLUDE_DEPTH;
+                for (int d = 0; d < dots - 1 && d < depth; ++d) {
+                    report->header_stats[stack[d]].bytes += size;
+                    report->header_stats[stack[d]].nested++;
+                }
+                depth = dots;
+                stack[dots - 1] = id;
+            }
+        } else if (wcsncmp(line, L"Time variable", 13) == 0) {
+            in_guard_list = FALSE;
+            depth = 0;
+            const wchar_t* name = (report->num_tus < num_inputs) ? inputs[report->num_tus] : L"(unknown)";
+            const wchar_t* slash = wcsrchr(name, L'\\');
+            tu = add_tu(report, slash ? slash + 1 : name);
+        } else if (wcsncmp(line, L"Multiple include guards may be useful for:", 42) == 0) {
+            in_guard_list = TRUE;
+        } else if (in_guard_list && (len == 0 || file_exists(line))) {
+            // インクルードガードの候補一覧 (パスだけの行) も -H の出力
+        } else if (wcsncmp(line, L"Extra diagnostic checks enabled", 31) == 0 || wcsncmp(line, L"Configure with --enable-checking", 32) == 0) {
+            // チェック付きでビルドされた gcc の注意書き
+        } else {
+            in_guard_list = FALSE;
+            drop = FALSE;
+        }
+
+        line[len] = saved;
+        if (!drop) {
+            memmove(write, line, raw_len * sizeof(wchar_t));
+            write += raw_len;
+        }
+        line = line_end ? line_end + 1 : NULL;
+    }
+    *write = L'\0';
+}
+
+// --- clang (-ftime-trace) ---
+static void collect_clang_trace(CompileReport* report, const wchar_t* trace_path, const wchar_t* tu_name) {
+    JsonValue* root = json_parse_file(trace_path, NULL, 0);
+    if (!root) return;
+    const JsonValue* events = json_get(root, L"traceEvents");
+    TuReport* tu = add_tu(report, tu_name);
+    for (const JsonValue* e = events ? events->first_child : NULL; e && tu; e = e->next) {
+        const wchar_t* name = json_get_string(e, L"name", L"");
+        double ms = json_get_number(e, L"dur", 0) / 1000.0;
+        const wchar_t* detail = json_get_string(json_get(e, L"args"), L"detail", NULL);
+
+        if (wcscmp(name, L"Source") == 0 && detail) {
+            ReportEntry* entry = get_header_entry(report, detail, wcslen(detail), NULL);
+            if (entry) { entry->time_ms += ms; entry->count++; }
+        } else if ((wcscmp(name, L"InstantiateClass") == 0 || wcscmp(name, L"InstantiateFunction") == 0) && detail) {
+            ReportEntry* entry = get_entry(&report->templates, &report->template_stats, &report->template_capacity, detail, wcslen(detail), NULL);
+            if (entry) { entry->time_ms += ms; entry->count++; }
+        } else if (wcscmp(name, L"Total Frontend") == 0) {
+            tu->frontend_ms = ms;
+        } else if (wcscmp(name, L"Total Backend") == 0) {
+            tu->backend_ms = ms;
+        } else if (wcscmp(name, L"Total InstantiateClass") == 0 || wcscmp(name, L"Total InstantiateFunction") == 0) {
+            tu->templates_ms += ms;
+        } else if (wcscmp(name, L"Total ExecuteCompiler") == 0) {
+            tu->total_ms = ms;
+        }
+    }
+    json_free(root);
+}
+
+// -ftime-trace は -o のオブジェクトと同じ名前で .json を書く。各入力は <trace_dir>\<stem>_<i>.o にコンパイルするので
+// (compile_objects)、入力ごとに <stem>_<i>.json を読み、翻訳単位には入力のファイル名を付ける
+static void collect_clang_traces(CompileReport* report, wchar_t* const* inputs, int num_inputs, const wchar_t* trace_dir) {
+    for (int i = 0; i < num_inputs; ++i) {
+        wchar_t stem[MAX_PATH], trace_path[MAX_PATH];
+        get_stem(inputs[i], stem, MAX_PATH);
+        swprintf_s(trace_path, MAX_PATH, L"%s\\%s_%d.json", trace_dir, stem, i);
+        const wchar_t* name = inputs[i];
+        for (const wchar_t* p = inputs[i]; *p; ++p) {
+            if (*p == L'\\' || *p == L'/') name = p + 1;
+        }
+        collect_clang_trace(report, trace_path, name);
+    }
+}
+
+// --- 公開関数 ---
+// コンパイルコマンドに追加するフラグ (clang のトレースは 100us 以上のイベントを記録する)
+const wchar_t* compile_report_flags(BOOL is_clang) {
+    return is_clang ? L" -ftime-trace -ftime-trace-granularity=100" : L" -ftime-report -H";
+}
+
+void compile_report_collect(CompileReport* report, BOOL is_clang, wchar_t* const* inputs, int num_inputs, const wchar_t* trace_dir, wchar_t* compiler_output) {
+    memset(report, 0, sizeof(CompileReport));
+    report->is_clang = is_clang;
+    if (is_clang) {
+        collect_clang_traces(report, inputs, num_inputs, trace_dir);
+    } else if (compiler_output) {
+        collect_gcc_output(report, inputs, num_inputs, compiler_output);
+    }
+}
+
+// --- 表示 ---
+struct RankedEntry {
+    int id;
+    double key;
+};
+
+static int compare_ranked_desc(const void* a, const void* b) {
+    double ka = ((const RankedEntry*)a)->key, kb = ((const RankedEntry*)b)->key;
+    return (ka < kb) - (ka > kb);
+}
+
+// 集計値を時間 (clang) または累積サイズ (gcc) の降順に並べる
+static RankedEntry* rank_entries(const ReportEntry* stats, int count, BOOL by_time) {
+    RankedEntry* ranked = (RankedEntry*)malloc((count + 1) * sizeof(RankedEntry));
+    if (!ranked) return NULL;
+    for (int i = 0; i < count; ++i) {
+        ranked[i].id = i;
+        ranked[i].key = by_time ? stats[i].time_ms : (double)stats[i].bytes;
+    }
+    qsort(ranked, count, sizeof(RankedEntry), compare_ranked_desc);
+    return ranked;
+}
+
+static const wchar_t* file_name_of(const wchar_t* path) {
+    const wchar_t* slash = wcsrchr(path, L'\\');
+    return slash ? slash + 1 : path;
+}
+
+static void print_entry_cost(const CompileReport* report, const ReportEntry* entry) {
+    if (report->is_clang) {
+        wprintf(L"%10.1f ms  %5dx", entry->time_ms, entry->count);
+    } else {
+        wprintf(L"%8.1f KB  %5dx  %6d nested", entry->bytes / 1024.0, entry->count, entry->nested);
+    }
+}
+
+// ソース中の #include ディレクティブに対応するヘッダーを集計結果から探す。
+// 探索パスで解決済みならフルパスで、見つからなければ書かれた名前で終わるパスで探す
+static int find_header_for_include(const CompileReport* report, const IncludeDirective* include) {
+    if (include->resolved) {
+        int id = string_set_find(&report->headers, include->resolved, wcslen(include->resolved));
+        if (id >= 0) return id;
+    }
+    wchar_t suffix[MAX_PATH];
+    swprintf_s(suffix, MAX_PATH, L"\\%s", include->target);
+    for (wchar_t* c = suffix; *c; ++c) if (*c == L'/') *c = L'\\';
+    size_t suffix_len = wcslen(suffix);
+    int best = -1;
+    for (int id = 0; id < report->headers.count; ++id) {
+        const wchar_t* path = report->headers.items[id];
+        size_t len = wcslen(path);
+        if (len < suffix_len || _wcsicmp(path + len - suffix_len, suffix) != 0) continue;
+        // 同名のヘッダーが複数ある場合は最も重いものを採る (インクルードパスの先頭で見つかるものとは限らない)
+        if (best < 0 || report->header_stats[id].time_ms + report->header_stats[id].bytes > report->header_stats[best].time_ms + report->header_stats[best].bytes) best = id;
+    }
+    return best;
+}
+
+void compile_report_print(const CompileReport* report, const IncludeList* includes) {
+    BOOL by_time = report->is_clang;
+    wprintf(L"\n--- Compile report (%s) ---\n", report->is_clang ? L"clang -ftime-trace" : L"gcc -ftime-report -H");
+    if (report->num_tus == 0 && report->headers.count == 0) {
+        wprintf(L"No timing data was produced by the compiler.\n");
+        return;
+    }
+
+    // 翻訳単位ごとの合計と、フロントエンド/バックエンドの内訳
+    double frontend = 0, backend = 0, templates = 0, total = 0;
+    wprintf(L"\nPer translation unit:\n      total   frontend    backend  templates  unit\n");
+    for (int i = 0; i < report->num_tus; ++i) {
+        const TuReport* tu = &report->tus[i];
+        wprintf(L"  %9.1f  %9.1f  %9.1f  %9.1f  %s\n", tu->total_ms, tu->frontend_ms, tu->backend_ms, tu->templates_ms, tu->name);
+        frontend += tu->frontend_ms;
+        backend += tu->backend_ms;
+        templates += tu->templates_ms;
+        total += tu->total_ms;
+    }
+    if (total > 0) {
+        wprintf(L"  %9.1f  %9.1f  %9.1f  %9.1f  (all, ms)  frontend %.0f%% / backend %.0f%%\n",
+                total, frontend, backend, templates, frontend * 100.0 / total, backend * 100.0 / total);
+    }
+
+    // ヘッダー (clang は累積解析時間、gcc は時間が得られないので入れ子を含む累積サイズで並べる)
+    RankedEntry* ranked = rank_entries(report->header_stats, report->headers.count, by_time);
+    if (ranked && report->headers.count > 0) {
+        wprintf(by_time ? L"\nTop headers by cumulative parse time:\n" : L"\nTop headers by cumulative size including nested headers:\n");
+        for (int i = 0; i < report->headers.count && i < REPORT_TOP; ++i) {
+            wprintf(L"  ");
+            print_entry_cost(report, &report->header_stats[ranked[i].id]);
+            wprintf(L"  %s\n", report->headers.items[ranked[i].id]);
+        }
+    }
+    free(ranked);
+
+    if (report->templates.count > 0) {
+        ranked = rank_entries(report->template_stats, report->templates.count, TRUE);
+        if (ranked) {
+            wprintf(L"\nTop template instantiations:\n");
+            for (int i = 0; i < report->templates.count && i < REPORT_TOP; ++i) {
+                const ReportEntry* entry = &report->template_stats[ranked[i].id];
+                wprintf(L"  %10.1f ms  %5dx  %s\n", entry->time_ms, entry->count, report->templates.items[ranked[i].id]);
+            }
+        }
+        free(ranked);
+    } else if (!report->is_clang && templates > 0) {
+        wprintf(L"\nTemplate instantiation: %.1f ms in total (per-template times require clang).\n", templates);
+    }
+
+    // ソースに書かれた #include ごとのコスト (削る・プリコンパイルする候補)
+    if (!includes || includes->count == 0) return;
+    RankedEntry* directives = (RankedEntry*)malloc(includes->count * sizeof(RankedEntry));
+    int* header_ids = (int*)malloc(includes->count * sizeof(int));
+    if (!directives || !header_ids) { free(directives); free(header_ids); return; }
+    int num_directives = 0;
+    for (int i = 0; i < includes->count; ++i) {
+        int id = find_header_for_include(report, &includes->items[i]);
+        if (id < 0) continue;
+        BOOL duplicate = FALSE; // 同じヘッダーを複数のファイルがインクルードしている場合は最初の1つだけ表示する
+        for (int j = 0; j < num_directives && !duplicate; ++j) duplicate = (header_ids[directives[j].id] == id);
+        if (duplicate) continue;
+        header_ids[i] = id;
+        directives[num_directives].id = i;
+        directives[num_directives].key = by_time ? report->header_stats[id].time_ms : (double)report->header_stats[id].bytes;
+        num_directives++;
+    }
+    qsort(directives, num_directives, sizeof(RankedEntry), compare_ranked_desc);
+    if (num_directives > 0) wprintf(L"\nIncludes in your sources, by cost:\n");
+    for (int i = 0; i < num_directives && i < REPORT_TOP; ++i) {
+        const IncludeDirective* include = &includes->items[directives[i].id];
+        wprintf(L"  ");
+        print_entry_cost(report, &report->header_stats[header_ids[directives[i].id]]);
+        wprintf(L"  %s: #include %s%s%s\n", file_name_of(include->file),
+                include->quoted ? L"\"" : L"<", include->target, include->quoted ? L"\"" : L">");
+    }
+    free(directives);
+    free(header_ids);
+}
+
+void compile_report_free(CompileReport* report) {
+    string_set_free(&report->headers);
+    string_set_free(&report->templates);
+    free(report->header_stats);
+    free(report->template_stats);
+    for (int i = 0; i < report->num_tus; ++i) free(report->tus[i].name);
+    free(report->tus);
+    memset(report, 0, sizeof(CompileReport));
+}
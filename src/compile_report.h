@@ -0,0 +1,44 @@
+#pragma once
+
+#include <windows.h>
+#include "utils.h"
+#include "compiler.h"
+
+// --- コンパイル時間の内訳 (--compile-report) ---
+// clang は -ftime-trace のトレースファイル、gcc は -ftime-report と -H の出力から集計する
+
+// ヘッダーやテンプレートごとの集計値 (全翻訳単位の合計)
+struct ReportEntry {
+    double time_ms;          // 累積時間 (入れ子の分を含む。clang のみ)
+    int count;               // 出現回数
+    ULONGLONG bytes;         // 入れ子を含むソースの累積サイズ (gcc のみ)
+    int nested;              // 入れ子でインクルードされたヘッダーの累積数 (gcc のみ)
+};
+
+// 翻訳単位ごとの合計
+struct TuReport {
+    wchar_t* name;
+    double frontend_ms;      // 解析 (プリプロセスを含む)
+    double backend_ms;       // 最適化とコード生成
+    double templates_ms;     // テンプレートの実体化
+    double total_ms;
+};
+
+struct CompileReport {
+    BOOL is_clang;
+    StringSet headers;       // ヘッダーのフルパス -> header_stats のインデックス
+    ReportEntry* header_stats;
+    int header_capacity;
+    StringSet templates;     // テンプレート名 -> template_stats のインデックス
+    ReportEntry* template_stats;
+    int template_capacity;
+    TuReport* tus;
+    int num_tus;
+    int tu_capacity;
+};
+
+// --- 関数宣言 ---
+const wchar_t* compile_report_flags(BOOL is_clang);
+void compile_report_collect(CompileReport* report, BOOL is_clang, wchar_t* const* inputs, int num_inputs, const wchar_t* trace_dir, wchar_t* compiler_output);
+void compile_report_print(const CompileReport* report, const IncludeList* includes);
+void compile_report_free(CompileReport* report);
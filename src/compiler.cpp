@@ -1,9 +1,16 @@
 #include "compiler.h"
 #include "utils.h"
+#include "timing.h"
+#include "process.h"
+#include "jobserver.h"
+#include "symindex.h"
+#include "cache.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <shlwapi.h> // For PathCanonicalizeW
+#include <shellapi.h> // For CommandLineToArgvW
 
 // --- データ構造 ---
 // ヘッダーファイルと対応するライブラリをマッピングする構造体
@@ -111,122 +118,438 @@ static const HeaderToLib lib_map[] = {
     {L"mmintrin.h", L"-mmmx"}, // MMX
 };
 
-// --- ヘルパー関数 ---
-// 指定された行で#includeまたは#pragmaがコメントアウトされているかチェックする
-bool is_commented_out(const wchar_t* line_start, const wchar_t* directive_pos) {
-    const wchar_t* p = line_start;
-    while (p < directive_pos) {
-        if (*p == L'/' && *(p + 1) == L'/') {
-            return true; // //行コメントの内側
-        }
-        p++;
+// --- インクルードの探索パス ---
+// ディレクトリの一覧のキャッシュ。ヘッダーを探すたびに探索パスの各ディレクトリを stat せず、
+// ディレクトリごとに一度だけ列挙して名前で引く (存在しないディレクトリは空の一覧になる)
+static StringSet g_listed_dirs;     // ディレクトリのフルパス (ID は g_dir_entries のインデックス)
+static StringSet* g_dir_entries;    // ディレクトリ内のファイルとサブディレクトリの名前
+static int g_dir_entries_capacity;
+
+static const StringSet* list_directory(const wchar_t* dir, size_t dir_len) {
+    int id = string_set_find(&g_listed_dirs, dir, dir_len);
+    if (id >= 0) return &g_dir_entries[id];
+    if (g_listed_dirs.count == g_dir_entries_capacity) {
+        int capacity = g_dir_entries_capacity ? g_dir_entries_capacity * 2 : 64;
+        StringSet* grown = (StringSet*)realloc(g_dir_entries, sizeof(StringSet) * capacity);
+        if (!grown) return NULL;
+        g_dir_entries = grown;
+        g_dir_entries_capacity = capacity;
+    }
+    id = string_set_intern(&g_listed_dirs, dir, dir_len, NULL);
+    if (id < 0) return NULL;
+    StringSet* entries = &g_dir_entries[id];
+    memset(entries, 0, sizeof(StringSet));
+
+    wchar_t pattern[MAX_PATH];
+    if (dir_len + 2 >= MAX_PATH) return entries;
+    swprintf_s(pattern, MAX_PATH, L"%.*s\\*", (int)dir_len, dir);
+    WIN32_FIND_DATAW find_data;
+    HANDLE h_find = FindFirstFileW(pattern, &find_data);
+    if (h_find != INVALID_HANDLE_VALUE) {
+        do {
+            if (wcscmp(find_data.cFileName, L".") != 0 && wcscmp(find_data.cFileName, L"..") != 0) {
+                string_set_intern(entries, find_data.cFileName, wcslen(find_data.cFileName), NULL);
+            }
+        } while (FindNextFileW(h_find, &find_data));
+        FindClose(h_find);
     }
-    return false;
+    return entries;
 }
 
-// 再帰的スキャン関数の前方宣言
-void scan_file_for_libs_recursive(const wchar_t* file_path, wchar_t* auto_flags, size_t auto_flags_size, wchar_t* linked_libs, size_t linked_libs_size, wchar_t** processed_files, int* processed_count, int max_processed);
+// dir の下の target (例: "GL/glew.h") を正規化したフルパスにし、存在すれば TRUE を返す
+static BOOL find_in_directory(const wchar_t* dir, size_t dir_len, const wchar_t* target, size_t target_len, wchar_t* path, size_t path_size) {
+    wchar_t joined[MAX_PATH * 2];
+    swprintf_s(joined, _countof(joined), L"%.*s\\%.*s", (int)dir_len, dir, (int)target_len, target);
+    for (wchar_t* c = joined; *c; ++c) if (*c == L'/') *c = L'\\';
+    if (wcslen(joined) >= MAX_PATH || path_size < MAX_PATH || !PathCanonicalizeW(path, joined)) return FALSE;
+    const wchar_t* leaf = wcsrchr(path, L'\\');
+    if (!leaf || leaf[1] == L'\0') return FALSE;
+    const StringSet* entries = list_directory(path, leaf - path);
+    return entries && string_set_find(entries, leaf + 1, wcslen(leaf + 1)) >= 0;
+}
 
-// 全てのソースファイルにわたってライブラリ検索を調整するメイン関数
-void find_libs_in_sources(const ProgramOptions* opts, wchar_t* auto_flags, size_t auto_flags_size) {
-    wchar_t linked_libs[1024] = {0}; // 重複を避けるためにリンクされたライブラリを追跡
-    wchar_t* processed_files[256] = {0}; // 無限再帰を避けるために処理されたファイルを追跡
-    int processed_count = 0;
+// コンパイラの既定のインクルードディレクトリ ("-v" の "#include <...> search starts here:" の一覧)。
+// コンパイラの起動は遅いため、結果はプロセス内とキャッシュ (.incdirs) に保存し、コンパイラが更新されるまで使う
+#define DEFAULT_INCLUDE_CACHE_SIZE 4
+struct DefaultIncludeDirs {
+    wchar_t compiler_path[MAX_PATH];
+    wchar_t* dirs;          // '\n' 区切り (見つからなければ空文字列)
+};
+static DefaultIncludeDirs g_default_include_dirs[DEFAULT_INCLUDE_CACHE_SIZE];
+static int g_num_default_include_dirs;
+
+// -E -v の出力から一覧を取り出し、フルパスに正規化して '\n' 区切りで返す
+#define SEARCH_LIST_SIZE 32767
+static wchar_t* parse_search_list(const wchar_t* output) {
+    const wchar_t* start = wcsstr(output, L"#include <...> search starts here:");
+    const wchar_t* end = start ? wcsstr(start, L"End of search list.") : NULL;
+    wchar_t* dirs = (wchar_t*)calloc(SEARCH_LIST_SIZE, sizeof(wchar_t));
+    if (!dirs || !end) return dirs;
+    size_t used = 0;
+    for (const wchar_t* line = wcschr(start, L'\n'); line && line < end; line = wcschr(line, L'\n')) {
+        line++;
+        while (*line == L' ' || *line == L'\t') line++;
+        size_t len = wcscspn(line, L"\r\n");
+        if (len == 0 || line + len > end || len >= MAX_PATH) continue;
+        wchar_t dir[MAX_PATH], full_path[MAX_PATH];
+        wmemcpy(dir, line, len);
+        dir[len] = L'\0';
+        if (wcsstr(dir, L"(framework directory)")) continue;
+        for (wchar_t* c = dir; *c; ++c) if (*c == L'/') *c = L'\\';
+        DWORD full_len = GetFullPathNameW(dir, MAX_PATH, full_path, NULL);
+        if (full_len == 0 || full_len >= MAX_PATH || used + full_len + 2 > SEARCH_LIST_SIZE) continue;
+        swprintf_s(dirs + used, SEARCH_LIST_SIZE - used, L"%s\n", full_path);
+        used += full_len + 1;
+    }
+    return dirs;
+}
 
-    for (int i = 0; i < opts->num_source_files; ++i) {
-        wchar_t full_path[MAX_PATH];
-        if (GetFullPathNameW(opts->source_files[i], MAX_PATH, full_path, NULL)) {
-            scan_file_for_libs_recursive(full_path, auto_flags, auto_flags_size, linked_libs, _countof(linked_libs), processed_files, &processed_count, _countof(processed_files));
+static const wchar_t* get_default_include_dirs(const wchar_t* compiler_path) {
+    for (int i = 0; i < g_num_default_include_dirs; ++i) {
+        if (_wcsicmp(g_default_include_dirs[i].compiler_path, compiler_path) == 0) return g_default_include_dirs[i].dirs;
+    }
+    if (g_num_default_include_dirs == DEFAULT_INCLUDE_CACHE_SIZE) return L"";
+
+    // キーはコンパイラのパス。コンパイラより古いエントリは使わない
+    const wchar_t* name = wcsrchr(compiler_path, L'\\');
+    BOOL is_cpp = wcsstr(name ? name : compiler_path, L"++") != NULL;
+    ULONGLONG key = hash_bytes(compiler_path, wcslen(compiler_path) * sizeof(wchar_t), 0);
+    wchar_t cache_path[MAX_PATH];
+    FILETIME compiler_time;
+    BOOL have_time = get_file_write_time(compiler_path, &compiler_time);
+    wchar_t* dirs = NULL;
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (have_time && cache_lookup(key, L".incdirs", &compiler_time, cache_path, MAX_PATH) && read_file_bytes(cache_path, &data, &size)) {
+        int length = MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, NULL, 0);
+        dirs = (wchar_t*)calloc(length + 1, sizeof(wchar_t));
+        if (dirs) MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, dirs, length);
+        free(data);
+    }
+    if (!dirs) {
+        wchar_t command[MAX_PATH + 64];
+        wchar_t* output = NULL;
+        swprintf_s(command, _countof(command), L"\"%s\" -x %s -E -v NUL", compiler_path, is_cpp ? L"c++" : L"c");
+        phase_begin(PHASE_COMMAND);
+        BOOL ok = run_process_and_capture_output(command, &output);
+        phase_end();
+        if (ok && output) dirs = parse_search_list(output);
+        free(output);
+        if (dirs && dirs[0] && cache_entry_path(key, L".incdirs", cache_path, MAX_PATH)) {
+            int length = WideCharToMultiByte(CP_UTF8, 0, dirs, -1, NULL, 0, NULL, NULL);
+            char* utf8 = (char*)malloc(length);
+            if (utf8 && WideCharToMultiByte(CP_UTF8, 0, dirs, -1, utf8, length, NULL, NULL) > 0) write_file_bytes(cache_path, utf8, length - 1);
+            free(utf8);
         }
     }
+    if (!dirs) dirs = _wcsdup(L"");
+    if (!dirs) return L"";
+
+    DefaultIncludeDirs* entry = &g_default_include_dirs[g_num_default_include_dirs++];
+    wcscpy_s(entry->compiler_path, MAX_PATH, compiler_path);
+    entry->dirs = dirs;
+    return dirs;
+}
 
-    // 処理済みファイルパスの追跡用に割り当てられたメモリを解放
-    for (int i = 0; i < processed_count; ++i) {
-        free(processed_files[i]);
+static void add_include_dir(IncludeSearchPath* search, const wchar_t* dir, size_t dir_len, IncludeDirKind kind) {
+    wchar_t copy[MAX_PATH], full_path[MAX_PATH];
+    if (dir_len == 0 || dir_len >= MAX_PATH) return;
+    wmemcpy(copy, dir, dir_len);
+    copy[dir_len] = L'\0';
+    for (wchar_t* c = copy; *c; ++c) if (*c == L'/') *c = L'\\';
+    DWORD full_len = GetFullPathNameW(copy, MAX_PATH, full_path, NULL);
+    if (full_len == 0 || full_len >= MAX_PATH) return;
+    while (full_len > 3 && full_path[full_len - 1] == L'\\') full_path[--full_len] = L'\0';
+    if (search->count == search->capacity) {
+        int capacity = search->capacity ? search->capacity * 2 : 16;
+        IncludeDir* grown = (IncludeDir*)realloc(search->dirs, sizeof(IncludeDir) * capacity);
+        if (!grown) return;
+        search->dirs = grown;
+        search->capacity = capacity;
     }
+    IncludeDir* entry = &search->dirs[search->count];
+    entry->path = _wcsdup(full_path);
+    entry->kind = kind;
+    if (entry->path) search->count++;
 }
 
-// #includeおよび#pragmaディレクティブをファイルで再帰的にスキャンしてライブラリフラグを構築する
-void scan_file_for_libs_recursive(const wchar_t* file_path, wchar_t* auto_flags, size_t auto_flags_size, wchar_t* linked_libs, size_t linked_libs_size, wchar_t** processed_files, int* processed_count, int max_processed) {
-    // 1. 同じファイルを複数回処理しないようにする
-    for (int i = 0; i < *processed_count; ++i) {
-        if (wcscmp(processed_files[i], file_path) == 0) return;
+// --cflags の -iquote / -I / -isystem / -idirafter と、コンパイラの既定のディレクトリから探索パスを作る。
+// 順序は gcc と同じ ("..." はインクルード元のディレクトリの次に -iquote、その後は <...> と共通)。
+// compiler_path が NULL なら既定のディレクトリは加えない
+void include_search_path_init(IncludeSearchPath* search, const wchar_t* compiler_flags, const wchar_t* compiler_path) {
+    memset(search, 0, sizeof(IncludeSearchPath));
+    int argc = 0;
+    wchar_t** argv = NULL;
+    if (compiler_flags && compiler_flags[0]) {
+        // CommandLineToArgvW は先頭をプログラム名として扱うため、ダミーを前に付ける
+        size_t size = wcslen(compiler_flags) + 3;
+        wchar_t* line = (wchar_t*)malloc(sizeof(wchar_t) * size);
+        if (line) {
+            swprintf_s(line, size, L"x %s", compiler_flags);
+            argv = CommandLineToArgvW(line, &argc);
+            free(line);
+        }
     }
 
-    // 2. 処理済みファイルのリストにファイルを追加する
-    if (*processed_count >= max_processed) return; // 深い再帰のための安全停止
-    processed_files[*processed_count] = _wcsdup(file_path);
-    (*processed_count)++;
+    static const struct { const wchar_t* flag; IncludeDirKind kind; } options[] = {
+        { L"-iquote", INCLUDE_DIR_QUOTE }, { L"-I", INCLUDE_DIR_USER }, { L"-isystem", INCLUDE_DIR_SYSTEM },
+    };
+    for (size_t o = 0; o < _countof(options); ++o) {
+        size_t flag_len = wcslen(options[o].flag);
+        for (int i = 1; i < argc; ++i) {
+            if (wcsncmp(argv[i], options[o].flag, flag_len) != 0) continue;
+            // "-Idir" と "-I dir" の両方の書き方を受け付ける
+            const wchar_t* value = argv[i] + flag_len;
+            if (*value == L'\0' && i + 1 < argc) value = argv[++i];
+            add_include_dir(search, value, wcslen(value), options[o].kind);
+        }
+    }
 
-    // 3. ファイルの内容を読み込む
-    wchar_t* content = NULL;
-    if (!read_file_content_wide(file_path, &content)) return;
+    BOOL no_default = FALSE;
+    for (int i = 1; i < argc; ++i) {
+        if (wcscmp(argv[i], L"-nostdinc") == 0) no_default = TRUE;
+    }
+    if (compiler_path && !no_default) {
+        const wchar_t* dirs = get_default_include_dirs(compiler_path);
+        for (const wchar_t* p = dirs; *p; ) {
+            size_t len = wcscspn(p, L"\n");
+            add_include_dir(search, p, len, INCLUDE_DIR_SYSTEM);
+            p += len;
+            if (*p == L'\n') p++;
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (wcsncmp(argv[i], L"-idirafter", 10) != 0) continue;
+        const wchar_t* value = argv[i] + 10;
+        if (*value == L'\0' && i + 1 < argc) value = argv[++i];
+        add_include_dir(search, value, wcslen(value), INCLUDE_DIR_SYSTEM);
+    }
+    if (argv) LocalFree(argv);
+}
 
-    // 4. 内容を行ごとにスキャンする
-    const wchar_t* line = content;
-    while (line && *line != L'\0') {
-        const wchar_t* line_end = wcschr(line, L'\n');
-        
-        // a. #include <...> と #include "..." をチェックする
-        for (size_t j = 0; j < _countof(lib_map); ++j) {
-            const wchar_t* header_pos = wcsstr(line, lib_map[j].header);
-            if (header_pos && (!line_end || header_pos < line_end) && !is_commented_out(line, header_pos)) {
-                if (!wcsstr(linked_libs, lib_map[j].library)) {
-                    wcscat_s(auto_flags, auto_flags_size, L" ");
-                    wcscat_s(auto_flags, auto_flags_size, lib_map[j].library);
-                    wcscat_s(linked_libs, linked_libs_size, lib_map[j].library);
-                    wcscat_s(linked_libs, linked_libs_size, L" ");
-                }
+void include_search_path_free(IncludeSearchPath* search) {
+    for (int i = 0; i < search->count; ++i) free(search->dirs[i].path);
+    free(search->dirs);
+    memset(search, 0, sizeof(IncludeSearchPath));
+}
+
+// --- ライブラリ検索 ---
+// システムヘッダー (-isystem や既定のディレクトリで見つかったもの) を読む深さ。1 ならソースや
+// ユーザーのヘッダーが直接インクルードしたものだけを読み (<GL/glew.h> が <GL/glu.h> を含む、など)、
+// その先 (windows.h の中の winbase.h など) は読まない
+#define SCAN_SYSTEM_DEPTH 1
+
+// スキャン1回分の状態。ファイルはIDの順に処理するので、files 自体が作業キューを兼ねる
+struct ScanContext {
+    StringSet files;        // 見つかったファイル (フルパス)
+    int* depths;            // ファイルの ID -> システムヘッダーとしての深さ (ユーザーのファイルは 0)
+    int depths_capacity;
+    const IncludeSearchPath* search; // NULL ならインクルード元からの相対パスだけを辿る
+    StringSet link_flags;   // 追加済みのフラグ (トークン単位の重複除去)
+    unsigned char lib_map_seen[(_countof(lib_map) + 7) / 8]; // 適用済みの lib_map エントリ
+    wchar_t* auto_flags;
+    size_t auto_flags_size;
+    BOOL truncated;
+    IncludeList* includes;  // NULL でなければ見つけた #include を記録する
+};
+
+// lib_map のヘッダー名 -> インデックスの索引 (初回のスキャン時に作成する)。
+// lib_map に重複はないので、ID はそのまま lib_map のインデックスになる
+static StringSet g_header_index;
+
+static BOOL build_header_index(void) {
+    if (g_header_index.count == (int)_countof(lib_map)) return TRUE;
+    for (size_t j = 0; j < _countof(lib_map); ++j) {
+        if (string_set_intern(&g_header_index, lib_map[j].header, wcslen(lib_map[j].header), NULL) != (int)j) {
+            string_set_free(&g_header_index);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// フラグを1つずつ追加する。追加済みのフラグは無視し、バッファに入りきらなければ警告して打ち切る。
+// libs_only なら -l だけを追加する (システムヘッダーの中のインクルードでは -mavx2 などを付けない)
+static void add_flags(ScanContext* ctx, const wchar_t* flags, BOOL libs_only) {
+    const wchar_t* p = flags;
+    while (*p) {
+        while (*p == L' ') p++;
+        if (!*p) break;
+        size_t len = wcscspn(p, L" ");
+        if (libs_only && wcsncmp(p, L"-l", 2) != 0) {
+            p += len;
+            continue;
+        }
+        BOOL added = FALSE;
+        if (string_set_intern(&ctx->link_flags, p, len, &added) >= 0 && added) {
+            size_t used = wcslen(ctx->auto_flags);
+            if (used + 1 + len < ctx->auto_flags_size) {
+                ctx->auto_flags[used] = L' ';
+                wmemcpy(ctx->auto_flags + used + 1, p, len);
+                ctx->auto_flags[used + 1 + len] = L'\0';
+            } else if (!ctx->truncated) {
+                fwprintf_err(L"警告: 自動検出したフラグが長すぎるため、一部を省略しました。\n");
+                ctx->truncated = TRUE;
             }
         }
+        p += len;
+    }
+}
 
-        // b. #pragma comment(lib, "...") をチェックする
-        const wchar_t* pragma_pos = wcsstr(line, L"#pragma comment(lib,");
-        if (pragma_pos && (!line_end || pragma_pos < line_end) && !is_commented_out(line, pragma_pos)) {
-            const wchar_t* lib_start = wcschr(pragma_pos, L'"');
-            if (lib_start) {
-                lib_start++; // 開始引用符を過ぎて移動
-                const wchar_t* lib_end = wcschr(lib_start, L'"');
-                if (lib_end) {
-                    wchar_t lib_name[256] = {0};
-                    wcsncpy_s(lib_name, _countof(lib_name), lib_start, lib_end - lib_start);
-                    
-                    // -lフラグとの互換性のために.libサフィックスがあれば削除
-                    wchar_t* dot_lib = wcsstr(lib_name, L".lib");
-                    if (dot_lib) *dot_lib = L'\0';
-
-                    wchar_t lib_flag[260];
-                    swprintf_s(lib_flag, _countof(lib_flag), L"-l%s", lib_name);
-
-                    if (!wcsstr(linked_libs, lib_flag)) {
-                        wcscat_s(auto_flags, auto_flags_size, L" ");
-                        wcscat_s(auto_flags, auto_flags_size, lib_flag);
-                        wcscat_s(linked_libs, linked_libs_size, lib_flag);
-                        wcscat_s(linked_libs, linked_libs_size, L" ");
-                    }
-                }
+// #include の対象 (例: "GL/gl.h") を lib_map から引く。完全一致のほか、
+// ディレクトリ部分を除いた名前でも引く (<sdk/zlib.h> -> zlib.h)。"mymath.h" が "math.h" に一致することはない。
+// システムヘッダーの中のインクルードではライブラリだけを追加し、エントリも適用済みにしない
+static void apply_header(ScanContext* ctx, const wchar_t* target, size_t len, BOOL in_system) {
+    const wchar_t* name = target;
+    for (;;) {
+        int j = string_set_find(&g_header_index, name, len - (name - target));
+        if (j >= 0) {
+            if (!(ctx->lib_map_seen[j / 8] & (1 << (j % 8)))) {
+                if (!in_system) ctx->lib_map_seen[j / 8] |= (unsigned char)(1 << (j % 8));
+                add_flags(ctx, lib_map[j].library, in_system);
             }
+            return;
         }
+        const wchar_t* slash = name;
+        while (slash < target + len && *slash != L'/' && *slash != L'\\') slash++;
+        if (slash >= target + len) return;
+        name = slash + 1;
+    }
+}
+
+// #pragma comment(lib, "name") の name を -lname として追加する
+static void apply_pragma_lib(ScanContext* ctx, const wchar_t* args) {
+    const wchar_t* p = args;
+    while (*p == L' ' || *p == L'\t') p++;
+    if (*p++ != L'(') return;
+    while (*p == L' ' || *p == L'\t') p++;
+    if (wcsncmp(p, L"lib", 3) != 0) return;
+    p += 3;
+    while (*p == L' ' || *p == L'\t') p++;
+    if (*p++ != L',') return;
+    const wchar_t* lib_start = wcschr(p, L'"');
+    if (!lib_start) return;
+    lib_start++;
+    const wchar_t* lib_end = wcschr(lib_start, L'"');
+    if (!lib_end || lib_end == lib_start) return;
+
+    // -lフラグとの互換性のために.libサフィックスがあれば削除
+    size_t len = lib_end - lib_start;
+    if (len > 4 && _wcsnicmp(lib_end - 4, L".lib", 4) == 0) len -= 4;
+    if (len == 0 || len > 256 || wmemchr(lib_start, L' ', len)) return;
+
+    wchar_t lib_flag[260];
+    swprintf_s(lib_flag, _countof(lib_flag), L"-l%.*s", (int)len, lib_start);
+    add_flags(ctx, lib_flag, FALSE);
+}
+
+static void record_include(IncludeList* includes, const wchar_t* file_path, const wchar_t* target, size_t target_len, BOOL quoted, const wchar_t* resolved) {
+    if (includes->count == includes->capacity) {
+        int capacity = includes->capacity ? includes->capacity * 2 : 64;
+        IncludeDirective* items = (IncludeDirective*)realloc(includes->items, capacity * sizeof(IncludeDirective));
+        if (!items) return;
+        includes->items = items;
+        includes->capacity = capacity;
+    }
+    IncludeDirective* d = &includes->items[includes->count];
+    d->file = _wcsdup(file_path);
+    d->target = (wchar_t*)malloc((target_len + 1) * sizeof(wchar_t));
+    d->resolved = resolved ? _wcsdup(resolved) : NULL;
+    d->quoted = quoted;
+    if (!d->file || !d->target) {
+        free(d->file);
+        free(d->target);
+        free(d->resolved);
+        return;
+    }
+    wmemcpy(d->target, target, target_len);
+    d->target[target_len] = L'\0';
+    includes->count++;
+}
+
+// スキャンするファイルを登録する (登録済みなら何もしない)。ID の順に処理するので、最初に見つかった深さが最も浅い
+static void add_scan_file(ScanContext* ctx, const wchar_t* path, int depth) {
+    if (string_set_find(&ctx->files, path, wcslen(path)) >= 0) return;
+    if (ctx->files.count == ctx->depths_capacity) {
+        int capacity = ctx->depths_capacity ? ctx->depths_capacity * 2 : 64;
+        int* grown = (int*)realloc(ctx->depths, sizeof(int) * capacity);
+        if (!grown) return;
+        ctx->depths = grown;
+        ctx->depths_capacity = capacity;
+    }
+    int id = string_set_intern(&ctx->files, path, wcslen(path), NULL);
+    if (id >= 0) ctx->depths[id] = depth;
+}
+
+// #include の対象を探す。"..." はインクルード元のディレクトリと -iquote から、その後は <...> と同じく
+// -I、-isystem、コンパイラの既定のディレクトリの順に探す。is_system には見つかった場所がシステムヘッダーかを返す
+static BOOL resolve_include(const ScanContext* ctx, const wchar_t* file_path, BOOL in_system, const wchar_t* target, size_t target_len, BOOL quoted,
+                            wchar_t* path, size_t path_size, BOOL* is_system) {
+    if (target_len >= MAX_PATH) return FALSE;
+    if (quoted) {
+        const wchar_t* last_slash = wcsrchr(file_path, L'\\');
+        if (last_slash && find_in_directory(file_path, last_slash - file_path, target, target_len, path, path_size)) {
+            *is_system = in_system;
+            return TRUE;
+        }
+    }
+    if (!ctx->search) return FALSE;
+    for (int i = 0; i < ctx->search->count; ++i) {
+        const IncludeDir* dir = &ctx->search->dirs[i];
+        if (dir->kind == INCLUDE_DIR_QUOTE && !quoted) continue;
+        if (find_in_directory(dir->path, wcslen(dir->path), target, target_len, path, path_size)) {
+            *is_system = dir->kind == INCLUDE_DIR_SYSTEM;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
 
-        // c. #include "relative_path.h" をチェックして再帰する
-        const wchar_t* include_pos = wcsstr(line, L"#include \"");
-        if (include_pos && (!line_end || include_pos < line_end) && !is_commented_out(line, include_pos)) {
-            const wchar_t* path_start = include_pos + wcslen(L"#include \"");
-            const wchar_t* path_end = wcschr(path_start, L'"');
-            if (path_end) {
-                wchar_t rel_path[MAX_PATH];
-                wcsncpy_s(rel_path, _countof(rel_path), path_start, path_end - path_start);
-
-                wchar_t current_dir[MAX_PATH] = {0};
-                wcsncpy_s(current_dir, _countof(current_dir), file_path, (wcsrchr(file_path, L'\\') - file_path + 1));
-                
-                wchar_t header_full_path[MAX_PATH];
-                swprintf_s(header_full_path, _countof(header_full_path), L"%s%s", current_dir, rel_path);
-                
-                wchar_t canonical_path[MAX_PATH];
-                if (PathCanonicalizeW(canonical_path, header_full_path)) {
-                    scan_file_for_libs_recursive(canonical_path, auto_flags, auto_flags_size, linked_libs, linked_libs_size, processed_files, processed_count, max_processed);
+// 1つのファイルの #include / #pragma ディレクティブを調べる。
+// 見つかったヘッダーは files に登録し、後で同じループの中で処理される。システムヘッダーは
+// SCAN_SYSTEM_DEPTH の深さまでだけ読み、その先のインクルードは名前で lib_map を引くだけにする
+static void scan_file_for_libs(ScanContext* ctx, int id) {
+    const wchar_t* file_path = ctx->files.items[id];
+    int depth = ctx->depths[id];
+    BOOL in_system = depth > 0;
+    wchar_t* content = NULL;
+    if (!read_file_content_wide(file_path, &content)) return;
+
+    wchar_t* line = content;
+    while (line) {
+        wchar_t* line_end = wcschr(line, L'\n');
+        if (line_end) *line_end = L'\0'; // 以降の検索をこの行の中だけに限定する
+
+        // ディレクティブは行頭 (空白の後) の '#' で始まる。コメントや文字列の中の記述は対象外
+        const wchar_t* p = line;
+        while (*p == L' ' || *p == L'\t') p++;
+        if (*p == L'#') {
+            p++;
+            while (*p == L' ' || *p == L'\t') p++;
+            if (wcsncmp(p, L"include", 7) == 0) {
+                p += 7;
+                while (*p == L' ' || *p == L'\t') p++;
+                wchar_t close = (*p == L'<') ? L'>' : (*p == L'"') ? L'"' : 0;
+                const wchar_t* target_end = close ? wcschr(p + 1, close) : NULL;
+                if (target_end && target_end > p + 1) {
+                    const wchar_t* target = p + 1;
+                    size_t target_len = target_end - target;
+                    apply_header(ctx, target, target_len, in_system);
+
+                    wchar_t resolved_path[MAX_PATH];
+                    BOOL is_system = FALSE;
+                    const wchar_t* resolved = NULL;
+                    if (resolve_include(ctx, file_path, in_system, target, target_len, close == L'"', resolved_path, MAX_PATH, &is_system)) {
+                        resolved = resolved_path;
+                        int child_depth = is_system ? depth + 1 : 0;
+                        if (child_depth <= SCAN_SYSTEM_DEPTH) add_scan_file(ctx, resolved_path, child_depth);
+                    }
+                    if (ctx->includes) record_include(ctx->includes, file_path, target, target_len, close == L'"', resolved);
                 }
+            } else if (wcsncmp(p, L"pragma", 6) == 0) {
+                p += 6;
+                while (*p == L' ' || *p == L'\t') p++;
+                if (wcsncmp(p, L"comment", 7) == 0) apply_pragma_lib(ctx, p + 7);
             }
         }
 
@@ -235,6 +558,106 @@ void scan_file_for_libs_recursive(const wchar_t* file_path, wchar_t* auto_flags,
     free(content);
 }
 
+// ソースから辿れるファイルを順にスキャンする。
+// 各ファイルは一度だけ読み、スキャン中に登録されたヘッダーも同じループで処理される
+static void scan_sources(ScanContext* ctx, wchar_t* const* source_files, int num_source_files) {
+    if (!build_header_index()) {
+        fwprintf_err(L"エラー: ライブラリ検索のためのメモリを確保できませんでした。\n");
+    }
+    for (int i = 0; i < num_source_files; ++i) {
+        wchar_t full_path[MAX_PATH];
+        if (GetFullPathNameW(source_files[i], MAX_PATH, full_path, NULL)) add_scan_file(ctx, full_path, 0);
+    }
+    for (int id = 0; id < ctx->files.count; ++id) {
+        scan_file_for_libs(ctx, id);
+    }
+}
+
+static void free_scan_context(ScanContext* ctx) {
+    string_set_free(&ctx->files);
+    string_set_free(&ctx->link_flags);
+    free(ctx->depths);
+}
+
+// 全てのソースファイルにわたってライブラリ検索を調整するメイン関数
+// newest_input が指定された場合、スキャンしたファイル (ソースとヘッダー) の最新の更新日時を返す
+void find_libs_in_sources(wchar_t* const* source_files, int num_source_files, const IncludeSearchPath* search, wchar_t* auto_flags, size_t auto_flags_size, FILETIME* newest_input) {
+    phase_begin(PHASE_SCAN);
+    ScanContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.auto_flags = auto_flags;
+    ctx.auto_flags_size = auto_flags_size;
+    ctx.search = search;
+
+    // 既に auto_flags にあるフラグ (-O2 など) は重複として扱う
+    for (const wchar_t* p = auto_flags; *p; ) {
+        while (*p == L' ') p++;
+        size_t len = wcscspn(p, L" ");
+        if (len) string_set_intern(&ctx.link_flags, p, len, NULL);
+        p += len;
+    }
+    scan_sources(&ctx, source_files, num_source_files);
+
+    if (newest_input) {
+        memset(newest_input, 0, sizeof(FILETIME));
+        for (int id = 0; id < ctx.files.count; ++id) {
+            FILETIME write_time;
+            if (get_file_write_time(ctx.files.items[id], &write_time) && CompareFileTime(&write_time, newest_input) > 0) {
+                *newest_input = write_time;
+            }
+        }
+    }
+
+    free_scan_context(&ctx);
+    phase_end();
+}
+
+// ソースから辿れる全ての #include ディレクティブを集める (--compile-report で結果と突き合わせる)
+void find_includes_in_sources(wchar_t* const* source_files, int num_source_files, const IncludeSearchPath* search, IncludeList* includes) {
+    phase_begin(PHASE_SCAN);
+    memset(includes, 0, sizeof(IncludeList));
+    wchar_t scratch[4096] = {0};
+    ScanContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.auto_flags = scratch;
+    ctx.auto_flags_size = _countof(scratch);
+    ctx.truncated = TRUE; // フラグは使わないので溢れても警告しない
+    ctx.includes = includes;
+    ctx.search = search;
+    scan_sources(&ctx, source_files, num_source_files);
+    free_scan_context(&ctx);
+    phase_end();
+}
+
+void free_include_list(IncludeList* includes) {
+    for (int i = 0; i < includes->count; ++i) {
+        free(includes->items[i].file);
+        free(includes->items[i].target);
+        free(includes->items[i].resolved);
+    }
+    free(includes->items);
+    memset(includes, 0, sizeof(IncludeList));
+}
+
+// 自動検出されたフラグをコンパイル用 (-m... など) とリンク用 (-l...) に振り分ける
+void split_link_flags(const wchar_t* flags, wchar_t* compile_flags, size_t compile_flags_size, wchar_t* link_flags, size_t link_flags_size) {
+    const wchar_t* p = flags;
+    while (*p) {
+        while (*p == L' ') p++;
+        if (!*p) break;
+        const wchar_t* end = wcschr(p, L' ');
+        size_t len = end ? (size_t)(end - p) : wcslen(p);
+        wchar_t token[260];
+        wcsncpy_s(token, _countof(token), p, len < _countof(token) ? len : _countof(token) - 1);
+        BOOL is_link = (wcsncmp(token, L"-l", 2) == 0);
+        wchar_t* dest = is_link ? link_flags : compile_flags;
+        size_t dest_size = is_link ? link_flags_size : compile_flags_size;
+        if (dest[0] != L'\0') wcscat_s(dest, dest_size, L" ");
+        wcscat_s(dest, dest_size, token);
+        p += len;
+    }
+}
+
 
 // --- コンパイラ設定 ---
 BOOL find_compiler(const wchar_t* compiler_name, BOOL has_cpp, wchar_t* compiler_path, size_t path_size) {
@@ -254,12 +677,70 @@ BOOL find_compiler(const wchar_t* compiler_name, BOOL has_cpp, wchar_t* compiler
 }
 
 // --- コンパイル ---
-BOOL build_compile_command(const ProgramOptions* opts, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL has_cpp, wchar_t* command, size_t command_size) {
+// 最適化フラグと警告フラグを flags に書き込む (ソースのスキャンは不要)
+static void build_base_flags(const ProgramOptions* opts, BOOL quick, wchar_t* flags, size_t flags_size) {
+    if (opts->debug_build) {
+        wcscpy_s(flags, flags_size, L"-g");
+    } else if (quick) {
+        wcscpy_s(flags, flags_size, L"-O0");
+    } else if (opts->profile || opts->alloc_stats) {
+        wcscpy_s(flags, flags_size, L"-O2 -g"); // シンボル解決のためストリップしない
+    } else {
+        wcscpy_s(flags, flags_size, L"-O2 -s");
+        if (opts->tuned_flags) { // --autotune で保存したフラグ
+            wcscat_s(flags, flags_size, L" ");
+            wcscat_s(flags, flags_size, opts->tuned_flags);
+        }
+    }
+    if (opts->profile) {
+        wcscat_s(flags, flags_size, L" -fno-omit-frame-pointer");
+    }
+    if (opts->warnings_all) {
+        wcscat_s(flags, flags_size, L" -Wall");
+    }
+}
+
+// ソースファイルとヘッダーファイルをスキャンして、必要なライブラリとフラグを flags に追加する。
+// compiler_path が NULL なら -I などで指定したディレクトリだけを探し、コンパイラの既定のディレクトリ
+// (の問い合わせ) とシステムヘッダーの中は調べない。-mavx2 などのコンパイル用のフラグはシステムヘッダーの
+// 外のインクルードからしか付かないため、この範囲でもコンパイル用のフラグは全て見つかる
+static void scan_auto_flags(const ProgramOptions* opts, const wchar_t* compiler_path, wchar_t* flags, size_t flags_size) {
+    IncludeSearchPath search;
+    include_search_path_init(&search, opts->compiler_flags, compiler_path);
+    find_libs_in_sources(opts->source_files, opts->num_source_files, &search, flags, flags_size, NULL);
+    include_search_path_free(&search);
+}
+
+// 最適化フラグ・自動検出したフラグ・警告フラグを auto_flags に書き込む
+static void build_auto_flags(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL quick, wchar_t* auto_flags, size_t auto_flags_size) {
+    build_base_flags(opts, quick, auto_flags, auto_flags_size);
+    scan_auto_flags(opts, compiler_path, auto_flags, auto_flags_size);
+}
+
+// compile_and_link がオブジェクトのコンパイルに付けるフラグ (最適化・警告・ユーザーのヘッダーから検出した
+// -m... など) を flags に書き込む。ユーザーの --cflags は含まない。--modules で同じフラグの BMI を作るのに使う
+void build_object_flags(const ProgramOptions* opts, BOOL quick, wchar_t* flags, size_t flags_size) {
+    wchar_t* auto_flags = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    wchar_t* libs = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    flags[0] = L'\0';
+    if (auto_flags && libs) {
+        libs[0] = L'\0';
+        build_base_flags(opts, quick, auto_flags, 32767);
+        scan_auto_flags(opts, NULL, auto_flags, 32767);
+        split_link_flags(auto_flags, flags, flags_size, libs, 32767);
+    }
+    free(auto_flags);
+    free(libs);
+}
+
+// inputs はコンパイラに渡すファイル (通常は opts->source_files、ユニティビルドでは生成したファイル)。
+// ライブラリの自動検出は常に元のソースに対して行う。quick なら最適化せずにビルドする (--tiered の初回)
+BOOL build_compile_command(const ProgramOptions* opts, wchar_t* const* inputs, int num_inputs, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL has_cpp, BOOL quick, wchar_t* command, size_t command_size) {
     wchar_t all_source_files_str[32767] = {0};
-    for (int i = 0; i < opts->num_source_files; ++i) {
+    for (int i = 0; i < num_inputs; ++i) {
         wchar_t full_path[MAX_PATH];
-        if (!GetFullPathNameW(opts->source_files[i], MAX_PATH, full_path, NULL)) {
-            fwprintf_err(L"エラー: ソースファイルのフルパスを取得できませんでした: %s\n", opts->source_files[i]);
+        if (!GetFullPathNameW(inputs[i], MAX_PATH, full_path, NULL)) {
+            fwprintf_err(L"エラー: ソースファイルのフルパスを取得できませんでした: %s\n", inputs[i]);
             return FALSE;
         }
         if (i > 0) {
@@ -270,19 +751,8 @@ BOOL build_compile_command(const ProgramOptions* opts, const wchar_t* executable
         wcscat_s(all_source_files_str, _countof(all_source_files_str), L"\"");
     }
 
-    wchar_t auto_flags[2048] = {0}; // より多くのライブラリフラグのためにサイズを増加
-    if (opts->debug_build) {
-        wcscpy_s(auto_flags, _countof(auto_flags), L"-g");
-    } else {
-        wcscpy_s(auto_flags, _countof(auto_flags), L"-O2 -s");
-    }
-
-    // ソースファイルとヘッダーファイルをスキャンして必要なライブラリをすべて見つける
-    find_libs_in_sources(opts, auto_flags, _countof(auto_flags));
-
-    if (opts->warnings_all) {
-        wcscat_s(auto_flags, _countof(auto_flags), L" -Wall");
-    }
+    wchar_t auto_flags[32767] = {0}; // コマンドラインの上限に合わせる
+    build_auto_flags(opts, compiler_path, quick, auto_flags, _countof(auto_flags));
 
     const wchar_t* user_flags = opts->compiler_flags ? opts->compiler_flags : L"";
     const wchar_t* user_libs = opts->user_libraries ? opts->user_libraries : L"";
@@ -296,4 +766,240 @@ BOOL build_compile_command(const ProgramOptions* opts, const wchar_t* executable
                executable_path);
 
     return TRUE;
-}
\ No newline at end of file
+}
+// --- コンパイルとリンク ---
+struct LinkBuffers {
+    wchar_t auto_flags[32767];
+    wchar_t compile_flags[32767];   // -m... などコンパイルとリンクの両方に渡すフラグ
+    wchar_t detected_libs[32767];   // ヘッダーと #pragma comment から検出した -l
+    wchar_t resolved_libs[32767];   // シンボル索引で解決した -l (--minimal-link)
+    wchar_t scanned_flags[32767];   // コンパイル中のスキャンで見つかったコンパイル用のフラグ (compile_flags に含まれるはず)
+    wchar_t command[32767];
+};
+
+// UTF-8 のログファイルの内容を output (ワイド文字列) の末尾に追加し、ファイルを削除する
+static void append_log(const wchar_t* log_path, wchar_t** output) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (read_file_bytes(log_path, &data, &size)) {
+        if (size > 0) {
+            int wide_size = MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, NULL, 0);
+            size_t old_len = *output ? wcslen(*output) : 0;
+            wchar_t* grown = (wchar_t*)realloc(*output, sizeof(wchar_t) * (old_len + wide_size + 1));
+            if (grown) {
+                MultiByteToWideChar(CP_UTF8, 0, (const char*)data, (int)size, grown + old_len, wide_size);
+                grown[old_len + wide_size] = L'\0';
+                *output = grown;
+            }
+        }
+        free(data);
+    }
+    DeleteFileW(log_path);
+}
+
+// flags に無いトークンを scanned から flags に加える。加えたものがあれば TRUE
+static BOOL add_missing_flags(wchar_t* flags, size_t flags_size, const wchar_t* scanned) {
+    BOOL added = FALSE;
+    for (const wchar_t* p = scanned; *p; ) {
+        while (*p == L' ') p++;
+        size_t len = wcscspn(p, L" ");
+        if (len == 0) break;
+        BOOL found = FALSE;
+        for (const wchar_t* q = flags; *q && !found; ) {
+            while (*q == L' ') q++;
+            size_t q_len = wcscspn(q, L" ");
+            found = (q_len == len && wcsncmp(p, q, len) == 0);
+            q += q_len;
+        }
+        if (!found) {
+            if (flags[0]) wcscat_s(flags, flags_size, L" ");
+            wcsncat_s(flags, flags_size, p, len);
+            added = TRUE;
+        }
+        p += len;
+    }
+    return added;
+}
+
+// 各入力を b->compile_flags でオブジェクトにコンパイルする (最大 opts->jobs 個を並列に)。出力が混ざらないよう、
+// 各コンパイラの出力はログファイルに書き、終わった後に入力の順に output に加える。
+// *scanned が FALSE なら、最初のコンパイラを起動した後、その実行中にリンク用のライブラリを探す
+static BOOL compile_objects(const ProgramOptions* opts, wchar_t* const* inputs, int num_inputs, const wchar_t* compiler_path, const wchar_t* extra_flags,
+                            const wchar_t* temp_dir, LinkBuffers* b, wchar_t** objects, ChildProcess* procs, BOOL* scanned, wchar_t** output) {
+    const wchar_t* user_flags = opts->compiler_flags ? opts->compiler_flags : L"";
+    ChildProcess* running[PROCESS_WAIT_MAX];
+    int num_running = 0;
+    int started = 0;
+    BOOL failed = FALSE;
+    int max_parallel = opts->jobs < 1 ? 1 : (opts->jobs > PROCESS_WAIT_MAX ? PROCESS_WAIT_MAX : opts->jobs);
+    while (started < num_inputs || num_running > 0) {
+        // 失敗後は新しいコンパイラを起動せず、実行中のものだけを待つ
+        // ジョブサーバーのトークンが無ければ、実行中のコンパイラの終了を待ってから起動する
+        while (!failed && started < num_inputs && num_running < max_parallel && jobserver_acquire(num_running)) {
+            wchar_t full_path[MAX_PATH], stem[MAX_PATH], object_path[MAX_PATH], log_path[MAX_PATH];
+            if (!GetFullPathNameW(inputs[started], MAX_PATH, full_path, NULL)) {
+                fwprintf_err(L"エラー: ソースファイルのフルパスを取得できませんでした: %s\n", inputs[started]);
+                failed = TRUE;
+                break;
+            }
+            get_stem(full_path, stem, MAX_PATH);
+            swprintf_s(object_path, MAX_PATH, L"%s\\%s_%d.o", temp_dir, stem, started);
+            swprintf_s(log_path, MAX_PATH, L"%s\\%s_%d.log", temp_dir, stem, started);
+            free(objects[started]);
+            objects[started] = _wcsdup(object_path);
+            swprintf_s(b->command, _countof(b->command), L"\"%s\" -c \"%s\" %s %s%s -o \"%s\"",
+                       compiler_path, full_path, b->compile_flags, user_flags, extra_flags, object_path);
+            if (opts->verbose) wprintf(L"Command: %s\n", b->command);
+
+            ProcessSpawnOptions spawn = {};
+            spawn.output = PROCESS_OUTPUT_FILE;
+            spawn.output_file = log_path;
+            spawn.hide_window = TRUE;
+            if (!objects[started] || !process_spawn(b->command, &spawn, &procs[started])) {
+                fwprintf_err(L"エラー: コンパイラを起動できませんでした: %s\n", b->command);
+                failed = TRUE;
+                break;
+            }
+            running[num_running++] = &procs[started++];
+        }
+        if (num_running == 0) break;
+
+        // ツールチェーンへの問い合わせとシステムヘッダーのスキャンは、コンパイラを待つ間に済ませる
+        if (!*scanned) {
+            phase_begin(PHASE_OVERLAP);
+            b->auto_flags[0] = L'\0';
+            b->detected_libs[0] = L'\0';
+            scan_auto_flags(opts, compiler_path, b->auto_flags, _countof(b->auto_flags));
+            split_link_flags(b->auto_flags, b->scanned_flags, _countof(b->scanned_flags), b->detected_libs, _countof(b->detected_libs));
+            phase_end();
+            *scanned = TRUE;
+        }
+
+        int slot = process_wait_any(running, num_running, INFINITE);
+        if (slot < 0) {
+            for (int i = 0; i < num_running; ++i) {
+                process_terminate(running[i]);
+                process_close(running[i]);
+            }
+            failed = TRUE;
+            break;
+        }
+        DWORD exit_code = 1;
+        process_exit_code(running[slot], &exit_code);
+        process_close(running[slot]);
+        if (exit_code != 0) failed = TRUE;
+        running[slot] = running[--num_running];
+        jobserver_sync(num_running);
+    }
+    jobserver_sync(0);
+    for (int i = 0; i < started; ++i) {
+        wchar_t log_path[MAX_PATH];
+        wcscpy_s(log_path, MAX_PATH, objects[i]);
+        wcscpy_s(log_path + wcslen(log_path) - 2, 5, L".log"); // "<stem>_<i>.o" -> "<stem>_<i>.log"
+        append_log(log_path, output);
+    }
+    return !failed;
+}
+
+// 各入力をオブジェクトにコンパイルし、まとめてリンクする。コンパイルはユーザーのヘッダーだけのスキャン
+// (コンパイル用のフラグはここで決まる) の後すぐに始め、ツールチェーンの問い合わせとシステムヘッダーまでの
+// スキャンはコンパイラの実行中に行う。その結果の -l はリンクにだけ使う。
+// --minimal-link では未定義シンボルをシンボル索引で引いて必要なライブラリだけをリンクし、索引が使えないときや
+// 索引に無いシンボルが残るときや最小のリンクが失敗したときは検出した -l もリンクする。
+// output にはコンパイラの出力を入力の順に返す。extra_flags はコンパイル時だけに付けるフラグ (--compile-report など)
+BOOL compile_and_link(const ProgramOptions* opts, wchar_t* const* inputs, int num_inputs, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL quick, const wchar_t* extra_flags, wchar_t** output) {
+    *output = NULL;
+    LinkBuffers* b = (LinkBuffers*)calloc(1, sizeof(LinkBuffers));
+    wchar_t** objects = (wchar_t**)calloc(num_inputs, sizeof(wchar_t*));
+    ChildProcess* procs = (ChildProcess*)calloc(num_inputs, sizeof(ChildProcess));
+    if (!b || !objects || !procs) {
+        free(b);
+        free(objects);
+        free(procs);
+        return FALSE;
+    }
+    const wchar_t* user_flags = opts->compiler_flags ? opts->compiler_flags : L"";
+    const wchar_t* user_libs = opts->user_libraries ? opts->user_libraries : L"";
+    wchar_t temp_dir[MAX_PATH];
+    get_parent_path(executable_path, temp_dir, MAX_PATH);
+
+    build_base_flags(opts, quick, b->auto_flags, _countof(b->auto_flags));
+    scan_auto_flags(opts, NULL, b->auto_flags, _countof(b->auto_flags));
+    split_link_flags(b->auto_flags, b->compile_flags, _countof(b->compile_flags), b->detected_libs, _countof(b->detected_libs));
+    BOOL scanned = FALSE;
+    BOOL failed = !compile_objects(opts, inputs, num_inputs, compiler_path, extra_flags, temp_dir, b, objects, procs, &scanned, output);
+
+    // 全体のスキャンでだけ見つかるコンパイル用のフラグ (-idirafter の先のヘッダーなど) があれば、加えてコンパイルし直す
+    if (scanned && add_missing_flags(b->compile_flags, _countof(b->compile_flags), b->scanned_flags)) {
+        if (opts->verbose) wprintf(L"Pipeline: the full scan found more compile flags; recompiling.\n");
+        free(*output);
+        *output = NULL;
+        failed = !compile_objects(opts, inputs, num_inputs, compiler_path, extra_flags, temp_dir, b, objects, procs, &scanned, output);
+    }
+
+    // --- リンク ---
+    BOOL success = !failed;
+    if (success) {
+        phase_begin(PHASE_LINK);
+        BOOL need_detected = TRUE;
+        SymbolIndex index;
+        if (!opts->minimal_link) {
+            // 検出したライブラリを全てリンクする
+        } else if (symbol_index_open(compiler_path, &index)) {
+            int num_undefined = 0, num_unresolved = 0;
+            if (symbol_index_resolve(&index, objects, num_inputs, b->resolved_libs, _countof(b->resolved_libs), &num_undefined, &num_unresolved)) {
+                need_detected = (num_unresolved > 0); // ユーザー指定のライブラリにあるシンボルなど
+                if (opts->verbose) {
+                    wprintf(L"Minimal link: %d undefined symbols (%d not in index), %lu libraries indexed%s.\n",
+                            num_undefined, num_unresolved, index.num_libs, index.rebuilt ? L" (index rebuilt)" : L"");
+                    wprintf(L"Minimal link: libraries: %s\n", b->resolved_libs[0] ? b->resolved_libs : L"(defaults only)");
+                }
+            } else {
+                b->resolved_libs[0] = L'\0';
+                if (opts->verbose) wprintf(L"Minimal link: could not read the object files; using detected libraries.\n");
+            }
+            symbol_index_close(&index);
+        } else if (opts->verbose) {
+            wprintf(L"Minimal link: symbol index unavailable; using detected libraries.\n");
+        }
+
+        // 選んだライブラリが依存するライブラリ (索引は各ライブラリが定義するシンボルしか持たない) が足りずに
+        // 最小のリンクが失敗したときは、検出した -l を全て加えてリンクし直す
+        wchar_t* link_output = NULL;
+        for (;;) {
+            swprintf_s(b->command, _countof(b->command), L"\"%s\"", compiler_path);
+            for (int i = 0; i < num_inputs; ++i) {
+                wcscat_s(b->command, _countof(b->command), L" \"");
+                wcscat_s(b->command, _countof(b->command), objects[i]);
+                wcscat_s(b->command, _countof(b->command), L"\"");
+            }
+            size_t len = wcslen(b->command);
+            swprintf_s(b->command + len, _countof(b->command) - len, L" %s %s %s %s %s -o \"%s\"",
+                       b->compile_flags, user_flags, b->resolved_libs, need_detected ? b->detected_libs : L"", user_libs, executable_path);
+            if (opts->verbose) wprintf(L"Command: %s\n", b->command);
+
+            success = run_process_and_capture_output(b->command, &link_output);
+            if (success || need_detected || !b->detected_libs[0]) break;
+            need_detected = TRUE;
+            free(link_output);
+            link_output = NULL;
+            if (opts->verbose) wprintf(L"Minimal link: link failed; relinking with the detected libraries.\n");
+        }
+        if (link_output) {
+            size_t old_len = *output ? wcslen(*output) : 0;
+            wchar_t* grown = (wchar_t*)realloc(*output, sizeof(wchar_t) * (old_len + wcslen(link_output) + 1));
+            if (grown) {
+                wcscpy_s(grown + old_len, wcslen(link_output) + 1, link_output);
+                *output = grown;
+            }
+            free(link_output);
+        }
+        phase_end();
+    }
+
+    for (int i = 0; i < num_inputs; ++i) free(objects[i]);
+    free(objects);
+    free(procs);
+    free(b);
+    return success;
+}
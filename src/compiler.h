@@ -3,6 +3,46 @@
 #include "options.h"
 #include <windows.h>
 
+// --- ソース中の #include ディレクティブ ---
+struct IncludeDirective {
+    wchar_t* file;       // インクルード元のフルパス
+    wchar_t* target;     // 書かれたままの名前 (例: windows.h, util/vec.h)
+    wchar_t* resolved;   // 探索パスで見つかった場合のフルパス (見つからなければ NULL)
+    BOOL quoted;         // "..." 形式か (<...> なら FALSE)
+};
+
+struct IncludeList {
+    IncludeDirective* items;
+    int count;
+    int capacity;
+};
+
+// --- インクルードの探索パス ---
+enum IncludeDirKind {
+    INCLUDE_DIR_QUOTE,   // -iquote ("..." 形式だけが探す)
+    INCLUDE_DIR_USER,    // -I
+    INCLUDE_DIR_SYSTEM,  // -isystem・-idirafter・コンパイラの既定のディレクトリ
+};
+
+struct IncludeDir {
+    wchar_t* path;       // 正規化したフルパス (末尾の区切り文字なし)
+    IncludeDirKind kind;
+};
+
+struct IncludeSearchPath {
+    IncludeDir* dirs;    // 探索する順
+    int count;
+    int capacity;
+};
+
 // --- 関数宣言 ---
 BOOL find_compiler(const wchar_t* compiler_name, BOOL has_cpp, wchar_t* compiler_path, size_t path_size);
-BOOL build_compile_command(const ProgramOptions* opts, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL has_cpp, wchar_t* command, size_t command_size);
+void include_search_path_init(IncludeSearchPath* search, const wchar_t* compiler_flags, const wchar_t* compiler_path);
+void include_search_path_free(IncludeSearchPath* search);
+void find_libs_in_sources(wchar_t* const* source_files, int num_source_files, const IncludeSearchPath* search, wchar_t* auto_flags, size_t auto_flags_size, FILETIME* newest_input);
+void find_includes_in_sources(wchar_t* const* source_files, int num_source_files, const IncludeSearchPath* search, IncludeList* includes);
+void free_include_list(IncludeList* includes);
+void split_link_flags(const wchar_t* flags, wchar_t* compile_flags, size_t compile_flags_size, wchar_t* link_flags, size_t link_flags_size);
+BOOL build_compile_command(const ProgramOptions* opts, wchar_t* const* inputs, int num_inputs, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL has_cpp, BOOL quick, wchar_t* command, size_t command_size);
+void build_object_flags(const ProgramOptions* opts, BOOL quick, wchar_t* flags, size_t flags_size);
+BOOL compile_and_link(const ProgramOptions* opts, wchar_t* const* inputs, int num_inputs, const wchar_t* executable_path, const wchar_t* compiler_path, BOOL quick, const wchar_t* extra_flags, wchar_t** output);
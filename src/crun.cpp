@@ -10,6 +10,24 @@
 #include "version.h"
 #include "options.h"
 #include "compiler.h"
+#include "profiler.h"
+#include "project.h"
+#include "process.h"
+#include "unity.h"
+#include "timing.h"
+#include "cache.h"
+#include "compile_report.h"
+#include "compare.h"
+#include "autotune.h"
+#include "alloc_stats.h"
+#include "size_report.h"
+#include "modules.h"
+#include "hot.h"
+#include "jobserver.h"
+#include "sweep.h"
+#include "history.h"
+#include "stats.h"
+#include "allocator.h"
 
 // --- クリーンアップ用のグローバル状態 ---
 wchar_t g_temp_dir_to_clean[MAX_PATH] = {0};
@@ -21,12 +39,401 @@ BOOL WINAPI ConsoleCtrlHandler(DWORD ctrl_type) {
         if (!g_keep_temp && g_temp_dir_to_clean[0] != L'\0') {
             remove_directory_recursively(g_temp_dir_to_clean);
         }
+        jobserver_shutdown(); // 持っているトークンを make に返す
     }
     return FALSE;
 }
 
+// --- プログラムの実行 ---
+// 資源制限を監視しながら終了を待ち、終了理由と実際に適用された CPU・優先度を返す
+static BOOL run_program(wchar_t* command_line, const ProgramOptions* opts, DWORD* p_exit_code, ProcessVerdict* p_verdict, ProcessPlacement* p_placement) {
+    ProcessSpawnOptions spawn = {};
+    spawn.limits = opts->limits;
+    spawn.placement = opts->placement;
+    ChildProcess proc;
+    if (!process_spawn(command_line, &spawn, &proc)) return FALSE;
+    process_wait(&proc, INFINITE, p_exit_code);
+    *p_verdict = proc.verdict;
+    *p_placement = proc.placement;
+    process_close(&proc);
+    return TRUE;
+}
+
+// --time --repeat: 通常の実行の後に、出力を捨てて繰り返し計測する (通常の実行は試走として数えない)。
+// crun の標準入力がファイルにリダイレクトされていれば、毎回そのファイルを読ませる
+static int run_timed_repeats(wchar_t* command_line, const ProgramOptions* opts, double* samples) {
+    wchar_t stdin_path[MAX_PATH] = {0};
+    HANDLE h_stdin = GetStdHandle(STD_INPUT_HANDLE);
+    if (h_stdin && h_stdin != INVALID_HANDLE_VALUE && GetFileType(h_stdin) == FILE_TYPE_DISK) {
+        DWORD length = GetFinalPathNameByHandleW(h_stdin, stdin_path, MAX_PATH, FILE_NAME_NORMALIZED);
+        if (length == 0 || length >= MAX_PATH) stdin_path[0] = L'\0';
+    }
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    int count = 0;
+    for (int i = 0; i < opts->time_repeat; ++i) {
+        ProcessSpawnOptions spawn = {};
+        spawn.output = PROCESS_OUTPUT_NULL;
+        spawn.null_stdin = TRUE;
+        spawn.input_file = stdin_path[0] ? stdin_path : NULL;
+        spawn.limits = opts->limits;
+        spawn.placement = opts->placement;
+        ChildProcess proc;
+        QueryPerformanceCounter(&start);
+        if (!process_spawn(command_line, &spawn, &proc)) break;
+        DWORD exit_code = 1;
+        process_wait(&proc, INFINITE, &exit_code);
+        QueryPerformanceCounter(&end);
+        ProcessVerdict verdict = proc.verdict;
+        process_close(&proc);
+        if (verdict != PROCESS_VERDICT_EXITED || exit_code != 0) {
+            fwprintf_err(L"Warning: Repeated run %d failed (%s, exit code %lu); timing stopped.\n", i + 1, process_verdict_name(verdict), exit_code);
+            break;
+        }
+        samples[count++] = (double)(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+    }
+    return count;
+}
+
+// --- 計測用の CPU (--cpu, --quiet-system) ---
+// プログラムを固定する CPU を決め、crun 自身 (と以後に起動するコンパイラ) はそれ以外の CPU に移す。
+// --quiet-system ではコアの SMT の兄弟も空け、優先度を上げて省電力による減速を抑える
+static void prepare_placement(ProgramOptions* opts, ULONGLONG* self_mask) {
+    *self_mask = 0;
+    ULONGLONG reserved = opts->placement.cpu_mask;
+    if (opts->quiet_system) {
+        ULONGLONG cpu = 0, core = 0;
+        if (!opts->placement.cpu_mask) { // --cpu の指定があればそれを優先する
+            if (process_quiet_cpus(&cpu, &core)) {
+                opts->placement.cpu_mask = cpu;
+                reserved = core;
+            } else {
+                fwprintf_err(L"Warning: --quiet-system found no spare physical core; the program is not pinned.\n");
+            }
+        }
+        if (opts->placement.priority == PROCESS_PRIORITY_NORMAL) opts->placement.priority = PROCESS_PRIORITY_HIGH;
+        opts->placement.no_throttling = TRUE;
+    }
+    if (reserved && !process_pin_self(reserved, self_mask) && opts->verbose) {
+        wprintf(L"Placement: crun could not move itself off the measured CPUs.\n");
+    }
+}
+
+// 制限による強制終了やクラッシュを通常の終了と区別して報告し、crun の終了コードを決める
+static DWORD report_verdict(ProcessVerdict verdict, const ProcessLimits* limits, DWORD exit_code) {
+    switch (verdict) {
+        case PROCESS_VERDICT_TIMEOUT:
+            fwprintf_err(L"\nError: Program killed (%s): exceeded %.3f s wall time.\n", process_verdict_name(verdict), limits->timeout_ms / 1000.0);
+            return 124; // timeout(1) と同じ
+        case PROCESS_VERDICT_CPU_LIMIT:
+            fwprintf_err(L"\nError: Program killed (%s): exceeded %.3f s of CPU time.\n", process_verdict_name(verdict), limits->cpu_limit_ms / 1000.0);
+            return 124;
+        case PROCESS_VERDICT_MEMORY_LIMIT:
+            fwprintf_err(L"\nError: Program killed (%s): exceeded %llu MB.\n", process_verdict_name(verdict), limits->memory_limit / (1024 * 1024));
+            return 137; // OOM killer による終了と同じ
+        case PROCESS_VERDICT_CRASHED:
+            fwprintf_err(L"\nError: Program terminated abnormally (%s, exit code 0x%08lX).\n", process_verdict_name(verdict), exit_code);
+            return exit_code;
+        default:
+            return exit_code;
+    }
+}
+
+// --- 段階的コンパイル (--tiered) ---
+// 最適化版 (-O2 など通常のビルド) の実行ファイルをキャッシュから探す。無ければバックグラウンドで
+// 最適化版のビルドを始め、終わり次第キャッシュに置かせる (crun の終了後も続く)。
+// キーはコンパイルコマンドとソースの内容のハッシュで、ヘッダーの変更は更新日時で判定する
+static BOOL find_or_start_optimized_tier(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL has_cpp, wchar_t* cached_path, size_t cached_path_size) {
+    wchar_t* command = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    wchar_t* scanned = (wchar_t*)calloc(32767, sizeof(wchar_t));
+    wchar_t* background = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    BOOL found = FALSE;
+    if (!command || !scanned || !background) goto done;
+
+    {
+        // 出力先を空にしたコマンドでキーを決める (コマンドは -o "<出力先>" で終わる)
+        if (!build_compile_command(opts, opts->source_files, opts->num_source_files, L"", compiler_path, has_cpp, FALSE, command, 32767)) goto done;
+        ULONGLONG key = hash_bytes(command, wcslen(command) * sizeof(wchar_t), 0);
+        for (int i = 0; i < opts->num_source_files; ++i) {
+            wchar_t full_path[MAX_PATH];
+            if (GetFullPathNameW(opts->source_files[i], MAX_PATH, full_path, NULL)) key = cache_hash_file(full_path, key);
+        }
+
+        FILETIME newest_input;
+        IncludeSearchPath search;
+        include_search_path_init(&search, opts->compiler_flags, compiler_path);
+        find_libs_in_sources(opts->source_files, opts->num_source_files, &search, scanned, 32767, &newest_input);
+        include_search_path_free(&search);
+        if (cache_lookup(key, L".exe", &newest_input, cached_path, cached_path_size)) {
+            found = TRUE;
+            goto done;
+        }
+        // crun の終了後も続くビルドはジョブサーバーのトークンを持てず、make の並列数を超えてしまう
+        JobserverMode jobserver = jobserver_mode();
+        if (jobserver == JOBSERVER_CLIENT || jobserver == JOBSERVER_SERVER) {
+            if (opts->verbose) wprintf(L"Tier: the optimized build is not started in the background under a jobserver.\n");
+            goto done;
+        }
+
+        wchar_t temp_path[MAX_PATH], final_path[MAX_PATH];
+        if (!cache_temp_path(key, L".exe", temp_path, MAX_PATH) || !cache_entry_path(key, L".exe", final_path, MAX_PATH)) {
+            if (opts->verbose) wprintf(L"Tier: cache directory is not available; the optimized build is skipped.\n");
+            goto done;
+        }
+        size_t prefix_length = wcslen(command) - 1; // 閉じ引用符の前に出力先を差し込む
+        swprintf_s(command + prefix_length, 32767 - prefix_length, L"%s\"", temp_path);
+
+        // 書き終えてから置き換え、失敗したら一時ファイルを消す。cmd.exe のコマンドラインは 8191 文字まで
+        int length = swprintf_s(background, 32767, L"cmd.exe /d /s /c \"%s >nul 2>&1 && move /y \"%s\" \"%s\" >nul 2>&1 || del \"%s\" 2>nul\"",
+                                command, temp_path, final_path, temp_path);
+        if (length <= 0 || length > 8191) {
+            if (opts->verbose) wprintf(L"Tier: compile command is too long for a background build; the optimized build is skipped.\n");
+            goto done;
+        }
+        ProcessSpawnOptions spawn = {};
+        spawn.output = PROCESS_OUTPUT_NULL;
+        spawn.null_stdin = TRUE;
+        spawn.hide_window = TRUE;
+        spawn.background = TRUE;
+        ChildProcess proc;
+        if (process_spawn(background, &spawn, &proc)) {
+            process_close(&proc); // 待たずに切り離す
+            if (opts->verbose) wprintf(L"Tier: optimized build started in the background -> %s\n", final_path);
+        } else if (opts->verbose) {
+            wprintf(L"Tier: failed to start the optimized build in the background.\n");
+        }
+    }
+
+done:
+    free(command);
+    free(scanned);
+    free(background);
+    return found;
+}
+
+// --- 単一プログラムのビルド ---
+// メインソースと同じディレクトリに一時ディレクトリ (crun_tmp_*) を作り、Ctrl+C 時の後片付けの対象にする
+static BOOL create_temp_dir(const ProgramOptions* opts, const wchar_t* main_source_full_path, wchar_t* temp_dir) {
+    wchar_t source_dir[MAX_PATH];
+    get_parent_path(main_source_full_path, source_dir, MAX_PATH);
+    swprintf_s(temp_dir, MAX_PATH, L"%s\\crun_tmp_%lu_%lu", source_dir, GetTickCount(), GetCurrentProcessId());
+    if (!CreateDirectoryW(temp_dir, NULL)) {
+        fwprintf_err(L"Error: Failed to create temporary directory.\n");
+        temp_dir[0] = L'\0';
+        return FALSE;
+    }
+
+    wcsncpy_s(g_temp_dir_to_clean, MAX_PATH, temp_dir, _TRUNCATE);
+    g_keep_temp = opts->keep_temp;
+    return TRUE;
+}
+
+// 一時ディレクトリを作成し、コマンドラインで指定されたソースをコンパイルする
+static BOOL compile_sources(const ProgramOptions* opts, wchar_t* temp_dir, wchar_t* executable_path) {
+    wchar_t main_source_full_path[MAX_PATH];
+    if (!GetFullPathNameW(opts->source_files[0], MAX_PATH, main_source_full_path, NULL)) {
+        fwprintf_err(L"Error: Could not get full path for source file: %s\n", opts->source_files[0]);
+        return FALSE;
+    }
+
+    BOOL has_cpp = FALSE;
+    for (int i = 0; i < opts->num_source_files; ++i) {
+        const wchar_t* ext = get_extension(opts->source_files[i]);
+        if (ext && wcscmp(ext, L".cpp") == 0) {
+            has_cpp = TRUE;
+            break;
+        }
+    }
+
+    if (!create_temp_dir(opts, main_source_full_path, temp_dir)) return FALSE;
+
+    wchar_t source_stem[MAX_PATH];
+    get_stem(main_source_full_path, source_stem, MAX_PATH);
+    swprintf_s(executable_path, MAX_PATH, L"%s\\%s.%s", temp_dir, source_stem, opts->hot ? L"dll" : L"exe");
+
+    wchar_t compiler_path[MAX_PATH];
+    if (!find_compiler(opts->compiler_name, has_cpp, compiler_path, MAX_PATH)) {
+        if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+        return FALSE;
+    }
+
+    // 段階的コンパイル: キャッシュに最適化版があればコンパイルせずにそれを実行する
+    BOOL quick = FALSE;
+    if (opts->tiered && !opts->debug_build && !opts->profile && !opts->compile_report && !opts->alloc_stats && !opts->malloc_name && !opts->size_report && !opts->modules && !opts->hot) {
+        phase_begin(PHASE_COMMAND);
+        wchar_t cached_path[MAX_PATH];
+        BOOL cached = find_or_start_optimized_tier(opts, compiler_path, has_cpp, cached_path, MAX_PATH);
+        phase_end();
+        if (cached) {
+            if (opts->verbose) wprintf(L"Tier: optimized (cached %s)\n", cached_path);
+            wcscpy_s(executable_path, MAX_PATH, cached_path);
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            temp_dir[0] = L'\0';
+            g_temp_dir_to_clean[0] = L'\0';
+            return TRUE;
+        }
+        quick = TRUE;
+        if (opts->verbose) wprintf(L"Tier: quick (-O0) build for this run.\n");
+    } else if (opts->tiered && opts->verbose) {
+        wprintf(L"Tier: --tiered is ignored with --debug, --profile, --compile-report, --alloc-stats, --malloc, --size-report, --modules and --hot.\n");
+    }
+
+    // ユニティビルドでは生成したユニティファイル (と対象外のソース) をコンパイラに渡す
+    phase_begin(PHASE_COMMAND);
+    UnitySources unity = {0};
+    if (opts->unity && opts->num_source_files > 1) {
+        if (!write_unity_sources(opts, temp_dir, &unity)) {
+            phase_end();
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            return FALSE;
+        }
+        if (opts->verbose) {
+            wprintf(L"Unity build: %d sources merged into %d unity files, %d compiled separately.\n",
+                    unity.num_merged, unity.num_unity_files, unity.num_files - unity.num_unity_files);
+        }
+    }
+    wchar_t* const* inputs = unity.files ? unity.files : opts->source_files;
+    int num_inputs = unity.files ? unity.num_files : opts->num_source_files;
+
+    // --alloc-stats: 計測用のシムを入力に加え、malloc などを --wrap でシムに差し替えてリンクする
+    const ProgramOptions* build_opts = opts;
+    AllocStatsBuild alloc_build = {0};
+    if (opts->alloc_stats) {
+        if (!alloc_stats_prepare(opts, has_cpp, temp_dir, inputs, num_inputs, &alloc_build)) {
+            phase_end();
+            free_unity_sources(&unity);
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            return FALSE;
+        }
+        build_opts = &alloc_build.opts;
+        inputs = alloc_build.inputs;
+        num_inputs = alloc_build.num_inputs;
+    }
+
+    // --malloc: 選んだアロケータのライブラリ (と --wrap 用のアダプタ) を加えてリンクする
+    AllocatorBuild allocator_build = {0};
+    if (opts->malloc_name) {
+        if (!allocator_prepare(opts, compiler_path, has_cpp, temp_dir, inputs, num_inputs, &allocator_build)) {
+            phase_end();
+            free_unity_sources(&unity);
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            return FALSE;
+        }
+        build_opts = &allocator_build.opts;
+        inputs = allocator_build.inputs;
+        num_inputs = allocator_build.num_inputs;
+    }
+    if (opts->verbose) wprintf(L"Allocator: %s\n", opts->malloc_name ? allocator_build.description : L"system (CRT malloc)");
+
+    // --hot: main を呼ぶアダプタを加え、常駐ホストが読み込む DLL としてリンクする
+    HotBuild hot_build = {0};
+    if (opts->hot) {
+        if (!hot_prepare(build_opts, has_cpp, temp_dir, inputs, num_inputs, &hot_build)) {
+            phase_end();
+            allocator_free_build(&allocator_build);
+            alloc_stats_free_build(&alloc_build);
+            free_unity_sources(&unity);
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            return FALSE;
+        }
+        build_opts = &hot_build.opts;
+        inputs = hot_build.inputs;
+        num_inputs = hot_build.num_inputs;
+    }
+
+    // --size-report: リンカにマップファイルを書かせ、ライブラリごとの寄与を集計する
+    wchar_t map_path[MAX_PATH];
+    swprintf_s(map_path, MAX_PATH, L"%s\\%s.map", temp_dir, source_stem);
+    SizeReportBuild size_build = {0};
+    if (opts->size_report && size_report_prepare(build_opts, map_path, &size_build)) build_opts = &size_build.opts;
+
+    BOOL is_clang = wcscmp(opts->compiler_name, L"clang") == 0;
+    phase_end();
+
+    // --modules: 標準ヘッダーのヘッダーユニットと std モジュールを (キャッシュに無ければ) ビルドし、コンパイルで読み込む
+    const wchar_t* extra_flags = opts->compile_report ? compile_report_flags(is_clang) : L"";
+    wchar_t* combined_flags = NULL;
+    ModulesBuild modules_build = {0};
+    if (opts->modules) {
+        phase_begin(PHASE_COMPILE);
+        BOOL prepared = modules_prepare(build_opts, compiler_path, quick, &modules_build);
+        phase_end();
+        size_t size = prepared ? wcslen(extra_flags) + wcslen(modules_build.compile_flags) + 1 : 0;
+        combined_flags = prepared ? (wchar_t*)malloc(sizeof(wchar_t) * size) : NULL;
+        if (!combined_flags) {
+            modules_free_build(&modules_build);
+            hot_free_build(&hot_build);
+            alloc_stats_free_build(&alloc_build);
+            allocator_free_build(&allocator_build);
+            size_report_free_build(&size_build);
+            free_unity_sources(&unity);
+            if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+            return FALSE;
+        }
+        swprintf_s(combined_flags, size, L"%s%s", extra_flags, modules_build.compile_flags);
+        extra_flags = combined_flags;
+        build_opts = &modules_build.opts;
+    }
+
+    // オブジェクトにコンパイルしてからリンクする。ライブラリのスキャンはコンパイラの実行中に行う
+    if (opts->verbose) wprintf(L"--- Compiling%s ---\n", opts->minimal_link ? L" (minimal link)" : L"");
+    wchar_t* compile_output = NULL;
+    LARGE_INTEGER frequency, compile_start, compile_end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&compile_start);
+    phase_begin(PHASE_COMPILE);
+    BOOL compile_success = compile_and_link(build_opts, inputs, num_inputs, executable_path, compiler_path, quick, extra_flags, &compile_output);
+    phase_end();
+    QueryPerformanceCounter(&compile_end);
+    double compile_ms = (double)(compile_end.QuadPart - compile_start.QuadPart) * 1000.0 / frequency.QuadPart;
+    free(combined_flags);
+    if (opts->verbose) {
+        wprintf(L"Pipeline: %.1f ms of scanning overlapped with compilation, link %.1f ms.\n",
+                phase_elapsed_ms(PHASE_OVERLAP), phase_elapsed_ms(PHASE_LINK));
+    }
+
+    // --compile-report: gcc の -H / -ftime-report の出力は集計して取り除き、診断メッセージだけを表示する
+    CompileReport report;
+    if (opts->compile_report) compile_report_collect(&report, is_clang, inputs, num_inputs, temp_dir, compile_output);
+    alloc_stats_free_build(&alloc_build);
+    allocator_free_build(&allocator_build);
+    hot_free_build(&hot_build);
+    size_report_free_build(&size_build);
+    free_unity_sources(&unity);
+
+    if (compile_output) {
+        wprintf(L"%s", compile_output); // コンパイラの出力を表示
+        free(compile_output);
+    }
+    if (opts->compile_report) {
+        IncludeList includes;
+        IncludeSearchPath search;
+        include_search_path_init(&search, opts->compiler_flags, compiler_path);
+        find_includes_in_sources(opts->source_files, opts->num_source_files, &search, &includes);
+        include_search_path_free(&search);
+        compile_report_print(&report, &includes);
+        free_include_list(&includes);
+        compile_report_free(&report);
+        fflush(stdout);
+    }
+
+    if (!compile_success) {
+        fwprintf_err(L"Compilation failed.\n");
+        modules_free_build(&modules_build);
+        if (!opts->keep_temp) remove_directory_recursively(temp_dir);
+        return FALSE;
+    }
+    if (opts->verbose) wprintf(L"Compilation successful.\n");
+    // --modules の前後のコンパイル時間を比べられるよう、--modules なしの時間も記録する
+    if (has_cpp) modules_record_compile_time(opts, compiler_path, main_source_full_path, opts->modules ? &modules_build : NULL, compile_ms);
+    modules_free_build(&modules_build);
+    if (opts->size_report) size_report_print(opts, compiler_path, main_source_full_path, executable_path, map_path);
+    return TRUE;
+}
+
 // --- メインエントリーポイント ---
 int main() {
+    phase_start_clock();
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
 
     int argc;
@@ -62,82 +469,78 @@ int main() {
     }
 
     ProgramOptions opts;
-    if (!parse_arguments(argc, argv, &opts)) {
+    phase_begin(PHASE_PARSE);
+    BOOL parsed = parse_arguments(argc, argv, &opts);
+    phase_end();
+    if (!parsed) {
         free_options(&opts);
         LocalFree(argv);
         return 1;
     }
 
-    wchar_t main_source_full_path[MAX_PATH];
-    if (!GetFullPathNameW(opts.source_files[0], MAX_PATH, main_source_full_path, NULL)) {
-        fwprintf_err(L"Error: Could not get full path for source file: %s\n", opts.source_files[0]);
+    // crun --history <file>: 記録済みの計測を表示して終了する
+    if (opts.history_source) {
+        DWORD history_exit_code = history_show(opts.history_source);
         free_options(&opts);
         LocalFree(argv);
-        return 1;
+        return history_exit_code;
     }
 
-    BOOL has_cpp = FALSE;
-    for (int i = 0; i < opts.num_source_files; ++i) {
-        const wchar_t* ext = get_extension(opts.source_files[i]);
-        if (ext && wcscmp(ext, L".cpp") == 0) {
-            has_cpp = TRUE;
-            break;
-        }
+    // make -j の下ではそのジョブサーバーから、-j を指定したときは crun が作ったものから、
+    // 2つ目以降に同時に起動するコンパイラごとにトークンを取る
+    JobserverMode jobserver = jobserver_setup(opts.jobs, opts.jobserver);
+    if (opts.verbose) {
+        if (jobserver == JOBSERVER_CLIENT) wprintf(L"Jobserver: using make's jobserver (%hs).\n", jobserver_name());
+        else if (jobserver == JOBSERVER_SERVER) wprintf(L"Jobserver: serving %d jobs to child processes (%hs).\n", opts.jobs, jobserver_name());
+        else if (jobserver == JOBSERVER_UNAVAILABLE) wprintf(L"Jobserver: not available; only --jobs limits parallel compilers.\n");
     }
 
-    wchar_t source_dir[MAX_PATH];
-    get_parent_path(main_source_full_path, source_dir, MAX_PATH);
-    wchar_t temp_dir[MAX_PATH];
-    swprintf_s(temp_dir, MAX_PATH, L"%s\\crun_tmp_%lu_%lu", source_dir, GetTickCount(), GetCurrentProcessId());
-    if (!CreateDirectoryW(temp_dir, NULL)) {
-        fwprintf_err(L"Error: Failed to create temporary directory.\n");
-        free_options(&opts);
-        LocalFree(argv);
-        return 1;
-    }
-
-    wcsncpy_s(g_temp_dir_to_clean, MAX_PATH, temp_dir, _TRUNCATE);
-    g_keep_temp = opts.keep_temp;
-
-    wchar_t source_stem[MAX_PATH];
-    get_stem(main_source_full_path, source_stem, MAX_PATH);
-    wchar_t executable_path[MAX_PATH];
-    swprintf_s(executable_path, MAX_PATH, L"%s\\%s.exe", temp_dir, source_stem);
+    wchar_t temp_dir[MAX_PATH] = {0};
+    wchar_t executable_path[MAX_PATH] = {0};
+    ULONGLONG self_cpu_mask = 0;
+    prepare_placement(&opts, &self_cpu_mask);
 
-    wchar_t compiler_path[MAX_PATH];
-    if (!find_compiler(opts.compiler_name, has_cpp, compiler_path, MAX_PATH)) {
-        if (!opts.keep_temp) remove_directory_recursively(temp_dir);
+    // --compare / --autotune / --sweep: 候補ごとにビルドして交互に計測し、表を表示して終了する
+    if (opts.compare_spec || opts.autotune || opts.sweep_spec) {
+        const wchar_t* bench_option = opts.compare_spec ? L"--compare" : opts.autotune ? L"--autotune" : L"--sweep";
+        wchar_t main_source_full_path[MAX_PATH];
+        DWORD bench_exit_code = 1;
+        if (opts.project_file) {
+            fwprintf_err(L"Error: %s cannot be used with a project manifest.\n", bench_option);
+        } else if (GetFullPathNameW(opts.source_files[0], MAX_PATH, main_source_full_path, NULL) &&
+            create_temp_dir(&opts, main_source_full_path, temp_dir)) {
+            if (opts.compare_spec) bench_exit_code = run_compare(&opts, temp_dir);
+            else if (opts.autotune) bench_exit_code = run_autotune(&opts, temp_dir);
+            else bench_exit_code = run_sweep(&opts, temp_dir);
+            if (!opts.keep_temp) remove_directory_recursively(temp_dir);
+        }
         free_options(&opts);
         LocalFree(argv);
-        return 1;
+        return bench_exit_code;
     }
 
-    wchar_t compile_command[32767];
-    if (!build_compile_command(&opts, executable_path, compiler_path, has_cpp, compile_command, 32767)) {
-        if (!opts.keep_temp) remove_directory_recursively(temp_dir);
+    // 以前の --autotune の結果があれば、最適化ビルドに使う
+    wchar_t tuned_flags[1024];
+    if (!opts.project_file && !opts.debug_build && !opts.profile) {
+        phase_begin(PHASE_COMMAND);
+        if (autotune_load_saved(&opts, tuned_flags, _countof(tuned_flags))) {
+            opts.tuned_flags = tuned_flags;
+            if (opts.verbose) wprintf(L"Autotune: using saved flags \"%s\".\n", tuned_flags);
+        }
+        phase_end();
+    }
+    BOOL built = opts.project_file ? build_project(&opts, executable_path, MAX_PATH)
+                                   : compile_sources(&opts, temp_dir, executable_path);
+    if (!built) {
         free_options(&opts);
         LocalFree(argv);
         return 1;
     }
-
-    if (opts.verbose) wprintf(L"--- Compiling ---\nCommand: %s\n", compile_command);
-    
-    wchar_t* compile_output = NULL;
-    BOOL compile_success = run_process_and_capture_output(compile_command, &compile_output);
-
-    if (compile_output) {
-        wprintf(L"%s", compile_output); // コンパイラの出力を表示
-        free(compile_output);
-    }
-
-    if (!compile_success) {
-        fwprintf_err(L"Compilation failed.\n");
-        if (!opts.keep_temp) remove_directory_recursively(temp_dir);
+    if (executable_path[0] == L'\0') { // ライブラリのみのターゲット、または --build
         free_options(&opts);
         LocalFree(argv);
-        return 1;
+        return 0;
     }
-    if (opts.verbose) wprintf(L"Compilation successful.\n");
 
     wchar_t run_command[32767];
     swprintf_s(run_command, 32767, L"\"%s\"", executable_path);
@@ -149,20 +552,78 @@ int main() {
 
     if (opts.verbose) { wprintf(L"--- Running ---\n"); fflush(stdout); }
 
+    BOOL has_placement = opts.placement.cpu_mask || opts.placement.priority != PROCESS_PRIORITY_NORMAL || opts.placement.no_throttling;
+
+    // シムは終了時に統計をこのファイルへ書き出す
+    wchar_t alloc_stats_path[MAX_PATH] = {0};
+    if (opts.alloc_stats && temp_dir[0] != L'\0') {
+        swprintf_s(alloc_stats_path, MAX_PATH, L"%s\\alloc_stats.txt", temp_dir);
+        SetEnvironmentVariableW(ALLOC_STATS_ENV, alloc_stats_path);
+    }
+
     LARGE_INTEGER start_time, end_time, frequency;
     if (opts.measure_time) { QueryPerformanceFrequency(&frequency); QueryPerformanceCounter(&start_time); }
 
     DWORD exit_code = 0;
-    run_program_and_get_exit_code(run_command, &exit_code);
+    ProcessVerdict verdict = PROCESS_VERDICT_EXITED;
+    ProcessPlacement placement = opts.placement; // プロファイラ経由では指定した値を表示する
+    phase_begin(PHASE_RUN);
+    BOOL started = opts.profile ? run_program_with_profiler(run_command, executable_path, &opts, &exit_code, &verdict)
+                 : opts.hot ? hot_run(&opts, executable_path, &exit_code, &verdict)
+                            : run_program(run_command, &opts, &exit_code, &verdict, &placement);
+    phase_end();
+    if (!started) {
+        fwprintf_err(L"Error: Failed to start %s\n", executable_path);
+        exit_code = 1;
+    }
 
+    BOOL regression = FALSE;
     if (opts.measure_time) {
         QueryPerformanceCounter(&end_time);
         double elapsed_ms = (double)(end_time.QuadPart - start_time.QuadPart) * 1000.0 / frequency.QuadPart;
         wprintf(L"\nExecution time: %.3f ms\n", elapsed_ms);
+
+        // 正常に終了した計測だけを履歴に残し、前の版と比べる (プロジェクトのターゲットは対象外)
+        double* samples = (double*)malloc(sizeof(double) * opts.time_repeat);
+        int num_samples = 0;
+        if (samples && started && verdict == PROCESS_VERDICT_EXITED && exit_code == 0) {
+            if (opts.time_repeat > 1) {
+                fflush(stdout);
+                num_samples = run_timed_repeats(run_command, &opts, samples);
+                if (num_samples > 0) {
+                    SampleStats stats;
+                    stats_compute(samples, num_samples, &stats);
+                    wprintf(L"Repeated: median %.3f ms, 95%% CI [%.3f, %.3f] over %d runs (output discarded)\n",
+                            stats.median, stats.ci_low, stats.ci_high, num_samples);
+                }
+            } else {
+                samples[num_samples++] = elapsed_ms;
+            }
+            wchar_t main_source_full_path[MAX_PATH];
+            if (num_samples > 0 && !opts.project_file && GetFullPathNameW(opts.source_files[0], MAX_PATH, main_source_full_path, NULL)) {
+                regression = history_record_run(&opts, main_source_full_path, samples, num_samples);
+            }
+        }
+        free(samples);
+    }
+    if (has_placement && started) {
+        wchar_t program_cpus[256], crun_cpus[256];
+        process_format_cpu_list(placement.cpu_mask, program_cpus, _countof(program_cpus));
+        process_format_cpu_list(self_cpu_mask, crun_cpus, _countof(crun_cpus));
+        wprintf(L"CPU set: %s (crun: %s), priority: %s\n", program_cpus[0] ? program_cpus : L"all",
+                crun_cpus[0] ? crun_cpus : L"all", process_priority_name(placement.priority));
     }
     if (opts.verbose) wprintf(L"\n--- Finished ---\nProgram exited with code %lu.\n", exit_code);
+    exit_code = report_verdict(verdict, &opts.limits, exit_code);
+    if (regression && exit_code == 0) exit_code = HISTORY_REGRESSION_EXIT_CODE;
+    if (alloc_stats_path[0] != L'\0' && started) alloc_stats_print(alloc_stats_path, executable_path);
 
-    if (!opts.keep_temp) remove_directory_recursively(temp_dir);
+    phase_begin(PHASE_CLEANUP);
+    if (!opts.keep_temp && temp_dir[0] != L'\0') remove_directory_recursively(temp_dir);
+    phase_end();
+    if (opts.phase_times_file && !phase_write_report(opts.phase_times_file)) {
+        fwprintf_err(L"Warning: Could not write phase times to %s\n", opts.phase_times_file);
+    }
     free_options(&opts);
     LocalFree(argv);
     return exit_code;
@@ -0,0 +1,364 @@
+#include "history.h"
+#include "stats.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+// --- 履歴ファイルの形式 ---
+// UTF-8 の TSV で、1 行が 1 回の --time の実行 (# で始まる行は見出し)。
+// 時刻, 状態 (ok / slow / accepted), ソースのフルパス, 内容のハッシュ, コンパイラ, フラグ, 引数, 計測値 (ms, カンマ区切り)
+// slow は退行と判定されて採用しなかった実行、accepted は退行でも --accept-baseline で採用した実行
+enum HistoryField {
+    FIELD_TIME,
+    FIELD_STATUS,
+    FIELD_SOURCE,
+    FIELD_HASH,
+    FIELD_COMPILER,
+    FIELD_FLAGS,
+    FIELD_ARGS,
+    FIELD_SAMPLES,
+    HISTORY_NUM_FIELDS
+};
+
+#define HISTORY_HEADER "#time\tstatus\tsource\thash\tcompiler\tflags\targs\tsamples_ms\n"
+
+struct HistoryRecord {
+    char* fields[HISTORY_NUM_FIELDS]; // 読み込んだファイルの内容 (UTF-8) を指す
+    double* samples;
+    int num_samples;
+};
+
+struct HistoryFile {
+    char* data;
+    HistoryRecord* records;
+    int count;
+};
+
+// 同じ系列 (ソース・コンパイラ・フラグ・引数が同じ実行) を識別する値。文字列は履歴ファイルと同じ UTF-8
+struct HistoryKey {
+    char source[MAX_PATH * 3];
+    char hash[17];
+    char compiler[256];
+    char flags[8192];
+    char args[8192];
+};
+
+// --- 履歴ファイルの読み書き ---
+static BOOL history_path(wchar_t* path, size_t path_size) {
+    DWORD length = GetEnvironmentVariableW(HISTORY_ENV, path, (DWORD)path_size);
+    if (length > 0 && length < path_size) return TRUE;
+
+    wchar_t base[MAX_PATH];
+    length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return FALSE;
+    swprintf_s(path, path_size, L"%s\\crun", base);
+    if (!CreateDirectoryW(path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return FALSE;
+    wcscat_s(path, path_size, L"\\history.tsv");
+    return TRUE;
+}
+
+// 履歴の 1 行を壊さないように、タブと改行を空白に置き換えて UTF-8 にする
+static void to_field(const wchar_t* text, char* field, size_t field_size) {
+    if (!WideCharToMultiByte(CP_UTF8, 0, text ? text : L"", -1, field, (int)field_size, NULL, NULL)) field[0] = '\0';
+    for (char* p = field; *p; ++p) {
+        if (*p == '\t' || *p == '\r' || *p == '\n') *p = ' ';
+    }
+}
+
+static void from_field(const char* field, wchar_t* text, size_t text_size) {
+    if (!MultiByteToWideChar(CP_UTF8, 0, field, -1, text, (int)text_size)) text[0] = L'\0';
+}
+
+static BOOL parse_record(char* line, HistoryRecord* record) {
+    memset(record, 0, sizeof(HistoryRecord));
+    char* p = line;
+    for (int i = 0; i < HISTORY_NUM_FIELDS; ++i) {
+        record->fields[i] = p;
+        char* tab = strchr(p, '\t');
+        if (i + 1 < HISTORY_NUM_FIELDS) {
+            if (!tab) return FALSE;
+            *tab = '\0';
+            p = tab + 1;
+        }
+    }
+    int capacity = 1;
+    for (const char* c = record->fields[FIELD_SAMPLES]; *c; ++c) {
+        if (*c == ',') capacity++;
+    }
+    record->samples = (double*)malloc(sizeof(double) * capacity);
+    if (!record->samples) return FALSE;
+    for (p = record->fields[FIELD_SAMPLES]; *p; ) {
+        char* end = NULL;
+        double ms = strtod(p, &end);
+        if (end == p) break;
+        if (ms >= 0 && record->num_samples < capacity) record->samples[record->num_samples++] = ms;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    if (record->num_samples == 0) {
+        free(record->samples);
+        record->samples = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// 壊れた行は読み飛ばす (書き込み途中で止まった実行など)
+static void load_history(const wchar_t* path, HistoryFile* file) {
+    memset(file, 0, sizeof(HistoryFile));
+    size_t size = 0;
+    if (!read_file_bytes(path, (unsigned char**)&file->data, &size)) return;
+    int capacity = 1;
+    for (size_t i = 0; i < size; ++i) {
+        if (file->data[i] == '\n') capacity++;
+    }
+    file->records = (HistoryRecord*)malloc(sizeof(HistoryRecord) * capacity);
+    if (!file->records) return;
+
+    char* line = file->data;
+    while (line && *line) {
+        char* newline = strchr(line, '\n');
+        if (newline) *newline = '\0';
+        size_t length = strlen(line);
+        if (length > 0 && line[length - 1] == '\r') line[length - 1] = '\0';
+        if (line[0] != '#' && line[0] != '\0' && parse_record(line, &file->records[file->count])) file->count++;
+        line = newline ? newline + 1 : NULL;
+    }
+}
+
+static void free_history(HistoryFile* file) {
+    for (int i = 0; i < file->count; ++i) free(file->records[i].samples);
+    free(file->records);
+    free(file->data);
+    memset(file, 0, sizeof(HistoryFile));
+}
+
+// 複数の crun が同時に書いても行が混ざらないよう、1 行を 1 回の WriteFile で追記する
+static BOOL append_line(const wchar_t* path, const char* line, size_t length) {
+    HANDLE h_file = CreateFileW(path, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h_file == INVALID_HANDLE_VALUE) return FALSE;
+    DWORD bytes_written;
+    LARGE_INTEGER file_size;
+    BOOL ok = TRUE;
+    if (GetFileSizeEx(h_file, &file_size) && file_size.QuadPart == 0) {
+        ok = WriteFile(h_file, HISTORY_HEADER, (DWORD)strlen(HISTORY_HEADER), &bytes_written, NULL);
+    }
+    ok = ok && WriteFile(h_file, line, (DWORD)length, &bytes_written, NULL) && bytes_written == (DWORD)length;
+    CloseHandle(h_file);
+    return ok;
+}
+
+// --- 系列と版 ---
+// フラグには計測結果を左右するビルドの設定をまとめる
+static void build_key(const ProgramOptions* opts, const wchar_t* main_source_full_path, HistoryKey* key) {
+    wchar_t flags[8192] = {0};
+    const wchar_t* parts[] = { opts->compiler_flags, opts->user_libraries, opts->tuned_flags,
+                               opts->debug_build ? L"--debug" : NULL, opts->alloc_stats ? L"--alloc-stats" : NULL };
+    for (int i = 0; i < (int)_countof(parts); ++i) {
+        if (!parts[i] || !parts[i][0]) continue;
+        if (flags[0]) wcscat_s(flags, _countof(flags), L" ");
+        wcscat_s(flags, _countof(flags), parts[i]);
+    }
+    if (opts->malloc_name) {
+        if (flags[0]) wcscat_s(flags, _countof(flags), L" ");
+        wcscat_s(flags, _countof(flags), L"--malloc=");
+        wcscat_s(flags, _countof(flags), opts->malloc_name);
+    }
+    wchar_t args[8192] = {0};
+    for (int i = 0; i < opts->num_program_args; ++i) {
+        if (i > 0) wcscat_s(args, _countof(args), L" ");
+        wcscat_s(args, _countof(args), opts->program_args[i]);
+    }
+
+    // 版はソースの内容だけで決める (パスを変えずに編集した場合に基準と比べるため)
+    ULONGLONG hash = 0;
+    for (int i = 0; i < opts->num_source_files; ++i) {
+        unsigned char* data = NULL;
+        size_t size = 0;
+        if (!read_file_bytes(opts->source_files[i], &data, &size)) continue;
+        hash = hash_bytes(data, size, hash);
+        free(data);
+    }
+    sprintf_s(key->hash, sizeof(key->hash), "%016llx", hash);
+    to_field(main_source_full_path, key->source, sizeof(key->source));
+    to_field(opts->compiler_name, key->compiler, sizeof(key->compiler));
+    to_field(flags, key->flags, sizeof(key->flags));
+    to_field(args, key->args, sizeof(key->args));
+}
+
+static BOOL same_series(const HistoryRecord* a, const HistoryRecord* b) {
+    return _stricmp(a->fields[FIELD_SOURCE], b->fields[FIELD_SOURCE]) == 0 &&
+           strcmp(a->fields[FIELD_COMPILER], b->fields[FIELD_COMPILER]) == 0 &&
+           strcmp(a->fields[FIELD_FLAGS], b->fields[FIELD_FLAGS]) == 0 &&
+           strcmp(a->fields[FIELD_ARGS], b->fields[FIELD_ARGS]) == 0;
+}
+
+static BOOL is_accepted(const HistoryRecord* record) {
+    return strcmp(record->fields[FIELD_STATUS], "slow") != 0;
+}
+
+// 同じ系列・同じ版の計測値をまとめる (accepted_only なら採用した実行だけ)。後ろに extra 個の空きを確保する
+static int collect_samples(const HistoryFile* file, const HistoryRecord* current, const char* hash, BOOL accepted_only, int extra, double** samples) {
+    int total = extra;
+    for (int i = 0; i < file->count; ++i) total += file->records[i].num_samples;
+    *samples = (double*)malloc(sizeof(double) * (total + 1));
+    if (!*samples) return 0;
+    int count = 0;
+    for (int i = 0; i < file->count; ++i) {
+        const HistoryRecord* r = &file->records[i];
+        if (!same_series(r, current) || strcmp(r->fields[FIELD_HASH], hash) != 0) continue;
+        if (accepted_only && !is_accepted(r)) continue;
+        memcpy(*samples + count, r->samples, sizeof(double) * r->num_samples);
+        count += r->num_samples;
+    }
+    return count;
+}
+
+// --- 公開関数 ---
+// 今回の計測を履歴に追記し、基準の版より有意に遅くなっていれば TRUE を返す
+BOOL history_record_run(const ProgramOptions* opts, const wchar_t* main_source_full_path, const double* samples, int count) {
+    wchar_t path[MAX_PATH];
+    if (count <= 0) return FALSE;
+    if (!history_path(path, MAX_PATH)) {
+        fwprintf_err(L"Warning: Could not locate the history file (set %s).\n", HISTORY_ENV);
+        return FALSE;
+    }
+    HistoryKey* key = (HistoryKey*)calloc(1, sizeof(HistoryKey));
+    if (!key) return FALSE;
+    build_key(opts, main_source_full_path, key);
+
+    HistoryRecord current;
+    memset(&current, 0, sizeof(current));
+    current.fields[FIELD_SOURCE] = key->source;
+    current.fields[FIELD_HASH] = key->hash;
+    current.fields[FIELD_COMPILER] = key->compiler;
+    current.fields[FIELD_FLAGS] = key->flags;
+    current.fields[FIELD_ARGS] = key->args;
+
+    HistoryFile history;
+    load_history(path, &history);
+
+    // 基準は同じ系列で内容の違う、最後に採用した版
+    const HistoryRecord* baseline = NULL;
+    for (int i = history.count - 1; i >= 0 && !baseline; --i) {
+        const HistoryRecord* r = &history.records[i];
+        if (same_series(r, &current) && is_accepted(r) && strcmp(r->fields[FIELD_HASH], key->hash) != 0) baseline = r;
+    }
+
+    BOOL regression = FALSE;
+    if (!baseline) {
+        wprintf(L"History: no earlier version of this source to compare with; recorded as the baseline.\n");
+    } else {
+        double* baseline_samples = NULL;
+        double* current_samples = NULL;
+        int num_baseline = collect_samples(&history, &current, baseline->fields[FIELD_HASH], TRUE, 0, &baseline_samples);
+        int num_current = collect_samples(&history, &current, key->hash, FALSE, count, &current_samples);
+        if (current_samples) memcpy(current_samples + num_current, samples, sizeof(double) * count);
+        wchar_t baseline_time[64];
+        from_field(baseline->fields[FIELD_TIME], baseline_time, _countof(baseline_time));
+        if (!baseline_samples || !current_samples) {
+            // メモリ不足では比較しない
+        } else if (num_baseline < HISTORY_MIN_SAMPLES || num_current + count < HISTORY_MIN_SAMPLES) {
+            wprintf(L"History: %d baseline and %d current runs; %d of each are needed to test for a slowdown (use --repeat).\n",
+                    num_baseline, num_current + count, HISTORY_MIN_SAMPLES);
+        } else {
+            num_current += count;
+            double p = stats_mann_whitney_p(baseline_samples, num_baseline, current_samples, num_current);
+            SampleStats before, after;
+            stats_compute(baseline_samples, num_baseline, &before);
+            stats_compute(current_samples, num_current, &after);
+            double change = after.median / before.median - 1.0;
+            wprintf(L"History: median %.3f ms -> %.3f ms (%+.1f%%, p = %.3f) against the baseline from %s (%d vs %d runs)\n",
+                    before.median, after.median, change * 100.0, p, baseline_time, num_baseline, num_current);
+            if (p < HISTORY_SIGNIFICANCE && change > HISTORY_MIN_SLOWDOWN) {
+                regression = TRUE;
+            } else if (p < HISTORY_SIGNIFICANCE && change < -HISTORY_MIN_SLOWDOWN) {
+                wprintf(L"History: significant speedup; this version becomes the new baseline.\n");
+            }
+        }
+        free(baseline_samples);
+        free(current_samples);
+    }
+    if (regression && opts->accept_baseline) {
+        wprintf(L"History: slowdown accepted; this version becomes the new baseline.\n");
+    } else if (regression) {
+        fwprintf_err(L"Error: Significant slowdown against the baseline (use --accept-baseline to accept it).\n");
+    }
+
+    // 追記する行を作る
+    size_t line_size = strlen(key->source) + strlen(key->compiler) + strlen(key->flags) + strlen(key->args) + 128 + (size_t)count * 24;
+    char* line = (char*)malloc(line_size);
+    if (line) {
+        SYSTEMTIME now;
+        GetLocalTime(&now);
+        const char* status = !regression ? "ok" : opts->accept_baseline ? "accepted" : "slow";
+        int length = sprintf_s(line, line_size, "%04d-%02d-%02d %02d:%02d:%02d\t%s\t%s\t%s\t%s\t%s\t%s\t",
+                               now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond,
+                               status, key->source, key->hash, key->compiler, key->flags, key->args);
+        for (int i = 0; i < count && length > 0; ++i) {
+            length += sprintf_s(line + length, line_size - length, i ? ",%.4f" : "%.4f", samples[i]);
+        }
+        if (length > 0) length += sprintf_s(line + length, line_size - length, "\n");
+        if (length <= 0 || !append_line(path, line, length)) fwprintf_err(L"Warning: Could not append to the history file %s\n", path);
+        free(line);
+    }
+    free_history(&history);
+    free(key);
+    return regression && !opts->accept_baseline;
+}
+
+// crun --history <file>: ソースの履歴を系列ごとに表示する
+DWORD history_show(const wchar_t* source_file) {
+    wchar_t path[MAX_PATH], full_path[MAX_PATH];
+    if (!history_path(path, MAX_PATH)) {
+        fwprintf_err(L"Error: Could not locate the history file (set %s).\n", HISTORY_ENV);
+        return 1;
+    }
+    if (!GetFullPathNameW(source_file, MAX_PATH, full_path, NULL)) wcscpy_s(full_path, MAX_PATH, source_file);
+    char source[MAX_PATH * 3];
+    to_field(full_path, source, sizeof(source));
+
+    HistoryFile history;
+    load_history(path, &history);
+    BOOL* shown = (BOOL*)calloc(history.count + 1, sizeof(BOOL));
+    int num_series = 0;
+    for (int i = 0; shown && i < history.count; ++i) {
+        const HistoryRecord* first = &history.records[i];
+        if (shown[i] || _stricmp(first->fields[FIELD_SOURCE], source) != 0) continue;
+
+        wchar_t compiler[256], flags[8192], args[8192];
+        from_field(first->fields[FIELD_COMPILER], compiler, _countof(compiler));
+        from_field(first->fields[FIELD_FLAGS], flags, _countof(flags));
+        from_field(first->fields[FIELD_ARGS], args, _countof(args));
+        wprintf(L"%s--- %s%s%s%s%s ---\n", num_series++ ? L"\n" : L"", compiler, flags[0] ? L" " : L"", flags,
+                args[0] ? L", args: " : L"", args);
+        wprintf(L"%-19s  %-8s %5s %12s  %-23s %8s  %s\n", L"Time", L"Version", L"Runs", L"Median(ms)", L"95% CI (ms)", L"Change", L"Status");
+
+        double first_median = 0, previous_median = 0, last_median = 0;
+        for (int j = i; j < history.count; ++j) {
+            HistoryRecord* r = &history.records[j];
+            if (shown[j] || !same_series(r, first)) continue;
+            shown[j] = TRUE;
+            SampleStats stats;
+            stats_compute(r->samples, r->num_samples, &stats);
+            wchar_t time[64], status[32], version[32], interval[64], change[32] = {0};
+            from_field(r->fields[FIELD_TIME], time, _countof(time));
+            from_field(r->fields[FIELD_STATUS], status, _countof(status));
+            from_field(r->fields[FIELD_HASH], version, _countof(version));
+            version[8] = L'\0'; // 先頭 8 桁だけ表示する
+            swprintf_s(interval, _countof(interval), L"[%.3f, %.3f]", stats.ci_low, stats.ci_high);
+            if (previous_median > 0) swprintf_s(change, _countof(change), L"%+.1f%%", (stats.median / previous_median - 1.0) * 100.0);
+            wprintf(L"%-19s  %-8s %5d %12.3f  %-23s %8s  %s\n", time, version, r->num_samples, stats.median, interval, change, status);
+            if (first_median == 0) first_median = stats.median;
+            previous_median = last_median = stats.median;
+        }
+        if (first_median > 0 && last_median != first_median) {
+            wprintf(L"Trend: %.3f ms -> %.3f ms (%+.1f%% since the first run)\n", first_median, last_median, (last_median / first_median - 1.0) * 100.0);
+        }
+    }
+    if (num_series == 0) wprintf(L"No history for %s in %s (runs are recorded with --time).\n", full_path, path);
+    free(shown);
+    free_history(&history);
+    return num_series ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- 計測結果の履歴 (--time の記録と退行の検出) ---
+// --time で計測した実行は、ソースのパス・内容のハッシュ・コンパイラ・フラグ・引数と一緒に
+// 履歴ファイル (既定は %LOCALAPPDATA%\crun\history.tsv) の末尾に 1 行ずつ追記する。
+// 同じソース・コンパイラ・フラグ・引数で内容の違う最後の「採用済み」の版を基準とし、
+// Mann-Whitney の U 検定で有意に遅くなっていれば退行として報告する (その実行は採用しない)
+#define HISTORY_ENV L"CRUN_HISTORY"       // 履歴ファイルの場所を変える環境変数 (CI のワークスペースなど)
+#define HISTORY_MIN_SAMPLES 5             // 検定に必要な基準側・現在側それぞれの計測数
+#define HISTORY_SIGNIFICANCE 0.05         // 退行とみなす有意水準
+#define HISTORY_MIN_SLOWDOWN 0.02         // 有意でもこれより小さい遅れ (中央値の比) は退行とみなさない
+#define HISTORY_REGRESSION_EXIT_CODE 3    // 退行を検出したときの crun の終了コード (プログラムが 0 で終了した場合)
+
+// --- 関数宣言 ---
+BOOL history_record_run(const ProgramOptions* opts, const wchar_t* main_source_full_path, const double* samples, int count);
+DWORD history_show(const wchar_t* source_file);
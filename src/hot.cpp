@@ -0,0 +1,401 @@
+#include "hot.h"
+#include "utils.h"
+#include "compiler.h"
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- DLL に加えるアダプタ ---
+// ユーザーの main を呼ぶ crun_hot_entry だけを公開する (dllexport があると他のシンボルは公開されない)。
+// exit は -Wl,--wrap=exit でここに回し、main から戻ったのと同じようにホストへ戻る。main は asm ラベルで
+// 参照する (C++ でも名前が修飾されず、main を直接呼ぶことにもならない)
+static const char g_adapter_source[] =
+    "/* crun --hot: ホストが DLL として読み込んだプログラムの main を呼ぶアダプタ */\n"
+    "#ifdef __cplusplus\n"
+    "extern \"C\" {\n"
+    "#endif\n"
+    "#define CRUN_HOT_STR2(x) #x\n"
+    "#define CRUN_HOT_STR(x) CRUN_HOT_STR2(x)\n"
+    "int crun_hot_user_main(int argc, char** argv) __asm__(CRUN_HOT_STR(__USER_LABEL_PREFIX__) \"main\");\n"
+    "static void* crun_hot_exit_point[5];\n"
+    "static int crun_hot_exit_code;\n"
+    "void __wrap_exit(int code) {\n"
+    "    crun_hot_exit_code = code;\n"
+    "    __builtin_longjmp(crun_hot_exit_point, 1);\n"
+    "}\n"
+    "__declspec(dllexport) int crun_hot_entry(int argc, char** argv) {\n"
+    "    if (__builtin_setjmp(crun_hot_exit_point)) return crun_hot_exit_code;\n"
+    "    return crun_hot_user_main(argc, argv);\n"
+    "}\n"
+    "#ifdef __cplusplus\n"
+    "}\n"
+    "#endif\n";
+
+// --- ホスト ---
+// 要求は L'\0' で区切ったフィールドの並び: crun の PID, 標準入力・出力・エラーのハンドル (crun がホストに
+// 複製したもの, 16 進), DLL, カレントディレクトリ, 引数の数, 引数..., 環境変数..., 空のフィールド。
+// 応答は "exit <終了コード>" または "error <GetLastError の値>"
+static const char g_host_source[] =
+    "/* crun --hot のホスト: 名前付きパイプで crun からの要求を待ち、DLL を読み込んで main を呼ぶ */\n"
+    "#include <windows.h>\n"
+    "#include <fcntl.h>\n"
+    "#include <io.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <wchar.h>\n"
+    "\n"
+    "typedef int (*crun_hot_entry_fn)(int argc, char** argv);\n"
+    "static wchar_t g_request[CRUN_HOT_MAX_REQUEST];\n"
+    "static const DWORD g_std_ids[3] = { STD_INPUT_HANDLE, STD_OUTPUT_HANDLE, STD_ERROR_HANDLE };\n"
+    "\n"
+    "static const wchar_t* next_field(const wchar_t** p, const wchar_t* end) {\n"
+    "    const wchar_t* field = *p;\n"
+    "    if (field >= end) return L\"\";\n"
+    "    *p = field + wcslen(field) + 1;\n"
+    "    return field;\n"
+    "}\n"
+    "\n"
+    "static BOOL pipe_io(HANDLE pipe, OVERLAPPED* ov, BOOL write, void* data, DWORD size, DWORD* done) {\n"
+    "    ResetEvent(ov->hEvent);\n"
+    "    BOOL ok = write ? WriteFile(pipe, data, size, NULL, ov) : ReadFile(pipe, data, size, NULL, ov);\n"
+    "    if (!ok && GetLastError() != ERROR_IO_PENDING) return FALSE;\n"
+    "    return GetOverlappedResult(pipe, ov, done, TRUE);\n"
+    "}\n"
+    "\n"
+    "/* crun の環境変数に置き換える (CRT の getenv も見るよう _wputenv で設定する) */\n"
+    "static void apply_environment(const wchar_t** p, const wchar_t* end) {\n"
+    "    wchar_t* current = GetEnvironmentStringsW();\n"
+    "    size_t length = 0;\n"
+    "    while (current && current[length]) length += wcslen(current + length) + 1;\n"
+    "    wchar_t* names = (wchar_t*)malloc((length + 1) * sizeof(wchar_t));\n"
+    "    if (names) {\n"
+    "        memcpy(names, current, length * sizeof(wchar_t));\n"
+    "        names[length] = L'\\0';\n"
+    "        for (wchar_t* name = names; *name; name += wcslen(name) + 1) {\n"
+    "            wchar_t* equals = wcschr(name + 1, L'=');\n"
+    "            if (name[0] == L'=' || !equals) continue;\n"
+    "            wchar_t saved = equals[1];\n"
+    "            equals[1] = L'\\0';\n"
+    "            _wputenv(name); /* \"NAME=\" で削除する */\n"
+    "            equals[1] = saved;\n"
+    "        }\n"
+    "        free(names);\n"
+    "    }\n"
+    "    if (current) FreeEnvironmentStringsW(current);\n"
+    "    for (;;) {\n"
+    "        const wchar_t* variable = next_field(p, end);\n"
+    "        if (!variable[0]) break;\n"
+    "        _wputenv(variable);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "/* crun の標準入出力を fd 0-2 と Win32 の標準ハンドルに付け替える */\n"
+    "static void attach_stdio(HANDLE handles[3]) {\n"
+    "    for (int fd = 0; fd < 3; ++fd) {\n"
+    "        if (!handles[fd]) continue;\n"
+    "        int new_fd = _open_osfhandle((intptr_t)handles[fd], fd == 0 ? _O_RDONLY : 0);\n"
+    "        if (new_fd < 0) { CloseHandle(handles[fd]); continue; }\n"
+    "        if (new_fd != fd) { _dup2(new_fd, fd); _close(new_fd); }\n"
+    "        SetStdHandle(g_std_ids[fd], (HANDLE)_get_osfhandle(fd));\n"
+    "    }\n"
+    "    clearerr(stdin);\n"
+    "    fflush(stdin); /* 前の実行で読み残した入力を捨てる */\n"
+    "    BOOL console = GetFileType(GetStdHandle(STD_OUTPUT_HANDLE)) == FILE_TYPE_CHAR;\n"
+    "    setvbuf(stdout, NULL, console ? _IONBF : _IOFBF, console ? 0 : 4096);\n"
+    "    setvbuf(stderr, NULL, _IONBF, 0);\n"
+    "}\n"
+    "\n"
+    "/* 出力を書き出し、crun のハンドルを閉じる (crun の出力先のパイプを開いたままにしない) */\n"
+    "static void detach_stdio(void) {\n"
+    "    fflush(NULL);\n"
+    "    for (int fd = 0; fd < 3; ++fd) {\n"
+    "        _close(fd);\n"
+    "        SetStdHandle(g_std_ids[fd], NULL);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static void serve(const wchar_t* request, const wchar_t* end, wchar_t* response, size_t response_size) {\n"
+    "    const wchar_t* p = request;\n"
+    "    DWORD client_pid = wcstoul(next_field(&p, end), NULL, 10);\n"
+    "    HANDLE handles[3];\n"
+    "    for (int i = 0; i < 3; ++i) handles[i] = (HANDLE)(uintptr_t)_wcstoui64(next_field(&p, end), NULL, 16);\n"
+    "    const wchar_t* dll = next_field(&p, end);\n"
+    "    const wchar_t* cwd = next_field(&p, end);\n"
+    "    int argc = _wtoi(next_field(&p, end));\n"
+    "    char** argv = (char**)calloc(argc + 1, sizeof(char*));\n"
+    "    for (int i = 0; argv && i < argc; ++i) {\n"
+    "        const wchar_t* arg = next_field(&p, end);\n"
+    "        int size = WideCharToMultiByte(CP_ACP, 0, arg, -1, NULL, 0, NULL, NULL);\n"
+    "        argv[i] = (char*)malloc(size > 0 ? size : 1);\n"
+    "        if (argv[i] && WideCharToMultiByte(CP_ACP, 0, arg, -1, argv[i], size, NULL, NULL) <= 0) argv[i][0] = '\\0';\n"
+    "    }\n"
+    "    apply_environment(&p, end);\n"
+    "    SetCurrentDirectoryW(cwd);\n"
+    "    AttachConsole(client_pid);\n"
+    "    attach_stdio(handles);\n"
+    "\n"
+    "    HMODULE module = LoadLibraryExW(dll, NULL, LOAD_WITH_ALTERED_SEARCH_PATH);\n"
+    "    crun_hot_entry_fn entry = module ? (crun_hot_entry_fn)(void*)GetProcAddress(module, \"crun_hot_entry\") : NULL;\n"
+    "    if (entry && argv) {\n"
+    "        int code = entry(argc, argv);\n"
+    "        fflush(NULL);\n"
+    "        FreeLibrary(module); /* 静的オブジェクトのデストラクタと atexit の関数はここで動く */\n"
+    "        _snwprintf(response, response_size, L\"exit %lu\", (unsigned long)(unsigned int)code);\n"
+    "    } else {\n"
+    "        _snwprintf(response, response_size, L\"error %lu\", GetLastError());\n"
+    "        if (module) FreeLibrary(module);\n"
+    "    }\n"
+    "    response[response_size - 1] = L'\\0';\n"
+    "    detach_stdio();\n"
+    "    FreeConsole();\n"
+    "    for (int i = 0; argv && i < argc; ++i) free(argv[i]);\n"
+    "    free(argv);\n"
+    "}\n"
+    "\n"
+    "int main(void) {\n"
+    "    const wchar_t* name = wcsstr(GetCommandLineW(), L\"\\\\\\\\.\\\\pipe\\\\\");\n"
+    "    if (!name) return 1;\n"
+    "    /* 同じ名前のホストが既に動いていれば終わる */\n"
+    "    HANDLE pipe = CreateNamedPipeW(name, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE | FILE_FLAG_OVERLAPPED,\n"
+    "                                   PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,\n"
+    "                                   1, 4096, sizeof(g_request), 0, NULL);\n"
+    "    if (pipe == INVALID_HANDLE_VALUE) return 1;\n"
+    "    OVERLAPPED ov = {0};\n"
+    "    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);\n"
+    "    for (int runs = 0; runs < CRUN_HOT_MAX_RUNS; ++runs) {\n"
+    "        ResetEvent(ov.hEvent);\n"
+    "        if (!ConnectNamedPipe(pipe, &ov)) {\n"
+    "            DWORD error = GetLastError(), ignored;\n"
+    "            if (error == ERROR_IO_PENDING) {\n"
+    "                if (WaitForSingleObject(ov.hEvent, CRUN_HOT_IDLE_TIMEOUT_MS) != WAIT_OBJECT_0) break; /* しばらく使われていない */\n"
+    "                if (!GetOverlappedResult(pipe, &ov, &ignored, FALSE)) { DisconnectNamedPipe(pipe); continue; }\n"
+    "            } else if (error != ERROR_PIPE_CONNECTED) {\n"
+    "                break;\n"
+    "            }\n"
+    "        }\n"
+    "        DWORD size = 0;\n"
+    "        if (pipe_io(pipe, &ov, FALSE, g_request, sizeof(g_request) - sizeof(wchar_t), &size)) {\n"
+    "            wchar_t response[64];\n"
+    "            g_request[size / sizeof(wchar_t)] = L'\\0';\n"
+    "            serve(g_request, g_request + size / sizeof(wchar_t), response, 64);\n"
+    "            DWORD written;\n"
+    "            pipe_io(pipe, &ov, TRUE, response, (DWORD)((wcslen(response) + 1) * sizeof(wchar_t)), &written);\n"
+    "            FlushFileBuffers(pipe);\n"
+    "        }\n"
+    "        DisconnectNamedPipe(pipe);\n"
+    "    }\n"
+    "    CloseHandle(pipe);\n"
+    "    return 0;\n"
+    "}\n";
+
+// --- ビルド ---
+// アダプタを入力に加え、-shared と --wrap=exit でリンクする
+BOOL hot_prepare(const ProgramOptions* opts, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, HotBuild* build) {
+    memset(build, 0, sizeof(HotBuild));
+    build->opts = *opts;
+    build->inputs = (wchar_t**)calloc(num_inputs + 1, sizeof(wchar_t*));
+    build->libraries = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    if (!build->inputs || !build->libraries) {
+        hot_free_build(build);
+        return FALSE;
+    }
+    for (int i = 0; i < num_inputs; ++i) build->inputs[i] = inputs[i];
+
+    // C++ のプログラムでは --cflags に C++ 用のフラグがあり得るため、アダプタも C++ としてコンパイルする
+    wchar_t adapter_path[MAX_PATH];
+    swprintf_s(adapter_path, MAX_PATH, L"%s\\crun_hot_adapter.%s", temp_dir, has_cpp ? L"cpp" : L"c");
+    build->adapter = write_file_bytes(adapter_path, g_adapter_source, sizeof(g_adapter_source) - 1) ? _wcsdup(adapter_path) : NULL;
+    if (!build->adapter) {
+        fwprintf_err(L"Error: Failed to write the --hot adapter.\n");
+        hot_free_build(build);
+        return FALSE;
+    }
+    build->inputs[num_inputs] = build->adapter;
+    build->num_inputs = num_inputs + 1;
+    swprintf_s(build->libraries, 32767, L"-shared -Wl,--wrap=exit %s", opts->user_libraries ? opts->user_libraries : L"");
+    build->opts.user_libraries = build->libraries;
+    return TRUE;
+}
+
+void hot_free_build(HotBuild* build) {
+    free(build->adapter);
+    free(build->inputs);
+    free(build->libraries);
+    memset(build, 0, sizeof(HotBuild));
+}
+
+// -m32 / -m64 はホストにも付ける (DLL と同じビット数でないと読み込めない)
+static const wchar_t* host_arch_flag(const ProgramOptions* opts) {
+    if (!opts->compiler_flags) return L"";
+    if (wcsstr(opts->compiler_flags, L"-m32")) return L"-m32";
+    if (wcsstr(opts->compiler_flags, L"-m64")) return L"-m64";
+    return L"";
+}
+
+// ホストの実行ファイルをキャッシュから探し、無ければビルドする。キーはコンパイラ・ホストのソース・ビット数
+static BOOL find_or_build_host(const ProgramOptions* opts, wchar_t* host_path, size_t host_path_size, ULONGLONG* key) {
+    wchar_t compiler_path[MAX_PATH];
+    if (!find_compiler(opts->compiler_name, FALSE, compiler_path, MAX_PATH)) return FALSE;
+    const wchar_t* arch = host_arch_flag(opts);
+    *key = hash_bytes(compiler_path, wcslen(compiler_path) * sizeof(wchar_t), 0);
+    *key = hash_bytes(g_host_source, sizeof(g_host_source) - 1, *key);
+    *key = hash_bytes(arch, wcslen(arch) * sizeof(wchar_t), *key);
+    FILETIME compiler_time = {0};
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (GetFileAttributesExW(compiler_path, GetFileExInfoStandard, &info)) compiler_time = info.ftLastWriteTime;
+    if (cache_lookup(*key, L".hot.exe", &compiler_time, host_path, host_path_size)) return TRUE;
+
+    wchar_t source_path[MAX_PATH], temp_path[MAX_PATH], command[4096];
+    if (!cache_temp_path(*key, L".hot.c", source_path, MAX_PATH) || !cache_temp_path(*key, L".hot.exe", temp_path, MAX_PATH)) return FALSE;
+    if (!write_file_bytes(source_path, g_host_source, sizeof(g_host_source) - 1)) return FALSE;
+    swprintf_s(command, _countof(command),
+               L"\"%s\" -x c -O2 -s %s -DCRUN_HOT_MAX_REQUEST=%d -DCRUN_HOT_IDLE_TIMEOUT_MS=%d -DCRUN_HOT_MAX_RUNS=%d \"%s\" -o \"%s\"",
+               compiler_path, arch, HOT_MAX_REQUEST, HOT_IDLE_TIMEOUT_MS, HOT_MAX_RUNS, source_path, temp_path);
+    if (opts->verbose) wprintf(L"Hot: building the host\nCommand: %s\n", command);
+
+    wchar_t* output = NULL;
+    BOOL built = run_process_and_capture_output(command, &output);
+    if (!built && output) wprintf(L"%s", output);
+    free(output);
+    DeleteFileW(source_path);
+    if (!built || !MoveFileExW(temp_path, host_path, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(temp_path);
+        fwprintf_err(L"Error: Failed to build the --hot host.\n");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// ホストのパイプにつなぐ。ホストが動いていなければ起動し、パイプが開くまで待つ
+static HANDLE connect_host(const ProgramOptions* opts, const wchar_t* host_path, const wchar_t* pipe_name) {
+    BOOL started = FALSE;
+    ULONGLONG deadline = GetTickCount64() + HOT_CONNECT_TIMEOUT_MS;
+    for (;;) {
+        HANDLE pipe = CreateFileW(pipe_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            DWORD mode = PIPE_READMODE_MESSAGE;
+            SetNamedPipeHandleState(pipe, &mode, NULL, NULL);
+            return pipe;
+        }
+        DWORD error = GetLastError();
+        if (error == ERROR_PIPE_BUSY) { // 別の crun の実行が終わるまで待つ
+            WaitNamedPipeW(pipe_name, NMPWAIT_WAIT_FOREVER);
+            deadline = GetTickCount64() + HOT_CONNECT_TIMEOUT_MS;
+            continue;
+        }
+        if (GetTickCount64() >= deadline) return INVALID_HANDLE_VALUE;
+        if (!started) {
+            wchar_t command[MAX_PATH * 2 + 8];
+            swprintf_s(command, _countof(command), L"\"%s\" %s", host_path, pipe_name);
+            ProcessSpawnOptions spawn = {};
+            spawn.detached = TRUE;
+            ChildProcess proc;
+            if (!process_spawn(command, &spawn, &proc)) return INVALID_HANDLE_VALUE;
+            process_close(&proc); // crun の終了後も常駐させる
+            started = TRUE;
+            if (opts->verbose) wprintf(L"Hot: started a new host (%s)\n", host_path);
+        }
+        Sleep(2);
+    }
+}
+
+// 要求を組み立てる。crun の標準入出力はホストに複製して、その値を渡す
+static size_t build_request(const ProgramOptions* opts, HANDLE host, const wchar_t* dll_path, wchar_t* request, size_t request_size) {
+    static const DWORD std_ids[3] = { STD_INPUT_HANDLE, STD_OUTPUT_HANDLE, STD_ERROR_HANDLE };
+    size_t length = 0;
+    int written = swprintf_s(request, request_size, L"%lu", GetCurrentProcessId());
+    if (written < 0) return 0;
+    length = written + 1;
+    for (int i = 0; i < 3; ++i) {
+        HANDLE remote = NULL;
+        HANDLE local = GetStdHandle(std_ids[i]);
+        if (local && local != INVALID_HANDLE_VALUE) DuplicateHandle(GetCurrentProcess(), local, host, &remote, 0, FALSE, DUPLICATE_SAME_ACCESS);
+        written = swprintf_s(request + length, request_size - length, L"%llx", (ULONGLONG)(ULONG_PTR)remote);
+        if (written < 0) return 0;
+        length += written + 1;
+    }
+
+    wchar_t cwd[MAX_PATH], argc_text[16];
+    if (!GetCurrentDirectoryW(MAX_PATH, cwd)) cwd[0] = L'\0';
+    swprintf_s(argc_text, _countof(argc_text), L"%d", opts->num_program_args + 1);
+    const wchar_t* fields[3] = { dll_path, cwd, argc_text };
+    for (int i = 0; i < 3 + 1 + opts->num_program_args; ++i) {
+        const wchar_t* field = i < 3 ? fields[i] : (i == 3 ? dll_path : opts->program_args[i - 4]); // argv[0] は DLL のパス
+        size_t size = wcslen(field) + 1;
+        if (length + size >= request_size) return 0;
+        memcpy(request + length, field, size * sizeof(wchar_t));
+        length += size;
+    }
+    wchar_t* environment = GetEnvironmentStringsW();
+    for (const wchar_t* variable = environment; variable && *variable; variable += wcslen(variable) + 1) {
+        if (variable[0] == L'=') continue; // ドライブごとのカレントディレクトリ (=C:=...)
+        size_t size = wcslen(variable) + 1;
+        if (length + size + 1 >= request_size) {
+            FreeEnvironmentStringsW(environment);
+            return 0;
+        }
+        memcpy(request + length, variable, size * sizeof(wchar_t));
+        length += size;
+    }
+    if (environment) FreeEnvironmentStringsW(environment);
+    request[length++] = L'\0'; // 環境変数の終わり
+    return length;
+}
+
+// --- 実行 ---
+// ホストに DLL の実行を頼み、終了コードを受け取る。ホストが応答せずに終わった場合 (プログラムのクラッシュ)
+// はホストの終了コードを異常終了として返す。次の実行では新しいホストを起動する
+BOOL hot_run(const ProgramOptions* opts, const wchar_t* dll_path, DWORD* p_exit_code, ProcessVerdict* p_verdict) {
+    *p_exit_code = 1;
+    *p_verdict = PROCESS_VERDICT_EXITED;
+    wchar_t host_path[MAX_PATH], pipe_name[128];
+    ULONGLONG key;
+    if (!find_or_build_host(opts, host_path, MAX_PATH, &key)) return FALSE;
+    DWORD session = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &session);
+    swprintf_s(pipe_name, _countof(pipe_name), L"\\\\.\\pipe\\crun-hot-%016llx-%lu", key, session);
+
+    HANDLE pipe = connect_host(opts, host_path, pipe_name);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        fwprintf_err(L"Error: Could not connect to the --hot host (%s).\n", pipe_name);
+        return FALSE;
+    }
+    ULONG host_pid = 0;
+    HANDLE host = GetNamedPipeServerProcessId(pipe, &host_pid)
+                      ? OpenProcess(PROCESS_DUP_HANDLE | SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, host_pid) : NULL;
+    wchar_t* request = (wchar_t*)malloc(sizeof(wchar_t) * HOT_MAX_REQUEST);
+    size_t length = (host && request) ? build_request(opts, host, dll_path, request, HOT_MAX_REQUEST) : 0;
+    BOOL started = FALSE;
+    if (!host) {
+        fwprintf_err(L"Error: Could not open the --hot host process (error %lu).\n", GetLastError());
+    } else if (length == 0) {
+        fwprintf_err(L"Error: Could not pass the program to the --hot host (arguments and environment must fit in %d characters).\n", HOT_MAX_REQUEST);
+    } else {
+        if (opts->verbose) wprintf(L"Hot: running in host %lu\n", host_pid);
+        fflush(stdout);
+        wchar_t response[64] = {0};
+        DWORD transferred = 0;
+        BOOL replied = WriteFile(pipe, request, (DWORD)(length * sizeof(wchar_t)), &transferred, NULL) &&
+                       ReadFile(pipe, response, sizeof(response) - sizeof(wchar_t), &transferred, NULL);
+        if (replied && wcsncmp(response, L"exit ", 5) == 0) {
+            *p_exit_code = wcstoul(response + 5, NULL, 10);
+            started = TRUE;
+        } else if (replied) {
+            fwprintf_err(L"Error: The --hot host could not load %s (%s).\n", dll_path, response);
+        } else {
+            // ホストが応答せずに終わった: プログラムがクラッシュした (または Ctrl+C で止めた)
+            WaitForSingleObject(host, 1000);
+            if (!GetExitCodeProcess(host, p_exit_code) || *p_exit_code == STILL_ACTIVE) *p_exit_code = 1;
+            *p_verdict = PROCESS_VERDICT_CRASHED;
+            started = TRUE;
+            if (opts->verbose) wprintf(L"Hot: the host terminated; a new one starts on the next run.\n");
+        }
+    }
+    free(request);
+    if (host) CloseHandle(host);
+    CloseHandle(pipe);
+    return started;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+#include "process.h"
+
+// --- 常駐ホストでの実行 (--hot) ---
+// ソースを main を呼ぶアダプタと一緒に DLL としてビルドし、常駐させたホストプロセスに名前付きパイプで
+// 実行を頼む。ホストは DLL を読み込み、crun の標準入出力・環境変数・カレントディレクトリで main を呼び、
+// 終了コードを返して DLL を解放する。プロセスの生成・ローダー・CRT の初期化を毎回行わずに済む。
+// ホストは DLL と同じ CRT を使うよう、同じコンパイラで一度だけビルドしてキャッシュに置く。
+// プログラムがクラッシュするとホストごと終わり、次の実行で新しいホストを起動する
+#define HOT_MAX_REQUEST 131072            // 要求 (引数と環境変数) の最大の文字数
+#define HOT_IDLE_TIMEOUT_MS (15 * 60 * 1000) // この間要求が無ければホストは終了する
+#define HOT_MAX_RUNS 200                  // ホストが実行する回数の上限 (プログラムが解放しなかったメモリなどを持ち越さない)
+#define HOT_CONNECT_TIMEOUT_MS 5000       // 起動したホストのパイプが開くまで待つ時間
+
+// DLL としてビルドする設定
+struct HotBuild {
+    ProgramOptions opts;         // user_libraries に -shared と --wrap=exit を加えたもの
+    wchar_t** inputs;            // 元の入力 + アダプタのソース
+    int num_inputs;
+    wchar_t* libraries;
+    wchar_t* adapter;            // 書き出したアダプタのパス
+};
+
+// --- 関数宣言 ---
+BOOL hot_prepare(const ProgramOptions* opts, BOOL has_cpp, const wchar_t* temp_dir, wchar_t* const* inputs, int num_inputs, HotBuild* build);
+void hot_free_build(HotBuild* build);
+BOOL hot_run(const ProgramOptions* opts, const wchar_t* dll_path, DWORD* p_exit_code, ProcessVerdict* p_verdict);
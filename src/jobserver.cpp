@@ -0,0 +1,127 @@
+#include "jobserver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- 状態 ---
+static JobserverMode g_mode = JOBSERVER_NONE;
+static char g_name[JOBSERVER_MAX_NAME];          // --jobserver-auth= の値
+static int g_num_held = 0;                       // 取ったトークンの数
+
+// MAKEFLAGS から --jobserver-auth= (make 4.1 以前は --jobserver-fds=) の値を取り出す。複数あれば最後のものを使う
+static BOOL find_jobserver_auth(const char* makeflags, char* value, size_t value_size) {
+    static const char* const prefixes[] = { "--jobserver-auth=", "--jobserver-fds=" };
+    BOOL found = FALSE;
+    const char* p = makeflags;
+    while (*p) {
+        while (*p == ' ' || *p == '\t') p++;
+        const char* word = p;
+        while (*p && *p != ' ' && *p != '\t') p++;
+        size_t length = (size_t)(p - word);
+        for (int i = 0; i < 2; ++i) {
+            size_t prefix_length = strlen(prefixes[i]);
+            if (length > prefix_length && length - prefix_length < value_size && strncmp(word, prefixes[i], prefix_length) == 0) {
+                memcpy(value, word + prefix_length, length - prefix_length);
+                value[length - prefix_length] = '\0';
+                found = TRUE;
+            }
+        }
+    }
+    return found;
+}
+
+// --- 名前付きセマフォ (make 4.0 以降の Windows 版と同じ) ---
+static HANDLE g_semaphore = NULL;
+
+static BOOL open_client(const char* name) {
+    g_semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, name);
+    return g_semaphore != NULL;
+}
+
+static BOOL create_server(int tokens, char* name, size_t name_size) {
+    snprintf(name, name_size, "crun_semaphore_%lu", GetCurrentProcessId());
+    g_semaphore = CreateSemaphoreA(NULL, tokens, tokens > 0 ? tokens : 1, name);
+    return g_semaphore != NULL;
+}
+
+static BOOL take_token(void) {
+    return WaitForSingleObject(g_semaphore, 0) == WAIT_OBJECT_0;
+}
+
+static void give_token(void) {
+    ReleaseSemaphore(g_semaphore, 1, NULL);
+}
+
+static void close_jobserver(void) {
+    if (g_semaphore) CloseHandle(g_semaphore);
+    g_semaphore = NULL;
+}
+
+static void export_makeflags(const char* makeflags) {
+    SetEnvironmentVariableA("MAKEFLAGS", makeflags);
+}
+
+// 使えるジョブサーバーを決める。MAKEFLAGS にあればそれを使い、無ければ serve のときだけ jobs 個分を作る。
+// 作ったときは MAKEFLAGS に -j と --jobserver-auth を加え、以後に起動する子プロセスへ渡す
+JobserverMode jobserver_setup(int jobs, BOOL serve) {
+    const char* makeflags = getenv("MAKEFLAGS");
+    if (makeflags && find_jobserver_auth(makeflags, g_name, sizeof(g_name))) {
+        g_mode = open_client(g_name) ? JOBSERVER_CLIENT : JOBSERVER_UNAVAILABLE;
+    } else if (serve) {
+        int tokens = jobs - 1; // 1つは crun 自身の分
+        if (tokens < 0) tokens = 0;
+        if (create_server(tokens, g_name, sizeof(g_name))) {
+            size_t size = (makeflags ? strlen(makeflags) : 0) + strlen(g_name) + 64;
+            char* flags = (char*)malloc(size);
+            if (flags) {
+                snprintf(flags, size, "%s%s-j%d --jobserver-auth=%s", makeflags ? makeflags : "", makeflags && *makeflags ? " " : "", jobs, g_name);
+                export_makeflags(flags);
+                free(flags);
+            }
+            g_mode = JOBSERVER_SERVER;
+        } else {
+            g_mode = JOBSERVER_UNAVAILABLE;
+        }
+    }
+    if (g_mode == JOBSERVER_CLIENT || g_mode == JOBSERVER_SERVER) atexit(jobserver_shutdown);
+    return g_mode;
+}
+
+JobserverMode jobserver_mode(void) {
+    return g_mode;
+}
+
+const char* jobserver_name(void) {
+    return g_name;
+}
+
+// 持っているトークンを limit 個まで返す
+static void release_tokens(int limit) {
+    if (limit < 0) limit = 0;
+    while (g_num_held > limit) { give_token(); g_num_held--; }
+}
+
+// num_running 個を実行中に、もう1つ起動してよいか。2つ目以降はトークンが無ければ待たずに FALSE を返すので、
+// 呼び出し側は実行中のものの終了を待ってからやり直す。起動しなかった分のトークンは次の呼び出しで使うか返す
+BOOL jobserver_acquire(int num_running) {
+    if (g_mode != JOBSERVER_CLIENT && g_mode != JOBSERVER_SERVER) return TRUE;
+    release_tokens(num_running);
+    if (g_num_held >= num_running) return TRUE;
+    if (g_num_held >= JOBSERVER_MAX_TOKENS || !take_token()) return FALSE;
+    g_num_held++;
+    return TRUE;
+}
+
+// プロセスが終わったら呼び、実行中の数に必要な分 (num_running - 1 個) を超えるトークンを返す
+void jobserver_sync(int num_running) {
+    if (g_mode != JOBSERVER_CLIENT && g_mode != JOBSERVER_SERVER) return;
+    release_tokens(num_running - 1);
+}
+
+// 持っているトークンを全て返して閉じる (終了時と Ctrl+C で呼ぶ。トークンを失うと make の並列数が減ったままになる)
+void jobserver_shutdown(void) {
+    if (g_mode != JOBSERVER_CLIENT && g_mode != JOBSERVER_SERVER) return;
+    release_tokens(0);
+    close_jobserver();
+    g_mode = JOBSERVER_NONE;
+}
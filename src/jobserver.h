@@ -0,0 +1,26 @@
+#pragma once
+
+#include "process.h"
+
+// --- GNU make のジョブサーバー (MAKEFLAGS の --jobserver-auth, -j) ---
+// make -j の下で起動されたときは、MAKEFLAGS のジョブサーバー (名前付きセマフォ) から、同時に起動する
+// 2つ目以降のコンパイラやプロセスごとにトークンを1つ取り、終わったら返す。
+// 1つ目は crun 自身が make から割り当てられた分 (暗黙のトークン) で動かす。
+// make の外で -j を指定したときは crun がジョブサーバーを作り、MAKEFLAGS で子プロセス (make や crun) に渡す
+#define JOBSERVER_MAX_TOKENS PROCESS_WAIT_MAX   // 同時に持つトークンの上限 (同時に待てるプロセスの数に合わせる)
+#define JOBSERVER_MAX_NAME 512
+
+enum JobserverMode {
+    JOBSERVER_NONE,        // ジョブサーバーを使わない (--jobs だけで同時実行数を決める)
+    JOBSERVER_CLIENT,      // MAKEFLAGS で渡されたものからトークンを取る
+    JOBSERVER_SERVER,      // crun が作ったもの (MAKEFLAGS で子プロセスにも渡す)
+    JOBSERVER_UNAVAILABLE  // MAKEFLAGS にあるものを開けないか、作れなかった
+};
+
+// --- 関数宣言 ---
+JobserverMode jobserver_setup(int jobs, BOOL serve);
+JobserverMode jobserver_mode(void);
+const char* jobserver_name(void);
+BOOL jobserver_acquire(int num_running);
+void jobserver_sync(int num_running);
+void jobserver_shutdown(void);
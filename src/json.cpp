@@ -0,0 +1,256 @@
+#include "json.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+// --- パーサー状態 ---
+struct JsonParser {
+    const wchar_t* p;
+    const wchar_t* start;
+    wchar_t* error;
+    size_t error_size;
+    BOOL failed;
+};
+
+static JsonValue* parse_value(JsonParser* ps, int depth);
+
+static void parse_error(JsonParser* ps, const wchar_t* message) {
+    if (ps->failed) return;
+    ps->failed = TRUE;
+    if (ps->error) {
+        // エラー位置を行番号で示す
+        int line = 1;
+        for (const wchar_t* q = ps->start; q < ps->p; ++q) if (*q == L'\n') line++;
+        swprintf_s(ps->error, ps->error_size, L"%s (line %d)", message, line);
+    }
+}
+
+static void skip_whitespace(JsonParser* ps) {
+    for (;;) {
+        while (*ps->p == L' ' || *ps->p == L'\t' || *ps->p == L'\r' || *ps->p == L'\n') ps->p++;
+        // 設定ファイルとして書きやすいよう // 行コメントだけは許容する
+        if (ps->p[0] == L'/' && ps->p[1] == L'/') {
+            while (*ps->p && *ps->p != L'\n') ps->p++;
+            continue;
+        }
+        break;
+    }
+}
+
+static JsonValue* new_value(JsonType type) {
+    JsonValue* v = (JsonValue*)calloc(1, sizeof(JsonValue));
+    if (v) v->type = type;
+    return v;
+}
+
+static int hex_digit(wchar_t c) {
+    if (c >= L'0' && c <= L'9') return c - L'0';
+    if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+    if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+    return -1;
+}
+
+static wchar_t* parse_string_raw(JsonParser* ps) {
+    if (*ps->p != L'"') { parse_error(ps, L"expected string"); return NULL; }
+    ps->p++;
+
+    // エスケープを展開しても元の長さを超えないため、終端までの長さで確保する
+    const wchar_t* end = ps->p;
+    while (*end && *end != L'"') {
+        if (*end == L'\\' && end[1]) end++;
+        end++;
+    }
+    if (*end != L'"') { parse_error(ps, L"unterminated string"); return NULL; }
+
+    wchar_t* out = (wchar_t*)malloc(sizeof(wchar_t) * (end - ps->p + 1));
+    if (!out) { parse_error(ps, L"out of memory"); return NULL; }
+    size_t n = 0;
+    while (ps->p < end) {
+        wchar_t c = *ps->p++;
+        if (c != L'\\') { out[n++] = c; continue; }
+        c = *ps->p++;
+        switch (c) {
+            case L'"': out[n++] = L'"'; break;
+            case L'\\': out[n++] = L'\\'; break;
+            case L'/': out[n++] = L'/'; break;
+            case L'b': out[n++] = L'\b'; break;
+            case L'f': out[n++] = L'\f'; break;
+            case L'n': out[n++] = L'\n'; break;
+            case L'r': out[n++] = L'\r'; break;
+            case L't': out[n++] = L'\t'; break;
+            case L'u': {
+                int code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    int d = (ps->p < end) ? hex_digit(*ps->p) : -1;
+                    if (d < 0) { free(out); parse_error(ps, L"invalid \\u escape"); return NULL; }
+                    code = code * 16 + d;
+                    ps->p++;
+                }
+                out[n++] = (wchar_t)code;
+                break;
+            }
+            default:
+                free(out);
+                parse_error(ps, L"invalid escape sequence");
+                return NULL;
+        }
+    }
+    out[n] = L'\0';
+    ps->p = end + 1;
+    return out;
+}
+
+static void append_child(JsonValue* parent, JsonValue* child, JsonValue** tail) {
+    if (*tail) (*tail)->next = child;
+    else parent->first_child = child;
+    *tail = child;
+    parent->child_count++;
+}
+
+static JsonValue* parse_container(JsonParser* ps, int depth, BOOL is_object) {
+    JsonValue* container = new_value(is_object ? JSON_OBJECT : JSON_ARRAY);
+    if (!container) { parse_error(ps, L"out of memory"); return NULL; }
+    wchar_t close = is_object ? L'}' : L']';
+    JsonValue* tail = NULL;
+
+    ps->p++;
+    skip_whitespace(ps);
+    if (*ps->p == close) { ps->p++; return container; }
+
+    for (;;) {
+        wchar_t* key = NULL;
+        if (is_object) {
+            skip_whitespace(ps);
+            key = parse_string_raw(ps);
+            if (!key) break;
+            skip_whitespace(ps);
+            if (*ps->p != L':') { free(key); parse_error(ps, L"expected ':'"); break; }
+            ps->p++;
+        }
+        JsonValue* child = parse_value(ps, depth + 1);
+        if (!child) { free(key); break; }
+        child->key = key;
+        append_child(container, child, &tail);
+
+        skip_whitespace(ps);
+        if (*ps->p == L',') {
+            ps->p++;
+            skip_whitespace(ps);
+            if (*ps->p == close) { ps->p++; return container; } // 末尾カンマを許容
+            continue;
+        }
+        if (*ps->p == close) { ps->p++; return container; }
+        parse_error(ps, is_object ? L"expected ',' or '}'" : L"expected ',' or ']'");
+        break;
+    }
+    json_free(container);
+    return NULL;
+}
+
+static JsonValue* parse_value(JsonParser* ps, int depth) {
+    if (depth > 256) { parse_error(ps, L"nesting too deep"); return NULL; }
+    skip_whitespace(ps);
+
+    wchar_t c = *ps->p;
+    if (c == L'{' || c == L'[') return parse_container(ps, depth, c == L'{');
+    if (c == L'"') {
+        wchar_t* s = parse_string_raw(ps);
+        if (!s) return NULL;
+        JsonValue* v = new_value(JSON_STRING);
+        if (!v) { free(s); parse_error(ps, L"out of memory"); return NULL; }
+        v->string = s;
+        return v;
+    }
+    if (c == L'-' || (c >= L'0' && c <= L'9')) {
+        wchar_t* end = NULL;
+        double number = wcstod(ps->p, &end);
+        if (end == ps->p) { parse_error(ps, L"invalid number"); return NULL; }
+        ps->p = end;
+        JsonValue* v = new_value(JSON_NUMBER);
+        if (v) v->number = number;
+        return v;
+    }
+    if (wcsncmp(ps->p, L"true", 4) == 0 || wcsncmp(ps->p, L"false", 5) == 0) {
+        BOOL value = (c == L't');
+        ps->p += value ? 4 : 5;
+        JsonValue* v = new_value(JSON_BOOL);
+        if (v) v->boolean = value;
+        return v;
+    }
+    if (wcsncmp(ps->p, L"null", 4) == 0) {
+        ps->p += 4;
+        return new_value(JSON_NULL);
+    }
+    parse_error(ps, L"unexpected character");
+    return NULL;
+}
+
+// JSONテキストを解析してツリーを返す (失敗時はNULLで、errorにメッセージが入る)
+JsonValue* json_parse(const wchar_t* text, wchar_t* error, size_t error_size) {
+    JsonParser ps = { text, text, error, error_size, FALSE };
+    JsonValue* root = parse_value(&ps, 0);
+    if (root) {
+        skip_whitespace(&ps);
+        if (*ps.p != L'\0') {
+            parse_error(&ps, L"trailing characters after JSON value");
+            json_free(root);
+            return NULL;
+        }
+    }
+    return root;
+}
+
+JsonValue* json_parse_file(const wchar_t* path, wchar_t* error, size_t error_size) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) {
+        if (error) swprintf_s(error, error_size, L"cannot read %s", path);
+        return NULL;
+    }
+    // JSONはUTF-8 (BOM付きも許容)
+    size_t offset = (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) ? 3 : 0;
+    int wide_size = MultiByteToWideChar(CP_UTF8, 0, (const char*)data + offset, -1, NULL, 0);
+    wchar_t* text = (wide_size > 0) ? (wchar_t*)malloc(sizeof(wchar_t) * wide_size) : NULL;
+    if (!text) {
+        free(data);
+        if (error) swprintf_s(error, error_size, L"cannot decode %s", path);
+        return NULL;
+    }
+    MultiByteToWideChar(CP_UTF8, 0, (const char*)data + offset, -1, text, wide_size);
+    free(data);
+
+    JsonValue* root = json_parse(text, error, error_size);
+    free(text);
+    return root;
+}
+
+const JsonValue* json_get(const JsonValue* object, const wchar_t* key) {
+    if (!object || object->type != JSON_OBJECT) return NULL;
+    for (const JsonValue* member = object->first_child; member; member = member->next) {
+        if (member->key && wcscmp(member->key, key) == 0) return member;
+    }
+    return NULL;
+}
+
+const wchar_t* json_get_string(const JsonValue* object, const wchar_t* key, const wchar_t* default_value) {
+    const JsonValue* v = json_get(object, key);
+    return (v && v->type == JSON_STRING) ? v->string : default_value;
+}
+
+double json_get_number(const JsonValue* object, const wchar_t* key, double default_value) {
+    const JsonValue* v = json_get(object, key);
+    return (v && v->type == JSON_NUMBER) ? v->number : default_value;
+}
+
+void json_free(JsonValue* value) {
+    while (value) {
+        JsonValue* next = value->next;
+        json_free(value->first_child);
+        free(value->key);
+        free(value->string);
+        free(value);
+        value = next;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <windows.h>
+
+// --- 最小限のJSONツリー ---
+enum JsonType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+struct JsonValue {
+    JsonType type;
+    wchar_t* key;            // オブジェクトのメンバーである場合のキー
+    wchar_t* string;         // JSON_STRING の値
+    double number;           // JSON_NUMBER の値
+    BOOL boolean;            // JSON_BOOL の値
+    JsonValue* first_child;  // 配列の要素 / オブジェクトのメンバー (出現順)
+    JsonValue* next;         // 同じ親を持つ次の要素
+    int child_count;
+};
+
+// --- 関数宣言 ---
+JsonValue* json_parse(const wchar_t* text, wchar_t* error, size_t error_size);
+JsonValue* json_parse_file(const wchar_t* path, wchar_t* error, size_t error_size);
+const JsonValue* json_get(const JsonValue* object, const wchar_t* key);
+const wchar_t* json_get_string(const JsonValue* object, const wchar_t* key, const wchar_t* default_value);
+double json_get_number(const JsonValue* object, const wchar_t* key, double default_value);
+void json_free(JsonValue* value);
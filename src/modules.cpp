@@ -0,0 +1,409 @@
+#include "modules.h"
+#include "utils.h"
+#include "compiler.h"
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// --- import できる標準ヘッダー ---
+// C++ のライブラリヘッダー ([headers] の表)。<cstdio> などの C 由来のヘッダーは import できない
+static const wchar_t* const g_importable_headers[] = {
+    L"algorithm", L"any", L"array", L"atomic", L"barrier", L"bit", L"bitset", L"charconv", L"chrono", L"codecvt",
+    L"compare", L"complex", L"concepts", L"condition_variable", L"coroutine", L"deque", L"exception", L"execution",
+    L"expected", L"filesystem", L"format", L"forward_list", L"fstream", L"functional", L"future", L"initializer_list",
+    L"iomanip", L"ios", L"iosfwd", L"iostream", L"istream", L"iterator", L"latch", L"limits", L"list", L"locale",
+    L"map", L"mdspan", L"memory", L"memory_resource", L"mutex", L"new", L"numbers", L"numeric", L"optional",
+    L"ostream", L"print", L"queue", L"random", L"ranges", L"ratio", L"regex", L"scoped_allocator", L"semaphore",
+    L"set", L"shared_mutex", L"source_location", L"span", L"spanstream", L"sstream", L"stack", L"stacktrace",
+    L"stdexcept", L"stop_token", L"streambuf", L"string", L"string_view", L"syncstream", L"system_error", L"thread",
+    L"tuple", L"type_traits", L"typeindex", L"typeinfo", L"unordered_map", L"unordered_set", L"utility", L"valarray",
+    L"variant", L"vector", L"version",
+};
+
+static BOOL is_importable_header(const wchar_t* name) {
+    for (size_t i = 0; i < _countof(g_importable_headers); ++i) {
+        if (wcscmp(g_importable_headers[i], name) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+// --- 使うヘッダーユニットとモジュールの一覧 ---
+struct ModuleUnit {
+    wchar_t name[64];    // ヘッダー名 (vector) またはモジュール名 (std, std.compat)
+    BOOL is_module;
+    BOOL imported;       // ソースが import で書いている (ビルドできなければコンパイルも失敗する)
+};
+
+struct UnitList {
+    ModuleUnit items[MODULES_MAX_UNITS];
+    int count;
+};
+
+static void add_unit(UnitList* units, const wchar_t* name, BOOL is_module, BOOL imported) {
+    // std.compat は std を import するため、std を先にビルドする
+    if (is_module && wcscmp(name, L"std.compat") == 0) add_unit(units, L"std", TRUE, imported);
+    for (int i = 0; i < units->count; ++i) {
+        if (units->items[i].is_module == is_module && wcscmp(units->items[i].name, name) == 0) {
+            units->items[i].imported |= imported;
+            return;
+        }
+    }
+    if (units->count >= MODULES_MAX_UNITS || wcslen(name) >= _countof(units->items[0].name)) return;
+    ModuleUnit* unit = &units->items[units->count++];
+    wcscpy_s(unit->name, _countof(unit->name), name);
+    unit->is_module = is_module;
+    unit->imported = imported;
+}
+
+static void skip_blanks(const char** p) {
+    while (**p == ' ' || **p == '\t') (*p)++;
+}
+
+// ソースの import 宣言 (import std; / import std.compat; / import <vector>;) を集める。
+// import 宣言は行頭 (export の後) にしか書けないため、各行の先頭だけを調べる
+static void scan_imports(const wchar_t* path, UnitList* units) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return;
+    const char* p = (const char*)data;
+    while (*p) {
+        skip_blanks(&p);
+        if (strncmp(p, "export", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+            p += 6;
+            skip_blanks(&p);
+        }
+        if (strncmp(p, "import", 6) == 0 && (p[6] == ' ' || p[6] == '\t' || p[6] == '<')) {
+            p += 6;
+            skip_blanks(&p);
+            BOOL is_header = (*p == '<');
+            if (is_header) p++;
+            const char* name = p;
+            if (is_header) {
+                while (*p && *p != '>' && *p != '\n') p++;
+            } else {
+                while (isalnum((unsigned char)*p) || *p == '_' || *p == '.') p++;
+            }
+            size_t len = (size_t)(p - name);
+            if (is_header && *p == '>') p++;
+            skip_blanks(&p);
+            wchar_t wide_name[64];
+            if (*p == ';' && len > 0 && len < _countof(wide_name)) {
+                for (size_t i = 0; i < len; ++i) wide_name[i] = (wchar_t)(unsigned char)name[i];
+                wide_name[len] = L'\0';
+                if (is_header ? is_importable_header(wide_name) : (wcscmp(wide_name, L"std") == 0 || wcscmp(wide_name, L"std.compat") == 0)) {
+                    add_unit(units, wide_name, !is_header, TRUE);
+                }
+            }
+        }
+        p = strchr(p, '\n');
+        if (!p) break;
+        p++;
+    }
+    free(data);
+}
+
+static BOOL is_in_system_dir(const IncludeSearchPath* search, const wchar_t* path) {
+    for (int i = 0; i < search->count; ++i) {
+        if (search->dirs[i].kind != INCLUDE_DIR_SYSTEM) continue;
+        size_t len = wcslen(search->dirs[i].path);
+        if (_wcsnicmp(path, search->dirs[i].path, len) == 0 && (path[len] == L'\\' || path[len] == L'/')) return TRUE;
+    }
+    return FALSE;
+}
+
+// ソース (とユーザーのヘッダー) が <...> でインクルードする標準ヘッダーを集める (g++ が import に置き換えるもの)
+static void scan_includes(const ProgramOptions* opts, const IncludeSearchPath* search, UnitList* units) {
+    IncludeList includes;
+    find_includes_in_sources(opts->source_files, opts->num_source_files, search, &includes);
+    for (int i = 0; i < includes.count; ++i) {
+        const IncludeDirective* d = &includes.items[i];
+        if (d->quoted || !d->resolved || !is_importable_header(d->target)) continue;
+        if (is_in_system_dir(search, d->file) || !is_in_system_dir(search, d->resolved)) continue;
+        add_unit(units, d->target, FALSE, FALSE);
+    }
+    free_include_list(&includes);
+}
+
+// 標準ライブラリのモジュールのソース。g++ (15 以降) は <include>\c++\<ver>\bits\std.cc、
+// clang++ (libc++) は <root>\share\libc++\v1\std.cppm にある
+static BOOL find_module_source(const IncludeSearchPath* search, const wchar_t* compiler_path, BOOL is_clang, const wchar_t* module, wchar_t* path, size_t path_size) {
+    if (is_clang) {
+        wchar_t bin_dir[MAX_PATH], root_dir[MAX_PATH];
+        get_parent_path(compiler_path, bin_dir, MAX_PATH);
+        get_parent_path(bin_dir, root_dir, MAX_PATH);
+        swprintf_s(path, path_size, L"%s\\share\\libc++\\v1\\%s.cppm", root_dir, module);
+        return file_exists(path);
+    }
+    for (int i = 0; i < search->count; ++i) {
+        if (search->dirs[i].kind != INCLUDE_DIR_SYSTEM) continue;
+        swprintf_s(path, path_size, L"%s\\bits\\%s.cc", search->dirs[i].path, module);
+        if (file_exists(path)) return TRUE;
+    }
+    return FALSE;
+}
+
+// --- ビルド ---
+struct ModulesContext {
+    const wchar_t* compiler_path;
+    BOOL is_clang;
+    BOOL verbose;
+    const wchar_t* flags;          // BMI とオブジェクトのビルドに使うフラグ (ユーザーのプログラムのコンパイルと同じもの)
+    wchar_t repository[MAX_PATH];  // このコンパイラとフラグの BMI を置くディレクトリ
+    wchar_t mapper[MAX_PATH];      // g++ のモジュールマッパー ($root でリポジトリを指す)
+    wchar_t command[32767];
+};
+
+static BOOL run_build(ModulesContext* ctx, BOOL show_errors) {
+    if (ctx->verbose) wprintf(L"Command: %s\n", ctx->command);
+    wchar_t* output = NULL;
+    BOOL built = run_process_and_capture_output(ctx->command, &output);
+    if (!built && output && (show_errors || ctx->verbose)) wprintf(L"%s", output);
+    free(output);
+    return built;
+}
+
+// 一時ファイルにビルドした成果物をリポジトリの名前に置き換える (他の crun が書きかけのものを読まないように)
+static BOOL commit_output(const wchar_t* temp_path, const wchar_t* path) {
+    if (MoveFileExW(temp_path, path, MOVEFILE_REPLACE_EXISTING)) return TRUE;
+    DeleteFileW(temp_path);
+    return FALSE;
+}
+
+// ヘッダーユニットを 1 つビルドする。g++ は CMI の名前をヘッダーのパスから自分で決めるため、
+// 成功したら <name>.hu という印を置き、次からはそれで判断する
+static BOOL build_header_unit(ModulesContext* ctx, const ModuleUnit* unit, wchar_t* compile_flags, size_t compile_flags_size, BOOL* built) {
+    wchar_t path[MAX_PATH], temp_path[MAX_PATH];
+    swprintf_s(path, MAX_PATH, L"%s\\%s.%s", ctx->repository, unit->name, ctx->is_clang ? L"pcm" : L"hu");
+    swprintf_s(temp_path, MAX_PATH, L"%s\\%s.%lu.tmp.pcm", ctx->repository, unit->name, GetCurrentProcessId());
+    if (!file_exists(path)) {
+        if (ctx->verbose) wprintf(L"Modules: building header unit <%s>\n", unit->name);
+        if (ctx->is_clang) {
+            swprintf_s(ctx->command, _countof(ctx->command), L"\"%s\" %s -fmodule-header=system -xc++-system-header %s -o \"%s\"",
+                       ctx->compiler_path, ctx->flags, unit->name, temp_path);
+            if (!run_build(ctx, unit->imported) || !commit_output(temp_path, path)) return FALSE;
+        } else {
+            swprintf_s(ctx->command, _countof(ctx->command), L"\"%s\" %s -fmodules-ts \"-fmodule-mapper=%s\" -fmodule-only -c -x c++-system-header %s",
+                       ctx->compiler_path, ctx->flags, ctx->mapper, unit->name);
+            if (!run_build(ctx, unit->imported) || !write_file_bytes(path, "", 0)) return FALSE;
+        }
+        *built = TRUE;
+    }
+    if (ctx->is_clang) {
+        size_t len = wcslen(compile_flags);
+        swprintf_s(compile_flags + len, compile_flags_size - len, L" \"-fmodule-file=%s\"", path);
+    }
+    return TRUE;
+}
+
+// std / std.compat モジュールをビルドする。BMI の他に、モジュールが定義する関数などのオブジェクトも
+// 作ってプログラムにリンクする
+static BOOL build_std_module(ModulesContext* ctx, const IncludeSearchPath* search, const ModuleUnit* unit, wchar_t* compile_flags, size_t compile_flags_size,
+                             wchar_t* libraries, size_t libraries_size, BOOL* built) {
+    wchar_t source[MAX_PATH], object_path[MAX_PATH], temp_object[MAX_PATH], pcm_path[MAX_PATH], temp_pcm[MAX_PATH];
+    if (!find_module_source(search, ctx->compiler_path, ctx->is_clang, unit->name, source, MAX_PATH)) {
+        fwprintf_err(L"Error: 'import %s;' needs the standard library module source (%s), which this toolchain does not have.\n",
+                     unit->name, ctx->is_clang ? L"share\\libc++\\v1\\std.cppm of libc++" : L"bits\\std.cc of GCC 15 or later");
+        return FALSE;
+    }
+    swprintf_s(object_path, MAX_PATH, L"%s\\%s.o", ctx->repository, unit->name);
+    swprintf_s(temp_object, MAX_PATH, L"%s\\%s.%lu.tmp.o", ctx->repository, unit->name, GetCurrentProcessId());
+    swprintf_s(pcm_path, MAX_PATH, L"%s\\%s.pcm", ctx->repository, unit->name);
+    swprintf_s(temp_pcm, MAX_PATH, L"%s\\%s.%lu.tmp.pcm", ctx->repository, unit->name, GetCurrentProcessId());
+    // std.compat は std を読み込む (clang++ では std の BMI を明示する)
+    wchar_t depends[MAX_PATH + 32] = L"";
+    if (ctx->is_clang && wcscmp(unit->name, L"std") != 0) swprintf_s(depends, _countof(depends), L" \"-fmodule-file=std=%s\\std.pcm\"", ctx->repository);
+
+    if (!file_exists(object_path)) {
+        if (ctx->verbose) wprintf(L"Modules: building module %s from %s\n", unit->name, source);
+        BOOL ok;
+        if (ctx->is_clang) {
+            swprintf_s(ctx->command, _countof(ctx->command), L"\"%s\" %s%s -Wno-reserved-module-identifier --precompile \"%s\" -o \"%s\"",
+                       ctx->compiler_path, ctx->flags, depends, source, temp_pcm);
+            ok = run_build(ctx, TRUE) && commit_output(temp_pcm, pcm_path);
+            if (ok) {
+                swprintf_s(ctx->command, _countof(ctx->command), L"\"%s\" %s%s -c \"%s\" -o \"%s\"", ctx->compiler_path, ctx->flags, depends, pcm_path, temp_object);
+                ok = run_build(ctx, TRUE);
+            }
+        } else {
+            swprintf_s(ctx->command, _countof(ctx->command), L"\"%s\" %s -fmodules-ts \"-fmodule-mapper=%s\" -c \"%s\" -o \"%s\"",
+                       ctx->compiler_path, ctx->flags, ctx->mapper, source, temp_object);
+            ok = run_build(ctx, TRUE);
+        }
+        if (!ok || !commit_output(temp_object, object_path)) {
+            fwprintf_err(L"Error: Failed to build the %s module from %s.\n", unit->name, source);
+            return FALSE;
+        }
+        *built = TRUE;
+    }
+    if (ctx->is_clang) {
+        size_t len = wcslen(compile_flags);
+        swprintf_s(compile_flags + len, compile_flags_size - len, L" \"-fmodule-file=%s=%s\"", unit->name, pcm_path);
+    }
+    size_t len = wcslen(libraries);
+    swprintf_s(libraries + len, libraries_size - len, L"\"%s\" ", object_path);
+    return TRUE;
+}
+
+// コンパイラの実行ファイル (更新されたら作り直す) とフラグごとのリポジトリを用意する
+static BOOL open_repository(ModulesContext* ctx) {
+    ULONGLONG key = hash_bytes(ctx->compiler_path, wcslen(ctx->compiler_path) * sizeof(wchar_t), 0);
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (GetFileAttributesExW(ctx->compiler_path, GetFileExInfoStandard, &info)) {
+        key = hash_bytes(&info.ftLastWriteTime, sizeof(FILETIME), key);
+    }
+    key = hash_bytes(ctx->flags, wcslen(ctx->flags) * sizeof(wchar_t), key);
+    if (!cache_entry_path(key, L".modules", ctx->repository, MAX_PATH)) return FALSE;
+    if (!CreateDirectoryW(ctx->repository, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return FALSE;
+    if (ctx->is_clang) return TRUE;
+
+    // g++ はマッパーの $root の下で CMI を探し、CMI のあるヘッダーの #include を import に置き換える
+    swprintf_s(ctx->mapper, MAX_PATH, L"%s\\mapper.txt", ctx->repository);
+    if (file_exists(ctx->mapper)) return TRUE;
+    char line[MAX_PATH * 3 + 16] = "$root ";
+    int len = WideCharToMultiByte(CP_ACP, 0, ctx->repository, -1, line + 6, (int)sizeof(line) - 8, NULL, NULL);
+    if (len == 0) return FALSE;
+    size_t size = strlen(line);
+    line[size++] = '\n';
+    return write_file_bytes(ctx->mapper, line, size);
+}
+
+// 使う標準ヘッダーとモジュールを調べ、キャッシュに無いものをビルドし、コンパイルとリンクに加える。
+// 失敗したヘッダーユニットは使わない (通常どおりインクルードする)。import で書かれたものの失敗はエラー
+BOOL modules_prepare(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL quick, ModulesBuild* build) {
+    memset(build, 0, sizeof(ModulesBuild));
+    build->opts = *opts;
+    ModulesContext* ctx = (ModulesContext*)calloc(1, sizeof(ModulesContext));
+    UnitList* units = (UnitList*)calloc(1, sizeof(UnitList));
+    wchar_t* flags = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    build->compile_flags = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    build->libraries = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    BOOL success = FALSE;
+    IncludeSearchPath search = {0};
+    if (!ctx || !units || !flags || !build->compile_flags || !build->libraries) goto done;
+    ctx->compiler_path = compiler_path;
+    ctx->is_clang = wcscmp(opts->compiler_name, L"clang") == 0;
+    ctx->verbose = opts->verbose;
+    build->compile_flags[0] = L'\0';
+    build->libraries[0] = L'\0';
+
+    include_search_path_init(&search, opts->compiler_flags, compiler_path);
+    for (int i = 0; i < opts->num_source_files; ++i) scan_imports(opts->source_files[i], units);
+    if (!ctx->is_clang) scan_includes(opts, &search, units);
+
+    // BMI はプログラムのコンパイルと同じフラグでビルドしないと読み込めない
+    {
+        build_object_flags(opts, quick, flags, 32767);
+        const wchar_t* user_flags = opts->compiler_flags ? opts->compiler_flags : L"";
+        BOOL uses_std = FALSE;
+        for (int i = 0; i < units->count; ++i) uses_std |= units->items[i].is_module;
+        size_t len = wcslen(flags);
+        swprintf_s(flags + len, 32767 - len, L" %s", user_flags);
+        if (!wcsstr(user_flags, L"-std=")) {
+            const wchar_t* std_flag = uses_std ? MODULES_STD_MODULE_FLAG : MODULES_STD_FLAG;
+            len = wcslen(flags);
+            swprintf_s(flags + len, 32767 - len, L" %s", std_flag);
+            swprintf_s(build->compile_flags, 32767, L" %s", std_flag);
+        }
+    }
+    ctx->flags = flags;
+    if (!open_repository(ctx)) {
+        fwprintf_err(L"Error: Could not create the module cache directory.\n");
+        goto done;
+    }
+    if (!ctx->is_clang) {
+        size_t len = wcslen(build->compile_flags);
+        swprintf_s(build->compile_flags + len, 32767 - len, L" -fmodules-ts \"-fmodule-mapper=%s\"", ctx->mapper);
+    }
+
+    {
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+        BOOL failed = FALSE;
+        for (int i = 0; i < units->count && !failed; ++i) {
+            const ModuleUnit* unit = &units->items[i];
+            BOOL built = FALSE;
+            BOOL ok = unit->is_module ? build_std_module(ctx, &search, unit, build->compile_flags, 32767, build->libraries, 32767, &built)
+                                      : build_header_unit(ctx, unit, build->compile_flags, 32767, &built);
+            if (ok) {
+                build->num_units++;
+                if (built) build->num_built++;
+            } else if (unit->imported) {
+                if (!unit->is_module) fwprintf_err(L"Error: Failed to build the header unit <%s>.\n", unit->name);
+                failed = TRUE;
+            } else {
+                fwprintf_err(L"Warning: Could not build the header unit <%s>; it is included as usual.\n", unit->name);
+                build->num_failed++;
+            }
+        }
+        QueryPerformanceCounter(&end);
+        build->build_ms = (double)(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+        if (failed) goto done;
+    }
+
+    if (build->libraries[0]) {
+        size_t len = wcslen(build->libraries);
+        swprintf_s(build->libraries + len, 32767 - len, L"%s", opts->user_libraries ? opts->user_libraries : L"");
+        build->opts.user_libraries = build->libraries;
+    }
+    if (opts->verbose) wprintf(L"Modules: %s (%d header units and modules)\n", ctx->repository, build->num_units);
+    success = TRUE;
+
+done:
+    include_search_path_free(&search);
+    free(ctx);
+    free(units);
+    free(flags);
+    if (!success) modules_free_build(build);
+    return success;
+}
+
+void modules_free_build(ModulesBuild* build) {
+    free(build->compile_flags);
+    free(build->libraries);
+    memset(build, 0, sizeof(ModulesBuild));
+}
+
+// --- コンパイル時間の比較 ---
+// --modules を一度使ったソースは、--modules なしのコンパイル時間も記録しておき (<key>.ctime)、
+// --modules のときにそれと比べて表示する。build が NULL なら --modules なしのビルド
+void modules_record_compile_time(const ProgramOptions* opts, const wchar_t* compiler_path, const wchar_t* main_source_full_path, const ModulesBuild* build, double compile_ms) {
+    ULONGLONG key = hash_bytes(compiler_path, wcslen(compiler_path) * sizeof(wchar_t), 0);
+    key = hash_bytes(main_source_full_path, wcslen(main_source_full_path) * sizeof(wchar_t), key);
+    key = hash_bytes(opts->compiler_flags ? opts->compiler_flags : L"", (opts->compiler_flags ? wcslen(opts->compiler_flags) : 0) * sizeof(wchar_t), key);
+    wchar_t path[MAX_PATH], temp_path[MAX_PATH];
+    if (!cache_entry_path(key, L".ctime", path, MAX_PATH) || !cache_temp_path(key, L".ctime", temp_path, MAX_PATH)) return;
+
+    if (!build) {
+        if (!file_exists(path)) return;
+        char text[32];
+        int len = snprintf(text, sizeof(text), "%.1f\n", compile_ms);
+        if (len > 0 && write_file_bytes(temp_path, text, (size_t)len)) commit_output(temp_path, path);
+        return;
+    }
+
+    double plain_ms = 0.0;
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (read_file_bytes(path, &data, &size)) {
+        plain_ms = atof((const char*)data);
+        free(data);
+    } else if (write_file_bytes(temp_path, "0\n", 2)) {
+        commit_output(temp_path, path);
+    }
+
+    wchar_t built[96] = L"";
+    if (build->num_built > 0) swprintf_s(built, _countof(built), L", %d built now in %.2f s", build->num_built, build->build_ms / 1000.0);
+    if (build->num_failed > 0) {
+        size_t len = wcslen(built);
+        swprintf_s(built + len, _countof(built) - len, L", %d failed", build->num_failed);
+    }
+    wprintf(L"Modules: %d header units and modules%s; compile %.2f s", build->num_units, built, compile_ms / 1000.0);
+    if (plain_ms > 0.0) {
+        wprintf(L" vs %.2f s without --modules (%.1fx).\n", plain_ms / 1000.0, plain_ms / compile_ms);
+    } else {
+        wprintf(L" (build once without --modules to compare).\n");
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- 標準ライブラリのモジュールとヘッダーユニット (--modules) ---
+// ソースが使う標準ヘッダーをヘッダーユニットに、import std; / import std.compat; があれば std モジュールに、
+// コンパイラとフラグの組ごとに一度だけビルドしてキャッシュ (<key>.modules ディレクトリ) に置き、以後の
+// コンパイルではそれを読み込む。g++ は CMI のあるヘッダーの #include を自分で import に置き換える
+// (ソースは書き換えない)。clang++ は #include を置き換えないため、import で書いたものだけが対象になる
+#define MODULES_MAX_UNITS 64
+#define MODULES_STD_FLAG L"-std=c++20"            // --cflags に -std= が無いときに付ける言語の版
+#define MODULES_STD_MODULE_FLAG L"-std=c++23"     // 同じく import std; を使うとき
+
+// モジュールを使うビルドの設定
+struct ModulesBuild {
+    ProgramOptions opts;     // user_libraries に std モジュールのオブジェクトを加えたもの
+    wchar_t* libraries;
+    wchar_t* compile_flags;  // コンパイル時だけに付けるフラグ (先頭は空白。-fmodules-ts や -fmodule-file=...)
+    int num_units;           // 読み込むヘッダーユニットとモジュールの数
+    int num_built;           // そのうち今回ビルドした数
+    int num_failed;          // ビルドに失敗して使わない (ヘッダーは通常どおりインクルードする) 数
+    double build_ms;         // 今回のビルドにかかった時間
+};
+
+// --- 関数宣言 ---
+BOOL modules_prepare(const ProgramOptions* opts, const wchar_t* compiler_path, BOOL quick, ModulesBuild* build);
+void modules_free_build(ModulesBuild* build);
+void modules_record_compile_time(const ProgramOptions* opts, const wchar_t* compiler_path, const wchar_t* main_source_full_path, const ModulesBuild* build, double compile_ms);
@@ -1,9 +1,13 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "options.h"
 #include "utils.h"
+#include "allocator.h"
+#include "sweep.h"
+#include "history.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wctype.h>
 
 // --- ヘルプとバージョン ---
 void print_help() {
@@ -11,6 +15,8 @@ void print_help() {
         L"crun - C/C++を手軽に実行するツール\n\n"
         L"使用法:\n"
         L"    crun <source_file> [program_arguments...] [options...]\n"
+        L"    crun <target> [program_arguments...] [options...]   (crun.json のあるディレクトリで)\n"
+        L"    crun --build [<target>]\n"
         L"    crun --clean\n\n"
         L"オプション:\n"
         L"    --help              このヘルプメッセージを表示します。\n"
@@ -20,29 +26,140 @@ void print_help() {
         L"    --libs \"<libs>\"      追加のライブラリとリンクします (例: \"-luser32 -lgdi32\")。\n"
         L"    --keep-temp         実行後に一時ディレクトリを保持します。\n"
         L"    --verbose, -v       詳細な出力を有効にします。\n"
-        L"    --time              実行時間を計測して表示します。\n"
+        L"    --time              実行時間を計測して表示し、履歴に記録して前の版より有意に遅ければ失敗します。\n"
         L"    --debug, -g         デバッグビルドを有効にします (-g)。\n"
         L"    --wall              コンパイラの全ての警告を有効にします (-Wall)。\n"
         L"    --clean             現在いるディレクトリから一時ディレクトリ (crun_tmp_*) を削除します。\n"
+        L"    --profile           フレームポインタ付きでビルドし、サンプリングでホットスポットを表示します。\n"
+        L"    --profile-freq <hz> サンプリング周波数を指定します (1-1000)。デフォルト: 1000。\n"
+        L"    --profile-top <n>   フラットプロファイルに表示する関数の数を指定します。デフォルト: 20。\n"
+        L"    --profile-folded <file>  flamegraph用のfolded stacksをファイルに書き出します。\n"
+        L"    --project <file>    プロジェクトマニフェストを指定します。デフォルト: カレントディレクトリの crun.json。\n"
+        L"    --build             プロジェクトのターゲットをビルドのみ行い、実行しません。\n"
+        L"    --jobs <n>          並列に実行するコンパイラの最大数を指定します。デフォルト: 論理CPU数。\n"
+        L"    -j <n>              --jobs と同じです。make の外ではジョブサーバーも作り、子プロセス (make や crun) と同時実行数を分け合います。\n"
+        L"    --timeout <sec>     実行時間の上限 (秒)。超えると子プロセスごと強制終了します。\n"
+        L"    --cpu-limit <sec>   CPU時間の上限 (秒)。\n"
+        L"    --mem-limit <size>  メモリ使用量の上限 (例: 512M, 2G。単位省略時はMB)。\n"
+        L"    --cpu <list>        プログラムを指定した論理CPUに固定します (例: 3, 2-3, 0,2)。crun 自身は他のCPUで動きます。\n"
+        L"    --priority <class>  プログラムの優先度を指定します ('high' または 'realtime')。\n"
+        L"    --quiet-system      計測用に物理コアを1つ選んでプログラムを固定し、優先度を上げ、省電力による減速を抑えます。\n"
+        L"    --unity[=N]         ソースを最大N個ずつユニティファイルにまとめてコンパイルします。\n"
+        L"    --unity-exclude <pattern>  ユニティビルドから除外するファイル (ワイルドカード可、複数指定可)。\n"
+        L"    --tiered            -O0 でビルドしてすぐ実行し、最適化版はバックグラウンドでビルドして次回から使います。\n"
+        L"    --compile-report    コンパイル時間の内訳 (重いヘッダー・テンプレート、翻訳単位ごとの時間) を表示します。\n"
+        L"    --minimal-link      オブジェクトの未定義シンボルを調べ、必要なライブラリだけをリンクします。\n"
+        L"    --compare <list>    gcc,clang[,<compiler>:<flags>...] を並列にビルドし、交互に繰り返し実行して比較します。\n"
+        L"    --repeat <n>        --compare・--autotune・--sweep で各候補を実行する回数を指定します。デフォルト: 10。\n"
+        L"                        --time と一緒に指定すると、通常の実行の後に出力を捨てて n 回計測します。\n"
+        L"    --autotune          最適化フラグの組み合わせを計測して探索し、最も速いものをこのソース用に保存します。\n"
+        L"    --autotune-space <spec>  探索するフラグ空間 (例: \"-O2|-O3;|-march=native;|-flto\")。\n"
+        L"    --alloc-stats       malloc/free を計測するシムをリンクし、終了後に回数・サイズ分布・ピーク・呼び出し元を表示します。\n"
+        L"    --malloc=<name>     プログラムのアロケータを指定します (system, mimalloc, jemalloc, tcmalloc)。デフォルト: system。\n"
+        L"    --size-report       実行ファイルのサイズの内訳 (セクション、ライブラリ、大きいシンボル、前回との差分) を表示します。\n"
+        L"    --sweep <spec>      入力サイズを掃引して計測し、計算量を推定します (例: \"N=1000..10000000:x10\"、値は引数の {N} か標準入力へ)。\n"
+        L"    --sweep-output <file>  --sweep の結果を書き出します (.json なら JSON、それ以外は CSV)。\n"
+        L"    --history <file>    ソースの --time の履歴 (版ごとの中央値と変化) を表示します。\n"
+        L"    --accept-baseline   --time の結果が前の版より遅くても採用し、次からの比較の基準にします。\n"
+        L"    --modules           標準ヘッダーをヘッダーユニットに、import std; を std モジュールにしてキャッシュし、C++ のコンパイルに使います。\n"
+        L"    --hot               DLL としてビルドし、常駐するホストプロセスで実行します (プロセスの起動を省きます)。\n"
+        L"    --phase-times <file>  crun 自身の各処理の時間をTSVでファイルに追記します (ベンチマーク用)。\n"
     );
 }
 
+// 秒数 (小数可) をミリ秒に変換する
+static BOOL parse_seconds(const wchar_t* text, DWORD* ms) {
+    wchar_t* end = NULL;
+    double seconds = wcstod(text, &end);
+    if (end == text || *end != L'\0' || seconds <= 0 || seconds > 4000000.0) return FALSE;
+    *ms = (DWORD)(seconds * 1000.0 + 0.5);
+    if (*ms == 0) *ms = 1;
+    return TRUE;
+}
+
+// K/M/G の単位付きサイズをバイト数に変換する (単位省略時はMB)
+static BOOL parse_size(const wchar_t* text, ULONGLONG* bytes) {
+    wchar_t* end = NULL;
+    double value = wcstod(text, &end);
+    if (end == text || value <= 0) return FALSE;
+    double unit = 1024.0 * 1024.0;
+    switch (*end) {
+        case L'\0': break;
+        case L'K': case L'k': unit = 1024.0; end++; break;
+        case L'M': case L'm': end++; break;
+        case L'G': case L'g': unit = 1024.0 * 1024.0 * 1024.0; end++; break;
+        default: return FALSE;
+    }
+    if (*end == L'B' || *end == L'b') end++;
+    if (*end != L'\0') return FALSE;
+    *bytes = (ULONGLONG)(value * unit);
+    return *bytes > 0;
+}
+
+// "0,2-3" 形式の論理CPUのリストをマスクに変換する (0 から 63 まで)
+static BOOL parse_cpu_list(const wchar_t* text, ULONGLONG* mask) {
+    *mask = 0;
+    const wchar_t* p = text;
+    while (*p) {
+        wchar_t* end = NULL;
+        long first = wcstol(p, &end, 10), last = first;
+        if (end == p) return FALSE;
+        p = end;
+        if (*p == L'-') {
+            last = wcstol(p + 1, &end, 10);
+            if (end == p + 1) return FALSE;
+            p = end;
+        }
+        if (first < 0 || last < first || last > 63) return FALSE;
+        for (long cpu = first; cpu <= last; ++cpu) *mask |= 1ULL << cpu;
+        if (*p == L',') p++;
+        else if (*p != L'\0') return FALSE;
+    }
+    return *mask != 0;
+}
+
 // --- 引数解析 ---
 BOOL parse_arguments(int argc, wchar_t** argv, ProgramOptions* opts) {
     memset(opts, 0, sizeof(ProgramOptions));
     opts->compiler_name = L"gcc"; // Default compiler
+    opts->profile_freq = 1000;
+    opts->profile_top = 20;
+    opts->repeat = 10;
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    opts->jobs = (int)system_info.dwNumberOfProcessors;
     opts->source_files = (wchar_t**)malloc(sizeof(wchar_t*) * argc);
     opts->program_args = (wchar_t**)malloc(sizeof(wchar_t*) * argc);
-    if (!opts->source_files || !opts->program_args) {
+    opts->unity_excludes = (wchar_t**)malloc(sizeof(wchar_t*) * argc);
+    if (!opts->source_files || !opts->program_args || !opts->unity_excludes) {
         fwprintf_err(L"エラー: 引数のためのメモリ確保に失敗しました。\n");
-        if (opts->source_files) free(opts->source_files);
-        if (opts->program_args) free(opts->program_args);
+        free_options(opts);
+        memset(opts, 0, sizeof(ProgramOptions));
         return FALSE;
     }
 
     BOOL cflags_next = FALSE;
     BOOL libs_next = FALSE;
     BOOL compiler_next = FALSE;
+    BOOL profile_freq_next = FALSE;
+    BOOL profile_top_next = FALSE;
+    BOOL profile_folded_next = FALSE;
+    BOOL project_next = FALSE;
+    BOOL jobs_next = FALSE;
+    BOOL timeout_next = FALSE;
+    BOOL cpu_limit_next = FALSE;
+    BOOL mem_limit_next = FALSE;
+    BOOL cpu_next = FALSE;
+    BOOL priority_next = FALSE;
+    BOOL unity_exclude_next = FALSE;
+    BOOL phase_times_next = FALSE;
+    BOOL compare_next = FALSE;
+    BOOL repeat_next = FALSE;
+    BOOL autotune_space_next = FALSE;
+    BOOL sweep_next = FALSE;
+    BOOL sweep_output_next = FALSE;
+    BOOL history_next = FALSE;
+    BOOL repeat_given = FALSE;
     BOOL sources_ended = FALSE; // Flag to indicate that the list of source files has ended
 
     for (int i = 1; i < argc; ++i) {
@@ -60,6 +177,107 @@ BOOL parse_arguments(int argc, wchar_t** argv, ProgramOptions* opts) {
             compiler_next = FALSE;
             continue;
         }
+        if (profile_freq_next) {
+            opts->profile_freq = _wtoi(arg);
+            if (opts->profile_freq < 1 || opts->profile_freq > 1000) {
+                fwprintf_err(L"エラー: --profile-freq には 1 から 1000 の値を指定してください。\n");
+                return FALSE;
+            }
+            profile_freq_next = FALSE;
+            continue;
+        }
+        if (profile_top_next) {
+            opts->profile_top = _wtoi(arg);
+            if (opts->profile_top < 1) {
+                fwprintf_err(L"エラー: --profile-top には 1 以上の値を指定してください。\n");
+                return FALSE;
+            }
+            profile_top_next = FALSE;
+            continue;
+        }
+        if (profile_folded_next) { opts->profile_folded = arg; profile_folded_next = FALSE; continue; }
+        if (project_next) { opts->project_file = arg; project_next = FALSE; continue; }
+        if (jobs_next) {
+            opts->jobs = _wtoi(arg);
+            if (opts->jobs < 1) {
+                fwprintf_err(L"エラー: --jobs には 1 以上の値を指定してください。\n");
+                return FALSE;
+            }
+            jobs_next = FALSE;
+            continue;
+        }
+        if (timeout_next) {
+            if (!parse_seconds(arg, &opts->limits.timeout_ms)) {
+                fwprintf_err(L"エラー: --timeout には正の秒数を指定してください。\n");
+                return FALSE;
+            }
+            timeout_next = FALSE;
+            continue;
+        }
+        if (cpu_limit_next) {
+            if (!parse_seconds(arg, &opts->limits.cpu_limit_ms)) {
+                fwprintf_err(L"エラー: --cpu-limit には正の秒数を指定してください。\n");
+                return FALSE;
+            }
+            cpu_limit_next = FALSE;
+            continue;
+        }
+        if (mem_limit_next) {
+            if (!parse_size(arg, &opts->limits.memory_limit)) {
+                fwprintf_err(L"エラー: --mem-limit には 512M や 2G のようなサイズを指定してください。\n");
+                return FALSE;
+            }
+            mem_limit_next = FALSE;
+            continue;
+        }
+        if (cpu_next) {
+            if (!parse_cpu_list(arg, &opts->placement.cpu_mask)) {
+                fwprintf_err(L"エラー: --cpu には 0 から 63 の論理CPUのリストを指定してください (例: 3, 2-3, 0,2)。\n");
+                return FALSE;
+            }
+            cpu_next = FALSE;
+            continue;
+        }
+        if (priority_next) {
+            if (wcscmp(arg, L"high") == 0) {
+                opts->placement.priority = PROCESS_PRIORITY_HIGH;
+            } else if (wcscmp(arg, L"realtime") == 0) {
+                opts->placement.priority = PROCESS_PRIORITY_REALTIME;
+            } else {
+                fwprintf_err(L"エラー: --priority には 'high' または 'realtime' を指定してください。\n");
+                return FALSE;
+            }
+            priority_next = FALSE;
+            continue;
+        }
+        if (compare_next) { opts->compare_spec = arg; compare_next = FALSE; continue; }
+        if (repeat_next) {
+            opts->repeat = _wtoi(arg);
+            if (opts->repeat < 1) {
+                fwprintf_err(L"エラー: --repeat には 1 以上の値を指定してください。\n");
+                return FALSE;
+            }
+            repeat_next = FALSE;
+            repeat_given = TRUE;
+            continue;
+        }
+        if (autotune_space_next) { opts->autotune_space = arg; autotune_space_next = FALSE; continue; }
+        if (sweep_next) {
+            wchar_t name[64];
+            double values[SWEEP_MAX_POINTS];
+            int count;
+            if (!sweep_parse_spec(arg, name, _countof(name), values, &count)) {
+                fwprintf_err(L"エラー: --sweep の指定 '%s' が不正です (例: \"N=1000..10000000:x10\", \"N=100..1000:+100\"、%d 点まで)。\n", arg, SWEEP_MAX_POINTS);
+                return FALSE;
+            }
+            opts->sweep_spec = arg;
+            sweep_next = FALSE;
+            continue;
+        }
+        if (sweep_output_next) { opts->sweep_output = arg; sweep_output_next = FALSE; continue; }
+        if (history_next) { opts->history_source = arg; history_next = FALSE; continue; }
+        if (phase_times_next) { opts->phase_times_file = arg; phase_times_next = FALSE; continue; }
+        if (unity_exclude_next) { opts->unity_excludes[opts->num_unity_excludes++] = arg; unity_exclude_next = FALSE; continue; }
 
         if (wcscmp(arg, L"--help") == 0) { print_help(); return FALSE; } // ヘルプのための特別ケース
         if (wcscmp(arg, L"--version") == 0) { /* mainで処理 */ continue; }
@@ -72,6 +290,65 @@ BOOL parse_arguments(int argc, wchar_t** argv, ProgramOptions* opts) {
         if (wcscmp(arg, L"--cflags") == 0) { cflags_next = TRUE; continue; }
         if (wcscmp(arg, L"--libs") == 0) { libs_next = TRUE; continue; }
         if (wcscmp(arg, L"--compiler") == 0) { compiler_next = TRUE; continue; }
+        if (wcscmp(arg, L"--profile") == 0) { opts->profile = TRUE; continue; }
+        if (wcscmp(arg, L"--profile-freq") == 0) { opts->profile = TRUE; profile_freq_next = TRUE; continue; }
+        if (wcscmp(arg, L"--profile-top") == 0) { opts->profile = TRUE; profile_top_next = TRUE; continue; }
+        if (wcscmp(arg, L"--profile-folded") == 0) { opts->profile = TRUE; profile_folded_next = TRUE; continue; }
+        if (wcscmp(arg, L"--project") == 0) { project_next = TRUE; continue; }
+        if (wcscmp(arg, L"--build") == 0) { opts->project_build_only = TRUE; continue; }
+        if (wcscmp(arg, L"--jobs") == 0) { jobs_next = TRUE; continue; }
+        // -j は短いオプションなのでプログラムの引数と区別できない。プログラムの引数が始まった後はそちらに渡す
+        if (!sources_ended && wcscmp(arg, L"-j") == 0) { opts->jobserver = TRUE; jobs_next = TRUE; continue; }
+        if (!sources_ended && wcsncmp(arg, L"-j", 2) == 0 && iswdigit(arg[2])) {
+            opts->jobserver = TRUE;
+            opts->jobs = _wtoi(arg + 2);
+            if (opts->jobs < 1) {
+                fwprintf_err(L"エラー: --jobs には 1 以上の値を指定してください。\n");
+                return FALSE;
+            }
+            continue;
+        }
+        if (wcscmp(arg, L"--timeout") == 0) { timeout_next = TRUE; continue; }
+        if (wcscmp(arg, L"--cpu-limit") == 0) { cpu_limit_next = TRUE; continue; }
+        if (wcscmp(arg, L"--mem-limit") == 0) { mem_limit_next = TRUE; continue; }
+        if (wcscmp(arg, L"--cpu") == 0) { cpu_next = TRUE; continue; }
+        if (wcscmp(arg, L"--priority") == 0) { priority_next = TRUE; continue; }
+        if (wcscmp(arg, L"--quiet-system") == 0) { opts->quiet_system = TRUE; continue; }
+        if (wcscmp(arg, L"--unity") == 0) { opts->unity = TRUE; continue; }
+        if (wcsncmp(arg, L"--unity=", 8) == 0) {
+            opts->unity = TRUE;
+            opts->unity_group_size = _wtoi(arg + 8);
+            if (opts->unity_group_size < 2) {
+                fwprintf_err(L"エラー: --unity=N には 2 以上の値を指定してください。\n");
+                return FALSE;
+            }
+            continue;
+        }
+        if (wcscmp(arg, L"--unity-exclude") == 0) { unity_exclude_next = TRUE; continue; }
+        if (wcscmp(arg, L"--tiered") == 0) { opts->tiered = TRUE; continue; }
+        if (wcscmp(arg, L"--compile-report") == 0) { opts->compile_report = TRUE; continue; }
+        if (wcscmp(arg, L"--minimal-link") == 0) { opts->minimal_link = TRUE; continue; }
+        if (wcscmp(arg, L"--compare") == 0) { compare_next = TRUE; continue; }
+        if (wcscmp(arg, L"--repeat") == 0) { repeat_next = TRUE; continue; }
+        if (wcscmp(arg, L"--autotune") == 0) { opts->autotune = TRUE; continue; }
+        if (wcscmp(arg, L"--autotune-space") == 0) { opts->autotune = TRUE; autotune_space_next = TRUE; continue; }
+        if (wcscmp(arg, L"--alloc-stats") == 0) { opts->alloc_stats = TRUE; continue; }
+        if (wcsncmp(arg, L"--malloc=", 9) == 0) {
+            if (!allocator_is_known(arg + 9)) {
+                fwprintf_err(L"エラー: --malloc には system, mimalloc, jemalloc, tcmalloc のいずれかを指定してください。\n");
+                return FALSE;
+            }
+            opts->malloc_name = (wcscmp(arg + 9, L"system") == 0) ? NULL : arg + 9;
+            continue;
+        }
+        if (wcscmp(arg, L"--size-report") == 0) { opts->size_report = TRUE; continue; }
+        if (wcscmp(arg, L"--sweep") == 0) { sweep_next = TRUE; continue; }
+        if (wcscmp(arg, L"--sweep-output") == 0) { sweep_output_next = TRUE; continue; }
+        if (wcscmp(arg, L"--history") == 0) { history_next = TRUE; continue; }
+        if (wcscmp(arg, L"--accept-baseline") == 0) { opts->accept_baseline = TRUE; continue; }
+        if (wcscmp(arg, L"--modules") == 0) { opts->modules = TRUE; continue; }
+        if (wcscmp(arg, L"--hot") == 0) { opts->hot = TRUE; continue; }
+        if (wcscmp(arg, L"--phase-times") == 0) { phase_times_next = TRUE; continue; }
 
         if (wcsncmp(arg, L"--", 2) == 0) {
             fwprintf_err(L"エラー: 不明なオプション '%s' です。\n", arg);
@@ -87,15 +364,66 @@ BOOL parse_arguments(int argc, wchar_t** argv, ProgramOptions* opts) {
         }
     }
 
-    if (cflags_next || libs_next || compiler_next) { 
+    if (cflags_next || libs_next || compiler_next || profile_freq_next || profile_top_next || profile_folded_next || project_next || jobs_next ||
+        timeout_next || cpu_limit_next || mem_limit_next || cpu_next || priority_next || unity_exclude_next || phase_times_next ||
+        compare_next || repeat_next || autotune_space_next || sweep_next || sweep_output_next || history_next) { 
         fwprintf_err(L"エラー: オプションには引数が必要です。\n"); 
         return FALSE; 
     }
+    opts->time_repeat = (opts->measure_time && repeat_given) ? opts->repeat : 1;
+    if (opts->history_source) return TRUE; // 履歴の表示だけ (ソースはコンパイルしない)
+    if (opts->sweep_spec && (opts->compare_spec || opts->autotune)) {
+        fwprintf_err(L"エラー: --sweep は --compare や --autotune と同時に使えません。\n");
+        return FALSE;
+    }
+    if (opts->sweep_output && !opts->sweep_spec) {
+        fwprintf_err(L"エラー: --sweep-output は --sweep と一緒に指定してください。\n");
+        return FALSE;
+    }
+    // ホストの中では資源制限・CPU の固定・プロファイラ・繰り返し計測を子プロセスごとに適用できない
+    if (opts->hot && (opts->profile || opts->alloc_stats || opts->time_repeat > 1 || opts->quiet_system ||
+                      opts->limits.timeout_ms || opts->limits.cpu_limit_ms || opts->limits.memory_limit ||
+                      opts->placement.cpu_mask || opts->placement.priority != PROCESS_PRIORITY_NORMAL)) {
+        fwprintf_err(L"エラー: --hot は --profile・--alloc-stats・--repeat (--time)・資源制限・--cpu・--priority・--quiet-system と同時に使えません。\n");
+        return FALSE;
+    }
+    if (opts->malloc_name && opts->alloc_stats) {
+        fwprintf_err(L"エラー: --malloc と --alloc-stats は同時に使えません (どちらも malloc を差し替えるため)。\n");
+        return FALSE;
+    }
+    // ソースファイルが無く、マニフェストがある場合はプロジェクトモード (最初の引数がターゲット名)
+    if (opts->num_source_files == 0 && !opts->project_file && file_exists(L"crun.json")) {
+        opts->project_file = L"crun.json";
+    }
+    if (opts->num_source_files == 0 && opts->project_file) {
+        if (opts->hot) {
+            fwprintf_err(L"エラー: --hot はプロジェクトのターゲットには使えません。\n");
+            return FALSE;
+        }
+        if (opts->num_program_args > 0) {
+            opts->project_target = opts->program_args[0];
+            memmove(opts->program_args, opts->program_args + 1, sizeof(wchar_t*) * (opts->num_program_args - 1));
+            opts->num_program_args--;
+        } else if (!opts->project_build_only) {
+            fwprintf_err(L"エラー: 実行するターゲットを指定してください (全ターゲットをビルドするには --build)。\n");
+            return FALSE;
+        }
+        return TRUE;
+    }
     if (opts->num_source_files == 0) { 
         fwprintf_err(L"エラー: ソースファイルが指定されていません。\n"); 
         print_help();
         return FALSE; 
     }
+    // モジュールのフラグ (-std=c++20 など) は全ての翻訳単位に付くため、C のソースとは混ぜられない
+    if (opts->modules) {
+        for (int i = 0; i < opts->num_source_files; ++i) {
+            if (wcscmp(get_extension(opts->source_files[i]), L".cpp") != 0) {
+                fwprintf_err(L"エラー: --modules は C++ のソースだけのときに使えます: %s\n", opts->source_files[i]);
+                return FALSE;
+            }
+        }
+    }
 
     return TRUE;
 }
@@ -104,5 +432,6 @@ void free_options(ProgramOptions* opts) {
     if (opts) {
         if (opts->source_files) free(opts->source_files);
         if (opts->program_args) free(opts->program_args);
+        if (opts->unity_excludes) free(opts->unity_excludes);
     }
 }
\ No newline at end of file
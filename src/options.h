@@ -2,6 +2,7 @@
 #pragma once
 
 #include <windows.h>
+#include "process.h"
 
 // --- プログラム設定を保持する構造体 ---
 struct ProgramOptions {
@@ -15,8 +16,43 @@ struct ProgramOptions {
     BOOL keep_temp;            // 一時ディレクトリを保持するか
     BOOL verbose;              // 詳細出力を有効にするか
     BOOL measure_time;         // 実行時間を計測するか
+    int time_repeat;           // --time で計測する回数 (--repeat を指定したときだけ 2 以上)
     BOOL warnings_all;         // 全ての警告を有効にするか
     BOOL debug_build;          // デバッグビルドを有効にするか
+    BOOL profile;              // サンプリングプロファイラを有効にするか
+    int profile_freq;          // サンプリング周波数 (Hz)
+    int profile_top;           // フラットプロファイルに表示する関数の数
+    const wchar_t* profile_folded; // folded stacks の出力先 (NULLなら出力しない)
+    const wchar_t* project_file;   // プロジェクトマニフェスト (crun.json) のパス
+    const wchar_t* project_target; // ビルド/実行するターゲット名 (NULLなら全ターゲット)
+    BOOL project_build_only;       // ビルドのみ行い実行しないか
+    int jobs;                      // 並列に起動するコンパイラプロセスの最大数
+    BOOL jobserver;                // make の外ではジョブサーバーを作り、子プロセスにも渡すか (-j)
+    ProcessLimits limits;          // 実行するプログラムの資源制限 (--timeout, --cpu-limit, --mem-limit)
+    ProcessPlacement placement;    // 実行するプログラムの CPU と優先度 (--cpu, --priority)
+    BOOL quiet_system;             // 計測用の物理コアを1つ選んでプログラムを固定し、crun 自身はそれ以外で動かすか
+    BOOL unity;                    // 複数のソースをユニティファイルにまとめてコンパイルするか
+    int unity_group_size;          // 1つのユニティファイルにまとめる最大数 (0なら無制限)
+    wchar_t** unity_excludes;      // ユニティビルドから除外するファイルのパターン
+    int num_unity_excludes;
+    BOOL tiered;                   // -O0 版をすぐ実行し、最適化版はバックグラウンドでビルドしてキャッシュする
+    BOOL compile_report;           // ヘッダー・テンプレートごとのコンパイル時間の内訳を表示するか
+    BOOL minimal_link;             // オブジェクトの未定義シンボルから必要なライブラリだけをリンクするか
+    const wchar_t* compare_spec;   // 比較するバリアント ("gcc,clang,gcc:-O3" など。NULLなら比較しない)
+    int repeat;                    // --compare・--autotune・--sweep の各候補と --time で実行する回数
+    BOOL autotune;                 // 最適化フラグの組み合わせを探索し、最も速いものを保存するか
+    const wchar_t* autotune_space; // 探索するフラグ空間 (NULLなら既定の空間)
+    const wchar_t* tuned_flags;    // 保存済みの --autotune の結果 (既定の最適化フラグの後に付ける)
+    BOOL alloc_stats;              // 計測用のシムをリンクし、終了後にアロケーションの統計を表示するか
+    const wchar_t* malloc_name;    // プログラムにリンクするアロケータ ("mimalloc" など。NULLなら CRT の malloc)
+    BOOL size_report;              // 生成した実行ファイルのセクション・ライブラリごとのサイズを表示するか
+    const wchar_t* sweep_spec;     // 掃引する入力サイズ ("N=1000..10000000:x10" など。NULLなら掃引しない)
+    const wchar_t* sweep_output;   // --sweep の結果の書き出し先 (.json なら JSON、それ以外は CSV)
+    const wchar_t* history_source; // 計測の履歴を表示するソース (crun --history <file>)
+    BOOL accept_baseline;          // --time の結果が退行でも採用し、次からの基準にするか
+    BOOL modules;                  // 標準ライブラリのヘッダーユニットと std モジュールをキャッシュしてコンパイルに使うか (C++ のみ)
+    BOOL hot;                      // DLL としてビルドし、常駐するホストプロセスで実行するか
+    const wchar_t* phase_times_file; // crun 自身の処理時間をTSVで追記する先 (ベンチマーク用)
 };
 
 // --- 関数宣言 ---
@@ -0,0 +1,193 @@
+#include "pe.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --- リトルエンディアン読み出しヘルパー ---
+static WORD rd16(const unsigned char* p) { return (WORD)(p[0] | (p[1] << 8)); }
+static DWORD rd32(const unsigned char* p) { return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24); }
+static ULONGLONG rd64(const unsigned char* p) { return (ULONGLONG)rd32(p) | ((ULONGLONG)rd32(p + 4) << 32); }
+
+#define COFF_SYMBOL_SIZE 18
+#define PE_SECTION_HEADER_SIZE 40
+#define PE_SCN_CNT_CODE 0x00000020
+
+static int compare_symbols(const void* a, const void* b) {
+    ULONGLONG x = ((const PeSymbol*)a)->address;
+    ULONGLONG y = ((const PeSymbol*)b)->address;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+// PE実行ファイルのCOFFシンボルテーブルからコードシンボルを読み込む
+// (-s でストリップされたバイナリにはシンボルテーブルが無いため失敗する)
+BOOL pe_load_symbols(const wchar_t* path, PeSymbolTable* table) {
+    memset(table, 0, sizeof(PeSymbolTable));
+
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return FALSE;
+
+    BOOL ok = FALSE;
+    do {
+        if (size < 0x40 || data[0] != 'M' || data[1] != 'Z') break;
+        DWORD pe_offset = rd32(data + 0x3C);
+        if ((size_t)pe_offset + 24 > size || memcmp(data + pe_offset, "PE\0\0", 4) != 0) break;
+
+        const unsigned char* file_header = data + pe_offset + 4;
+        WORD num_sections = rd16(file_header + 2);
+        DWORD symtab_offset = rd32(file_header + 8);
+        DWORD num_symbols = rd32(file_header + 12);
+        WORD opt_header_size = rd16(file_header + 16);
+        const unsigned char* opt_header = file_header + 20;
+        const unsigned char* sections = opt_header + opt_header_size;
+        if ((size_t)(sections - data) + (size_t)num_sections * PE_SECTION_HEADER_SIZE > size) break;
+
+        WORD magic = rd16(opt_header);
+        table->image_base = (magic == 0x20b) ? rd64(opt_header + 24) : rd32(opt_header + 28);
+
+        if (symtab_offset == 0 || num_symbols == 0) break; // ストリップ済み
+        size_t strtab_offset = (size_t)symtab_offset + (size_t)num_symbols * COFF_SYMBOL_SIZE;
+        if (strtab_offset + 4 > size) break;
+        const char* strtab = (const char*)(data + strtab_offset);
+        DWORD strtab_size = rd32(data + strtab_offset);
+        if (strtab_offset + strtab_size > size) strtab_size = (DWORD)(size - strtab_offset); // 壊れたファイルでも範囲外を読まない
+
+        table->symbols = (PeSymbol*)malloc(sizeof(PeSymbol) * (num_symbols + 1));
+        if (!table->symbols) break;
+
+        for (DWORD i = 0; i < num_symbols; ++i) {
+            const unsigned char* sym = data + symtab_offset + (size_t)i * COFF_SYMBOL_SIZE;
+            DWORD value = rd32(sym + 8);
+            short section_number = (short)rd16(sym + 12);
+            BYTE storage_class = sym[16];
+            BYTE num_aux = sym[17];
+
+            // 外部シンボル(2)と静的シンボル(3)のうち、コードセクション内のものだけを対象にする
+            if (section_number > 0 && section_number <= num_sections && (storage_class == 2 || storage_class == 3)) {
+                const unsigned char* section = sections + (size_t)(section_number - 1) * PE_SECTION_HEADER_SIZE;
+                if (rd32(section + 36) & PE_SCN_CNT_CODE) {
+                    char short_name[9] = {0};
+                    const char* name;
+                    size_t name_len;
+                    if (rd32(sym) == 0) {
+                        DWORD name_offset = rd32(sym + 4);
+                        name = (name_offset < strtab_size) ? strtab + name_offset : "";
+                        name_len = (name_offset < strtab_size) ? strnlen(name, strtab_size - name_offset) : 0;
+                    } else {
+                        memcpy(short_name, sym, 8);
+                        name = short_name;
+                        name_len = strlen(short_name);
+                    }
+                    // セクションシンボル (.text など) は関数ではないので除外
+                    char* copy = (name_len > 0 && name[0] != '.') ? (char*)malloc(name_len + 1) : NULL;
+                    if (copy) {
+                        memcpy(copy, name, name_len);
+                        copy[name_len] = '\0';
+                        PeSymbol* out = &table->symbols[table->count++];
+                        out->address = table->image_base + rd32(section + 12) + value;
+                        out->size = (ULONGLONG)rd32(section + 12) + rd32(section + 8); // 一時的にセクション終端RVAを保持
+                        out->name = copy;
+                    }
+                }
+            }
+            i += num_aux;
+        }
+
+        qsort(table->symbols, table->count, sizeof(PeSymbol), compare_symbols);
+        for (int i = 0; i < table->count; ++i) {
+            ULONGLONG section_end = table->image_base + table->symbols[i].size;
+            ULONGLONG end = (i + 1 < table->count && table->symbols[i + 1].address < section_end) ? table->symbols[i + 1].address : section_end;
+            table->symbols[i].size = end - table->symbols[i].address;
+        }
+        ok = table->count > 0;
+    } while (0);
+
+    free(data);
+    if (!ok) pe_free_symbols(table);
+    return ok;
+}
+
+// アドレスを含むシンボルを二分探索する (見つからなければNULL)
+const PeSymbol* pe_find_symbol(const PeSymbolTable* table, ULONGLONG address) {
+    int lo = 0, hi = table->count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (table->symbols[mid].address <= address) { found = mid; lo = mid + 1; }
+        else hi = mid - 1;
+    }
+    if (found < 0) return NULL;
+    const PeSymbol* sym = &table->symbols[found];
+    return (address < sym->address + sym->size) ? sym : NULL;
+}
+
+void pe_free_symbols(PeSymbolTable* table) {
+    if (table->symbols) {
+        for (int i = 0; i < table->count; ++i) free(table->symbols[i].name);
+        free(table->symbols);
+    }
+    memset(table, 0, sizeof(PeSymbolTable));
+}
+
+// PE実行ファイルのセクションヘッダを読み込む (--size-report)
+BOOL pe_load_sections(const wchar_t* path, PeSectionTable* table) {
+    memset(table, 0, sizeof(PeSectionTable));
+
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return FALSE;
+
+    BOOL ok = FALSE;
+    do {
+        if (size < 0x40 || data[0] != 'M' || data[1] != 'Z') break;
+        DWORD pe_offset = rd32(data + 0x3C);
+        if ((size_t)pe_offset + 24 > size || memcmp(data + pe_offset, "PE\0\0", 4) != 0) break;
+
+        const unsigned char* file_header = data + pe_offset + 4;
+        WORD num_sections = rd16(file_header + 2);
+        DWORD symtab_offset = rd32(file_header + 8);
+        DWORD num_symbols = rd32(file_header + 12);
+        WORD opt_header_size = rd16(file_header + 16);
+        const unsigned char* opt_header = file_header + 20;
+        const unsigned char* sections = opt_header + opt_header_size;
+        if (opt_header_size < 64 || (size_t)(sections - data) + (size_t)num_sections * PE_SECTION_HEADER_SIZE > size) break;
+
+        table->file_size = size;
+        table->headers_size = rd32(opt_header + 60);
+
+        // 長いセクション名 ("/4" など) はシンボルテーブルの後ろの文字列テーブルを指す
+        const char* strtab = NULL;
+        DWORD strtab_size = 0;
+        size_t strtab_offset = (size_t)symtab_offset + (size_t)num_symbols * COFF_SYMBOL_SIZE;
+        if (symtab_offset != 0 && strtab_offset + 4 <= size) {
+            strtab = (const char*)(data + strtab_offset);
+            strtab_size = rd32(data + strtab_offset);
+            if (strtab_offset + strtab_size > size) strtab_size = (DWORD)(size - strtab_offset);
+            table->symbols_size = (DWORD)(strtab_offset - symtab_offset) + strtab_size;
+        }
+
+        table->sections = (PeSection*)calloc(num_sections + 1, sizeof(PeSection));
+        if (!table->sections) break;
+        for (WORD i = 0; i < num_sections; ++i) {
+            const unsigned char* section = sections + (size_t)i * PE_SECTION_HEADER_SIZE;
+            PeSection* out = &table->sections[table->count++];
+            memcpy(out->name, section, 8);
+            if (out->name[0] == '/' && strtab) {
+                DWORD name_offset = (DWORD)strtoul(out->name + 1, NULL, 10);
+                if (name_offset < strtab_size) strncpy_s(out->name, sizeof(out->name), strtab + name_offset, _TRUNCATE);
+            }
+            out->virtual_size = rd32(section + 8);
+            out->raw_size = rd32(section + 16);
+            out->characteristics = rd32(section + 36);
+        }
+        ok = TRUE;
+    } while (0);
+
+    free(data);
+    if (!ok) pe_free_sections(table);
+    return ok;
+}
+
+void pe_free_sections(PeSectionTable* table) {
+    free(table->sections);
+    memset(table, 0, sizeof(PeSectionTable));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <windows.h>
+
+// --- PEファイルのシンボル ---
+struct PeSymbol {
+    ULONGLONG address; // 優先イメージベースを含む仮想アドレス
+    ULONGLONG size;    // 次のシンボル (またはセクション終端) までのバイト数
+    char* name;        // COFFシンボル名 (UTF-8、C++名はマングルされたまま)
+};
+
+struct PeSymbolTable {
+    PeSymbol* symbols;    // アドレス昇順に並んだコードシンボル
+    int count;
+    ULONGLONG image_base; // オプショナルヘッダの優先イメージベース
+};
+
+// --- PEファイルのセクション ---
+struct PeSection {
+    char name[64];          // セクション名 (長い名前は文字列テーブルから解決する)
+    DWORD virtual_size;     // メモリ上のサイズ
+    DWORD raw_size;         // ファイル上のサイズ (ファイルアラインメント単位に切り上げ)
+    DWORD characteristics;
+};
+
+struct PeSectionTable {
+    PeSection* sections;    // セクションヘッダの順
+    int count;
+    ULONGLONG file_size;
+    DWORD headers_size;     // オプショナルヘッダの SizeOfHeaders
+    DWORD symbols_size;     // COFFシンボルテーブルと文字列テーブルのサイズ (ストリップ済みなら0)
+};
+
+// --- 関数宣言 ---
+BOOL pe_load_symbols(const wchar_t* path, PeSymbolTable* table);
+const PeSymbol* pe_find_symbol(const PeSymbolTable* table, ULONGLONG address);
+void pe_free_symbols(PeSymbolTable* table);
+BOOL pe_load_sections(const wchar_t* path, PeSectionTable* table);
+void pe_free_sections(PeSectionTable* table);
@@ -0,0 +1,374 @@
+#include "process.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 子プロセスに継承させるためのハンドルを開く
+static HANDLE open_inheritable(const wchar_t* path, DWORD access, DWORD creation) {
+    SECURITY_ATTRIBUTES sa_attr = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    return CreateFileW(path, access, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa_attr, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+static BOOL has_limits(const ProcessLimits* limits) {
+    return limits->timeout_ms || limits->cpu_limit_ms || limits->memory_limit;
+}
+
+// 子孫プロセスごと制限をかけるジョブを作る。失敗した場合は制限なしで実行を続ける
+static BOOL create_limited_job(ChildProcess* proc) {
+    proc->job = CreateJobObjectW(NULL, NULL);
+    if (!proc->job) return FALSE;
+
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION info = {};
+    // crun が先に終了してもプロセスツリーを残さない。例外時のエラーダイアログで止まらないようにもする
+    info.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE | JOB_OBJECT_LIMIT_DIE_ON_UNHANDLED_EXCEPTION;
+    if (proc->limits.memory_limit) {
+        info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_JOB_MEMORY;
+        info.JobMemoryLimit = (SIZE_T)proc->limits.memory_limit;
+    }
+    if (proc->limits.cpu_limit_ms) {
+        info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_JOB_TIME;
+        info.BasicLimitInformation.PerJobUserTimeLimit.QuadPart = (LONGLONG)proc->limits.cpu_limit_ms * 10000; // 100ns単位
+    }
+    proc->job_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    JOBOBJECT_ASSOCIATE_COMPLETION_PORT port = { proc->job, proc->job_port };
+    if (!SetInformationJobObject(proc->job, JobObjectExtendedLimitInformation, &info, sizeof(info)) ||
+        !proc->job_port ||
+        !SetInformationJobObject(proc->job, JobObjectAssociateCompletionPortInformation, &port, sizeof(port))) {
+        if (proc->job_port) CloseHandle(proc->job_port);
+        CloseHandle(proc->job);
+        proc->job = NULL;
+        proc->job_port = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL has_placement(const ProcessPlacement* placement) {
+    return placement->cpu_mask || placement->priority != PROCESS_PRIORITY_NORMAL || placement->no_throttling;
+}
+
+// 停止中の子プロセスに CPU と優先度を設定し、実際に適用された値を proc->placement に読み戻す
+static void apply_placement(ChildProcess* proc, const ProcessPlacement* placement) {
+    if (placement->cpu_mask) SetProcessAffinityMask(proc->process, (DWORD_PTR)placement->cpu_mask);
+    if (placement->priority != PROCESS_PRIORITY_NORMAL) {
+        // SeIncreaseBasePriorityPrivilege が無ければ REALTIME は HIGH として扱われる
+        SetPriorityClass(proc->process, placement->priority == PROCESS_PRIORITY_REALTIME ? REALTIME_PRIORITY_CLASS : HIGH_PRIORITY_CLASS);
+    }
+#ifdef PROCESS_POWER_THROTTLING_CURRENT_VERSION
+    if (placement->no_throttling) { // 省電力のための減速 (EcoQoS) を常に無効にする
+        PROCESS_POWER_THROTTLING_STATE state = {};
+        state.Version = PROCESS_POWER_THROTTLING_CURRENT_VERSION;
+        state.ControlMask = PROCESS_POWER_THROTTLING_EXECUTION_SPEED;
+        state.StateMask = 0;
+        SetProcessInformation(proc->process, ProcessPowerThrottling, &state, sizeof(state));
+    }
+#endif
+
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    if (GetProcessAffinityMask(proc->process, &process_mask, &system_mask)) proc->placement.cpu_mask = process_mask;
+    DWORD priority_class = GetPriorityClass(proc->process);
+    proc->placement.priority = (priority_class == REALTIME_PRIORITY_CLASS) ? PROCESS_PRIORITY_REALTIME :
+                               (priority_class == HIGH_PRIORITY_CLASS) ? PROCESS_PRIORITY_HIGH : PROCESS_PRIORITY_NORMAL;
+    proc->placement.no_throttling = placement->no_throttling;
+}
+
+static BOOL spawn_child(wchar_t* command_line, const ProcessSpawnOptions* options, ChildProcess* proc) {
+    static const ProcessSpawnOptions defaults = {}; // PROCESS_OUTPUT_INHERIT
+    if (!options) options = &defaults;
+    memset(proc, 0, sizeof(ChildProcess));
+
+    HANDLE child_output = NULL; // 起動後に親側で閉じるハンドル
+    HANDLE child_input = NULL;
+    STARTUPINFOW si = {};
+    si.cb = sizeof(STARTUPINFOW);
+    si.dwFlags |= STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    switch (options->output) {
+        case PROCESS_OUTPUT_CAPTURE: {
+            SECURITY_ATTRIBUTES sa_attr = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+            if (!CreatePipe(&proc->output_read, &child_output, &sa_attr, 0) || !SetHandleInformation(proc->output_read, HANDLE_FLAG_INHERIT, 0)) {
+                if (proc->output_read) CloseHandle(proc->output_read);
+                if (child_output) CloseHandle(child_output);
+                proc->output_read = NULL;
+                return FALSE;
+            }
+            break;
+        }
+        case PROCESS_OUTPUT_FILE:
+            child_output = open_inheritable(options->output_file, GENERIC_WRITE, CREATE_ALWAYS);
+            if (child_output == INVALID_HANDLE_VALUE) return FALSE;
+            break;
+        case PROCESS_OUTPUT_NULL:
+            child_output = open_inheritable(L"NUL", GENERIC_WRITE, OPEN_EXISTING);
+            if (child_output == INVALID_HANDLE_VALUE) return FALSE;
+            break;
+        default:
+            break;
+    }
+    if (child_output) {
+        si.hStdOutput = child_output;
+        si.hStdError = child_output; // 標準エラー出力も同じ先へ
+    }
+    if (options->input_file || options->null_stdin) {
+        child_input = open_inheritable(options->input_file ? options->input_file : L"NUL", GENERIC_READ, OPEN_EXISTING);
+        if (child_input != INVALID_HANDLE_VALUE) si.hStdInput = child_input;
+        else child_input = NULL;
+    }
+
+    // 常駐させるプロセスには crun の標準入出力を持たせない (パイプの読み手が EOF を待ち続けないように)
+    if (options->detached) si.dwFlags &= ~STARTF_USESTDHANDLES;
+
+    DWORD flags = 0;
+    if (options->hide_window) {
+        si.dwFlags |= STARTF_USESHOWWINDOW;
+        si.wShowWindow = SW_HIDE;
+        flags |= CREATE_NO_WINDOW;
+    }
+    if (options->start_suspended) flags |= CREATE_SUSPENDED;
+    if (options->background) flags |= BELOW_NORMAL_PRIORITY_CLASS | CREATE_NEW_PROCESS_GROUP; // Ctrl+C を受け取らない
+    if (options->detached) flags |= DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP;
+
+    proc->limits = options->limits;
+    // ジョブへの登録が終わるまで子プロセスが孫を作れないよう、停止状態で起動する
+    BOOL use_job = has_limits(&proc->limits) && create_limited_job(proc);
+    if (use_job) flags |= CREATE_SUSPENDED;
+    // CPU と優先度も最初の命令を実行する前に設定する
+    BOOL use_placement = has_placement(&options->placement);
+    if (use_placement) flags |= CREATE_SUSPENDED;
+
+    PROCESS_INFORMATION pi = {};
+    BOOL ok = CreateProcessW(NULL, command_line, NULL, NULL, !options->detached, flags, NULL, NULL, &si, &pi);
+    if (child_output) CloseHandle(child_output); // 書き込み側は子だけが持つ
+    if (child_input) CloseHandle(child_input);
+    if (!ok) {
+        if (proc->output_read) CloseHandle(proc->output_read);
+        if (proc->job_port) CloseHandle(proc->job_port);
+        if (proc->job) CloseHandle(proc->job);
+        memset(proc, 0, sizeof(ChildProcess));
+        return FALSE;
+    }
+    proc->process = pi.hProcess;
+    proc->thread = pi.hThread;
+    proc->running = TRUE;
+    proc->start_ms = GetTickCount64();
+    if (use_job) {
+        if (!AssignProcessToJobObject(proc->job, pi.hProcess)) {
+            // 既に別のジョブに属していて入れ子にできない環境 (Windows 7 以前) では時間制限だけを監視する
+            CloseHandle(proc->job_port);
+            CloseHandle(proc->job);
+            proc->job = NULL;
+            proc->job_port = NULL;
+        }
+    }
+    if (use_placement) apply_placement(proc, &options->placement);
+    if ((use_job || use_placement) && !options->start_suspended) ResumeThread(pi.hThread);
+    return TRUE;
+}
+
+void process_resume(ChildProcess* proc) {
+    if (proc->thread) ResumeThread(proc->thread);
+}
+
+// ジョブの通知を読み出し、メモリやCPU時間の超過があれば記録する
+static void drain_job_messages(ChildProcess* proc) {
+    if (!proc->job_port) return;
+    DWORD message;
+    ULONG_PTR key;
+    LPOVERLAPPED overlapped;
+    while (GetQueuedCompletionStatus(proc->job_port, &message, &key, &overlapped, 0)) {
+        if (proc->verdict != PROCESS_VERDICT_EXITED) continue; // 最初の理由を優先する
+        if (message == JOB_OBJECT_MSG_JOB_MEMORY_LIMIT || message == JOB_OBJECT_MSG_PROCESS_MEMORY_LIMIT) {
+            proc->verdict = PROCESS_VERDICT_MEMORY_LIMIT;
+        } else if (message == JOB_OBJECT_MSG_END_OF_JOB_TIME || message == JOB_OBJECT_MSG_END_OF_PROCESS_TIME) {
+            proc->verdict = PROCESS_VERDICT_CPU_LIMIT;
+        }
+    }
+}
+
+// 制限を超えていればプロセスツリーごと終了させて TRUE を返す。待機ループから定期的に呼ぶ
+BOOL process_check_limits(ChildProcess* proc) {
+    if (!proc->running || !has_limits(&proc->limits)) return FALSE;
+    drain_job_messages(proc);
+    if (proc->verdict == PROCESS_VERDICT_EXITED && proc->limits.timeout_ms &&
+        GetTickCount64() - proc->start_ms >= proc->limits.timeout_ms) {
+        proc->verdict = PROCESS_VERDICT_TIMEOUT;
+    }
+    if (proc->verdict == PROCESS_VERDICT_EXITED) return FALSE;
+    // メモリ超過はジョブが確保を失敗させるだけなので、ここで終了させる
+    process_terminate(proc);
+    WaitForSingleObject(proc->process, INFINITE);
+    return TRUE;
+}
+
+BOOL process_exit_code(ChildProcess* proc, DWORD* exit_code) {
+    if (!GetExitCodeProcess(proc->process, exit_code)) return FALSE;
+    if (*exit_code == STILL_ACTIVE && WaitForSingleObject(proc->process, 0) == WAIT_TIMEOUT) return FALSE;
+    proc->running = FALSE;
+    drain_job_messages(proc); // 確保に失敗して自分で終了した場合もメモリ超過として扱う
+    // NTSTATUS のエラー値 (アクセス違反など) で終わった場合はクラッシュ。Ctrl+C による終了は除く
+    if (proc->verdict == PROCESS_VERDICT_EXITED && *exit_code >= 0xC0000000 && *exit_code != 0xC000013A) {
+        proc->verdict = PROCESS_VERDICT_CRASHED;
+    }
+    return TRUE;
+}
+
+// 終了を待つ。タイムアウトした場合は FALSE を返す。制限付きの場合は待機中に制限を監視する
+BOOL process_wait(ChildProcess* proc, DWORD timeout_ms, DWORD* exit_code) {
+    if (has_limits(&proc->limits)) {
+        ULONGLONG start = GetTickCount64();
+        for (;;) {
+            DWORD slice = 20;
+            if (timeout_ms != INFINITE) {
+                ULONGLONG elapsed = GetTickCount64() - start;
+                if (elapsed >= timeout_ms) return FALSE;
+                if (timeout_ms - elapsed < slice) slice = (DWORD)(timeout_ms - elapsed);
+            }
+            if (WaitForSingleObject(proc->process, slice) == WAIT_OBJECT_0) break;
+            if (process_check_limits(proc)) break;
+        }
+    } else if (WaitForSingleObject(proc->process, timeout_ms) != WAIT_OBJECT_0) {
+        return FALSE;
+    }
+    DWORD code = 0;
+    process_exit_code(proc, &code);
+    if (exit_code) *exit_code = code;
+    return TRUE;
+}
+
+// 複数の子プロセスのうち、最初に終了したもののインデックスを返す (タイムアウト/失敗時は -1)
+int process_wait_any(ChildProcess** procs, int count, DWORD timeout_ms) {
+    HANDLE handles[PROCESS_WAIT_MAX];
+    if (count <= 0 || count > PROCESS_WAIT_MAX) return -1;
+    for (int i = 0; i < count; ++i) handles[i] = procs[i]->process;
+    DWORD result = WaitForMultipleObjects((DWORD)count, handles, FALSE, timeout_ms);
+    if (result - WAIT_OBJECT_0 < (DWORD)count) return (int)(result - WAIT_OBJECT_0);
+    return -1;
+}
+
+// キャプチャした出力を終端まで読み取る (呼び出し側で free する。NUL終端付き)
+BOOL process_read_output(ChildProcess* proc, char** output, size_t* size) {
+    *output = NULL;
+    if (size) *size = 0;
+    if (!proc->output_read) return FALSE;
+
+    char buffer[4096];
+    DWORD bytes_read;
+    size_t total_size = 0;
+    char* data = NULL;
+    while (ReadFile(proc->output_read, buffer, sizeof(buffer), &bytes_read, NULL) && bytes_read != 0) {
+        char* new_data = (char*)realloc(data, total_size + bytes_read + 1);
+        if (!new_data) { free(data); CloseHandle(proc->output_read); proc->output_read = NULL; return FALSE; }
+        data = new_data;
+        memcpy(data + total_size, buffer, bytes_read);
+        total_size += bytes_read;
+    }
+    CloseHandle(proc->output_read);
+    proc->output_read = NULL;
+
+    if (!data) data = (char*)malloc(1);
+    if (!data) return FALSE;
+    data[total_size] = '\0';
+    *output = data;
+    if (size) *size = total_size;
+    return TRUE;
+}
+
+// ジョブに属していれば子孫プロセスもまとめて終了させる
+void process_terminate(ChildProcess* proc) {
+    if (!proc->process || !proc->running) return;
+    if (proc->job) TerminateJobObject(proc->job, 1);
+    else TerminateProcess(proc->process, 1);
+}
+
+void process_close(ChildProcess* proc) {
+    if (proc->output_read) CloseHandle(proc->output_read);
+    if (proc->job_port) CloseHandle(proc->job_port);
+    if (proc->job) CloseHandle(proc->job); // KILL_ON_JOB_CLOSE により残った子孫も終了する
+    if (proc->thread) CloseHandle(proc->thread);
+    if (proc->process) CloseHandle(proc->process);
+    memset(proc, 0, sizeof(ChildProcess));
+}
+
+// --- CPU の選択 ---
+// --quiet-system 用に、CPU 0 (割り込みを受けやすい) を含まない最後の物理コアを選ぶ。
+// cpu_mask はそのコアの論理CPUの1つ、core_mask は SMT の兄弟を含むコア全体
+BOOL process_quiet_cpus(ULONGLONG* cpu_mask, ULONGLONG* core_mask) {
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return FALSE;
+    DWORD size = 0;
+    GetLogicalProcessorInformation(NULL, &size);
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)malloc(size);
+    if (!info || !GetLogicalProcessorInformation(info, &size)) {
+        free(info);
+        return FALSE;
+    }
+    ULONGLONG best = 0;
+    for (DWORD i = 0; i < size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); ++i) {
+        ULONGLONG core = (ULONGLONG)(info[i].ProcessorMask & process_mask);
+        if (info[i].Relationship != RelationProcessorCore || core == 0 || (core & 1)) continue;
+        if (core > best) best = core;
+    }
+    free(info);
+    if (best == 0) return FALSE;
+    *core_mask = best;
+    *cpu_mask = best & (~best + 1); // 最も小さい番号の論理CPU
+    return TRUE;
+}
+
+// crun 自身 (と以後に起動するコンパイラなど) を avoid_mask 以外の CPU に移す
+BOOL process_pin_self(ULONGLONG avoid_mask, ULONGLONG* self_mask) {
+    DWORD_PTR process_mask = 0, system_mask = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return FALSE;
+    ULONGLONG mask = (ULONGLONG)process_mask & ~avoid_mask;
+    if (mask == 0 || !SetProcessAffinityMask(GetCurrentProcess(), (DWORD_PTR)mask)) return FALSE;
+    *self_mask = mask;
+    return TRUE;
+}
+
+// コマンドラインを起動する。完了を待つには process_wait / process_wait_any を使う
+BOOL process_spawn(wchar_t* command_line, const ProcessSpawnOptions* options, ChildProcess* proc) {
+    phase_begin(PHASE_SPAWN);
+    BOOL ok = spawn_child(command_line, options, proc);
+    phase_end();
+    return ok;
+}
+
+// --- 表示 ---
+// CPU のマスクを "0-2,4" の形式にする
+void process_format_cpu_list(ULONGLONG mask, wchar_t* text, size_t text_size) {
+    size_t length = 0;
+    text[0] = L'\0';
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        if (!(mask & (1ULL << cpu))) continue;
+        int last = cpu;
+        while (last + 1 < 64 && (mask & (1ULL << (last + 1)))) last++;
+        int written = (last > cpu) ? swprintf(text + length, text_size - length, L"%s%d-%d", length ? L"," : L"", cpu, last)
+                                   : swprintf(text + length, text_size - length, L"%s%d", length ? L"," : L"", cpu);
+        if (written < 0) break;
+        length += (size_t)written;
+        cpu = last;
+    }
+}
+
+const wchar_t* process_priority_name(ProcessPriority priority) {
+    switch (priority) {
+        case PROCESS_PRIORITY_HIGH: return L"high";
+        case PROCESS_PRIORITY_REALTIME: return L"realtime";
+        default: return L"normal";
+    }
+}
+
+// --- 終了理由の表示名 ---
+const wchar_t* process_verdict_name(ProcessVerdict verdict) {
+    switch (verdict) {
+        case PROCESS_VERDICT_CRASHED: return L"crash";
+        case PROCESS_VERDICT_TIMEOUT: return L"timeout";
+        case PROCESS_VERDICT_CPU_LIMIT: return L"cpu limit";
+        case PROCESS_VERDICT_MEMORY_LIMIT: return L"memory limit";
+        default: return L"exited";
+    }
+}
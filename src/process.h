@@ -0,0 +1,88 @@
+#pragma once
+
+// プロセス起動レイヤー: CreateProcessW による起動・待機と、ジョブオブジェクトによる資源制限
+#include <windows.h>
+
+// process_wait_any で同時に待てる最大数 (WaitForMultipleObjects の上限に合わせる)
+#define PROCESS_WAIT_MAX 64
+
+// --- 子プロセスの標準出力/標準エラー出力の扱い ---
+enum ProcessOutput {
+    PROCESS_OUTPUT_INHERIT, // crun の標準出力/標準エラー出力をそのまま引き継ぐ
+    PROCESS_OUTPUT_CAPTURE, // パイプで受け取る (process_read_output で読む)
+    PROCESS_OUTPUT_FILE,    // output_file に書き出す
+    PROCESS_OUTPUT_NULL     // 破棄する
+};
+
+// --- 実行時の資源制限 (0 は無制限) ---
+// ジョブオブジェクトと監視ループで実施する
+struct ProcessLimits {
+    DWORD timeout_ms;            // 壁時計での制限時間
+    DWORD cpu_limit_ms;          // CPU時間の上限
+    ULONGLONG memory_limit;      // メモリ使用量の上限 (バイト)
+};
+
+// --- 実行する CPU と優先度 (--cpu, --priority, --quiet-system) ---
+// 停止状態で起動して SetProcessAffinityMask と優先度クラスを設定してから再開する
+enum ProcessPriority {
+    PROCESS_PRIORITY_NORMAL,
+    PROCESS_PRIORITY_HIGH,
+    PROCESS_PRIORITY_REALTIME
+};
+
+struct ProcessPlacement {
+    ULONGLONG cpu_mask;          // 固定する論理CPU (ビット i が CPU i。0 なら固定しない。先頭の64個まで)
+    ProcessPriority priority;
+    BOOL no_throttling;          // 省電力のための減速 (Win32 の EcoQoS) を避ける
+};
+
+// --- 子プロセスの終了理由 ---
+enum ProcessVerdict {
+    PROCESS_VERDICT_EXITED,       // 自分で終了した (終了コードは問わない)
+    PROCESS_VERDICT_CRASHED,      // 例外やシグナルで異常終了した
+    PROCESS_VERDICT_TIMEOUT,      // 制限時間を超えたため強制終了した
+    PROCESS_VERDICT_CPU_LIMIT,    // CPU時間の上限を超えた
+    PROCESS_VERDICT_MEMORY_LIMIT  // メモリの上限を超えた
+};
+
+struct ProcessSpawnOptions {
+    ProcessOutput output;
+    const wchar_t* output_file;  // PROCESS_OUTPUT_FILE のときの出力先
+    BOOL null_stdin;             // 標準入力を空にする (繰り返し実行時など)
+    const wchar_t* input_file;   // 標準入力をこのファイルから読む (null_stdin より優先)
+    BOOL hide_window;            // コンソールウィンドウを作らない (コンパイラなど)
+    BOOL start_suspended;        // メインスレッドを停止状態で作成する
+    BOOL background;             // 低い優先度・独立したプロセスグループで起動し、crun の終了後も動かし続ける
+    BOOL detached;               // ハンドルを継承させず、コンソールからも切り離して起動する (常駐させるプロセス)
+    ProcessLimits limits;        // 制限を1つでも指定すると子孫プロセスごと管理する
+    ProcessPlacement placement;  // CPU の固定と優先度 (既定のままなら何もしない)
+};
+
+struct ChildProcess {
+    HANDLE process;
+    HANDLE thread;
+    HANDLE output_read;
+    HANDLE job;                  // 制限付きで起動した場合のジョブオブジェクト
+    HANDLE job_port;             // ジョブの通知 (メモリ超過など) を受け取るポート
+    BOOL running;
+    ProcessLimits limits;
+    ULONGLONG start_ms;
+    ProcessVerdict verdict;      // 制限による強制終了を記録する (終了後は process_exit_code が確定させる)
+    ProcessPlacement placement;  // 実際に適用された CPU と優先度 (配置を指定した場合だけ読み戻す)
+};
+
+// --- 関数宣言 ---
+BOOL process_spawn(wchar_t* command_line, const ProcessSpawnOptions* options, ChildProcess* proc);
+void process_resume(ChildProcess* proc);
+BOOL process_wait(ChildProcess* proc, DWORD timeout_ms, DWORD* exit_code);
+int process_wait_any(ChildProcess** procs, int count, DWORD timeout_ms);
+BOOL process_exit_code(ChildProcess* proc, DWORD* exit_code);
+BOOL process_read_output(ChildProcess* proc, char** output, size_t* size);
+void process_terminate(ChildProcess* proc);
+void process_close(ChildProcess* proc);
+BOOL process_check_limits(ChildProcess* proc);
+const wchar_t* process_verdict_name(ProcessVerdict verdict);
+BOOL process_quiet_cpus(ULONGLONG* cpu_mask, ULONGLONG* core_mask);
+BOOL process_pin_self(ULONGLONG avoid_mask, ULONGLONG* self_mask);
+void process_format_cpu_list(ULONGLONG mask, wchar_t* text, size_t text_size);
+const wchar_t* process_priority_name(ProcessPriority priority);
@@ -0,0 +1,341 @@
+#include "profiler.h"
+#include "pe.h"
+#include "process.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dbghelp.h>  // StackWalk64
+#include <psapi.h>    // EnumProcessModules
+#include <mmsystem.h> // timeBeginPeriod
+
+#define PROFILE_MAX_DEPTH 128
+#define PROFILE_TREE_MIN_PERCENT 1.0 // これ未満のノードはコールツリーに表示しない
+#define PROFILE_TREE_MAX_DEPTH 32
+
+// --- サンプル格納 ---
+// 各サンプルのフレームは葉 (実行中の命令) から根 (スタートアップ側) の順に連結して保持する
+struct SampleBuffer {
+    ULONGLONG* frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    int* depths;
+    int count;
+    int capacity;
+};
+
+// --- コールツリー ---
+struct CallNode {
+    int symbol;       // 0 = 未解決, それ以外は PeSymbolTable のインデックス + 1
+    int count;        // このノードを通過したサンプル数 (包含)
+    int first_child;
+    int next_sibling;
+};
+
+struct CallTree {
+    CallNode* nodes;
+    int count;
+    int capacity;
+};
+
+struct FlatEntry {
+    int symbol;
+    int self;
+    int total;
+};
+
+static BOOL sample_buffer_push(SampleBuffer* buf, const ULONGLONG* frames, int depth) {
+    if (buf->count == buf->capacity) {
+        int new_capacity = buf->capacity ? buf->capacity * 2 : 1024;
+        int* new_depths = (int*)realloc(buf->depths, sizeof(int) * new_capacity);
+        if (!new_depths) return FALSE;
+        buf->depths = new_depths;
+        buf->capacity = new_capacity;
+    }
+    if (buf->frame_count + depth > buf->frame_capacity) {
+        size_t new_capacity = buf->frame_capacity ? buf->frame_capacity * 2 : 16384;
+        while (new_capacity < buf->frame_count + depth) new_capacity *= 2;
+        ULONGLONG* new_frames = (ULONGLONG*)realloc(buf->frames, sizeof(ULONGLONG) * new_capacity);
+        if (!new_frames) return FALSE;
+        buf->frames = new_frames;
+        buf->frame_capacity = new_capacity;
+    }
+    memcpy(buf->frames + buf->frame_count, frames, sizeof(ULONGLONG) * depth);
+    buf->frame_count += depth;
+    buf->depths[buf->count++] = depth;
+    return TRUE;
+}
+
+// 対象スレッドを一瞬停止させ、アンワインド情報を使ってコールスタックを取得する
+static int capture_stack(HANDLE process, HANDLE thread, ULONGLONG* frames) {
+    if (SuspendThread(thread) == (DWORD)-1) return 0;
+
+    int depth = 0;
+    CONTEXT ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.ContextFlags = CONTEXT_FULL;
+    if (GetThreadContext(thread, &ctx)) {
+        STACKFRAME64 frame;
+        memset(&frame, 0, sizeof(frame));
+#if defined(_M_X64) || defined(__x86_64__)
+        DWORD machine = IMAGE_FILE_MACHINE_AMD64;
+        frame.AddrPC.Offset = ctx.Rip;
+        frame.AddrFrame.Offset = ctx.Rbp;
+        frame.AddrStack.Offset = ctx.Rsp;
+#else
+        DWORD machine = IMAGE_FILE_MACHINE_I386;
+        frame.AddrPC.Offset = ctx.Eip;
+        frame.AddrFrame.Offset = ctx.Ebp;
+        frame.AddrStack.Offset = ctx.Esp;
+#endif
+        frame.AddrPC.Mode = AddrModeFlat;
+        frame.AddrFrame.Mode = AddrModeFlat;
+        frame.AddrStack.Mode = AddrModeFlat;
+        while (depth < PROFILE_MAX_DEPTH &&
+               StackWalk64(machine, process, thread, &frame, &ctx, NULL, SymFunctionTableAccess64, SymGetModuleBase64, NULL)) {
+            if (frame.AddrPC.Offset == 0) break;
+            frames[depth++] = frame.AddrPC.Offset;
+        }
+    }
+
+    ResumeThread(thread);
+    return depth;
+}
+
+// 実行時アドレスをシンボルIDに変換する (戻りアドレスは呼び出し命令内を指すよう1戻す)
+static int resolve_frame(const PeSymbolTable* symbols, ULONGLONG module_base, ULONGLONG address, BOOL is_return_address) {
+    if (symbols->count == 0 || module_base == 0 || address < module_base) return 0;
+    if (is_return_address) address--;
+    const PeSymbol* sym = pe_find_symbol(symbols, address - module_base + symbols->image_base);
+    return sym ? (int)(sym - symbols->symbols) + 1 : 0;
+}
+
+static const char* symbol_name(const PeSymbolTable* symbols, int id) {
+    return id ? symbols->symbols[id - 1].name : "[unknown]";
+}
+
+static int call_tree_child(CallTree* tree, int parent, int symbol) {
+    for (int c = tree->nodes[parent].first_child; c >= 0; c = tree->nodes[c].next_sibling) {
+        if (tree->nodes[c].symbol == symbol) return c;
+    }
+    if (tree->count == tree->capacity) {
+        int new_capacity = tree->capacity * 2;
+        CallNode* new_nodes = (CallNode*)realloc(tree->nodes, sizeof(CallNode) * new_capacity);
+        if (!new_nodes) return -1;
+        tree->nodes = new_nodes;
+        tree->capacity = new_capacity;
+    }
+    int id = tree->count++;
+    tree->nodes[id].symbol = symbol;
+    tree->nodes[id].count = 0;
+    tree->nodes[id].first_child = -1;
+    tree->nodes[id].next_sibling = tree->nodes[parent].first_child;
+    tree->nodes[parent].first_child = id;
+    return id;
+}
+
+static int compare_flat_entries(const void* a, const void* b) {
+    const FlatEntry* x = (const FlatEntry*)a;
+    const FlatEntry* y = (const FlatEntry*)b;
+    if (x->self != y->self) return y->self - x->self;
+    return y->total - x->total;
+}
+
+// 子ノードを包含サンプル数の多い順に並べた配列を返す (呼び出し側で解放)
+static int* sorted_children(const CallTree* tree, int node, int* out_count) {
+    int n = 0;
+    for (int c = tree->nodes[node].first_child; c >= 0; c = tree->nodes[c].next_sibling) n++;
+    *out_count = n;
+    if (n == 0) return NULL;
+    int* children = (int*)malloc(sizeof(int) * n);
+    if (!children) { *out_count = 0; return NULL; }
+    int i = 0;
+    for (int c = tree->nodes[node].first_child; c >= 0; c = tree->nodes[c].next_sibling) {
+        int j = i++;
+        while (j > 0 && tree->nodes[children[j - 1]].count < tree->nodes[c].count) {
+            children[j] = children[j - 1];
+            j--;
+        }
+        children[j] = c;
+    }
+    return children;
+}
+
+static void print_call_tree(const CallTree* tree, const PeSymbolTable* symbols, int node, int depth, int total_samples) {
+    int n;
+    int* children = sorted_children(tree, node, &n);
+    for (int i = 0; i < n; ++i) {
+        const CallNode* child = &tree->nodes[children[i]];
+        double percent = child->count * 100.0 / total_samples;
+        if (percent < PROFILE_TREE_MIN_PERCENT) break;
+        wprintf(L"  %*s%6.2f%%  %hs\n", depth * 2, L"", percent, symbol_name(symbols, child->symbol));
+        if (depth + 1 < PROFILE_TREE_MAX_DEPTH) {
+            print_call_tree(tree, symbols, children[i], depth + 1, total_samples);
+        }
+    }
+    free(children);
+}
+
+// flamegraph.pl などで読める "root;...;leaf count" 形式で自己サンプルを書き出す
+static void write_folded_stacks(FILE* out, const CallTree* tree, const PeSymbolTable* symbols, int node, int* path, int depth) {
+    if (node != 0) {
+        int self = tree->nodes[node].count;
+        for (int c = tree->nodes[node].first_child; c >= 0; c = tree->nodes[c].next_sibling) {
+            self -= tree->nodes[c].count;
+        }
+        if (self > 0) {
+            for (int i = 0; i < depth; ++i) {
+                fprintf(out, "%s%s", i ? ";" : "", symbol_name(symbols, path[i]));
+            }
+            fprintf(out, " %d\n", self);
+        }
+    }
+    for (int c = tree->nodes[node].first_child; c >= 0; c = tree->nodes[c].next_sibling) {
+        path[depth] = tree->nodes[c].symbol;
+        write_folded_stacks(out, tree, symbols, c, path, depth + 1);
+    }
+}
+
+// interval_ms は実際のサンプリング間隔 (ミリ秒単位に丸めるため、周波数は指定した値と異なることがある)
+static void print_profile_report(const SampleBuffer* samples, const PeSymbolTable* symbols, ULONGLONG module_base, DWORD interval_ms, const ProgramOptions* opts) {
+    DWORD effective_freq = 1000 / interval_ms;
+    if ((int)effective_freq == opts->profile_freq) {
+        wprintf(L"\n--- Profile (%d samples, %lu Hz) ---\n", samples->count, effective_freq);
+    } else {
+        wprintf(L"\n--- Profile (%d samples, %lu Hz; %d Hz requested, the interval is whole milliseconds) ---\n",
+                samples->count, effective_freq, opts->profile_freq);
+    }
+    if (samples->count == 0) {
+        wprintf(L"No samples were collected (the program finished too quickly).\n");
+        return;
+    }
+
+    int symbol_count = symbols->count + 1;
+    FlatEntry* flat = (FlatEntry*)calloc(symbol_count, sizeof(FlatEntry));
+    int* last_sample = (int*)malloc(sizeof(int) * symbol_count);
+    int* ids = (int*)malloc(sizeof(int) * (samples->frame_count + 1));
+    CallTree tree = { (CallNode*)malloc(sizeof(CallNode) * 1024), 1, 1024 };
+    if (!flat || !last_sample || !ids || !tree.nodes) {
+        fwprintf_err(L"Error: Out of memory while building the profile report.\n");
+        free(flat); free(last_sample); free(ids); free(tree.nodes);
+        return;
+    }
+    tree.nodes[0].symbol = 0;
+    tree.nodes[0].count = samples->count;
+    tree.nodes[0].first_child = -1;
+    tree.nodes[0].next_sibling = -1;
+    for (int i = 0; i < symbol_count; ++i) { flat[i].symbol = i; last_sample[i] = -1; }
+
+    size_t offset = 0;
+    for (int s = 0; s < samples->count; ++s) {
+        int depth = samples->depths[s];
+        int* sample_ids = ids + offset;
+        // 未解決フレーム (DLL内など) が連続する場合は1つにまとめる
+        int n = 0;
+        for (int f = 0; f < depth; ++f) {
+            int id = resolve_frame(symbols, module_base, samples->frames[offset + f], f > 0);
+            if (id == 0 && n > 0 && sample_ids[n - 1] == 0) continue;
+            sample_ids[n++] = id;
+        }
+
+        flat[sample_ids[0]].self++;
+        for (int f = 0; f < n; ++f) {
+            if (last_sample[sample_ids[f]] != s) { // 再帰呼び出しは1サンプルにつき1回だけ数える
+                last_sample[sample_ids[f]] = s;
+                flat[sample_ids[f]].total++;
+            }
+        }
+
+        int node = 0;
+        for (int f = n - 1; f >= 0 && node >= 0; --f) {
+            node = call_tree_child(&tree, node, sample_ids[f]);
+            if (node >= 0) tree.nodes[node].count++;
+        }
+        offset += depth;
+    }
+
+    qsort(flat, symbol_count, sizeof(FlatEntry), compare_flat_entries);
+    wprintf(L"\nFlat profile (top %d):\n", opts->profile_top);
+    wprintf(L"   self%%      self   total%%     total  function\n");
+    for (int i = 0; i < symbol_count && i < opts->profile_top && flat[i].self > 0; ++i) {
+        wprintf(L"  %6.2f%%  %8d  %6.2f%%  %8d  %hs\n",
+                flat[i].self * 100.0 / samples->count, flat[i].self,
+                flat[i].total * 100.0 / samples->count, flat[i].total,
+                symbol_name(symbols, flat[i].symbol));
+    }
+
+    wprintf(L"\nCall tree (inclusive, >= %.0f%%):\n", PROFILE_TREE_MIN_PERCENT);
+    print_call_tree(&tree, symbols, 0, 0, samples->count);
+
+    if (opts->profile_folded) {
+        FILE* out = _wfopen(opts->profile_folded, L"w");
+        if (out) {
+            int path[PROFILE_MAX_DEPTH];
+            write_folded_stacks(out, &tree, symbols, 0, path, 0);
+            fclose(out);
+            wprintf(L"\nFolded stacks written to %s\n", opts->profile_folded);
+        } else {
+            fwprintf_err(L"Warning: Could not write folded stacks to %s\n", opts->profile_folded);
+        }
+    }
+
+    free(flat);
+    free(last_sample);
+    free(ids);
+    free(tree.nodes);
+}
+
+// プログラムを実行しながらメインスレッドを一定間隔でサンプリングし、終了後にレポートを表示する
+BOOL run_program_with_profiler(wchar_t* command_line, const wchar_t* executable_path, const ProgramOptions* opts, DWORD* p_exit_code, ProcessVerdict* p_verdict) {
+    PeSymbolTable symbols;
+    if (!pe_load_symbols(executable_path, &symbols)) {
+        fwprintf_err(L"Warning: No symbol table found in %s; samples will be unresolved.\n", executable_path);
+    }
+
+    ProcessSpawnOptions spawn = {};
+    spawn.start_suspended = TRUE;
+    spawn.limits = opts->limits;
+    spawn.placement = opts->placement;
+    ChildProcess proc;
+    if (!process_spawn(command_line, &spawn, &proc)) {
+        pe_free_symbols(&symbols);
+        return FALSE;
+    }
+
+    SymInitializeW(proc.process, NULL, FALSE);
+    // 待機はミリ秒単位のため、指定した周波数に最も近い整数のミリ秒にする
+    DWORD interval_ms = (DWORD)((1000 + opts->profile_freq / 2) / opts->profile_freq);
+    if (interval_ms == 0) interval_ms = 1;
+    timeBeginPeriod(1); // 既定の15.6msタイマー分解能ではサンプリング間隔が粗すぎる
+    process_resume(&proc);
+
+    SampleBuffer samples = {0};
+    ULONGLONG frames[PROFILE_MAX_DEPTH];
+    ULONGLONG module_base = 0;
+    while (WaitForSingleObject(proc.process, interval_ms) == WAIT_TIMEOUT) {
+        if (process_check_limits(&proc)) break; // 制限を超えた場合もそこまでのサンプルは報告する
+        if (module_base == 0) {
+            // ローダーの初期化が終わるまではモジュール一覧を取得できない
+            HMODULE main_module;
+            DWORD needed;
+            if (!EnumProcessModules(proc.process, &main_module, sizeof(main_module), &needed)) continue;
+            module_base = (ULONGLONG)(ULONG_PTR)main_module;
+            SymRefreshModuleList(proc.process);
+        }
+        int depth = capture_stack(proc.process, proc.thread, frames);
+        if (depth > 0) sample_buffer_push(&samples, frames, depth);
+    }
+    timeEndPeriod(1);
+
+    process_exit_code(&proc, p_exit_code);
+    *p_verdict = proc.verdict;
+    SymCleanup(proc.process);
+    process_close(&proc);
+
+    print_profile_report(&samples, &symbols, module_base, interval_ms, opts);
+
+    free(samples.frames);
+    free(samples.depths);
+    pe_free_symbols(&symbols);
+    return TRUE;
+}
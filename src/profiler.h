@@ -0,0 +1,7 @@
+#pragma once
+
+#include "options.h"
+#include <windows.h>
+
+// --- 関数宣言 ---
+BOOL run_program_with_profiler(wchar_t* command_line, const wchar_t* executable_path, const ProgramOptions* opts, DWORD* p_exit_code, ProcessVerdict* p_verdict);
@@ -0,0 +1,630 @@
+#include "project.h"
+#include "compiler.h"
+#include "json.h"
+#include "process.h"
+#include "jobserver.h"
+#include "timing.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#define PROJECT_BUILD_DIR L".crun_build"
+#define PROJECT_COMMAND_SIZE 32767
+
+// --- データ構造 ---
+enum TargetType {
+    TARGET_EXECUTABLE,
+    TARGET_STATIC_LIBRARY
+};
+
+struct ProjectTarget {
+    const wchar_t* name;
+    TargetType type;
+    wchar_t** sources;          // ソースファイルのフルパス
+    int num_sources;
+    const wchar_t* cflags;      // ターゲット固有のコンパイルフラグ
+    const wchar_t* libs;        // ターゲット固有のリンクライブラリ
+    const JsonValue* deps_json;
+    int* deps;                  // 依存ターゲットのインデックス
+    int num_deps;
+    BOOL selected;              // 今回ビルドするターゲットか
+    int visit_state;            // 循環検出用 (0: 未訪問, 1: 訪問中, 2: 完了)
+    BOOL has_cpp;               // 自身または依存ライブラリにC++ソースが含まれるか
+    wchar_t build_dir[MAX_PATH];
+    wchar_t output_path[MAX_PATH];
+    wchar_t link_libs[2048];    // スキャンで検出したライブラリ (依存ライブラリの分を含む)
+    FILETIME output_time;
+    int final_job;              // 成果物を生成するジョブ (-1: 最新のためスキップ)
+};
+
+enum JobState {
+    JOB_WAITING,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+};
+
+struct BuildJob {
+    wchar_t* command;
+    wchar_t* description;
+    wchar_t delete_before[MAX_PATH]; // 起動前に削除するファイル (アーカイブの作り直しと、失敗時に古い成果物を残さないため)
+    wchar_t log_path[MAX_PATH];
+    wchar_t record_path[MAX_PATH];   // 成功したらコマンドのハッシュを記録する成果物 (空なら記録しない)
+    ULONGLONG command_hash;
+    JobState state;
+    int pending;                // 未完了の依存ジョブ数
+    int* dependents;
+    int num_dependents;
+    ChildProcess process;
+};
+
+struct ProjectContext {
+    const ProgramOptions* opts;
+    wchar_t project_dir[MAX_PATH];
+    FILETIME manifest_time;
+    const wchar_t* global_cflags;
+    const wchar_t* global_libs;
+    ProjectTarget* targets;
+    int num_targets;
+    int* order;                 // 依存先が先に来るトポロジカル順
+    int num_ordered;
+    BuildJob* jobs;
+    int num_jobs;
+    int jobs_capacity;
+    wchar_t c_compiler[MAX_PATH];
+    wchar_t cpp_compiler[MAX_PATH];
+    wchar_t archiver[MAX_PATH];
+};
+
+// --- ヘルパー関数 ---
+static BOOL is_cpp_source(const wchar_t* path) {
+    const wchar_t* ext = get_extension(path);
+    return ext && wcscmp(ext, L".cpp") == 0;
+}
+
+// 空白区切りのフラグ列に、同じトークンがまだ無ければ追加する
+static void append_unique_flags(wchar_t* list, size_t list_size, const wchar_t* flags) {
+    const wchar_t* p = flags;
+    while (*p) {
+        while (*p == L' ') p++;
+        if (!*p) break;
+        const wchar_t* end = wcschr(p, L' ');
+        size_t len = end ? (size_t)(end - p) : wcslen(p);
+
+        BOOL found = FALSE;
+        const wchar_t* q = list;
+        while (*q && !found) {
+            while (*q == L' ') q++;
+            const wchar_t* q_end = wcschr(q, L' ');
+            size_t q_len = q_end ? (size_t)(q_end - q) : wcslen(q);
+            found = (q_len == len && wcsncmp(q, p, len) == 0);
+            q += q_len;
+        }
+        if (!found) {
+            if (list[0] != L'\0') wcscat_s(list, list_size, L" ");
+            wcsncat_s(list, list_size, p, len);
+        }
+        p += len;
+    }
+}
+
+static const wchar_t* get_compiler(ProjectContext* ctx, BOOL cpp) {
+    wchar_t* path = cpp ? ctx->cpp_compiler : ctx->c_compiler;
+    if (path[0] == L'\0' && !find_compiler(ctx->opts->compiler_name, cpp, path, MAX_PATH)) return NULL;
+    return path;
+}
+
+static const wchar_t* get_archiver(ProjectContext* ctx) {
+    if (ctx->archiver[0] != L'\0') return ctx->archiver;
+    // LTOオブジェクトも扱えるよう、コンパイラ付属のラッパーを優先する
+    const wchar_t* candidates_gcc[] = { L"gcc-ar.exe", L"ar.exe" };
+    const wchar_t* candidates_clang[] = { L"llvm-ar.exe", L"ar.exe" };
+    const wchar_t** candidates = (wcscmp(ctx->opts->compiler_name, L"clang") == 0) ? candidates_clang : candidates_gcc;
+    for (int i = 0; i < 2; ++i) {
+        if (find_executable_in_path(candidates[i], ctx->archiver, MAX_PATH)) return ctx->archiver;
+    }
+    ctx->archiver[0] = L'\0';
+    fwprintf_err(L"エラー: 静的ライブラリの作成に必要なアーカイバ (%s または %s) がPATHに見つかりません。\n", candidates[0], candidates[1]);
+    return NULL;
+}
+
+// --- コマンドの記録 ---
+// 成果物を作ったコマンド (コンパイラ・フラグ・--debug などを含む) のハッシュを <成果物>.cmd に置き、
+// 更新日時が新しくてもコマンドが変わっていれば作り直す
+static ULONGLONG hash_command(const wchar_t* command) {
+    return hash_bytes(command, wcslen(command) * sizeof(wchar_t), 0);
+}
+
+static BOOL command_matches(const wchar_t* output_path, ULONGLONG hash) {
+    wchar_t path[MAX_PATH];
+    swprintf_s(path, MAX_PATH, L"%s.cmd", output_path);
+    FILE* in = _wfopen(path, L"r");
+    if (!in) return FALSE;
+    unsigned long long recorded = 0;
+    BOOL matches = fscanf(in, "%llx", &recorded) == 1 && recorded == hash;
+    fclose(in);
+    return matches;
+}
+
+static void record_command(const BuildJob* job) {
+    if (job->record_path[0] == L'\0') return;
+    wchar_t path[MAX_PATH];
+    swprintf_s(path, MAX_PATH, L"%s.cmd", job->record_path);
+    FILE* out = _wfopen(path, L"w");
+    if (!out) return;
+    fprintf(out, "%016llx\n", job->command_hash);
+    fclose(out);
+}
+
+// --- ジョブ管理 ---
+static int add_job(ProjectContext* ctx, wchar_t* command, const wchar_t* description) {
+    if (ctx->num_jobs == ctx->jobs_capacity) {
+        int new_capacity = ctx->jobs_capacity ? ctx->jobs_capacity * 2 : 64;
+        BuildJob* new_jobs = (BuildJob*)realloc(ctx->jobs, sizeof(BuildJob) * new_capacity);
+        if (!new_jobs) return -1;
+        ctx->jobs = new_jobs;
+        ctx->jobs_capacity = new_capacity;
+    }
+    BuildJob* job = &ctx->jobs[ctx->num_jobs];
+    memset(job, 0, sizeof(BuildJob));
+    job->command = command;
+    job->description = _wcsdup(description);
+    swprintf_s(job->log_path, MAX_PATH, L"%s\\%s\\job_%d.log", ctx->project_dir, PROJECT_BUILD_DIR, ctx->num_jobs);
+    return ctx->num_jobs++;
+}
+
+static BOOL add_job_dependency(ProjectContext* ctx, int job, int dependency) {
+    if (job < 0 || dependency < 0) return TRUE;
+    BuildJob* dep = &ctx->jobs[dependency];
+    int* new_dependents = (int*)realloc(dep->dependents, sizeof(int) * (dep->num_dependents + 1));
+    if (!new_dependents) return FALSE;
+    dep->dependents = new_dependents;
+    dep->dependents[dep->num_dependents++] = job;
+    ctx->jobs[job].pending++;
+    return TRUE;
+}
+
+// ジョブの出力をログファイルへリダイレクトして起動する (並列実行時に出力が混ざらないようにする)
+static BOOL start_job(BuildJob* job, BOOL verbose) {
+    if (job->delete_before[0] != L'\0') DeleteFileW(job->delete_before);
+    if (verbose) wprintf(L"Command: %s\n", job->command);
+
+    ProcessSpawnOptions spawn = {};
+    spawn.output = PROCESS_OUTPUT_FILE;
+    spawn.output_file = job->log_path;
+    spawn.hide_window = TRUE;
+    if (!process_spawn(job->command, &spawn, &job->process)) return FALSE;
+    job->state = JOB_RUNNING;
+    return TRUE;
+}
+
+static void print_job_log(const BuildJob* job) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (read_file_bytes(job->log_path, &data, &size)) {
+        if (size > 0) {
+            int wide_size = MultiByteToWideChar(CP_UTF8, 0, (const char*)data, -1, NULL, 0);
+            wchar_t* text = (wchar_t*)malloc(sizeof(wchar_t) * wide_size);
+            if (text) {
+                MultiByteToWideChar(CP_UTF8, 0, (const char*)data, -1, text, wide_size);
+                wprintf(L"%s", text);
+                free(text);
+            }
+        }
+        free(data);
+    }
+    DeleteFileW(job->log_path);
+}
+
+// 依存関係を満たしたジョブから順に、最大 max_parallel 個を同時に実行する
+static BOOL run_build_jobs(ProjectContext* ctx, int max_parallel) {
+    ChildProcess* running[PROCESS_WAIT_MAX];
+    int running_job[PROCESS_WAIT_MAX];
+    int num_running = 0;
+    int started = 0;
+    int finished = 0;
+    BOOL failed = FALSE;
+    if (max_parallel > PROCESS_WAIT_MAX) max_parallel = PROCESS_WAIT_MAX;
+    if (max_parallel < 1) max_parallel = 1;
+
+    while (finished < ctx->num_jobs) {
+        // 失敗後は新しいジョブを起動せず、実行中のものだけを待つ
+        for (int j = 0; j < ctx->num_jobs && !failed && num_running < max_parallel; ++j) {
+            BuildJob* job = &ctx->jobs[j];
+            if (job->state != JOB_WAITING || job->pending > 0) continue;
+            if (!jobserver_acquire(num_running)) break; // トークンが無ければ実行中のジョブの終了を待つ
+            wprintf(L"[%d/%d] %s\n", ++started, ctx->num_jobs, job->description);
+            fflush(stdout);
+            if (!start_job(job, ctx->opts->verbose)) {
+                fwprintf_err(L"Error: Failed to start: %s\n", job->command);
+                job->state = JOB_FAILED;
+                failed = TRUE;
+                finished++;
+                break;
+            }
+            running[num_running] = &job->process;
+            running_job[num_running] = j;
+            num_running++;
+        }
+        if (num_running == 0) break;
+
+        int slot = process_wait_any(running, num_running, INFINITE);
+        if (slot < 0) {
+            for (int r = 0; r < num_running; ++r) {
+                process_terminate(running[r]);
+                process_close(running[r]);
+            }
+            jobserver_sync(0);
+            return FALSE;
+        }
+        BuildJob* job = &ctx->jobs[running_job[slot]];
+
+        DWORD exit_code = 1;
+        process_exit_code(&job->process, &exit_code);
+        process_close(&job->process);
+        print_job_log(job);
+
+        if (exit_code == 0) {
+            job->state = JOB_DONE;
+            record_command(job);
+            for (int d = 0; d < job->num_dependents; ++d) ctx->jobs[job->dependents[d]].pending--;
+        } else {
+            job->state = JOB_FAILED;
+            failed = TRUE;
+            fwprintf_err(L"Error: %s failed.\n", job->description);
+        }
+        finished++;
+
+        running[slot] = running[num_running - 1];
+        running_job[slot] = running_job[num_running - 1];
+        num_running--;
+        jobserver_sync(num_running);
+    }
+    jobserver_sync(0);
+    return !failed;
+}
+
+// --- マニフェストの読み込み ---
+static BOOL load_targets(ProjectContext* ctx, const JsonValue* root) {
+    const JsonValue* targets = json_get(root, L"targets");
+    if (!targets || targets->type != JSON_OBJECT || targets->child_count == 0) {
+        fwprintf_err(L"エラー: マニフェストに \"targets\" オブジェクトがありません。\n");
+        return FALSE;
+    }
+    ctx->global_cflags = json_get_string(root, L"cflags", L"");
+    ctx->global_libs = json_get_string(root, L"libs", L"");
+
+    ctx->targets = (ProjectTarget*)calloc(targets->child_count, sizeof(ProjectTarget));
+    ctx->order = (int*)malloc(sizeof(int) * targets->child_count);
+    if (!ctx->targets || !ctx->order) return FALSE;
+
+    for (const JsonValue* t = targets->first_child; t; t = t->next) {
+        ProjectTarget* target = &ctx->targets[ctx->num_targets++];
+        target->name = t->key;
+        target->final_job = -1;
+        if (t->type != JSON_OBJECT) {
+            fwprintf_err(L"エラー: ターゲット '%s' の定義はオブジェクトである必要があります。\n", t->key);
+            return FALSE;
+        }
+
+        const wchar_t* type = json_get_string(t, L"type", L"executable");
+        if (wcscmp(type, L"executable") == 0) {
+            target->type = TARGET_EXECUTABLE;
+        } else if (wcscmp(type, L"static_library") == 0) {
+            target->type = TARGET_STATIC_LIBRARY;
+        } else {
+            fwprintf_err(L"エラー: ターゲット '%s' の type '%s' は無効です ('executable' または 'static_library')。\n", t->key, type);
+            return FALSE;
+        }
+        target->cflags = json_get_string(t, L"cflags", L"");
+        target->libs = json_get_string(t, L"libs", L"");
+        target->deps_json = json_get(t, L"deps");
+
+        const JsonValue* sources = json_get(t, L"sources");
+        if (!sources || sources->type != JSON_ARRAY || sources->child_count == 0) {
+            fwprintf_err(L"エラー: ターゲット '%s' に \"sources\" が指定されていません。\n", t->key);
+            return FALSE;
+        }
+        target->sources = (wchar_t**)calloc(sources->child_count, sizeof(wchar_t*));
+        if (!target->sources) return FALSE;
+        for (const JsonValue* s = sources->first_child; s; s = s->next) {
+            if (s->type != JSON_STRING) continue;
+            // ソースのパスはマニフェストのあるディレクトリからの相対パス
+            wchar_t joined[MAX_PATH], full_path[MAX_PATH];
+            if (s->string[0] != L'\0' && (s->string[1] == L':' || s->string[0] == L'\\' || s->string[0] == L'/')) {
+                wcsncpy_s(joined, MAX_PATH, s->string, _TRUNCATE);
+            } else {
+                swprintf_s(joined, MAX_PATH, L"%s\\%s", ctx->project_dir, s->string);
+            }
+            if (!GetFullPathNameW(joined, MAX_PATH, full_path, NULL) || !file_exists(full_path)) {
+                fwprintf_err(L"エラー: ターゲット '%s' のソースファイルが見つかりません: %s\n", t->key, s->string);
+                return FALSE;
+            }
+            target->sources[target->num_sources++] = _wcsdup(full_path);
+            if (is_cpp_source(full_path)) target->has_cpp = TRUE;
+        }
+    }
+
+    // 依存ターゲット名をインデックスに解決する
+    for (int i = 0; i < ctx->num_targets; ++i) {
+        ProjectTarget* target = &ctx->targets[i];
+        if (!target->deps_json) continue;
+        if (target->deps_json->type != JSON_ARRAY) {
+            fwprintf_err(L"エラー: ターゲット '%s' の \"deps\" は配列である必要があります。\n", target->name);
+            return FALSE;
+        }
+        target->deps = (int*)malloc(sizeof(int) * (target->deps_json->child_count + 1));
+        if (!target->deps) return FALSE;
+        for (const JsonValue* d = target->deps_json->first_child; d; d = d->next) {
+            int found = -1;
+            for (int k = 0; k < ctx->num_targets && d->type == JSON_STRING; ++k) {
+                if (wcscmp(ctx->targets[k].name, d->string) == 0) { found = k; break; }
+            }
+            if (found < 0) {
+                fwprintf_err(L"エラー: ターゲット '%s' の依存先 '%s' が定義されていません。\n", target->name, d->type == JSON_STRING ? d->string : L"?");
+                return FALSE;
+            }
+            target->deps[target->num_deps++] = found;
+        }
+    }
+    return TRUE;
+}
+
+// 選択されたターゲットとその依存先を、依存先が先になる順序で並べる
+static BOOL order_targets(ProjectContext* ctx, int index) {
+    ProjectTarget* target = &ctx->targets[index];
+    if (target->visit_state == 2) return TRUE;
+    if (target->visit_state == 1) {
+        fwprintf_err(L"エラー: ターゲット '%s' の依存関係が循環しています。\n", target->name);
+        return FALSE;
+    }
+    target->visit_state = 1;
+    target->selected = TRUE;
+    for (int d = 0; d < target->num_deps; ++d) {
+        if (!order_targets(ctx, target->deps[d])) return FALSE;
+    }
+    target->visit_state = 2;
+    ctx->order[ctx->num_ordered++] = index;
+    return TRUE;
+}
+
+static void mark_transitive_deps(ProjectContext* ctx, int index, BOOL* marks) {
+    for (int d = 0; d < ctx->targets[index].num_deps; ++d) {
+        int dep = ctx->targets[index].deps[d];
+        if (!marks[dep]) {
+            marks[dep] = TRUE;
+            mark_transitive_deps(ctx, dep, marks);
+        }
+    }
+}
+
+// --- ビルド計画 ---
+// ターゲットのコンパイル/リンクジョブを登録する。最新のオブジェクトと成果物は再ビルドしない
+static BOOL plan_target(ProjectContext* ctx, int index) {
+    ProjectTarget* target = &ctx->targets[index];
+    const ProgramOptions* opts = ctx->opts;
+
+    swprintf_s(target->build_dir, MAX_PATH, L"%s\\%s\\%s", ctx->project_dir, PROJECT_BUILD_DIR, target->name);
+    CreateDirectoryW(target->build_dir, NULL);
+    if (target->type == TARGET_EXECUTABLE) {
+        swprintf_s(target->output_path, MAX_PATH, L"%s\\%s.exe", target->build_dir, target->name);
+    } else {
+        swprintf_s(target->output_path, MAX_PATH, L"%s\\lib%s.a", target->build_dir, target->name);
+    }
+
+    BOOL output_exists = get_file_write_time(target->output_path, &target->output_time);
+    BOOL needs_output = !output_exists;
+    int first_compile_job = ctx->num_jobs;
+
+    wchar_t* objects = (wchar_t*)calloc(PROJECT_COMMAND_SIZE, sizeof(wchar_t));
+    if (!objects) return FALSE;
+    // スキャンでは -I などをコンパイルと同じフラグ (マニフェストと --cflags) から取る
+    wchar_t search_flags[4096];
+    swprintf_s(search_flags, _countof(search_flags), L"%s %s %s", ctx->global_cflags, target->cflags,
+               opts->compiler_flags ? opts->compiler_flags : L"");
+
+    for (int s = 0; s < target->num_sources; ++s) {
+        const wchar_t* source = target->sources[s];
+
+        // ソースごとに #include をスキャンし、必要なフラグと入力ファイルの最新更新日時を得る
+        wchar_t scanned[2048] = {0}, compile_flags[2048] = {0}, link_flags[2048] = {0};
+        FILETIME newest_input;
+        IncludeSearchPath search;
+        include_search_path_init(&search, search_flags, get_compiler(ctx, is_cpp_source(source)));
+        find_libs_in_sources((wchar_t* const*)&target->sources[s], 1, &search, scanned, _countof(scanned), &newest_input);
+        include_search_path_free(&search);
+        split_link_flags(scanned, compile_flags, _countof(compile_flags), link_flags, _countof(link_flags));
+        append_unique_flags(target->link_libs, _countof(target->link_libs), link_flags);
+        if (CompareFileTime(&newest_input, &ctx->manifest_time) < 0) newest_input = ctx->manifest_time;
+
+        wchar_t stem[MAX_PATH], object_path[MAX_PATH];
+        get_stem(source, stem, MAX_PATH);
+        swprintf_s(object_path, MAX_PATH, L"%s\\%s_%08lx.o", target->build_dir, stem,
+                   (unsigned long)(hash_bytes(source, wcslen(source) * sizeof(wchar_t), 0) & 0xFFFFFFFF));
+        wcscat_s(objects, PROJECT_COMMAND_SIZE, L" \"");
+        wcscat_s(objects, PROJECT_COMMAND_SIZE, object_path);
+        wcscat_s(objects, PROJECT_COMMAND_SIZE, L"\"");
+
+        const wchar_t* compiler = get_compiler(ctx, is_cpp_source(source));
+        if (!compiler) { free(objects); return FALSE; }
+        wchar_t* command = (wchar_t*)malloc(sizeof(wchar_t) * PROJECT_COMMAND_SIZE);
+        if (!command) { free(objects); return FALSE; }
+        swprintf_s(command, PROJECT_COMMAND_SIZE, L"\"%s\" -c \"%s\" -o \"%s\" %s%s %s %s %s %s",
+                   compiler, source, object_path,
+                   opts->debug_build ? L"-g" : (opts->profile ? L"-O2 -g -fno-omit-frame-pointer" : L"-O2"),
+                   opts->warnings_all ? L" -Wall" : L"",
+                   compile_flags, ctx->global_cflags, target->cflags,
+                   opts->compiler_flags ? opts->compiler_flags : L"");
+        ULONGLONG hash = hash_command(command);
+
+        FILETIME object_time;
+        BOOL object_up_to_date = get_file_write_time(object_path, &object_time) && CompareFileTime(&object_time, &newest_input) >= 0 &&
+                                 command_matches(object_path, hash);
+        if (object_up_to_date) {
+            if (output_exists && CompareFileTime(&object_time, &target->output_time) > 0) needs_output = TRUE;
+            free(command);
+            continue;
+        }
+
+        wchar_t description[MAX_PATH + 64];
+        const wchar_t* file_name = wcsrchr(source, L'\\');
+        swprintf_s(description, _countof(description), L"Compiling %s (%s)", file_name ? file_name + 1 : source, target->name);
+        int job = add_job(ctx, command, description);
+        if (job < 0) { free(command); free(objects); return FALSE; }
+        wcscpy_s(ctx->jobs[job].record_path, MAX_PATH, object_path);
+        ctx->jobs[job].command_hash = hash;
+        needs_output = TRUE;
+    }
+
+    // 実行ファイルは依存ライブラリ全体 (推移的) とリンクする
+    BOOL* deps = (BOOL*)calloc(ctx->num_targets, sizeof(BOOL));
+    if (!deps) { free(objects); return FALSE; }
+    mark_transitive_deps(ctx, index, deps);
+    for (int i = 0; i < ctx->num_targets; ++i) {
+        if (!deps[i] || ctx->targets[i].type != TARGET_STATIC_LIBRARY) continue;
+        append_unique_flags(target->link_libs, _countof(target->link_libs), ctx->targets[i].link_libs);
+        if (ctx->targets[i].has_cpp) target->has_cpp = TRUE;
+        if (target->type == TARGET_EXECUTABLE) {
+            if (ctx->targets[i].final_job >= 0) needs_output = TRUE;
+            else if (output_exists && CompareFileTime(&ctx->targets[i].output_time, &target->output_time) > 0) needs_output = TRUE;
+        }
+    }
+
+    wchar_t* command = (wchar_t*)malloc(sizeof(wchar_t) * PROJECT_COMMAND_SIZE);
+    if (!command) { free(deps); free(objects); return FALSE; }
+    wchar_t description[MAX_PATH];
+    if (target->type == TARGET_STATIC_LIBRARY) {
+        const wchar_t* archiver = get_archiver(ctx);
+        if (!archiver) { free(command); free(deps); free(objects); return FALSE; }
+        swprintf_s(command, PROJECT_COMMAND_SIZE, L"\"%s\" rcs \"%s\"%s", archiver, target->output_path, objects);
+        swprintf_s(description, MAX_PATH, L"Archiving lib%s.a", target->name);
+    } else {
+        const wchar_t* linker = get_compiler(ctx, target->has_cpp);
+        if (!linker) { free(command); free(deps); free(objects); return FALSE; }
+        // 静的ライブラリは「依存する側が先」の順に並べる (トポロジカル順の逆)
+        wchar_t dep_archives[PROJECT_COMMAND_SIZE / 2] = {0};
+        for (int k = ctx->num_ordered - 1; k >= 0; --k) {
+            const ProjectTarget* dep = &ctx->targets[ctx->order[k]];
+            if (!deps[ctx->order[k]] || dep->type != TARGET_STATIC_LIBRARY) continue;
+            wcscat_s(dep_archives, _countof(dep_archives), L" \"");
+            wcscat_s(dep_archives, _countof(dep_archives), dep->output_path);
+            wcscat_s(dep_archives, _countof(dep_archives), L"\"");
+        }
+        swprintf_s(command, PROJECT_COMMAND_SIZE, L"\"%s\"%s%s%s %s %s %s %s -o \"%s\"",
+                   linker, objects, dep_archives,
+                   (opts->debug_build || opts->profile) ? L"" : L" -s",
+                   target->link_libs, target->libs, ctx->global_libs,
+                   opts->user_libraries ? opts->user_libraries : L"",
+                   target->output_path);
+        swprintf_s(description, MAX_PATH, L"Linking %s.exe", target->name);
+    }
+    ULONGLONG hash = hash_command(command);
+    if (!command_matches(target->output_path, hash)) needs_output = TRUE;
+    if (!needs_output) {
+        if (opts->verbose) wprintf(L"'%s' is up to date.\n", target->name);
+        free(command);
+        free(deps);
+        free(objects);
+        return TRUE;
+    }
+
+    int job = add_job(ctx, command, description);
+    if (job < 0) { free(command); free(deps); free(objects); return FALSE; }
+    wcscpy_s(ctx->jobs[job].delete_before, MAX_PATH, target->output_path);
+    wcscpy_s(ctx->jobs[job].record_path, MAX_PATH, target->output_path);
+    ctx->jobs[job].command_hash = hash;
+
+    for (int j = first_compile_job; j < job; ++j) add_job_dependency(ctx, job, j);
+    for (int i = 0; i < ctx->num_targets; ++i) {
+        if (deps[i]) add_job_dependency(ctx, job, ctx->targets[i].final_job);
+    }
+    target->final_job = job;
+
+    free(deps);
+    free(objects);
+    return TRUE;
+}
+
+static void free_project(ProjectContext* ctx) {
+    for (int i = 0; i < ctx->num_targets; ++i) {
+        for (int s = 0; s < ctx->targets[i].num_sources; ++s) free(ctx->targets[i].sources[s]);
+        free(ctx->targets[i].sources);
+        free(ctx->targets[i].deps);
+    }
+    for (int j = 0; j < ctx->num_jobs; ++j) {
+        free(ctx->jobs[j].command);
+        free(ctx->jobs[j].description);
+        free(ctx->jobs[j].dependents);
+    }
+    free(ctx->targets);
+    free(ctx->order);
+    free(ctx->jobs);
+}
+
+// マニフェスト (crun.json) に従ってターゲットをビルドする。
+// 実行すべき実行ファイルがあれば executable_path にそのパスを返す (無ければ空文字列)
+BOOL build_project(const ProgramOptions* opts, wchar_t* executable_path, size_t executable_path_size) {
+    executable_path[0] = L'\0';
+
+    ProjectContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.opts = opts;
+
+    wchar_t manifest_path[MAX_PATH];
+    if (!GetFullPathNameW(opts->project_file, MAX_PATH, manifest_path, NULL) || !get_file_write_time(manifest_path, &ctx.manifest_time)) {
+        fwprintf_err(L"エラー: マニフェスト '%s' が見つかりません。\n", opts->project_file);
+        return FALSE;
+    }
+    get_parent_path(manifest_path, ctx.project_dir, MAX_PATH);
+
+    wchar_t error[256] = {0};
+    JsonValue* root = json_parse_file(manifest_path, error, _countof(error));
+    if (!root) {
+        fwprintf_err(L"エラー: マニフェスト '%s' を解析できません: %s\n", opts->project_file, error);
+        return FALSE;
+    }
+
+    BOOL ok = load_targets(&ctx, root);
+
+    // ビルド対象を決める (ターゲット指定が無ければ全ターゲット)
+    int selected = -1;
+    if (ok && opts->project_target) {
+        for (int i = 0; i < ctx.num_targets; ++i) {
+            if (wcscmp(ctx.targets[i].name, opts->project_target) == 0) { selected = i; break; }
+        }
+        if (selected < 0) {
+            fwprintf_err(L"エラー: ターゲット '%s' はマニフェストに定義されていません。\n", opts->project_target);
+            ok = FALSE;
+        }
+    }
+    for (int i = 0; ok && i < ctx.num_targets; ++i) {
+        if (selected < 0 || selected == i) ok = order_targets(&ctx, i);
+    }
+
+    if (ok) {
+        wchar_t build_root[MAX_PATH];
+        swprintf_s(build_root, MAX_PATH, L"%s\\%s", ctx.project_dir, PROJECT_BUILD_DIR);
+        CreateDirectoryW(build_root, NULL);
+        for (int k = 0; ok && k < ctx.num_ordered; ++k) ok = plan_target(&ctx, ctx.order[k]);
+    }
+
+    if (ok && ctx.num_jobs > 0) {
+        if (opts->verbose) wprintf(L"--- Building (%d jobs, up to %d in parallel) ---\n", ctx.num_jobs, opts->jobs);
+        phase_begin(PHASE_COMPILE);
+        ok = run_build_jobs(&ctx, opts->jobs);
+        phase_end();
+        if (!ok) fwprintf_err(L"Build failed.\n");
+    } else if (ok && opts->verbose) {
+        wprintf(L"--- Nothing to build ---\n");
+    }
+
+    if (ok && selected >= 0 && !opts->project_build_only && ctx.targets[selected].type == TARGET_EXECUTABLE) {
+        wcsncpy_s(executable_path, executable_path_size, ctx.targets[selected].output_path, _TRUNCATE);
+    }
+
+    free_project(&ctx);
+    json_free(root);
+    return ok;
+}
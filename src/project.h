@@ -0,0 +1,7 @@
+#pragma once
+
+#include "options.h"
+#include <windows.h>
+
+// --- 関数宣言 ---
+BOOL build_project(const ProgramOptions* opts, wchar_t* executable_path, size_t executable_path_size);
@@ -0,0 +1,496 @@
+#include "size_report.h"
+#include "utils.h"
+#include "compiler.h"
+#include "cache.h"
+#include "pe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- 名前ごとのサイズの一覧 (セクション・ライブラリ) ---
+struct SizeEntry {
+    wchar_t name[128];
+    ULONGLONG code;      // セクションではメモリ上のサイズ
+    ULONGLONG data;      // セクションではファイル上のサイズ
+    BOOL is_auto;        // lib_map で自動的に追加したライブラリ
+};
+
+struct SizeList {
+    SizeEntry* items;
+    int count;
+    int capacity;
+};
+
+static SizeEntry* size_list_find(const SizeList* list, const wchar_t* name) {
+    for (int i = 0; i < list->count; ++i) {
+        if (_wcsicmp(list->items[i].name, name) == 0) return &list->items[i];
+    }
+    return NULL;
+}
+
+// 名前のエントリを返す (無ければ追加する)
+static SizeEntry* size_list_get(SizeList* list, const wchar_t* name) {
+    SizeEntry* entry = size_list_find(list, name);
+    if (entry) return entry;
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 32;
+        SizeEntry* grown = (SizeEntry*)realloc(list->items, sizeof(SizeEntry) * capacity);
+        if (!grown) return NULL;
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    entry = &list->items[list->count++];
+    memset(entry, 0, sizeof(SizeEntry));
+    wcsncpy_s(entry->name, _countof(entry->name), name, _TRUNCATE);
+    return entry;
+}
+
+static int compare_entries_desc(const void* a, const void* b) {
+    const SizeEntry* x = (const SizeEntry*)a;
+    const SizeEntry* y = (const SizeEntry*)b;
+    ULONGLONG sx = x->code + x->data, sy = y->code + y->data;
+    return (sx < sy) - (sx > sy);
+}
+
+// --- マップファイルに現れるシンボル ---
+struct MapSymbol {
+    ULONGLONG address;
+    ULONGLONG end;       // 入力セクションの終端 (サイズは次のシンボルかここまで)
+    char* name;
+};
+
+struct MapSymbolList {
+    MapSymbol* items;
+    int count;
+    int capacity;
+};
+
+static void add_map_symbol(MapSymbolList* list, ULONGLONG address, ULONGLONG end, const char* name) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 1024;
+        MapSymbol* grown = (MapSymbol*)realloc(list->items, sizeof(MapSymbol) * capacity);
+        if (!grown) return;
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    MapSymbol* symbol = &list->items[list->count++];
+    symbol->address = address;
+    symbol->end = end;
+    symbol->name = _strdup(name);
+}
+
+static int compare_map_symbols(const void* a, const void* b) {
+    ULONGLONG x = ((const MapSymbol*)a)->address;
+    ULONGLONG y = ((const MapSymbol*)b)->address;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static int compare_map_symbols_by_size(const void* a, const void* b) {
+    ULONGLONG x = ((const MapSymbol*)a)->end - ((const MapSymbol*)a)->address;
+    ULONGLONG y = ((const MapSymbol*)b)->end - ((const MapSymbol*)b)->address;
+    return (x < y) - (x > y);
+}
+
+// --- マップファイルの解析 (GNU ld) ---
+// ツールチェーンのスタートアップオブジェクトか (名前だけで決め、crtools.o のようなユーザーのファイルは含めない)
+static BOOL is_startup_object(const char* base) {
+    static const char* const names[] = { "crt1.o", "crt2.o", "crtbegin.o", "crtend.o", "dllcrt1.o", "dllcrt2.o" };
+    for (size_t i = 0; i < _countof(names); ++i) {
+        if (_stricmp(base, names[i]) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+// 入力ファイルの表記からライブラリ名を決める:
+//   C:/.../libstdc++.a(eh_alloc.o)   -> stdc++
+//   C:/.../libws2_32.a(dxxxs00012.o) -> ws2_32
+//   C:/.../crt2.o                    -> (startup)
+//   C:/Users/.../ccXXXXXX.o          -> (program)
+static void library_name_from_input(const char* input, wchar_t* name, size_t name_size) {
+    char path[1024];
+    strncpy_s(path, sizeof(path), input, _TRUNCATE);
+    size_t len = strlen(path);
+    BOOL is_archive = FALSE;
+    if (len > 0 && path[len - 1] == ')') {
+        char* member = strrchr(path, '(');
+        if (member && member != path) {
+            *member = '\0';
+            is_archive = TRUE;
+        }
+    }
+    const char* base = path;
+    for (const char* p = path; *p; ++p) {
+        if (*p == '/' || *p == '\\') base = p + 1;
+    }
+
+    char label[256];
+    if (is_archive) {
+        strncpy_s(label, sizeof(label), base, _TRUNCATE);
+        if (strncmp(label, "lib", 3) == 0) memmove(label, label + 3, strlen(label + 3) + 1);
+        size_t label_len = strlen(label);
+        if (label_len > 6 && _stricmp(label + label_len - 6, ".dll.a") == 0) label[label_len - 6] = '\0';
+        else if (label_len > 2 && _stricmp(label + label_len - 2, ".a") == 0) label[label_len - 2] = '\0';
+    } else if (is_startup_object(base)) {
+        strcpy_s(label, sizeof(label), "(startup)");
+    } else {
+        strcpy_s(label, sizeof(label), "(program)");
+    }
+    if (MultiByteToWideChar(CP_ACP, 0, label, -1, name, (int)name_size) == 0) wcscpy_s(name, name_size, L"(unknown)");
+}
+
+// 出力セクションの種類: 0 は集計しない (デバッグ情報・.bss など)、1 はコード、2 はファイルに載るデータ
+static int output_section_kind(const char* name) {
+    if (name[0] != '.') return 0; // /DISCARD/ など
+    if (strncmp(name, ".debug", 6) == 0 || strncmp(name, ".zdebug", 7) == 0 || strncmp(name, ".stab", 5) == 0) return 0;
+    if (strncmp(name, ".bss", 4) == 0) return 0;
+    if (strncmp(name, ".text", 5) == 0) return 1;
+    return 2;
+}
+
+// "0xADDR 0xSIZE file" (ファイルが無い場合は FALSE)
+static BOOL parse_input_fields(const char* p, ULONGLONG* address, ULONGLONG* size, const char** file) {
+    char* end = NULL;
+    *address = strtoull(p, &end, 16);
+    if (end == p) return FALSE;
+    p = end;
+    *size = strtoull(p, &end, 16);
+    if (end == p) return FALSE;
+    p = end;
+    while (*p == ' ' || *p == '\t') p++;
+    *file = p;
+    return *p != '\0';
+}
+
+// マップファイルを読み、ライブラリごとのサイズとシンボルを集める (GNU ld 形式でなければ FALSE)
+static BOOL parse_map_file(const wchar_t* map_path, SizeList* libraries, MapSymbolList* symbols) {
+    FILE* in = _wfopen(map_path, L"r");
+    if (!in) return FALSE;
+
+    char line[4096];
+    BOOL in_map = FALSE;
+    int kind = 0;
+    BOOL pending = FALSE;                 // 名前だけの入力セクション行の後 (アドレスとサイズは次の行)
+    ULONGLONG input_end = 0;              // 現在の入力セクションの終端 (シンボルのサイズの上限)
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!in_map) {
+            // それより前の "Discarded input sections" は同じ書式なので読み飛ばす
+            if (strncmp(line, "Linker script and memory map", 28) == 0) in_map = TRUE;
+            continue;
+        }
+        if (line[0] == '\0') continue;
+        if (line[0] != ' ') {
+            // 出力セクション (.text など) か、それ以外の指示 (LOAD, OUTPUT など)
+            kind = output_section_kind(line);
+            pending = FALSE;
+            input_end = 0;
+            continue;
+        }
+        if (kind == 0) continue;
+
+        const char* fields = NULL;
+        if (line[1] != ' ') {
+            // 入力セクション: " .text  0x... 0x... file" (名前が長いと 2 行に分かれる)
+            if (line[1] == '*') { pending = FALSE; input_end = 0; continue; } // *fill* と入力セクションのパターン
+            const char* p = line + 1;
+            while (*p && *p != ' ' && *p != '\t') p++;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p == '\0') { pending = TRUE; continue; }
+            fields = p;
+        } else {
+            const char* p = line;
+            while (*p == ' ' || *p == '\t') p++;
+            if (pending) {
+                fields = p;
+            } else if (input_end != 0) {
+                // 入力セクション内のシンボル: "0xADDR  name" (PROVIDE や代入は除く)
+                char* end = NULL;
+                ULONGLONG address = strtoull(p, &end, 16);
+                if (end == p) continue;
+                while (*end == ' ' || *end == '\t') end++;
+                if (*end == '\0' || strpbrk(end, "=( ")) continue;
+                add_map_symbol(symbols, address, input_end, end);
+                continue;
+            } else {
+                continue;
+            }
+        }
+        pending = FALSE;
+
+        ULONGLONG address, size;
+        const char* file;
+        if (!parse_input_fields(fields, &address, &size, &file) || size == 0) {
+            input_end = 0;
+            continue;
+        }
+        input_end = address + size;
+        wchar_t name[128];
+        library_name_from_input(file, name, _countof(name));
+        SizeEntry* entry = size_list_get(libraries, name);
+        if (!entry) continue;
+        if (kind == 1) entry->code += size;
+        else entry->data += size;
+    }
+    fclose(in);
+    return in_map && libraries->count > 0;
+}
+
+// --- 前回の結果 ---
+// キーはコンパイラとメインソースのフルパス (内容を変えても同じエントリを上書きし、差分を取る)
+static BOOL summary_path(const ProgramOptions* opts, const wchar_t* main_source_full_path, wchar_t* path, size_t path_size) {
+    ULONGLONG key = hash_bytes(opts->compiler_name, wcslen(opts->compiler_name) * sizeof(wchar_t), 0);
+    key = hash_bytes(main_source_full_path, wcslen(main_source_full_path) * sizeof(wchar_t), key);
+    return cache_entry_path(key, L".size", path, path_size);
+}
+
+// 1 行に 1 項目: "file <bytes>" / "section <memory> <file> <name>" / "lib <code> <data> <name>"
+static BOOL load_summary(const wchar_t* path, ULONGLONG* file_size, SizeList* sections, SizeList* libraries) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return FALSE;
+    char* text = (char*)realloc(data, size + 1);
+    if (!text) {
+        free(data);
+        return FALSE;
+    }
+    text[size] = '\0';
+
+    *file_size = 0;
+    char* context = NULL;
+    for (char* line = strtok_s(text, "\n", &context); line; line = strtok_s(NULL, "\n", &context)) {
+        SizeList* list = NULL;
+        char* p = line;
+        if (strncmp(p, "file ", 5) == 0) { *file_size = strtoull(p + 5, NULL, 10); continue; }
+        if (strncmp(p, "section ", 8) == 0) { list = sections; p += 8; }
+        else if (strncmp(p, "lib ", 4) == 0) { list = libraries; p += 4; }
+        else continue;
+        ULONGLONG a = strtoull(p, &p, 10);
+        ULONGLONG b = strtoull(p, &p, 10);
+        if (*p == ' ') p++;
+        wchar_t name[128];
+        if (MultiByteToWideChar(CP_UTF8, 0, p, -1, name, _countof(name)) == 0) continue;
+        SizeEntry* entry = size_list_get(list, name);
+        if (entry) {
+            entry->code = a;
+            entry->data = b;
+        }
+    }
+    free(text);
+    return *file_size != 0;
+}
+
+static void save_summary(const wchar_t* path, ULONGLONG file_size, const SizeList* sections, const SizeList* libraries) {
+    size_t capacity = 64 + (size_t)(sections->count + libraries->count) * 448;
+    char* text = (char*)malloc(capacity);
+    if (!text) return;
+    size_t length = (size_t)sprintf_s(text, capacity, "file %llu\n", file_size);
+    const SizeList* lists[2] = { sections, libraries };
+    const char* tags[2] = { "section", "lib" };
+    for (int l = 0; l < 2; ++l) {
+        for (int i = 0; i < lists[l]->count; ++i) {
+            const SizeEntry* entry = &lists[l]->items[i];
+            char name[384];
+            if (WideCharToMultiByte(CP_UTF8, 0, entry->name, -1, name, sizeof(name), NULL, NULL) == 0) continue;
+            length += (size_t)sprintf_s(text + length, capacity - length, "%s %llu %llu %s\n", tags[l], entry->code, entry->data, name);
+        }
+    }
+    write_file_bytes(path, text, length);
+    free(text);
+}
+
+// --- 表示 ---
+// 前回との差分 ("+1.20 KB" / "-300 B")。変化が無ければ空
+static void format_delta(ULONGLONG current, ULONGLONG previous, wchar_t* text, size_t size) {
+    text[0] = L'\0';
+    if (current == previous) return;
+    wchar_t amount[32];
+    format_bytes(current > previous ? current - previous : previous - current, amount, _countof(amount));
+    swprintf_s(text, size, L"%c%s", current > previous ? L'+' : L'-', amount);
+}
+
+// 一覧の項目の差分欄 (前回の一覧に無ければ "new")
+static void format_entry_delta(ULONGLONG current, const SizeList* previous, const wchar_t* name, BOOL is_section, wchar_t* text, size_t size) {
+    const SizeEntry* before = size_list_find(previous, name);
+    if (!before) wcscpy_s(text, size, L"new");
+    else format_delta(current, is_section ? before->data : before->code + before->data, text, size);
+}
+
+static void print_sections(const SizeList* sections, const SizeList* previous, BOOL has_previous) {
+    wprintf(L"\n%-16s %12s %12s  %s\n", L"Section", L"Memory", L"File", L"Change");
+    for (int i = 0; i < sections->count; ++i) {
+        const SizeEntry* entry = &sections->items[i];
+        wchar_t text[3][32] = {{0}};
+        format_bytes(entry->code, text[0], 32);
+        format_bytes(entry->data, text[1], 32);
+        if (has_previous) format_entry_delta(entry->data, previous, entry->name, TRUE, text[2], 32);
+        wprintf(L"%-16s %12s %12s  %s\n", entry->name, text[0], text[1], text[2]);
+    }
+    for (int i = 0; has_previous && i < previous->count; ++i) {
+        if (!size_list_find(sections, previous->items[i].name)) wprintf(L"%-16s %12s %12s  removed\n", previous->items[i].name, L"-", L"-");
+    }
+}
+
+static void print_libraries(SizeList* libraries, const SizeList* previous, BOOL has_previous) {
+    qsort(libraries->items, libraries->count, sizeof(SizeEntry), compare_entries_desc);
+    wprintf(L"\nContribution by library (from the linker map):\n");
+    wprintf(L"%-24s %12s %12s %12s  %s\n", L"Library", L"Code", L"Data", L"Total", L"Change");
+    wchar_t unused[1024] = {0};
+    for (int i = 0; i < libraries->count; ++i) {
+        const SizeEntry* entry = &libraries->items[i];
+        ULONGLONG total = entry->code + entry->data;
+        if (total == 0) {
+            // lib_map で追加したが、どのシンボルも使われずリンクされなかったライブラリ
+            if (unused[0]) wcscat_s(unused, _countof(unused), L", ");
+            wcscat_s(unused, _countof(unused), entry->name);
+            continue;
+        }
+        wchar_t label[160];
+        wchar_t text[4][32] = {{0}};
+        swprintf_s(label, _countof(label), entry->is_auto ? L"%s (auto)" : L"%s", entry->name);
+        format_bytes(entry->code, text[0], 32);
+        format_bytes(entry->data, text[1], 32);
+        format_bytes(total, text[2], 32);
+        if (has_previous) format_entry_delta(total, previous, entry->name, FALSE, text[3], 32);
+        wprintf(L"%-24s %12s %12s %12s  %s\n", label, text[0], text[1], text[2], text[3]);
+    }
+    for (int i = 0; has_previous && i < previous->count; ++i) {
+        if (!size_list_find(libraries, previous->items[i].name)) wprintf(L"%-24s %12s %12s %12s  removed\n", previous->items[i].name, L"-", L"-", L"-");
+    }
+    if (unused[0]) wprintf(L"Auto-added but not linked in (no symbols used): %s\n", unused);
+}
+
+// マップファイルのシンボル (ストリップしても残る) から大きい順に表示する
+static void print_largest_from_map(MapSymbolList* symbols) {
+    qsort(symbols->items, symbols->count, sizeof(MapSymbol), compare_map_symbols);
+    for (int i = 0; i < symbols->count; ++i) {
+        MapSymbol* symbol = &symbols->items[i];
+        if (i + 1 < symbols->count && symbols->items[i + 1].address < symbol->end) symbol->end = symbols->items[i + 1].address;
+        if (symbol->end < symbol->address) symbol->end = symbol->address;
+    }
+    qsort(symbols->items, symbols->count, sizeof(MapSymbol), compare_map_symbols_by_size);
+    wprintf(L"\nLargest symbols:\n%12s  %s\n", L"Size", L"Symbol");
+    for (int i = 0; i < symbols->count && i < SIZE_REPORT_TOP_SYMBOLS; ++i) {
+        wchar_t text[32];
+        format_bytes(symbols->items[i].end - symbols->items[i].address, text, 32);
+        wprintf(L"%12s  %hs\n", text, symbols->items[i].name);
+    }
+}
+
+static int compare_pe_symbols_by_size(const void* a, const void* b) {
+    ULONGLONG x = ((const PeSymbol*)a)->size;
+    ULONGLONG y = ((const PeSymbol*)b)->size;
+    return (x < y) - (x > y);
+}
+
+// マップファイルが無い場合 (clang + lld など) は実行ファイルのシンボルテーブルを使う
+static void print_largest_from_pe(const wchar_t* executable_path) {
+    PeSymbolTable table;
+    if (!pe_load_symbols(executable_path, &table)) {
+        wprintf(L"\nLargest symbols: unavailable (the executable is stripped; use --debug to keep symbols).\n");
+        return;
+    }
+    qsort(table.symbols, table.count, sizeof(PeSymbol), compare_pe_symbols_by_size);
+    wprintf(L"\nLargest functions:\n%12s  %s\n", L"Size", L"Symbol");
+    for (int i = 0; i < table.count && i < SIZE_REPORT_TOP_SYMBOLS; ++i) {
+        wchar_t text[32];
+        format_bytes(table.symbols[i].size, text, 32);
+        wprintf(L"%12s  %hs\n", text, table.symbols[i].name);
+    }
+    pe_free_symbols(&table);
+}
+
+// --- 公開関数 ---
+BOOL size_report_prepare(const ProgramOptions* opts, const wchar_t* map_path, SizeReportBuild* build) {
+    memset(build, 0, sizeof(SizeReportBuild));
+    build->opts = *opts;
+    build->libraries = (wchar_t*)malloc(sizeof(wchar_t) * 32767);
+    if (!build->libraries) return FALSE;
+    swprintf_s(build->libraries, 32767, L"-Wl,-Map=\"%s\" %s", map_path, opts->user_libraries ? opts->user_libraries : L"");
+    build->opts.user_libraries = build->libraries;
+    return TRUE;
+}
+
+void size_report_free_build(SizeReportBuild* build) {
+    free(build->libraries);
+    memset(build, 0, sizeof(SizeReportBuild));
+}
+
+void size_report_print(const ProgramOptions* opts, const wchar_t* compiler_path, const wchar_t* main_source_full_path, const wchar_t* executable_path, const wchar_t* map_path) {
+    PeSectionTable pe;
+    if (!pe_load_sections(executable_path, &pe)) {
+        fwprintf_err(L"Warning: Could not read the sections of %s.\n", executable_path);
+        return;
+    }
+    SizeList sections = {0}, libraries = {0};
+    for (int i = 0; i < pe.count; ++i) {
+        wchar_t name[64];
+        if (MultiByteToWideChar(CP_UTF8, 0, pe.sections[i].name, -1, name, _countof(name)) == 0) continue;
+        SizeEntry* entry = size_list_get(&sections, name);
+        if (!entry) continue;
+        entry->code = pe.sections[i].virtual_size;
+        entry->data = pe.sections[i].raw_size;
+    }
+
+    MapSymbolList symbols = {0};
+    BOOL has_map = parse_map_file(map_path, &libraries, &symbols);
+    if (has_map) {
+        // lib_map で自動追加したライブラリに印を付ける (リンクされなかったものは 0 バイトで載せる)
+        wchar_t auto_flags[4096] = {0};
+        IncludeSearchPath search;
+        include_search_path_init(&search, opts->compiler_flags, compiler_path);
+        find_libs_in_sources(opts->source_files, opts->num_source_files, &search, auto_flags, _countof(auto_flags), NULL);
+        include_search_path_free(&search);
+        for (wchar_t* token = auto_flags; *token; ) {
+            while (*token == L' ') token++;
+            size_t len = wcscspn(token, L" ");
+            if (len > 2 && wcsncmp(token, L"-l", 2) == 0) {
+                wchar_t name[128];
+                wcsncpy_s(name, _countof(name), token + 2, len - 2);
+                SizeEntry* entry = size_list_get(&libraries, name);
+                if (entry) entry->is_auto = TRUE;
+            }
+            token += len;
+        }
+    }
+
+    wchar_t path[MAX_PATH];
+    BOOL has_path = summary_path(opts, main_source_full_path, path, MAX_PATH);
+    ULONGLONG previous_size = 0;
+    SizeList previous_sections = {0}, previous_libraries = {0};
+    BOOL has_previous = has_path && load_summary(path, &previous_size, &previous_sections, &previous_libraries);
+    if (has_previous && !has_map) previous_libraries.count = 0;
+
+    wchar_t text[3][32];
+    format_bytes(pe.file_size, text[0], 32);
+    wprintf(L"\n--- Size report ---\n");
+    if (has_previous) {
+        format_bytes(previous_size, text[1], 32);
+        format_delta(pe.file_size, previous_size, text[2], 32);
+        wprintf(L"File:     %s (previous build: %s, %s)\n", text[0], text[1], text[2][0] ? text[2] : L"unchanged");
+    } else {
+        wprintf(L"File:     %s\n", text[0]);
+    }
+    format_bytes(pe.headers_size, text[1], 32);
+    format_bytes(pe.symbols_size, text[2], 32);
+    wprintf(L"Headers:  %s   Symbol table: %s%s\n", text[1], text[2], pe.symbols_size ? L"" : L" (stripped)");
+
+    print_sections(&sections, &previous_sections, has_previous);
+    if (has_map) {
+        print_libraries(&libraries, &previous_libraries, has_previous && previous_libraries.count > 0);
+        print_largest_from_map(&symbols);
+    } else {
+        wprintf(L"\nContribution by library: unavailable (the linker did not write a GNU ld map file).\n");
+        print_largest_from_pe(executable_path);
+    }
+    fflush(stdout);
+
+    if (has_path) save_summary(path, pe.file_size, &sections, &libraries);
+
+    for (int i = 0; i < symbols.count; ++i) free(symbols.items[i].name);
+    free(symbols.items);
+    free(sections.items);
+    free(libraries.items);
+    free(previous_sections.items);
+    free(previous_libraries.items);
+    pe_free_sections(&pe);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- 実行ファイルのサイズの内訳 (--size-report) ---
+// セクションごとのサイズは生成した PE を直接読んで求める。ライブラリごとの寄与はリンカ (GNU ld) に
+// -Map でマップファイルを書かせ、入力セクションをアーカイブ単位で集計する。前回の結果はキャッシュに
+// ソースごとに保存し、次の --size-report で差分を表示する
+#define SIZE_REPORT_TOP_SYMBOLS 15
+
+// マップファイルを書かせるビルドの設定
+struct SizeReportBuild {
+    ProgramOptions opts;         // user_libraries に -Wl,-Map を加えたもの
+    wchar_t* libraries;
+};
+
+// --- 関数宣言 ---
+BOOL size_report_prepare(const ProgramOptions* opts, const wchar_t* map_path, SizeReportBuild* build);
+void size_report_free_build(SizeReportBuild* build);
+void size_report_print(const ProgramOptions* opts, const wchar_t* compiler_path, const wchar_t* main_source_full_path, const wchar_t* executable_path, const wchar_t* map_path);
@@ -0,0 +1,69 @@
+#include <windows.h>
+#include "stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// samples を昇順に並べ替えて統計量を求める
+void stats_compute(double* samples, int count, SampleStats* stats) {
+    memset(stats, 0, sizeof(SampleStats));
+    stats->count = count;
+    if (count <= 0) return;
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) sum += samples[i];
+    stats->mean = sum / count;
+    double squares = 0.0;
+    for (int i = 0; i < count; ++i) squares += (samples[i] - stats->mean) * (samples[i] - stats->mean);
+    stats->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0.0;
+    stats->min = samples[0];
+    stats->max = samples[count - 1];
+    stats->median = (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2.0;
+
+    // 中央値より小さい標本の数は二項分布 B(n, 1/2) に従う。その正規近似で95%区間の順位を決める (1始まり)
+    double half_width = 1.96 * sqrt((double)count) / 2.0;
+    int low_rank = (int)floor(count / 2.0 - half_width + 0.5);
+    int high_rank = (int)floor(count / 2.0 + 1.0 + half_width + 0.5);
+    if (low_rank < 1) low_rank = 1;
+    if (high_rank > count) high_rank = count;
+    stats->ci_low = samples[low_rank - 1];
+    stats->ci_high = samples[high_rank - 1];
+}
+
+// 2つの中央値の信頼区間が重なるか (重ならなければ差は偶然ではないとみなせる)
+BOOL stats_intervals_overlap(const SampleStats* a, const SampleStats* b) {
+    return a->ci_low <= b->ci_high && b->ci_low <= a->ci_high;
+}
+
+// Mann-Whitney の U 検定 (両側) の p 値。分布の形を仮定せずに、a と b の分布の位置に差があるかを調べる。
+// 同順位には平均順位を与え、正規近似 (連続性補正付き) で p 値を求める
+double stats_mann_whitney_p(const double* a, int count_a, const double* b, int count_b) {
+    if (count_a <= 0 || count_b <= 0) return 1.0;
+    double rank_sum_a = 0.0;
+    for (int i = 0; i < count_a; ++i) {
+        // a[i] の順位 = (それより小さい値の数) + (同じ値の数 + 1) / 2
+        int less = 0, equal = 0;
+        for (int j = 0; j < count_a; ++j) {
+            if (a[j] < a[i]) less++;
+            else if (a[j] == a[i]) equal++;
+        }
+        for (int j = 0; j < count_b; ++j) {
+            if (b[j] < a[i]) less++;
+            else if (b[j] == a[i]) equal++;
+        }
+        rank_sum_a += less + (equal + 1) / 2.0;
+    }
+    double u = rank_sum_a - count_a * (count_a + 1) / 2.0;
+    double mean = count_a * (double)count_b / 2.0;
+    double sigma = sqrt(count_a * (double)count_b * (count_a + count_b + 1) / 12.0);
+    double distance = fabs(u - mean) - 0.5;
+    if (distance <= 0.0) return 1.0;
+    return erfc(distance / sigma / sqrt(2.0));
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// --- 繰り返し計測の統計 ---
+// 外れ値に強い中央値と、分布を仮定しない中央値の信頼区間 (順序統計量による95%区間) を求める
+struct SampleStats {
+    int count;
+    double min;
+    double max;
+    double mean;
+    double stddev;     // 標本標準偏差 (count が 1 なら 0)
+    double median;
+    double ci_low;     // 中央値の95%信頼区間 (標本が少ないと min/max まで広がる)
+    double ci_high;
+};
+
+// --- 関数宣言 ---
+void stats_compute(double* samples, int count, SampleStats* stats);
+BOOL stats_intervals_overlap(const SampleStats* a, const SampleStats* b);
+double stats_mann_whitney_p(const double* a, int count_a, const double* b, int count_b);
@@ -0,0 +1,509 @@
+#include "sweep.h"
+#include "compare.h"
+#include "process.h"
+#include "stats.h"
+#include "utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+// --- データ構造 ---
+struct SweepPoint {
+    ULONGLONG n;
+    wchar_t input_path[MAX_PATH]; // 値を標準入力で渡す場合のファイル (引数に埋め込む場合は空)
+    double* run_ms;
+    int num_runs;
+    BOOL failed;
+    SampleStats stats;
+};
+
+// 計算量のモデル。当てはめは t = overhead + c * f(n) (overhead はプロセスの起動などの固定費)
+struct ComplexityModel {
+    const wchar_t* name;
+    const char* json_name;
+    double (*f)(double n);
+};
+
+struct ModelFit {
+    double overhead_ms;
+    double coefficient_ms;    // f(n) の 1 単位あたりの時間
+    double error;             // 相対誤差の二乗平均平方根
+    BOOL valid;
+};
+
+static double model_constant(double n) { (void)n; return 1.0; }
+static double model_log(double n) { return log2(n); }
+static double model_linear(double n) { return n; }
+static double model_n_log_n(double n) { return n * log2(n); }
+static double model_quadratic(double n) { return n * n; }
+static double model_cubic(double n) { return n * n * n; }
+
+static const ComplexityModel g_models[] = {
+    { L"O(1)",       "O(1)",       model_constant },
+    { L"O(log n)",   "O(log n)",   model_log },
+    { L"O(n)",       "O(n)",       model_linear },
+    { L"O(n log n)", "O(n log n)", model_n_log_n },
+    { L"O(n^2)",     "O(n^2)",     model_quadratic },
+    { L"O(n^3)",     "O(n^3)",     model_cubic },
+};
+#define NUM_MODELS ((int)_countof(g_models))
+
+// --- 指定の解析 ---
+// "N=1000..10000000:x10" (10 倍ずつ) または "N=100..1000:+100" (100 ずつ)。刻みを省略すると 10 倍ずつ
+BOOL sweep_parse_spec(const wchar_t* spec, wchar_t* name, size_t name_size, double* values, int* count) {
+    *count = 0;
+    const wchar_t* equals = wcschr(spec, L'=');
+    if (!equals || equals == spec || (size_t)(equals - spec) >= name_size) return FALSE;
+    for (const wchar_t* c = spec; c < equals; ++c) {
+        if (!iswalnum(*c) && *c != L'_') return FALSE;
+    }
+    wcsncpy_s(name, name_size, spec, equals - spec);
+
+    wchar_t* end = NULL;
+    double first = wcstod(equals + 1, &end);
+    if (end == equals + 1 || wcsncmp(end, L"..", 2) != 0) return FALSE;
+    const wchar_t* p = end + 2;
+    double last = wcstod(p, &end);
+    if (end == p || first < 1 || last < first) return FALSE;
+    double step = 10;
+    BOOL multiply = TRUE;
+    if (*end == L':') {
+        p = end + 1;
+        if (*p == L'x' || *p == L'*') multiply = TRUE;
+        else if (*p == L'+') multiply = FALSE;
+        else return FALSE;
+        step = wcstod(p + 1, &end);
+        if (end == p + 1 || (multiply ? step <= 1 : step <= 0)) return FALSE;
+    }
+    if (*end != L'\0') return FALSE;
+
+    for (double v = first; v <= last * (1 + 1e-9); v = multiply ? v * step : v + step) {
+        if (*count == SWEEP_MAX_POINTS) return FALSE;
+        values[(*count)++] = floor(v + 0.5);
+    }
+    return *count >= 2;
+}
+
+// --- 実行 ---
+// 引数の {name} を値で置き換えたコマンドを作る。どの引数にも {name} が無ければ substituted は FALSE
+static void build_run_command(const ProgramOptions* opts, const wchar_t* executable, const wchar_t* name, ULONGLONG n,
+                              wchar_t* command, size_t command_size, BOOL* substituted) {
+    wchar_t placeholder[80], value[32];
+    swprintf_s(placeholder, _countof(placeholder), L"{%s}", name);
+    swprintf_s(value, _countof(value), L"%llu", n);
+    size_t placeholder_len = wcslen(placeholder);
+    *substituted = FALSE;
+
+    swprintf_s(command, command_size, L"\"%s\"", executable);
+    for (int i = 0; i < opts->num_program_args; ++i) {
+        wcscat_s(command, command_size, L" \"");
+        for (const wchar_t* p = opts->program_args[i]; *p; ) {
+            const wchar_t* found = wcsstr(p, placeholder);
+            size_t len = found ? (size_t)(found - p) : wcslen(p);
+            wcsncat_s(command, command_size, p, len);
+            p += len;
+            if (found) {
+                wcscat_s(command, command_size, value);
+                p += placeholder_len;
+                *substituted = TRUE;
+            }
+        }
+        wcscat_s(command, command_size, L"\"");
+    }
+}
+
+static double elapsed_ms(const LARGE_INTEGER* start, const LARGE_INTEGER* end, const LARGE_INTEGER* frequency) {
+    return (double)(end->QuadPart - start->QuadPart) * 1000.0 / frequency->QuadPart;
+}
+
+// 1回実行して所要時間を返す (出力は捨てる)
+static BOOL run_point_once(const ProgramOptions* opts, const CompareVariant* build, const wchar_t* name, const SweepPoint* point, double* ms) {
+    wchar_t run_command[32767];
+    BOOL substituted;
+    build_run_command(opts, build->executable, name, point->n, run_command, _countof(run_command), &substituted);
+    ProcessSpawnOptions spawn = {};
+    spawn.output = PROCESS_OUTPUT_NULL;
+    spawn.null_stdin = TRUE;
+    spawn.input_file = point->input_path[0] ? point->input_path : NULL;
+    spawn.limits = opts->limits;
+    spawn.placement = opts->placement;
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    ChildProcess proc;
+    if (!process_spawn(run_command, &spawn, &proc)) {
+        fwprintf_err(L"Error: Failed to start %s\n", build->executable);
+        return FALSE;
+    }
+    DWORD exit_code = 1;
+    process_wait(&proc, INFINITE, &exit_code);
+    QueryPerformanceCounter(&end);
+    ProcessVerdict verdict = proc.verdict;
+    process_close(&proc);
+    *ms = elapsed_ms(&start, &end, &frequency);
+
+    if (verdict != PROCESS_VERDICT_EXITED || exit_code != 0) {
+        fwprintf_err(L"Error: %s=%llu failed (%s, exit code %lu); the point is excluded.\n", name, point->n, process_verdict_name(verdict), exit_code);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// --- 当てはめ ---
+// 相対誤差で重み付けした最小二乗 (重み 1/t^2)。小さい n の短い時間も大きい n と同じ重さで効くようにする。
+// 固定費が負になる場合は固定費 0 で当てはめ直し、係数が負になるモデルは採らない
+static void fit_model(const SweepPoint* points, int count, int model, ModelFit* fit) {
+    memset(fit, 0, sizeof(ModelFit));
+    double s = 0, sf = 0, sff = 0, st = 0, sft = 0;
+    int used = 0;
+    for (int i = 0; i < count; ++i) {
+        if (points[i].failed || points[i].stats.count == 0 || points[i].stats.median <= 0) continue;
+        double t = points[i].stats.median;
+        double f = g_models[model].f((double)points[i].n);
+        double w = 1.0 / (t * t);
+        s += w; sf += w * f; sff += w * f * f; st += w * t; sft += w * f * t;
+        used++;
+    }
+    if (used < 2) return;
+
+    if (model == 0) {
+        fit->overhead_ms = st / s;
+    } else {
+        double det = s * sff - sf * sf;
+        if (det > 0) {
+            fit->coefficient_ms = (s * sft - sf * st) / det;
+            fit->overhead_ms = (st - fit->coefficient_ms * sf) / s;
+        }
+        if (det <= 0 || fit->overhead_ms < 0) {
+            fit->overhead_ms = 0;
+            fit->coefficient_ms = sft / sff;
+        }
+        if (fit->coefficient_ms <= 0) return;
+    }
+
+    double sum = 0;
+    for (int i = 0; i < count; ++i) {
+        if (points[i].failed || points[i].stats.count == 0 || points[i].stats.median <= 0) continue;
+        double t = points[i].stats.median;
+        double predicted = fit->overhead_ms + fit->coefficient_ms * g_models[model].f((double)points[i].n);
+        sum += ((t - predicted) / t) * ((t - predicted) / t);
+    }
+    fit->error = sqrt(sum / used);
+    fit->valid = TRUE;
+}
+
+// f(n) が 0 以下 (O(log n) と O(n log n) の n=1) の点では FALSE
+static BOOL has_unit_cost(int model, ULONGLONG n) {
+    return g_models[model].f((double)n) > 0;
+}
+
+// 単位あたりのコスト (固定費を除いた時間 / f(n))。f(n) が 0 以下なら定義できないので -1
+static double unit_cost(double ms, const ModelFit* fit, int model, ULONGLONG n) {
+    if (!has_unit_cost(model, n)) return -1.0;
+    return (ms - fit->overhead_ms) / g_models[model].f((double)n);
+}
+
+// --- 表示 ---
+static void format_duration(double ms, wchar_t* text, size_t size) {
+    if (ms >= 1.0) swprintf_s(text, size, L"%.3f ms", ms);
+    else if (ms >= 1e-3) swprintf_s(text, size, L"%.2f us", ms * 1e3);
+    else swprintf_s(text, size, L"%.2f ns", ms * 1e6);
+}
+
+// キャッシュの各段の容量 (同じ段で最も大きいもの)
+static void print_cache_sizes(void) {
+    DWORD size = 0;
+    GetLogicalProcessorInformation(NULL, &size);
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info = size ? (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)malloc(size) : NULL;
+    if (!info || !GetLogicalProcessorInformation(info, &size)) {
+        free(info);
+        return;
+    }
+    ULONGLONG caches[4] = {0};
+    for (DWORD i = 0; i < size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); ++i) {
+        if (info[i].Relationship != RelationCache) continue;
+        BYTE level = info[i].Cache.Level;
+        if (level < 1 || level > 3 || (info[i].Cache.Type != CacheData && info[i].Cache.Type != CacheUnified)) continue;
+        if (info[i].Cache.Size > caches[level]) caches[level] = info[i].Cache.Size;
+    }
+    free(info);
+    wprintf(L"Caches:");
+    for (int level = 1; level <= 3; ++level) {
+        if (caches[level] == 0) continue;
+        wchar_t text[32];
+        format_bytes(caches[level], text, 32);
+        wprintf(L" L%d %s", level, text);
+    }
+    wprintf(L"\n");
+}
+
+// 両対数の散布図。'*' は計測した中央値、'.' は最もよく合うモデルの曲線
+static void print_plot(const SweepPoint* points, int count, const ModelFit* fit, int model) {
+    double x_min = 0, x_max = 0, y_min = 0, y_max = 0;
+    BOOL any = FALSE;
+    for (int i = 0; i < count; ++i) {
+        if (points[i].failed || points[i].stats.median <= 0) continue;
+        double x = log10((double)points[i].n), y = log10(points[i].stats.median);
+        if (!any || x < x_min) x_min = x;
+        if (!any || x > x_max) x_max = x;
+        if (!any || y < y_min) y_min = y;
+        if (!any || y > y_max) y_max = y;
+        any = TRUE;
+    }
+    if (!any || x_max <= x_min) return;
+    if (y_max - y_min < 1e-6) { y_min -= 0.5; y_max += 0.5; }
+
+    wchar_t grid[SWEEP_PLOT_HEIGHT][SWEEP_PLOT_WIDTH + 1];
+    for (int r = 0; r < SWEEP_PLOT_HEIGHT; ++r) {
+        wmemset(grid[r], L' ', SWEEP_PLOT_WIDTH);
+        grid[r][SWEEP_PLOT_WIDTH] = L'\0';
+    }
+    if (fit && fit->valid) {
+        for (int c = 0; c < SWEEP_PLOT_WIDTH; ++c) {
+            double n = pow(10.0, x_min + (x_max - x_min) * c / (SWEEP_PLOT_WIDTH - 1));
+            double predicted = fit->overhead_ms + fit->coefficient_ms * g_models[model].f(n);
+            if (predicted <= 0) continue;
+            int r = (int)floor((log10(predicted) - y_min) / (y_max - y_min) * (SWEEP_PLOT_HEIGHT - 1) + 0.5);
+            if (r >= 0 && r < SWEEP_PLOT_HEIGHT) grid[SWEEP_PLOT_HEIGHT - 1 - r][c] = L'.';
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (points[i].failed || points[i].stats.median <= 0) continue;
+        int c = (int)floor((log10((double)points[i].n) - x_min) / (x_max - x_min) * (SWEEP_PLOT_WIDTH - 1) + 0.5);
+        int r = (int)floor((log10(points[i].stats.median) - y_min) / (y_max - y_min) * (SWEEP_PLOT_HEIGHT - 1) + 0.5);
+        grid[SWEEP_PLOT_HEIGHT - 1 - r][c] = L'*';
+    }
+
+    wchar_t top[32], bottom[32];
+    format_duration(pow(10.0, y_max), top, 32);
+    format_duration(pow(10.0, y_min), bottom, 32);
+    wprintf(L"\n");
+    for (int r = 0; r < SWEEP_PLOT_HEIGHT; ++r) {
+        const wchar_t* label = (r == 0) ? top : (r == SWEEP_PLOT_HEIGHT - 1) ? bottom : L"";
+        wprintf(L"%11s |%s\n", label, grid[r]);
+    }
+    wprintf(L"%11s +", L"");
+    for (int c = 0; c < SWEEP_PLOT_WIDTH; ++c) wprintf(L"-");
+    wchar_t left[32], right[32];
+    swprintf_s(left, _countof(left), L"%.0f", pow(10.0, x_min));
+    swprintf_s(right, _countof(right), L"%.0f", pow(10.0, x_max));
+    wprintf(L"\n%11s  %-*s%s\n", L"", SWEEP_PLOT_WIDTH - (int)wcslen(right), left, right);
+    wprintf(L"%11s  (log-log; * = median, . = %s fit)\n", L"", g_models[model].name);
+}
+
+// --- 結果の書き出し (--sweep-output) ---
+// 拡張子が .json なら JSON、それ以外は CSV (点ごとに 1 行)
+static BOOL write_results(const wchar_t* path, const char* name, const SweepPoint* points, int count,
+                          const ModelFit* fits, int best) {
+    FILE* out = _wfopen(path, L"wb");
+    if (!out) return FALSE;
+    const wchar_t* ext = get_extension(path);
+    if (ext && _wcsicmp(ext, L".json") == 0) {
+        fprintf(out, "{\n  \"parameter\": \"%s\",\n  \"points\": [\n", name);
+        for (int i = 0; i < count; ++i) {
+            const SweepPoint* p = &points[i];
+            fprintf(out, "    {\"n\": %llu, \"ok\": %s, \"runs\": %d", p->n, p->failed ? "false" : "true", p->num_runs);
+            if (p->stats.count > 0) {
+                fprintf(out, ", \"median_ms\": %.6f, \"ci_low_ms\": %.6f, \"ci_high_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f, \"samples_ms\": [",
+                        p->stats.median, p->stats.ci_low, p->stats.ci_high, p->stats.min, p->stats.max);
+                for (int r = 0; r < p->num_runs; ++r) fprintf(out, "%s%.6f", r ? ", " : "", p->run_ms[r]);
+                fprintf(out, "]");
+            }
+            fprintf(out, "}%s\n", i + 1 < count ? "," : "");
+        }
+        fprintf(out, "  ],\n  \"fits\": [\n");
+        int written = 0;
+        for (int m = 0; m < NUM_MODELS; ++m) {
+            if (!fits[m].valid) continue;
+            fprintf(out, "%s    {\"model\": \"%s\", \"overhead_ms\": %.6f, \"coefficient_ms\": %.9g, \"rms_relative_error\": %.6f}",
+                    written++ ? ",\n" : "", g_models[m].json_name, fits[m].overhead_ms, fits[m].coefficient_ms, fits[m].error);
+        }
+        fprintf(out, "\n  ],\n  \"best\": %s%s%s\n}\n", best >= 0 ? "\"" : "", best >= 0 ? g_models[best].json_name : "null", best >= 0 ? "\"" : "");
+    } else {
+        fprintf(out, "%s,runs,median_ms,ci_low_ms,ci_high_ms,min_ms,max_ms\n", name);
+        for (int i = 0; i < count; ++i) {
+            const SweepPoint* p = &points[i];
+            if (p->stats.count == 0) fprintf(out, "%llu,0,,,,,\n", p->n);
+            else fprintf(out, "%llu,%d,%.6f,%.6f,%.6f,%.6f,%.6f\n", p->n, p->num_runs, p->stats.median, p->stats.ci_low, p->stats.ci_high, p->stats.min, p->stats.max);
+        }
+    }
+    BOOL ok = !ferror(out);
+    fclose(out);
+    return ok;
+}
+
+static void print_results(const ProgramOptions* opts, const wchar_t* name, const SweepPoint* points, int count, const ModelFit* fits, int best) {
+    wprintf(L"\n--- Sweep %s (%d interleaved runs each) ---\n", name, opts->repeat);
+    wprintf(L"%12s %12s  %-23s %s\n", name, L"Median(ms)", L"95% CI (ms)", best > 0 ? L"Per unit" : L"");
+    for (int i = 0; i < count; ++i) {
+        const SweepPoint* p = &points[i];
+        if (p->stats.count == 0) {
+            wprintf(L"%12llu %12s\n", p->n, L"failed");
+            continue;
+        }
+        wchar_t interval[64], per_unit[32] = {0};
+        swprintf_s(interval, _countof(interval), L"[%.3f, %.3f]", p->stats.ci_low, p->stats.ci_high);
+        if (best > 0) {
+            double cost = unit_cost(p->stats.median, &fits[best], best, p->n);
+            if (cost > 0) format_duration(cost, per_unit, 32);
+        }
+        wprintf(L"%12llu %12.3f  %-23s %s\n", p->n, p->stats.median, interval, per_unit);
+    }
+
+    // 誤差の小さい順にモデルを並べる
+    int order[NUM_MODELS], num_valid = 0;
+    for (int m = 0; m < NUM_MODELS; ++m) {
+        if (!fits[m].valid) continue;
+        int k = num_valid++;
+        while (k > 0 && fits[order[k - 1]].error > fits[m].error) { order[k] = order[k - 1]; k--; }
+        order[k] = m;
+    }
+    if (num_valid == 0) {
+        wprintf(L"\nNot enough successful points to fit a complexity model.\n");
+        return;
+    }
+    wprintf(L"\nComplexity fit (t = overhead + c * f(%s), least squares on relative error):\n", name);
+    wprintf(L"%-12s %12s %16s %10s\n", L"Model", L"Overhead", L"c", L"RMS error");
+    for (int k = 0; k < num_valid; ++k) {
+        const ModelFit* fit = &fits[order[k]];
+        wchar_t overhead[32], coefficient[32];
+        format_duration(fit->overhead_ms, overhead, 32);
+        format_duration(fit->coefficient_ms, coefficient, 32);
+        wprintf(L"%-12s %12s %16s %9.1f%%%s\n", g_models[order[k]].name, overhead, order[k] == 0 ? L"-" : coefficient,
+                fit->error * 100.0, order[k] == best ? L"  <- best" : L"");
+    }
+
+    // 両対数の傾き (固定費を除いた時間)。モデルの間の計算量 (n^1.5 など) の目安になる
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int used = 0;
+    for (int i = 0; i < count; ++i) {
+        double t = points[i].stats.median - fits[best].overhead_ms;
+        if (points[i].stats.count == 0 || t <= 0) continue;
+        double x = log((double)points[i].n), y = log(t);
+        sx += x; sy += y; sxx += x * x; sxy += x * y;
+        used++;
+    }
+    if (used >= 2 && used * sxx - sx * sx > 0) {
+        wprintf(L"Empirical exponent: %.2f (log-log slope of median minus overhead)\n", (used * sxy - sx * sy) / (used * sxx - sx * sx));
+    }
+
+    // 単位あたりのコストの段差 (データがキャッシュに収まらなくなる点など)
+    if (best > 0) {
+        BOOL any_cliff = FALSE;
+        const SweepPoint* previous = NULL;
+        for (int i = 0; i < count; ++i) {
+            const SweepPoint* p = &points[i];
+            if (p->stats.count == 0 || !has_unit_cost(best, p->n)) continue;
+            if (previous) {
+                double before = unit_cost(previous->stats.median, &fits[best], best, previous->n);
+                double after = unit_cost(p->stats.median, &fits[best], best, p->n);
+                double before_high = unit_cost(previous->stats.ci_high, &fits[best], best, previous->n);
+                double after_low = unit_cost(p->stats.ci_low, &fits[best], best, p->n);
+                if (before > 0 && after > before * SWEEP_CLIFF_RATIO && after_low > before_high) {
+                    wprintf(L"Cliff: cost per unit rises %.1fx between %s=%llu and %s=%llu\n", after / before, name, previous->n, name, p->n);
+                    any_cliff = TRUE;
+                }
+            }
+            previous = p;
+        }
+        if (any_cliff) print_cache_sizes();
+    }
+    print_plot(points, count, &fits[best], best);
+}
+
+// --- 公開関数 ---
+// 全ての点が正常に実行できれば 0 を返す
+DWORD run_sweep(const ProgramOptions* opts, const wchar_t* work_dir) {
+    wchar_t name[64];
+    double values[SWEEP_MAX_POINTS];
+    int count = 0;
+    if (!sweep_parse_spec(opts->sweep_spec, name, _countof(name), values, &count)) {
+        fwprintf_err(L"Error: Invalid --sweep '%s' (e.g. \"N=1000..10000000:x10\" or \"N=100..1000:+100\").\n", opts->sweep_spec);
+        return 1;
+    }
+
+    CompareVariant* build = (CompareVariant*)calloc(1, sizeof(CompareVariant));
+    SweepPoint* points = (SweepPoint*)calloc(count, sizeof(SweepPoint));
+    if (!build || !points) {
+        free(build);
+        free(points);
+        return 1;
+    }
+    build->compiler_name = opts->compiler_name;
+    wcscpy_s(build->label, _countof(build->label), opts->compiler_name);
+    if (opts->verbose) wprintf(L"--- Compiling ---\n");
+    DWORD exit_code = 1;
+    if (compare_build_variants(opts, build, 1, work_dir, 1) == 0) goto done;
+
+    // 引数に {name} が無ければ、値を 1 行のファイルにして標準入力に渡す
+    {
+        wchar_t probe[32767];
+        BOOL substituted;
+        build_run_command(opts, build->executable, name, 0, probe, _countof(probe), &substituted);
+        if (!substituted && opts->verbose) wprintf(L"No {%s} in the program arguments; the value is passed on stdin.\n", name);
+        for (int i = 0; i < count; ++i) {
+            SweepPoint* p = &points[i];
+            p->n = (ULONGLONG)values[i];
+            p->run_ms = (double*)malloc(sizeof(double) * opts->repeat);
+            if (!p->run_ms) p->failed = TRUE;
+            if (!substituted) {
+                char line[32];
+                int length = sprintf_s(line, sizeof(line), "%llu\n", p->n);
+                swprintf_s(p->input_path, MAX_PATH, L"%s\\input_%d.txt", work_dir, i);
+                if (!write_file_bytes(p->input_path, line, length)) p->failed = TRUE;
+            }
+        }
+    }
+
+    // 各点を1回ずつ試走してから (計測しない)、点の順をずらしながら交互に計測する
+    fwprintf(stderr, L"Sweeping %s over %d points x %d ", name, count, opts->repeat);
+    for (int i = 0; i < count; ++i) {
+        double ms;
+        if (!points[i].failed && !run_point_once(opts, build, name, &points[i], &ms)) points[i].failed = TRUE;
+    }
+    for (int round = 0; round < opts->repeat; ++round) {
+        for (int k = 0; k < count; ++k) {
+            SweepPoint* p = &points[(round + k) % count];
+            if (p->failed) continue;
+            double ms;
+            if (run_point_once(opts, build, name, p, &ms)) p->run_ms[p->num_runs++] = ms;
+            else p->failed = TRUE;
+        }
+        fwprintf(stderr, L".");
+    }
+    fwprintf(stderr, L"\n");
+
+    {
+        for (int i = 0; i < count; ++i) {
+            if (!points[i].failed && points[i].num_runs > 0) stats_compute(points[i].run_ms, points[i].num_runs, &points[i].stats);
+        }
+        ModelFit fits[NUM_MODELS];
+        int best = -1;
+        for (int m = 0; m < NUM_MODELS; ++m) {
+            fit_model(points, count, m, &fits[m]);
+            if (fits[m].valid && (best < 0 || fits[m].error < fits[best].error)) best = m;
+        }
+        print_results(opts, name, points, count, fits, best);
+
+        if (opts->sweep_output) {
+            char narrow_name[64];
+            WideCharToMultiByte(CP_UTF8, 0, name, -1, narrow_name, sizeof(narrow_name), NULL, NULL);
+            if (write_results(opts->sweep_output, narrow_name, points, count, fits, best)) wprintf(L"Results written to %s\n", opts->sweep_output);
+            else fwprintf_err(L"Error: Could not write %s\n", opts->sweep_output);
+        }
+    }
+
+    exit_code = 0;
+    for (int i = 0; i < count; ++i) {
+        if (points[i].failed) exit_code = 1;
+    }
+done:
+    for (int i = 0; i < count; ++i) free(points[i].run_ms);
+    free(points);
+    free(build);
+    return exit_code;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <windows.h>
+#include "options.h"
+
+// --- 入力サイズの掃引 (--sweep) ---
+// 一度だけビルドし、"N=1000..10000000:x10" の各点でプログラムを繰り返し実行する。値は引数の {N} に
+// 埋め込み、引数に {N} が無ければ標準入力に 1 行で渡す。中央値の系列を計算量のモデル (n, n log n, n^2 …) に
+// 当てはめて最もよく合うものと定数を求め、単位あたりのコストが跳ね上がる点 (キャッシュの段差) を示す
+#define SWEEP_MAX_POINTS 64
+#define SWEEP_CLIFF_RATIO 1.5      // 隣の点との単位あたりコストの比がこれを超えたら段差とみなす
+#define SWEEP_PLOT_WIDTH 64
+#define SWEEP_PLOT_HEIGHT 16
+
+// --- 関数宣言 ---
+BOOL sweep_parse_spec(const wchar_t* spec, wchar_t* name, size_t name_size, double* values, int* count);
+DWORD run_sweep(const ProgramOptions* opts, const wchar_t* work_dir);
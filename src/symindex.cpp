@@ -0,0 +1,471 @@
+#include "symindex.h"
+#include "cache.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_INDEX_MAGIC "CRSYMIX1"
+#define COFF_SYMBOL_SIZE 18
+#define COFF_SYM_CLASS_EXTERNAL 2
+
+// --- 索引ファイルの形式 ---
+// ヘッダーの後に DWORD の配列 (lib_names, lib_flags, slots, symbol_names, symbol_libs) と文字列領域が続く
+struct SymbolIndexHeader {
+    char magic[8];
+    ULONGLONG signature;            // lib ディレクトリの内容 (名前・サイズ・更新日時) のハッシュ
+    DWORD num_libs;
+    DWORD num_symbols;
+    DWORD slot_count;
+    DWORD strings_size;
+};
+
+// コンパイラドライバが既定でリンクするライブラリ (mingw の specs と llvm-mingw の既定値)。
+// 同じシンボルを持つ他のライブラリ (別の CRT など) を誤って選ばないよう、これらを優先して登録する
+static const char* const g_default_libs[] = {
+    "mingw32", "mingwex", "mingwthrd", "moldname", "msvcrt", "ucrt", "ucrtbase", "gcc", "gcc_s", "gcc_eh",
+    "stdc++", "supc++", "c++", "c++abi", "unwind", "pthread", "winpthread", "m",
+    "kernel32", "user32", "advapi32", "shell32",
+};
+static const char* const g_default_lib_prefixes[] = { "api-ms-win", "msvcr", "msvcp", "vcruntime", "ucrt" };
+
+// --- リトルエンディアン/ビッグエンディアン読み出しヘルパー ---
+static WORD rd16(const unsigned char* p) { return (WORD)(p[0] | (p[1] << 8)); }
+static DWORD rd32(const unsigned char* p) { return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24); }
+static DWORD rd32be(const unsigned char* p) { return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | (DWORD)p[3]; }
+
+static DWORD hash_name(const char* s) {
+    DWORD h = 2166136261u; // FNV-1a
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// --- シンボル名の集合 (大文字・小文字を区別する) ---
+struct NameSet {
+    char** names;
+    int* values;
+    int count;
+    int capacity;
+    int* slots;                     // 名前の番号 + 1、0 は空き
+    int slot_count;
+};
+
+// 名前の番号を返す。新しく登録した場合は value を記録する。メモリ不足の場合は -1
+static int name_set_add(NameSet* set, const char* name, size_t len, int value) {
+    if ((set->count + 1) * 2 > set->slot_count) {
+        int slot_count = set->slot_count ? set->slot_count * 2 : 1024;
+        int* slots = (int*)calloc(slot_count, sizeof(int));
+        if (!slots) return -1;
+        for (int i = 0; i < set->count; ++i) {
+            DWORD s = hash_name(set->names[i]) & (slot_count - 1);
+            while (slots[s]) s = (s + 1) & (slot_count - 1);
+            slots[s] = i + 1;
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->slot_count = slot_count;
+    }
+    char key[1024];
+    if (len >= sizeof(key)) return -1;
+    memcpy(key, name, len);
+    key[len] = '\0';
+    DWORD mask = (DWORD)set->slot_count - 1;
+    DWORD s = hash_name(key) & mask;
+    for (; set->slots[s]; s = (s + 1) & mask) {
+        if (strcmp(set->names[set->slots[s] - 1], key) == 0) return set->slots[s] - 1;
+    }
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 1024;
+        char** names = (char**)realloc(set->names, capacity * sizeof(char*));
+        if (!names) return -1;
+        set->names = names;
+        int* values = (int*)realloc(set->values, capacity * sizeof(int));
+        if (!values) return -1;
+        set->values = values;
+        set->capacity = capacity;
+    }
+    set->names[set->count] = _strdup(key);
+    if (!set->names[set->count]) return -1;
+    set->values[set->count] = value;
+    set->slots[s] = ++set->count;
+    return set->count - 1;
+}
+
+static BOOL name_set_contains(const NameSet* set, const char* name) {
+    if (set->slot_count == 0) return FALSE;
+    DWORD mask = (DWORD)set->slot_count - 1;
+    for (DWORD s = hash_name(name) & mask; set->slots[s]; s = (s + 1) & mask) {
+        if (strcmp(set->names[set->slots[s] - 1], name) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static void name_set_free(NameSet* set) {
+    for (int i = 0; i < set->count; ++i) free(set->names[i]);
+    free(set->names);
+    free(set->values);
+    free(set->slots);
+    memset(set, 0, sizeof(NameSet));
+}
+
+// --- lib ディレクトリ ---
+struct LibFile {
+    wchar_t path[MAX_PATH];
+    char name[MAX_PATH];            // -l に渡す名前 (libws2_32.a / libws2_32.dll.a -> ws2_32)
+    BOOL is_default;
+};
+
+static BOOL is_default_lib(const char* name) {
+    for (size_t i = 0; i < _countof(g_default_libs); ++i) {
+        if (strcmp(name, g_default_libs[i]) == 0) return TRUE;
+    }
+    for (size_t i = 0; i < _countof(g_default_lib_prefixes); ++i) {
+        if (strncmp(name, g_default_lib_prefixes[i], strlen(g_default_lib_prefixes[i])) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static int compare_lib_files(const void* a, const void* b) {
+    const LibFile* x = (const LibFile*)a;
+    const LibFile* y = (const LibFile*)b;
+    if (x->is_default != y->is_default) return x->is_default ? -1 : 1; // 既定のライブラリを先に
+    int c = strcmp(x->name, y->name);
+    return c ? c : _wcsicmp(x->path, y->path); // 同名なら libfoo.a より libfoo.dll.a を後に
+}
+
+// ディレクトリ内の lib*.a を列挙し、名前・サイズ・更新日時を signature に混ぜる
+static void list_lib_dir(const wchar_t* dir, LibFile** files, int* count, int* capacity, ULONGLONG* signature) {
+    wchar_t pattern[MAX_PATH];
+    swprintf_s(pattern, MAX_PATH, L"%s\\lib*.a", dir);
+    WIN32_FIND_DATAW find_data;
+    HANDLE h_find = FindFirstFileW(pattern, &find_data);
+    if (h_find == INVALID_HANDLE_VALUE) return;
+    do {
+        if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if (*count == *capacity) {
+            int new_capacity = *capacity ? *capacity * 2 : 512;
+            LibFile* grown = (LibFile*)realloc(*files, new_capacity * sizeof(LibFile));
+            if (!grown) break;
+            *files = grown;
+            *capacity = new_capacity;
+        }
+        LibFile* lib = &(*files)[*count];
+        swprintf_s(lib->path, MAX_PATH, L"%s\\%s", dir, find_data.cFileName);
+        if (WideCharToMultiByte(CP_UTF8, 0, find_data.cFileName + 3, -1, lib->name, sizeof(lib->name), NULL, NULL) <= 0) continue;
+        size_t len = strlen(lib->name);
+        if (len > 6 && strcmp(lib->name + len - 6, ".dll.a") == 0) lib->name[len - 6] = '\0';
+        else if (len > 2) lib->name[len - 2] = '\0';
+        else continue;
+        lib->is_default = is_default_lib(lib->name);
+        (*count)++;
+
+        *signature = hash_bytes(lib->path, wcslen(lib->path) * sizeof(wchar_t), *signature);
+        *signature = hash_bytes(&find_data.nFileSizeLow, sizeof(DWORD), *signature);
+        *signature = hash_bytes(&find_data.ftLastWriteTime, sizeof(FILETIME), *signature);
+    } while (FindNextFileW(h_find, &find_data));
+    FindClose(h_find);
+}
+
+// コンパイラの場所からライブラリの検索ディレクトリを決める (<root>\lib と <root>\<triple>\lib)
+int symbol_index_lib_dirs(const wchar_t* compiler_path, wchar_t dirs[][MAX_PATH], int max_dirs) {
+    wchar_t bin_dir[MAX_PATH], root[MAX_PATH];
+    get_parent_path(compiler_path, bin_dir, MAX_PATH);
+    get_parent_path(bin_dir, root, MAX_PATH);
+    int count = 0;
+    swprintf_s(dirs[count++], MAX_PATH, L"%s\\lib", root);
+
+    wchar_t pattern[MAX_PATH];
+    swprintf_s(pattern, MAX_PATH, L"%s\\*-mingw32", root);
+    WIN32_FIND_DATAW find_data;
+    HANDLE h_find = FindFirstFileW(pattern, &find_data);
+    if (h_find != INVALID_HANDLE_VALUE) {
+        do {
+            if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && count < max_dirs) {
+                swprintf_s(dirs[count++], MAX_PATH, L"%s\\%s\\lib", root, find_data.cFileName);
+            }
+        } while (FindNextFileW(h_find, &find_data));
+        FindClose(h_find);
+    }
+    return count;
+}
+
+// --- アーカイブのシンボル表 (armap) ---
+// 先頭メンバー "/" (GNU/MS 形式、ビッグエンディアン32bit) または "/SYM64/" だけを読み、本体は読まない
+static void read_armap(const wchar_t* path, int lib, NameSet* symbols) {
+    HANDLE h_file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h_file == INVALID_HANDLE_VALUE) return;
+    unsigned char header[8 + 60];
+    DWORD bytes_read = 0;
+    unsigned char* table = NULL;
+    do {
+        if (!ReadFile(h_file, header, sizeof(header), &bytes_read, NULL) || bytes_read != sizeof(header)) break;
+        if (memcmp(header, "!<arch>\n", 8) != 0) break;
+        const char* member_name = (const char*)header + 8;
+        BOOL is_sym64 = memcmp(member_name, "/SYM64/ ", 8) == 0;
+        if (!is_sym64 && memcmp(member_name, "/ ", 2) != 0) break; // シンボル表の無いアーカイブ
+        char size_text[11] = {0};
+        memcpy(size_text, header + 8 + 48, 10);
+        DWORD size = (DWORD)strtoul(size_text, NULL, 10);
+        if (size < 4 || size > 256 * 1024 * 1024) break;
+        table = (unsigned char*)malloc(size + 1);
+        if (!table || !ReadFile(h_file, table, size, &bytes_read, NULL) || bytes_read != size) break;
+        table[size] = '\0';
+
+        size_t entry_size = is_sym64 ? 8 : 4;
+        ULONGLONG num_entries = is_sym64 ? ((ULONGLONG)rd32be(table) << 32 | rd32be(table + 4)) : rd32be(table);
+        size_t strings_offset = entry_size + (size_t)num_entries * entry_size;
+        if (num_entries > size || strings_offset > size) break;
+        const char* p = (const char*)table + strings_offset;
+        const char* end = (const char*)table + size;
+        for (ULONGLONG i = 0; i < num_entries && p < end; ++i) {
+            size_t len = strlen(p);
+            if (len > 0) name_set_add(symbols, p, len, lib); // 最初に登録したライブラリが優先される
+            p += len + 1;
+        }
+    } while (0);
+    free(table);
+    CloseHandle(h_file);
+}
+
+// --- 索引の作成と読み込み ---
+static BOOL attach_index(SymbolIndex* index, const unsigned char* data, size_t size, ULONGLONG signature) {
+    if (size < sizeof(SymbolIndexHeader)) return FALSE;
+    const SymbolIndexHeader* header = (const SymbolIndexHeader*)data;
+    if (memcmp(header->magic, SYMBOL_INDEX_MAGIC, 8) != 0 || header->signature != signature) return FALSE;
+    size_t arrays = ((size_t)header->num_libs * 2 + header->slot_count + (size_t)header->num_symbols * 2) * sizeof(DWORD);
+    if (sizeof(SymbolIndexHeader) + arrays + header->strings_size != size) return FALSE;
+    if (header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0) return FALSE;
+
+    const DWORD* p = (const DWORD*)(data + sizeof(SymbolIndexHeader));
+    index->num_libs = header->num_libs;
+    index->num_symbols = header->num_symbols;
+    index->slot_count = header->slot_count;
+    index->lib_names = p; p += header->num_libs;
+    index->lib_flags = p; p += header->num_libs;
+    index->slots = p; p += header->slot_count;
+    index->symbol_names = p; p += header->num_symbols;
+    index->symbol_libs = p; p += header->num_symbols;
+    index->strings = (const char*)p;
+
+    // 壊れた索引ファイルで範囲外を読まないよう、文字列のオフセットとライブラリの番号を確かめる
+    // (文字列領域は '\0' で終わるので、オフセットが範囲内なら strcmp も範囲内で止まる)
+    if (header->strings_size == 0 || index->strings[header->strings_size - 1] != '\0') return FALSE;
+    for (DWORD i = 0; i < header->num_libs; ++i) {
+        if (index->lib_names[i] >= header->strings_size) return FALSE;
+    }
+    for (DWORD i = 0; i < header->num_symbols; ++i) {
+        if (index->symbol_names[i] >= header->strings_size || index->symbol_libs[i] >= header->num_libs) return FALSE;
+    }
+    index->view = data;
+    return TRUE;
+}
+
+// 全てのライブラリの armap を読み、索引ファイルの内容をメモリ上に組み立てる
+static unsigned char* build_index(const LibFile* libs, int num_libs, ULONGLONG signature, size_t* out_size) {
+    NameSet symbols = {0};
+    for (int i = 0; i < num_libs; ++i) read_armap(libs[i].path, i, &symbols);
+
+    DWORD slot_count = 1024;
+    while (slot_count < (DWORD)symbols.count * 2) slot_count *= 2;
+    size_t strings_size = 0;
+    for (int i = 0; i < num_libs; ++i) strings_size += strlen(libs[i].name) + 1;
+    for (int i = 0; i < symbols.count; ++i) strings_size += strlen(symbols.names[i]) + 1;
+    size_t size = sizeof(SymbolIndexHeader) + ((size_t)num_libs * 2 + slot_count + (size_t)symbols.count * 2) * sizeof(DWORD) + strings_size;
+    unsigned char* data = (unsigned char*)calloc(size, 1);
+    if (!data) { name_set_free(&symbols); return NULL; }
+
+    SymbolIndexHeader* header = (SymbolIndexHeader*)data;
+    memcpy(header->magic, SYMBOL_INDEX_MAGIC, 8);
+    header->signature = signature;
+    header->num_libs = num_libs;
+    header->num_symbols = symbols.count;
+    header->slot_count = slot_count;
+    header->strings_size = (DWORD)strings_size;
+
+    DWORD* lib_names = (DWORD*)(data + sizeof(SymbolIndexHeader));
+    DWORD* lib_flags = lib_names + num_libs;
+    DWORD* slots = lib_flags + num_libs;
+    DWORD* symbol_names = slots + slot_count;
+    DWORD* symbol_libs = symbol_names + symbols.count;
+    char* strings = (char*)(symbol_libs + symbols.count);
+    DWORD offset = 0;
+    for (int i = 0; i < num_libs; ++i) {
+        lib_names[i] = offset;
+        lib_flags[i] = libs[i].is_default ? SYMBOL_LIB_DEFAULT : 0;
+        strcpy(strings + offset, libs[i].name);
+        offset += (DWORD)strlen(libs[i].name) + 1;
+    }
+    for (int i = 0; i < symbols.count; ++i) {
+        symbol_names[i] = offset;
+        symbol_libs[i] = (DWORD)symbols.values[i];
+        strcpy(strings + offset, symbols.names[i]);
+        offset += (DWORD)strlen(symbols.names[i]) + 1;
+        DWORD s = hash_name(symbols.names[i]) & (slot_count - 1);
+        while (slots[s]) s = (s + 1) & (slot_count - 1);
+        slots[s] = (DWORD)i + 1;
+    }
+    name_set_free(&symbols);
+    *out_size = size;
+    return data;
+}
+
+static BOOL map_index_file(const wchar_t* path, SymbolIndex* index, ULONGLONG signature) {
+    index->file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (index->file == INVALID_HANDLE_VALUE) { index->file = NULL; return FALSE; }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(index->file, &size) && size.QuadPart > 0) {
+        index->mapping = CreateFileMappingW(index->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const unsigned char* view = index->mapping ? (const unsigned char*)MapViewOfFile(index->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (view && attach_index(index, view, (size_t)size.QuadPart, signature)) return TRUE;
+        if (view) UnmapViewOfFile(view);
+    }
+    if (index->mapping) CloseHandle(index->mapping);
+    CloseHandle(index->file);
+    index->mapping = NULL;
+    index->file = NULL;
+    index->view = NULL;
+    return FALSE;
+}
+
+// 索引を開く。lib ディレクトリの内容が前回と違えば (または索引が無ければ) 作り直してキャッシュに保存する
+BOOL symbol_index_open(const wchar_t* compiler_path, SymbolIndex* index) {
+    memset(index, 0, sizeof(SymbolIndex));
+    wchar_t dirs[8][MAX_PATH];
+    int num_dirs = symbol_index_lib_dirs(compiler_path, dirs, 8);
+
+    LibFile* libs = NULL;
+    int num_libs = 0, capacity = 0;
+    ULONGLONG dir_key = 0, signature = 0;
+    for (int i = 0; i < num_dirs; ++i) {
+        dir_key = hash_bytes(dirs[i], wcslen(dirs[i]) * sizeof(wchar_t), dir_key);
+        list_lib_dir(dirs[i], &libs, &num_libs, &capacity, &signature);
+    }
+    if (num_libs == 0) { free(libs); return FALSE; }
+    qsort(libs, num_libs, sizeof(LibFile), compare_lib_files);
+
+    wchar_t index_path[MAX_PATH];
+    BOOL have_path = cache_entry_path(dir_key, L".symidx", index_path, MAX_PATH);
+    if (have_path && map_index_file(index_path, index, signature)) { free(libs); return TRUE; }
+
+    size_t size = 0;
+    unsigned char* data = build_index(libs, num_libs, signature, &size);
+    free(libs);
+    if (!data) return FALSE;
+    index->rebuilt = TRUE;
+
+    // 一時ファイルに書いてから置き換える。他の crun が古い索引をマップ中で置き換えられなければ、今回はメモリ上の索引を使う
+    wchar_t temp_path[MAX_PATH];
+    if (have_path && cache_temp_path(dir_key, L".symidx", temp_path, MAX_PATH) && write_file_bytes(temp_path, data, size)) {
+        if (MoveFileExW(temp_path, index_path, MOVEFILE_REPLACE_EXISTING) && map_index_file(index_path, index, signature)) {
+            free(data);
+            return TRUE;
+        }
+        DeleteFileW(temp_path);
+    }
+    index->owned = data;
+    return attach_index(index, data, size, signature);
+}
+
+// シンボルを定義しているライブラリの番号を返す (無ければ -1)
+static int lookup_symbol(const SymbolIndex* index, const char* name) {
+    DWORD mask = index->slot_count - 1;
+    for (DWORD s = hash_name(name) & mask; index->slots[s]; s = (s + 1) & mask) {
+        DWORD symbol = index->slots[s] - 1;
+        if (symbol < index->num_symbols && strcmp(index->strings + index->symbol_names[symbol], name) == 0) {
+            return (int)index->symbol_libs[symbol];
+        }
+    }
+    return -1;
+}
+
+// --- オブジェクトファイルの未定義シンボル ---
+// COFF オブジェクト (gcc/clang の .o) のシンボル表から外部シンボルを読み、定義済みと未定義に分ける
+static BOOL read_object_symbols(const wchar_t* path, NameSet* defined, NameSet* undefined) {
+    unsigned char* data = NULL;
+    size_t size = 0;
+    if (!read_file_bytes(path, &data, &size)) return FALSE;
+
+    BOOL ok = FALSE;
+    do {
+        if (size < 20) break;
+        WORD machine = rd16(data);
+        if (machine != 0x8664 && machine != 0x14c && machine != 0xaa64 && machine != 0x1c4) break; // bigobj などは扱わない
+        DWORD symtab_offset = rd32(data + 8);
+        DWORD num_symbols = rd32(data + 12);
+        size_t strtab_offset = (size_t)symtab_offset + (size_t)num_symbols * COFF_SYMBOL_SIZE;
+        if (strtab_offset + 4 > size) break;
+        const char* strtab = (const char*)(data + strtab_offset);
+        DWORD strtab_size = rd32(data + strtab_offset);
+        if (strtab_offset + strtab_size > size) break;
+
+        for (DWORD i = 0; i < num_symbols; ++i) {
+            const unsigned char* sym = data + symtab_offset + (size_t)i * COFF_SYMBOL_SIZE;
+            short section_number = (short)rd16(sym + 12);
+            BYTE storage_class = sym[16];
+            if (storage_class == COFF_SYM_CLASS_EXTERNAL) {
+                char short_name[9] = {0};
+                const char* name;
+                if (rd32(sym) == 0) {
+                    DWORD name_offset = rd32(sym + 4);
+                    name = (name_offset < strtab_size) ? strtab + name_offset : "";
+                } else {
+                    memcpy(short_name, sym, 8);
+                    name = short_name;
+                }
+                // セクション番号 0 で値も 0 なら未定義 (値があれば共通シンボルで、定義として扱う)
+                BOOL is_undefined = (section_number == 0 && rd32(sym + 8) == 0);
+                if (name[0]) name_set_add(is_undefined ? undefined : defined, name, strlen(name), 0);
+            }
+            i += sym[17]; // 補助シンボルを読み飛ばす
+        }
+        ok = TRUE;
+    } while (0);
+    free(data);
+    return ok;
+}
+
+// オブジェクトの未定義シンボルを索引で引き、必要なライブラリだけを -l フラグとして返す。
+// 既定でリンクされるライブラリのシンボルには何も追加しない。オブジェクトを読めなければ FALSE
+BOOL symbol_index_resolve(const SymbolIndex* index, wchar_t* const* objects, int num_objects, wchar_t* link_flags, size_t link_flags_size, int* num_undefined, int* num_unresolved) {
+    NameSet defined = {0}, undefined = {0};
+    BOOL ok = TRUE;
+    for (int i = 0; i < num_objects && ok; ++i) ok = read_object_symbols(objects[i], &defined, &undefined);
+
+    unsigned char* needed = (unsigned char*)calloc(index->num_libs + 1, 1);
+    ok = ok && needed;
+    *num_undefined = 0;
+    *num_unresolved = 0;
+    for (int i = 0; ok && i < undefined.count; ++i) {
+        if (name_set_contains(&defined, undefined.names[i])) continue; // 他のオブジェクトで定義されている
+        (*num_undefined)++;
+        int lib = lookup_symbol(index, undefined.names[i]);
+        if (lib < 0) (*num_unresolved)++;
+        else if (!(index->lib_flags[lib] & SYMBOL_LIB_DEFAULT)) needed[lib] = 1;
+    }
+
+    link_flags[0] = L'\0';
+    for (DWORD lib = 0; ok && lib < index->num_libs; ++lib) {
+        if (!needed[lib]) continue;
+        wchar_t flag[MAX_PATH + 4];
+        swprintf_s(flag, _countof(flag), L"%s-l%hs", link_flags[0] ? L" " : L"", index->strings + index->lib_names[lib]);
+        if (wcslen(link_flags) + wcslen(flag) >= link_flags_size) { ok = FALSE; break; }
+        wcscat_s(link_flags, link_flags_size, flag);
+    }
+    free(needed);
+    name_set_free(&defined);
+    name_set_free(&undefined);
+    return ok;
+}
+
+void symbol_index_close(SymbolIndex* index) {
+    if (index->mapping) {
+        UnmapViewOfFile(index->view);
+        CloseHandle(index->mapping);
+    }
+    if (index->file) CloseHandle(index->file);
+    free(index->owned);
+    memset(index, 0, sizeof(SymbolIndex));
+}
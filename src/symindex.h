@@ -0,0 +1,32 @@
+#pragma once
+
+#include <windows.h>
+
+// --- シンボル -> ライブラリの索引 (--minimal-link) ---
+// ツールチェーンの lib ディレクトリにある全ての .a のシンボル表 (armap) から作り、キャッシュに保存する。
+// ファイルはそのままメモリにマップして引けるハッシュ表の形式で、lib ディレクトリの内容が変わったときだけ作り直す
+struct SymbolIndex {
+    HANDLE file;
+    HANDLE mapping;
+    const unsigned char* view;      // マップしたファイル (作り直した直後で置き換えられなかった場合は owned)
+    unsigned char* owned;
+    DWORD num_libs;
+    DWORD num_symbols;
+    DWORD slot_count;               // 2のべき乗
+    const DWORD* lib_names;         // ライブラリ名 ("ws2_32" など) の strings 内オフセット
+    const DWORD* lib_flags;         // SYMBOL_LIB_DEFAULT など
+    const DWORD* slots;             // ハッシュ表 (シンボル番号 + 1、0 は空き)
+    const DWORD* symbol_names;      // シンボル名の strings 内オフセット
+    const DWORD* symbol_libs;       // シンボルを最初に定義しているライブラリの番号
+    const char* strings;
+    BOOL rebuilt;                   // 今回作り直したか
+};
+
+// コンパイラドライバが常にリンクするライブラリ (CRT や kernel32 など)。ここにあるシンボルには何も追加しない
+#define SYMBOL_LIB_DEFAULT 0x1
+
+// --- 関数宣言 ---
+BOOL symbol_index_open(const wchar_t* compiler_path, SymbolIndex* index);
+BOOL symbol_index_resolve(const SymbolIndex* index, wchar_t* const* objects, int num_objects, wchar_t* link_flags, size_t link_flags_size, int* num_undefined, int* num_unresolved);
+void symbol_index_close(SymbolIndex* index);
+int symbol_index_lib_dirs(const wchar_t* compiler_path, wchar_t dirs[][MAX_PATH], int max_dirs);
@@ -0,0 +1,71 @@
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <windows.h>
+
+#define PHASE_STACK_DEPTH 16
+
+// --- 計測状態 ---
+static long long g_phase_ticks[PHASE_COUNT];
+static int g_phase_stack[PHASE_STACK_DEPTH];
+static int g_phase_depth = 0;
+static long long g_segment_start = 0; // スタック先頭のフェーズが最後に再開した時刻
+static long long g_clock_start = 0;
+
+static long long now_ticks(void) {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static double ticks_to_us(long long ticks) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)ticks * 1000000.0 / (double)frequency.QuadPart;
+}
+
+// main の先頭で呼び、合計時間の起点にする
+void phase_start_clock(void) {
+    g_clock_start = now_ticks();
+}
+
+void phase_begin(CrunPhase phase) {
+    long long now = now_ticks();
+    if (g_phase_depth > 0 && g_phase_stack[g_phase_depth - 1] == PHASE_OVERLAP) phase = PHASE_OVERLAP;
+    if (g_phase_depth > 0) g_phase_ticks[g_phase_stack[g_phase_depth - 1]] += now - g_segment_start;
+    if (g_phase_depth < PHASE_STACK_DEPTH) g_phase_stack[g_phase_depth++] = phase;
+    g_segment_start = now;
+}
+
+void phase_end(void) {
+    if (g_phase_depth == 0) return;
+    long long now = now_ticks();
+    g_phase_ticks[g_phase_stack[--g_phase_depth]] += now - g_segment_start;
+    g_segment_start = now; // 外側のフェーズを再開する
+}
+
+double phase_elapsed_ms(CrunPhase phase) {
+    return ticks_to_us(g_phase_ticks[phase]) / 1000.0;
+}
+
+// 1回分の計測結果をTSVの1行として追記する (ファイルが空ならヘッダーも書く)。
+// overhead_us は合計からコンパイラ・リンカ・プログラムの実行時間と、コンパイラの実行に隠れた処理の時間を除いた
+// crun 自身の時間
+int phase_write_report(const wchar_t* path) {
+    FILE* out = _wfopen(path, L"ab");
+    if (!out) return 0;
+    fseek(out, 0, SEEK_END);
+    if (ftell(out) == 0) {
+        fprintf(out, "parse_us\tscan_us\tcommand_us\tspawn_us\tcompile_us\trun_us\tcleanup_us\tlink_us\toverlap_us\ttotal_us\toverhead_us\n");
+    }
+    double total = ticks_to_us(now_ticks() - g_clock_start);
+    double phases[PHASE_COUNT];
+    for (int i = 0; i < PHASE_COUNT; ++i) phases[i] = ticks_to_us(g_phase_ticks[i]);
+    double overhead = total - phases[PHASE_COMPILE] - phases[PHASE_LINK] - phases[PHASE_OVERLAP] - phases[PHASE_RUN];
+    for (int i = 0; i < PHASE_COUNT; ++i) fprintf(out, "%.0f\t", phases[i]);
+    fprintf(out, "%.0f\t%.0f\n", total, overhead);
+    fclose(out);
+    return 1;
+}
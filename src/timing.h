@@ -0,0 +1,27 @@
+#pragma once
+
+#include <wchar.h>
+
+// --- crun 自身の処理時間の計測 (--phase-times) ---
+// フェーズは入れ子にでき、内側のフェーズの間は外側のフェーズの計測を止める
+// (例: コマンド構築中のスキャン時間はスキャンにだけ計上される)。
+// ただし PHASE_OVERLAP の中で始めたフェーズは PHASE_OVERLAP に計上する (コンパイラの実行と重なった処理)
+enum CrunPhase {
+    PHASE_PARSE,    // 引数解析
+    PHASE_SCAN,     // #include / #pragma のスキャン
+    PHASE_COMMAND,  // コマンドライン構築 (ユニティファイル生成を含む)
+    PHASE_SPAWN,    // プロセス起動の呼び出し
+    PHASE_COMPILE,  // コンパイラの実行 (起動を除く)
+    PHASE_RUN,      // プログラムの実行 (起動を除く)
+    PHASE_CLEANUP,  // 一時ディレクトリの削除
+    PHASE_LINK,     // リンク (--minimal-link のシンボル解決を含む)
+    PHASE_OVERLAP,  // コンパイラの実行中に行ったスキャンとツールチェーンの問い合わせ
+    PHASE_COUNT
+};
+
+// --- 関数宣言 ---
+void phase_start_clock(void);
+void phase_begin(CrunPhase phase);
+void phase_end(void);
+double phase_elapsed_ms(CrunPhase phase);
+int phase_write_report(const wchar_t* path);
@@ -0,0 +1,134 @@
+#include "unity.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <shlwapi.h> // For PathMatchSpecW
+
+// ソース中にこのマーカーがあるファイルはユニティファイルにまとめない
+#define UNITY_OPT_OUT_MARKER "crun: no-unity"
+
+// --unity-exclude のパターン (ファイル名またはフルパスに対するワイルドカード) か、
+// ソース中のマーカーで除外されているか
+static BOOL is_unity_excluded(const ProgramOptions* opts, const wchar_t* full_path) {
+    const wchar_t* last_slash = wcsrchr(full_path, L'\\');
+    const wchar_t* file_name = last_slash ? last_slash + 1 : full_path;
+    for (int i = 0; i < opts->num_unity_excludes; ++i) {
+        if (PathMatchSpecW(file_name, opts->unity_excludes[i]) || PathMatchSpecW(full_path, opts->unity_excludes[i])) return TRUE;
+    }
+
+    unsigned char* data = NULL;
+    size_t size = 0;
+    BOOL marked = FALSE;
+    if (read_file_bytes(full_path, &data, &size)) {
+        marked = strstr((const char*)data, UNITY_OPT_OUT_MARKER) != NULL;
+        free(data);
+    }
+    return marked;
+}
+
+static BOOL append_file(UnitySources* sources, const wchar_t* path) {
+    wchar_t* copy = _wcsdup(path);
+    if (!copy) return FALSE;
+    sources->files[sources->num_files++] = copy;
+    return TRUE;
+}
+
+// 1グループ分のユニティファイルを書き出す。
+// 元のファイルを #include するため、診断メッセージの位置 (#line 情報) は元のファイルを指したままになる
+static BOOL write_unity_file(const wchar_t* unity_path, wchar_t* const* members, int num_members) {
+    size_t capacity = 128;
+    for (int i = 0; i < num_members; ++i) capacity += wcslen(members[i]) * 3 + 16;
+    char* text = (char*)malloc(capacity);
+    if (!text) return FALSE;
+
+    int length = sprintf(text, "/* crun unity build: %d sources */\n", num_members);
+    for (int i = 0; i < num_members; ++i) {
+        char path_utf8[MAX_PATH * 3];
+        int n = WideCharToMultiByte(CP_UTF8, 0, members[i], -1, path_utf8, sizeof(path_utf8), NULL, NULL);
+        if (n <= 0) { free(text); return FALSE; }
+        for (char* p = path_utf8; *p; ++p) if (*p == '\\') *p = '/'; // 区切り文字をエスケープと誤解されないようにする
+        length += sprintf(text + length, "#include \"%s\"\n", path_utf8);
+    }
+    BOOL ok = write_file_bytes(unity_path, text, (size_t)length);
+    free(text);
+    return ok;
+}
+
+// C と C++ のソースを別々のグループに分け、最大 unity_group_size 個ずつユニティファイルにまとめる
+BOOL write_unity_sources(const ProgramOptions* opts, const wchar_t* output_dir, UnitySources* sources) {
+    memset(sources, 0, sizeof(UnitySources));
+    int n = opts->num_source_files;
+    sources->files = (wchar_t**)calloc(n * 2 + 1, sizeof(wchar_t*));
+    wchar_t** full_paths = (wchar_t**)calloc(n + 1, sizeof(wchar_t*));
+    wchar_t** separate = (wchar_t**)calloc(n + 1, sizeof(wchar_t*));
+    wchar_t** group = (wchar_t**)calloc(n + 1, sizeof(wchar_t*));
+    BOOL* excluded = (BOOL*)calloc(n + 1, sizeof(BOOL));
+    int num_separate = 0;
+    BOOL ok = sources->files && full_paths && separate && group && excluded;
+
+    for (int i = 0; ok && i < n; ++i) {
+        wchar_t full_path[MAX_PATH];
+        if (!GetFullPathNameW(opts->source_files[i], MAX_PATH, full_path, NULL)) {
+            fwprintf_err(L"エラー: ソースファイルのフルパスを取得できませんでした: %s\n", opts->source_files[i]);
+            ok = FALSE;
+            break;
+        }
+        full_paths[i] = _wcsdup(full_path);
+        if (!full_paths[i]) { ok = FALSE; break; }
+        excluded[i] = is_unity_excluded(opts, full_path);
+        if (excluded[i]) separate[num_separate++] = full_paths[i];
+    }
+
+    // まとめないソース (除外されたもの・グループに1つしかないもの) はユニティファイルの後にそのまま渡す
+    wchar_t** direct = (wchar_t**)calloc(n + 1, sizeof(wchar_t*));
+    int num_direct = 0;
+    ok = ok && direct;
+    static const wchar_t* const languages[] = { L".c", L".cpp" };
+    int group_size = opts->unity_group_size > 0 ? opts->unity_group_size : n;
+    for (int lang = 0; ok && lang < 2; ++lang) {
+        int num_group = 0;
+        int num_written = 0;
+        for (int i = 0; ok && i <= n; ++i) {
+            if (i < n) {
+                const wchar_t* ext = get_extension(full_paths[i]);
+                if (excluded[i] || !ext || wcscmp(ext, languages[lang]) != 0) continue;
+                group[num_group++] = full_paths[i];
+                if (num_group < group_size) continue;
+            }
+            if (num_group == 1) {
+                direct[num_direct++] = group[0];
+            } else if (num_group > 1) {
+                wchar_t unity_path[MAX_PATH];
+                swprintf_s(unity_path, MAX_PATH, L"%s\\unity_%s_%d%s", output_dir, languages[lang] + 1, num_written++, languages[lang]);
+                ok = write_unity_file(unity_path, group, num_group) && append_file(sources, unity_path);
+                sources->num_unity_files++;
+                sources->num_merged += num_group;
+            }
+            num_group = 0;
+        }
+    }
+    for (int i = 0; ok && i < num_direct; ++i) ok = append_file(sources, direct[i]);
+    for (int i = 0; ok && i < num_separate; ++i) ok = append_file(sources, separate[i]);
+
+    if (full_paths) for (int i = 0; i < n; ++i) free(full_paths[i]);
+    free(full_paths);
+    free(separate);
+    free(direct);
+    free(group);
+    free(excluded);
+    if (!ok) {
+        fwprintf_err(L"エラー: ユニティファイルを生成できませんでした。\n");
+        free_unity_sources(sources);
+    }
+    return ok;
+}
+
+void free_unity_sources(UnitySources* sources) {
+    if (sources->files) {
+        for (int i = 0; i < sources->num_files; ++i) free(sources->files[i]);
+        free(sources->files);
+    }
+    memset(sources, 0, sizeof(UnitySources));
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "options.h"
+#include <windows.h>
+
+// --- ユニティビルドのコンパイル対象 ---
+struct UnitySources {
+    wchar_t** files;       // コンパイラに渡すファイル (生成したユニティファイル + 対象外のソース)
+    int num_files;
+    int num_unity_files;   // files の先頭から何個が生成したユニティファイルか
+    int num_merged;        // ユニティファイルにまとめたソースの数
+};
+
+// --- 関数宣言 ---
+BOOL write_unity_sources(const ProgramOptions* opts, const wchar_t* output_dir, UnitySources* sources);
+void free_unity_sources(UnitySources* sources);
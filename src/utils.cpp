@@ -1,6 +1,9 @@
 #include "utils.h"
+#include "process.h"
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
 #include <shellapi.h> // For SHFileOperationW
 
 // --- Global State for Cleanup ---
@@ -24,80 +27,41 @@ BOOL file_exists(const wchar_t* path) {
 
 // プロセスを実行し、完了を待つ
 BOOL run_process(wchar_t* command_line, BOOL verbose) {
-    PROCESS_INFORMATION pi = {0};
-    STARTUPINFOW si = {0};
-    si.cb = sizeof(STARTUPINFOW);
+    ProcessSpawnOptions spawn = {};
     // verboseでない場合、コンパイラのコンソールウィンドウを非表示にする
-    if (!verbose) {
-        si.dwFlags |= STARTF_USESHOWWINDOW;
-        si.wShowWindow = SW_HIDE;
-    }
-    if (!CreateProcessW(NULL, command_line, NULL, NULL, FALSE, verbose ? 0 : CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-        return FALSE;
-    }
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    DWORD exit_code;
-    GetExitCodeProcess(pi.hProcess, &exit_code);
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+    spawn.hide_window = !verbose;
+    ChildProcess proc;
+    if (!process_spawn(command_line, &spawn, &proc)) return FALSE;
+    DWORD exit_code = 1;
+    process_wait(&proc, INFINITE, &exit_code);
+    process_close(&proc);
     return exit_code == 0;
 }
 
 // プログラムを実行し、標準入出力を引き継いで終了コードを取得
 BOOL run_program_and_get_exit_code(wchar_t* command_line, DWORD* p_exit_code) {
-    PROCESS_INFORMATION pi = {0};
-    STARTUPINFOW si = {0};
-    si.cb = sizeof(STARTUPINFOW);
-    si.dwFlags |= STARTF_USESTDHANDLES;
-    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
-    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
-    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
-    if (!CreateProcessW(NULL, command_line, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi)) {
-        return FALSE;
-    }
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    GetExitCodeProcess(pi.hProcess, p_exit_code);
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+    ChildProcess proc;
+    if (!process_spawn(command_line, NULL, &proc)) return FALSE;
+    process_wait(&proc, INFINITE, p_exit_code);
+    process_close(&proc);
     return TRUE;
 }
 
 // プロセスを実行し、その標準出力をキャプチャする
 BOOL run_process_and_capture_output(wchar_t* command_line, wchar_t** output) {
-    HANDLE h_child_stdout_rd, h_child_stdout_wr;
-    SECURITY_ATTRIBUTES sa_attr = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
-    if (!CreatePipe(&h_child_stdout_rd, &h_child_stdout_wr, &sa_attr, 0) || !SetHandleInformation(h_child_stdout_rd, HANDLE_FLAG_INHERIT, 0)) return FALSE;
-
-    PROCESS_INFORMATION pi = {0};
-    STARTUPINFOW si = {0};
-    si.cb = sizeof(STARTUPINFOW);
-    si.dwFlags |= STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE;
-    si.hStdOutput = h_child_stdout_wr;
-    si.hStdError = h_child_stdout_wr; // 標準エラー出力もキャプチャ
-    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
-
-    if (!CreateProcessW(NULL, command_line, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
-        CloseHandle(h_child_stdout_rd); CloseHandle(h_child_stdout_wr);
-        return FALSE;
-    }
-    CloseHandle(h_child_stdout_wr); // 書き込みハンドルは不要なので閉じる
+    ProcessSpawnOptions spawn = {};
+    spawn.output = PROCESS_OUTPUT_CAPTURE; // 標準エラー出力もキャプチャ
+    spawn.hide_window = TRUE;
+    ChildProcess proc;
+    if (!process_spawn(command_line, &spawn, &proc)) return FALSE;
 
     // パイプから出力を読み取る
-    char buffer[1024];
-    DWORD bytes_read, total_size = 0;
     char* narrow_output = NULL;
-    while (ReadFile(h_child_stdout_rd, buffer, sizeof(buffer), &bytes_read, NULL) && bytes_read != 0) {
-        char* new_output = (char*)realloc(narrow_output, total_size + bytes_read);
-        if (!new_output) { free(narrow_output); CloseHandle(h_child_stdout_rd); return FALSE; }
-        narrow_output = new_output;
-        memcpy(narrow_output + total_size, buffer, bytes_read);
-        total_size += bytes_read;
+    if (!process_read_output(&proc, &narrow_output, NULL)) {
+        process_terminate(&proc);
+        process_close(&proc);
+        return FALSE;
     }
-    char* final_output = (char*)realloc(narrow_output, total_size + 1);
-    if (!final_output) { free(narrow_output); CloseHandle(h_child_stdout_rd); return FALSE; }
-    narrow_output = final_output;
-    narrow_output[total_size] = '\0';
 
     // UTF-8からワイド文字列に変換
     int wchars_num = MultiByteToWideChar(CP_UTF8, 0, narrow_output, -1, NULL, 0);
@@ -105,11 +69,9 @@ BOOL run_process_and_capture_output(wchar_t* command_line, wchar_t** output) {
     if (*output) MultiByteToWideChar(CP_UTF8, 0, narrow_output, -1, *output, wchars_num);
     free(narrow_output);
 
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    DWORD exit_code;
-    GetExitCodeProcess(pi.hProcess, &exit_code);
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+    DWORD exit_code = 1;
+    process_wait(&proc, INFINITE, &exit_code);
+    process_close(&proc);
     return exit_code == 0;
 }
 
@@ -203,6 +165,37 @@ BOOL read_file_content_wide(const wchar_t* path, wchar_t** content) {
     return TRUE;
 }
 
+// ファイル内容をバイト列のまま読み込む (バイナリ解析用)
+BOOL read_file_bytes(const wchar_t* path, unsigned char** data, size_t* size) {
+    HANDLE h_file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h_file == INVALID_HANDLE_VALUE) return FALSE;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(h_file, &file_size) || file_size.QuadPart > 0x7FFFFFFF) { CloseHandle(h_file); return FALSE; }
+
+    *data = (unsigned char*)malloc((size_t)file_size.QuadPart + 1);
+    if (!*data) { CloseHandle(h_file); return FALSE; }
+
+    DWORD bytes_read;
+    if (!ReadFile(h_file, *data, (DWORD)file_size.QuadPart, &bytes_read, NULL) || bytes_read != (DWORD)file_size.QuadPart) {
+        free(*data); *data = NULL; CloseHandle(h_file); return FALSE;
+    }
+    CloseHandle(h_file);
+    (*data)[bytes_read] = 0;
+    *size = bytes_read;
+    return TRUE;
+}
+
+// バイト列をファイルに書き出す (既存のファイルは上書き)
+BOOL write_file_bytes(const wchar_t* path, const void* data, size_t size) {
+    HANDLE h_file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h_file == INVALID_HANDLE_VALUE) return FALSE;
+    DWORD bytes_written;
+    BOOL ok = WriteFile(h_file, data, (DWORD)size, &bytes_written, NULL) && bytes_written == (DWORD)size;
+    CloseHandle(h_file);
+    return ok;
+}
+
 // crunの一時ディレクトリを掃除する
 void clean_temp_directories(const wchar_t* target_dir) {
     wchar_t search_path[MAX_PATH];
@@ -238,3 +231,102 @@ void clean_temp_directories(const wchar_t* target_dir) {
         wprintf(L"No crun temporary directories found to clean.\n");
     }
 }
+
+
+// ファイルの最終更新日時を取得
+BOOL get_file_write_time(const wchar_t* path, FILETIME* write_time) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data)) return FALSE;
+    *write_time = data.ftLastWriteTime;
+    return TRUE;
+}
+
+// バイト数を B/KB/MB/GB の読みやすい表記にする
+void format_bytes(ULONGLONG bytes, wchar_t* text, size_t size) {
+    if (bytes >= 1024ULL * 1024 * 1024) swprintf_s(text, size, L"%.2f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+    else if (bytes >= 1024 * 1024) swprintf_s(text, size, L"%.2f MB", bytes / (1024.0 * 1024.0));
+    else if (bytes >= 1024) swprintf_s(text, size, L"%.2f KB", bytes / 1024.0);
+    else swprintf_s(text, size, L"%llu B", bytes);
+}
+
+// FNV-1a (64bit) ハッシュ。seed に前回の結果を渡すと複数のバッファを連結してハッシュできる
+ULONGLONG hash_bytes(const void* data, size_t size, ULONGLONG seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    ULONGLONG hash = seed ? seed : 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// --- 文字列の集合 (インターン) ---
+static unsigned int string_set_hash(const wchar_t* s, size_t len) {
+    unsigned int h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned int)towlower(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static BOOL string_set_rehash(StringSet* set, int slot_count) {
+    int* slots = (int*)calloc(slot_count, sizeof(int));
+    if (!slots) return FALSE;
+    for (int id = 0; id < set->count; ++id) {
+        unsigned int i = string_set_hash(set->items[id], wcslen(set->items[id])) & (slot_count - 1);
+        while (slots[i]) i = (i + 1) & (slot_count - 1);
+        slots[i] = id + 1;
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->slot_count = slot_count;
+    return TRUE;
+}
+
+// s の先頭 len 文字を登録してIDを返す (登録済みなら既存のID)。メモリ不足の場合は -1
+int string_set_intern(StringSet* set, const wchar_t* s, size_t len, BOOL* added) {
+    if (added) *added = FALSE;
+    if ((set->count + 1) * 2 > set->slot_count) { // 負荷率を 1/2 以下に保つ
+        if (!string_set_rehash(set, set->slot_count ? set->slot_count * 2 : 64)) return -1;
+    }
+    unsigned int mask = (unsigned int)set->slot_count - 1;
+    unsigned int i = string_set_hash(s, len) & mask;
+    for (; set->slots[i]; i = (i + 1) & mask) {
+        const wchar_t* item = set->items[set->slots[i] - 1];
+        if (_wcsnicmp(item, s, len) == 0 && item[len] == L'\0') return set->slots[i] - 1;
+    }
+
+    if (set->count == set->items_capacity) {
+        int capacity = set->items_capacity ? set->items_capacity * 2 : 64;
+        wchar_t** items = (wchar_t**)realloc(set->items, capacity * sizeof(wchar_t*));
+        if (!items) return -1;
+        set->items = items;
+        set->items_capacity = capacity;
+    }
+    wchar_t* copy = (wchar_t*)malloc((len + 1) * sizeof(wchar_t));
+    if (!copy) return -1;
+    wmemcpy(copy, s, len);
+    copy[len] = L'\0';
+    set->items[set->count] = copy;
+    set->slots[i] = ++set->count;
+    if (added) *added = TRUE;
+    return set->count - 1;
+}
+
+int string_set_find(const StringSet* set, const wchar_t* s, size_t len) {
+    if (set->slot_count == 0) return -1;
+    unsigned int mask = (unsigned int)set->slot_count - 1;
+    for (unsigned int i = string_set_hash(s, len) & mask; set->slots[i]; i = (i + 1) & mask) {
+        const wchar_t* item = set->items[set->slots[i] - 1];
+        if (_wcsnicmp(item, s, len) == 0 && item[len] == L'\0') return set->slots[i] - 1;
+    }
+    return -1;
+}
+
+void string_set_free(StringSet* set) {
+    for (int i = 0; i < set->count; ++i) free(set->items[i]);
+    free(set->items);
+    free(set->slots);
+    memset(set, 0, sizeof(StringSet));
+}
@@ -9,6 +9,17 @@
 extern "C" {
 #endif
 
+// --- 文字列の集合 (インターン) ---
+// 文字列に 0 から始まる連番のIDを振り、開番地法のハッシュ表で引く。
+// パスとライブラリ名の比較に使うため、大文字・小文字は区別しない
+typedef struct StringSet {
+    wchar_t** items;    // ID -> 文字列
+    int count;
+    int items_capacity;
+    int* slots;         // ハッシュ表 (ID + 1、0 は空き)
+    int slot_count;     // 2のべき乗
+} StringSet;
+
 void fwprintf_err(const wchar_t* format, ...);
 BOOL file_exists(const wchar_t* path);
 BOOL run_process(wchar_t* command_line, BOOL verbose);
@@ -20,7 +31,15 @@ const wchar_t* get_extension(const wchar_t* path);
 void get_stem(const wchar_t* path, wchar_t* stem, size_t stem_size);
 BOOL remove_directory_recursively(const wchar_t* path);
 BOOL read_file_content_wide(const wchar_t* path, wchar_t** content);
+BOOL read_file_bytes(const wchar_t* path, unsigned char** data, size_t* size);
+BOOL write_file_bytes(const wchar_t* path, const void* data, size_t size);
 void clean_temp_directories(const wchar_t* target_dir);
+BOOL get_file_write_time(const wchar_t* path, FILETIME* write_time);
+void format_bytes(ULONGLONG bytes, wchar_t* text, size_t size);
+ULONGLONG hash_bytes(const void* data, size_t size, ULONGLONG seed);
+int string_set_intern(StringSet* set, const wchar_t* s, size_t len, BOOL* added);
+int string_set_find(const StringSet* set, const wchar_t* s, size_t len);
+void string_set_free(StringSet* set);
 
 #ifdef __cplusplus
 }
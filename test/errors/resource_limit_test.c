@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --timeout / --cpu-limit / --mem-limit の動作確認用
+//   crun resource_limit_test.c loop  --timeout 1     -> timeout
+//   crun resource_limit_test.c loop  --cpu-limit 1   -> cpu limit
+//   crun resource_limit_test.c alloc --mem-limit 64M -> memory limit
+//   crun resource_limit_test.c crash                 -> crash
+int main(int argc, char* argv[]) {
+    const char* mode = (argc > 1) ? argv[1] : "loop";
+
+    if (strcmp(mode, "alloc") == 0) {
+        // 確保したページに書き込み、実際にメモリを消費させる
+        for (size_t total = 0;; total += 16 << 20) {
+            char* block = (char*)malloc(16 << 20);
+            if (!block) {
+                printf("malloc failed after %zu MB\n", total >> 20);
+                return 1;
+            }
+            memset(block, 1, 16 << 20);
+        }
+    }
+    if (strcmp(mode, "crash") == 0) {
+        volatile int* p = NULL;
+        *p = 42;
+        return 0;
+    }
+
+    volatile unsigned long long counter = 0;
+    for (;;) counter++;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// include_path_test.c から -I で見つけるラッパーヘッダー。
+// crun は -I のディレクトリからこのヘッダーを見つけて読み、winsock2.h から -lws2_32 を追加する
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+static int net_startup(void) {
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include <net_helpers.h>
+
+// -I で指定したディレクトリのヘッダー経由で必要になるライブラリ (ws2_32) の検出を確かめる
+// 例: crun test/features/include_path_test.c --cflags "-Itest/features/include"
+int main() {
+    if (!net_startup()) {
+        printf("WSAStartup failed.\n");
+        return 1;
+    }
+    struct in_addr address;
+    if (inet_pton(AF_INET, "127.0.0.1", &address) == 1) {
+        printf("Parsed 127.0.0.1 -> 0x%08lx\n", (unsigned long)ntohl(address.s_addr));
+    }
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// --modules 用のサンプル: 重い標準ヘッダーをいくつも使う。2 回目からはキャッシュしたヘッダーユニットを読み込む
+// 例: crun test/features/modules_test.cpp --modules
+
+int main() {
+    std::vector<std::string> words = {"modules", "header", "unit", "header", "modules", "header"};
+    std::map<std::string, int> counts;
+    for (const std::string& word : words) counts[word]++;
+
+    std::vector<std::pair<std::string, int>> sorted(counts.begin(), counts.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    for (const auto& entry : sorted) std::cout << entry.first << ": " << entry.second << "\n";
+
+    if (sorted[0].first == "header" && sorted[0].second == 3) {
+        std::cout << "\nResult is correct.\n";
+        return 0;
+    }
+    std::cout << "\nResult is incorrect.\n";
+    return 1;
+}
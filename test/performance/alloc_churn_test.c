@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --alloc-stats 用のサンプル: 小さな確保の繰り返しと、伸長する realloc を行う
+// 例: crun test/performance/alloc_churn_test.c --alloc-stats
+typedef struct Node {
+    struct Node* next;
+    char name[24];
+} Node;
+
+static Node* push_node(Node* head, int i) {
+    Node* node = (Node*)malloc(sizeof(Node));
+    if (!node) return head;
+    snprintf(node->name, sizeof(node->name), "node-%d", i);
+    node->next = head;
+    return node;
+}
+
+static char* append(char* buffer, size_t* length, const char* text) {
+    size_t n = strlen(text);
+    char* grown = (char*)realloc(buffer, *length + n + 1); // 毎回伸長する (realloc の移動とコピーの例)
+    if (!grown) return buffer;
+    memcpy(grown + *length, text, n + 1);
+    *length += n;
+    return grown;
+}
+
+int main(void) {
+    Node* head = NULL;
+    for (int i = 0; i < 100000; i++) head = push_node(head, i);
+
+    char* text = NULL;
+    size_t length = 0;
+    int count = 0;
+    for (Node* node = head; node; node = node->next) {
+        if (count++ % 100 == 0) text = append(text, &length, node->name);
+    }
+    printf("nodes: %d, text length: %lu\n", count, (unsigned long)length);
+
+    while (head) {
+        Node* next = head->next;
+        free(head);
+        head = next;
+    }
+    free(text);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#!/bin/sh
+# crun 自身のオーバーヘッドを計測するベンチマーク (make bench / make bench-baseline から実行)
+#
+# 合成したソースツリーに対して crun を --phase-times 付きで繰り返し実行し、
+# 各フェーズ (引数解析・スキャン・コマンド構築・プロセス起動・後片付け) の中央値を
+# コンパイラやプログラムの実行時間とは分けて集計する。保存済みのベースラインと比べ、
+# しきい値を超えて遅くなったフェーズがあれば終了コード 1 を返す。
+#
+# 環境変数:
+#   CRUN             crun の実行コマンド (既定: Windows では bin/crun.exe、それ以外では wine bin/crun.exe)
+#   BENCH_REPEAT     各シナリオの実行回数 (既定: 5)
+#   BENCH_THRESHOLD  回帰とみなす増加率 [%] (既定: 10)
+#   BENCH_MIN_DELTA  回帰とみなす最小の増加量 [us] (既定: 500。短いフェーズのノイズを無視する)
+#   BENCH_SCENARIOS  実行するシナリオ名 (空白区切り。既定: 全シナリオ)
+#   BENCH_WORK_DIR   合成ソースと計測結果の置き場所 (既定: .bench)
+set -eu
+
+ROOT_DIR=$(cd "$(dirname "$0")/../.." && pwd)
+BASELINE="$ROOT_DIR/test/performance/bench_baseline.tsv"
+WORK_DIR=${BENCH_WORK_DIR:-"$ROOT_DIR/.bench"}
+REPEAT=${BENCH_REPEAT:-5}
+THRESHOLD=${BENCH_THRESHOLD:-10}
+MIN_DELTA=${BENCH_MIN_DELTA:-500}
+SCENARIOS=${BENCH_SCENARIOS:-"tu_1 tu_10 tu_100 tu_1000 include_shallow include_deep amalgamation pragma_heavy"}
+UPDATE_BASELINE=0
+[ "${1:-}" = "--update-baseline" ] && UPDATE_BASELINE=1
+
+# 比べるベースラインが無ければ計測しても判定できないので、先に記録してもらう
+if [ "$UPDATE_BASELINE" -eq 0 ] && [ ! -f "$BASELINE" ]; then
+    echo "No baseline found at $BASELINE." >&2
+    echo "Record one on a Windows machine with 'make bench-baseline' and commit it, then run 'make bench'." >&2
+    exit 1
+fi
+
+if [ -z "${CRUN:-}" ]; then
+    case "$(uname -s)" in
+        MINGW*|MSYS*|CYGWIN*) CRUN="$ROOT_DIR/bin/crun.exe" ;;
+        *) CRUN="wine $ROOT_DIR/bin/crun.exe" ;;
+    esac
+fi
+
+# --- 合成ソースツリーの生成 ---
+gen_tu() { # $1: 翻訳単位の数
+    n=$1
+    i=1
+    : > decls.h
+    while [ "$i" -lt "$n" ]; do
+        printf 'int f%d(int x) { return x * %d + 1; }\n' "$i" "$i" > "t$i.c"
+        printf 'int f%d(int x);\n' "$i" >> decls.h
+        i=$((i + 1))
+    done
+    {
+        printf '#include <stdio.h>\n#include "decls.h"\nint main(void) {\n    int acc = 0;\n'
+        i=1
+        while [ "$i" -lt "$n" ]; do printf '    acc += f%d(acc);\n' "$i"; i=$((i + 1)); done
+        printf '    printf("%%d\\n", acc);\n    return 0;\n}\n'
+    } > main.c
+    i=1
+    ARGS="main.c"
+    while [ "$i" -lt "$n" ]; do ARGS="$ARGS t$i.c"; i=$((i + 1)); done
+}
+
+gen_include_shallow() { # main.c が 200 個のヘッダーを直接インクルードする
+    : > main.c
+    i=0
+    while [ "$i" -lt 200 ]; do
+        printf '#pragma once\n#include <string.h>\nstatic inline int h%d(void) { return %d; }\n' "$i" "$i" > "h$i.h"
+        printf '#include "h%d.h"\n' "$i" >> main.c
+        i=$((i + 1))
+    done
+    printf 'int main(void) { return h0() + h199() - 199; }\n' >> main.c
+    ARGS="main.c"
+}
+
+gen_include_deep() { # h0.h -> h1.h -> ... -> h199.h の深いインクルードチェーン
+    i=0
+    while [ "$i" -lt 200 ]; do
+        next=$((i + 1))
+        if [ "$i" -lt 199 ]; then
+            printf '#pragma once\n#include "h%d.h"\nstatic inline int d%d(void) { return %d; }\n' "$next" "$i" "$i" > "h$i.h"
+        else
+            printf '#pragma once\n#include <math.h>\nstatic inline int d%d(void) { return %d; }\n' "$i" "$i" > "h$i.h"
+        fi
+        i=$next
+    done
+    printf '#include "h0.h"\nint main(void) { return d0() + d199() - 199; }\n' > main.c
+    ARGS="main.c"
+}
+
+gen_amalgamation() { # 約4MBの単一ソース
+    awk 'BEGIN {
+        print "#include <stdio.h>";
+        for (i = 0; i < 24000; i++) {
+            printf "static int fn_%d(int x) { int y = x ^ %d; y = (y << 3) - (y >> 2) + %d; return y %% 9973; } /* padding padding padding padding padding padding padding padding padding */\n", i, i, i;
+        }
+        print "int main(void) {";
+        print "    int acc = 0;";
+        for (i = 0; i < 24000; i += 97) printf "    acc += fn_%d(acc);\n", i;
+        print "    printf(\"%d\\n\", acc);";
+        print "    return 0;";
+        print "}";
+    }' > main.c
+    ARGS="main.c"
+}
+
+gen_pragma_heavy() { # #pragma comment(lib, ...) を大量に含むソース
+    awk 'BEGIN {
+        split("user32 gdi32 ws2_32 ole32 shell32 advapi32 winmm comdlg32 version shlwapi", libs, " ");
+        for (i = 0; i < 2000; i++) printf "#pragma comment(lib, \"%s\")\n", libs[(i % 10) + 1];
+        print "int main(void) { return 0; }";
+    }' > main.c
+    ARGS="main.c"
+}
+
+generate() { # $1: シナリオ名
+    case "$1" in
+        tu_*) gen_tu "${1#tu_}" ;;
+        include_shallow) gen_include_shallow ;;
+        include_deep) gen_include_deep ;;
+        amalgamation) gen_amalgamation ;;
+        pragma_heavy) gen_pragma_heavy ;;
+        *) echo "unknown scenario: $1" >&2; exit 2 ;;
+    esac
+}
+
+# --- 計測 ---
+# phase.tsv の各列の中央値を "scenario<TAB>値..." の1行で出力する
+median_row() { # $1: シナリオ名, $2: phase.tsv
+    awk -F '\t' -v name="$1" '
+        NR == 1 { cols = NF; next }
+        { rows++; for (c = 1; c <= NF; c++) v[c, rows] = $c + 0 }
+        END {
+            line = name;
+            for (c = 1; c <= cols; c++) {
+                # 挿入ソートで中央値を求める (行数は BENCH_REPEAT 程度)
+                for (i = 1; i <= rows; i++) s[i] = v[c, i];
+                for (i = 2; i <= rows; i++) { x = s[i]; j = i - 1; while (j > 0 && s[j] > x) { s[j + 1] = s[j]; j-- } s[j + 1] = x }
+                m = (rows % 2) ? s[(rows + 1) / 2] : (s[rows / 2] + s[rows / 2 + 1]) / 2;
+                line = line "\t" int(m);
+            }
+            print line;
+        }' "$2"
+}
+
+RESULTS="$WORK_DIR/results.tsv"
+mkdir -p "$WORK_DIR"
+printf 'scenario\tparse_us\tscan_us\tcommand_us\tspawn_us\tcompile_us\trun_us\tcleanup_us\tlink_us\toverlap_us\ttotal_us\toverhead_us\n' > "$RESULTS"
+
+for scenario in $SCENARIOS; do
+    dir="$WORK_DIR/$scenario"
+    rm -rf "$dir"
+    mkdir -p "$dir"
+    (
+        cd "$dir"
+        generate "$scenario"
+        printf '%-16s ' "$scenario" >&2
+        run=0
+        while [ "$run" -lt "$REPEAT" ]; do
+            # shellcheck disable=SC2086
+            if ! $CRUN $ARGS --phase-times phase.tsv > run.log 2>&1; then
+                echo "FAILED (see $dir/run.log)" >&2
+                exit 1
+            fi
+            printf '.' >&2
+            run=$((run + 1))
+        done
+        echo >&2
+    )
+    median_row "$scenario" "$dir/phase.tsv" >> "$RESULTS"
+done
+
+echo
+column -t -s "$(printf '\t')" "$RESULTS" 2>/dev/null || cat "$RESULTS"
+
+if [ "$UPDATE_BASELINE" -eq 1 ]; then
+    cp "$RESULTS" "$BASELINE"
+    echo
+    echo "Baseline updated: $BASELINE"
+    exit 0
+fi
+
+# --- ベースラインとの比較 (コンパイラとプログラムの実行時間は比較しない) ---
+echo
+awk -F '\t' -v threshold="$THRESHOLD" -v min_delta="$MIN_DELTA" '
+    !(FILENAME in seen) { seen[FILENAME] = 1; for (c = 1; c <= NF; c++) col[FILENAME, $c] = c; next }
+    FILENAME == ARGV[1] { base[$1] = $0; next }
+    {
+        if (!($1 in base)) { printf "%-16s (not in baseline)\n", $1; next }
+        split(base[$1], b, "\t");
+        n = split("parse_us scan_us command_us spawn_us cleanup_us overhead_us", metrics, " ");
+        for (m = 1; m <= n; m++) {
+            bc = col[ARGV[1], metrics[m]]; cc = col[FILENAME, metrics[m]];
+            if (!bc || !cc) continue;
+            old = b[bc] + 0; cur = $cc + 0;
+            if (cur - old > min_delta && cur > old * (1 + threshold / 100)) {
+                change = (old > 0) ? (cur - old) * 100 / old : 100;
+                printf "REGRESSION %-16s %-12s %10d us -> %10d us (%+.1f%%)\n", $1, metrics[m], old, cur, change;
+                regressions++;
+            }
+        }
+    }
+    END {
+        if (regressions) { printf "%d regression(s) above %s%%.\n", regressions, threshold; exit 1 }
+        printf "No regressions above %s%% (min delta %s us).\n", threshold, min_delta;
+    }' "$BASELINE" "$RESULTS"
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// --compare 用のサンプル: コンパイラや最適化フラグで速さが変わりやすい数値計算ループ
+// 例: crun test/performance/compare_kernel_test.c --compare gcc,clang,gcc:-O3
+#define N 1024
+
+static float a[N], b[N], c[N];
+
+int main(int argc, char* argv[]) {
+    long iterations = (argc > 1) ? atol(argv[1]) : 200000;
+    for (int i = 0; i < N; i++) {
+        a[i] = (float)i * 0.5f;
+        b[i] = (float)(N - i) * 0.25f;
+    }
+
+    // ベクトル化の有無で差が出る saxpy 風のループ
+    float checksum = 0.0f;
+    for (long it = 0; it < iterations; it++) {
+        float s = 0.5f + (float)(it % 7) * 0.001f;
+        for (int i = 0; i < N; i++) c[i] = a[i] * s + b[i];
+        for (int i = 0; i < N; i++) a[i] = c[i] * 0.999f;
+        checksum += c[it % N];
+    }
+
+    // 出力はバリアント間で比較されるため、丸め誤差の出にくい桁数で表示する
+    printf("checksum: %.2e\n", checksum);
+    return 0;
+}
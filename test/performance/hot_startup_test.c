@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// --hot 用のサンプル: 引数と標準入力を受け取り、exit() で終了コードを返す
+// 例: crun test/performance/hot_startup_test.c 3 --hot    (終了コード 3)
+//     echo 1 2 3 | crun test/performance/hot_startup_test.c --hot
+static int g_runs; // ホストで実行するたびに初期化されていること (DLL を毎回読み込み直す)
+
+int main(int argc, char* argv[]) {
+    long sum = 0, value;
+    g_runs++;
+    if (argc > 1) {
+        printf("runs=%d exit=%s\n", g_runs, argv[1]);
+        exit(atoi(argv[1]));
+    }
+    while (scanf("%ld", &value) == 1) sum += value;
+    printf("runs=%d sum=%ld\n", g_runs, sum);
+    return 0;
+}
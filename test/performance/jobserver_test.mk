@@ -0,0 +1,15 @@
+# make のジョブサーバーの動作確認: 各レシピの crun が複数のソースを並列にコンパイルするときに、make のトークンを使う
+# 例: make -j2 -f test/performance/jobserver_test.mk        ("Jobserver: using make's jobserver" が表示される)
+#     crun test/unity/main.c test/unity/counter.c test/unity/format.c -j 2 --verbose   (crun がジョブサーバーを作る)
+CRUN ?= crun
+
+all: unity basic
+
+# + を付けると、make 4.3 以前もジョブサーバーの記述子を crun に渡す
+unity:
+	+$(CRUN) test/unity/main.c test/unity/counter.c test/unity/format.c --verbose
+
+basic:
+	+$(CRUN) test/basic/main.c test/basic/helper.c --verbose
+
+.PHONY: all unity basic
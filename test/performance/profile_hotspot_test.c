@@ -0,0 +1,29 @@
+#include <stdio.h>
+
+// --profile の動作確認用: 処理時間の大半が hot_loop に集中するプログラム
+static volatile double sink;
+
+__attribute__((noinline)) double hot_loop(int n) {
+    double acc = 0.0;
+    for (int i = 1; i <= n; i++) {
+        acc += 1.0 / ((double)i * i);
+    }
+    return acc;
+}
+
+__attribute__((noinline)) double warm_loop(int n) {
+    double acc = 0.0;
+    for (int i = 1; i <= n; i++) {
+        acc += (double)(i % 7);
+    }
+    return acc;
+}
+
+int main() {
+    for (int round = 0; round < 200; round++) {
+        sink = hot_loop(2000000);
+        sink = warm_loop(200000);
+    }
+    printf("done: %f\n", sink);
+    return 0;
+}
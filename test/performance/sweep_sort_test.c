@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// --sweep 用のサンプル: n 個の乱数を qsort で並べる (O(n log n))
+// 例: crun test/performance/sweep_sort_test.c --sweep "N=1000..10000000:x10" {N}
+//     crun test/performance/sweep_sort_test.c --sweep "N=1000..1000000:x10"   (n は標準入力から)
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+    long n = 0;
+    if (argc > 1) n = atol(argv[1]);
+    else if (scanf("%ld", &n) != 1) n = 100000;
+    if (n < 1) return 1;
+
+    int* data = (int*)malloc(sizeof(int) * n);
+    if (!data) return 1;
+    unsigned int state = 12345;
+    for (long i = 0; i < n; i++) {
+        state = state * 1103515245u + 12345u;
+        data[i] = (int)(state >> 1);
+    }
+    qsort(data, n, sizeof(int), compare_ints);
+
+    // 最適化で消されないように結果を使う
+    printf("n=%ld min=%d max=%d\n", n, data[0], data[n - 1]);
+    free(data);
+    return 0;
+}
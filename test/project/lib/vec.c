@@ -0,0 +1,6 @@
+#include <math.h>
+#include "vec.h"
+
+double vec_length(double x, double y) {
+    return sqrt(x * x + y * y);
+}
@@ -0,0 +1,6 @@
+#ifndef VEC_H
+#define VEC_H
+
+double vec_length(double x, double y);
+
+#endif
@@ -0,0 +1,10 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/vec.h"
+
+int main(int argc, char* argv[]) {
+    double x = argc > 1 ? atof(argv[1]) : 3.0;
+    double y = argc > 2 ? atof(argv[2]) : 4.0;
+    printf("length(%g, %g) = %g\n", x, y, vec_length(x, y));
+    return 0;
+}
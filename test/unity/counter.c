@@ -0,0 +1,10 @@
+static int state = 0;
+
+static int step(void) {
+    return 2;
+}
+
+int counter_next(void) {
+    state += step();
+    return state;
+}
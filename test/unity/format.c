@@ -0,0 +1,11 @@
+// crun: no-unity
+// counter.c と同名の static 関数を持つため、ユニティファイルにまとめると再定義エラーになる
+#include <stdio.h>
+
+static int step(void) {
+    return 0;
+}
+
+void format_value(char* buffer, int value) {
+    sprintf(buffer, "value = %d", value + step());
+}
@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+// --unity の動作確認用: crun main.c counter.c format.c --unity --verbose
+int counter_next(void);
+void format_value(char* buffer, int value);
+
+int main(void) {
+    char buffer[64];
+    for (int i = 0; i < 3; i++) {
+        format_value(buffer, counter_next());
+        printf("%s\n", buffer);
+    }
+    return 0;
+}